@@ -27,14 +27,15 @@ struct ColorInOut
 };
 
 vertex ColorInOut depthnormals_skin_vertex( VertexSkin vert [[stage_in]],
-                                            constant Uniforms& uniforms [[ buffer(5) ]])
+                                            constant Uniforms& uniforms [[ buffer(5) ]],
+                                            const device matrix_float4x4* boneMatrices [[ buffer(6) ]])
 {
     ColorInOut out;
     
-    matrix_float4x4 boneTransform = uniforms.boneMatrices[ vert.boneIndex.x ] * vert.boneWeights.x +
-                                    uniforms.boneMatrices[ vert.boneIndex.y ] * vert.boneWeights.y +
-                                    uniforms.boneMatrices[ vert.boneIndex.z ] * vert.boneWeights.z +
-                                    uniforms.boneMatrices[ vert.boneIndex.w ] * vert.boneWeights.w;
+    matrix_float4x4 boneTransform = boneMatrices[ uniforms.boneOffset + vert.boneIndex.x ] * vert.boneWeights.x +
+                                    boneMatrices[ uniforms.boneOffset + vert.boneIndex.y ] * vert.boneWeights.y +
+                                    boneMatrices[ uniforms.boneOffset + vert.boneIndex.z ] * vert.boneWeights.z +
+                                    boneMatrices[ uniforms.boneOffset + vert.boneIndex.w ] * vert.boneWeights.w;
 
     float4 in_position = float4( vert.position.xyz, 1.0 );
     float4 skinnedPosition = boneTransform * in_position;
@@ -21,7 +21,6 @@ struct Uniforms
     float f0;
     float4 tex0scaleOffset;
     float4 tilesXY;
-    matrix_float4x4 boneMatrices[ 80 ];
     int isVR;
     int kernelSize;
     float2 bloomParams;
@@ -33,6 +32,15 @@ struct Uniforms
     float timeStamp; // In seconds.
     float roughness;
     float alphaThreshold;
+    float clusterSliceScale;
+    float clusterSliceBias;
+    uint clusterSliceCount;
+    int particleEmitterCount; // Emitters in the emitter buffer of the particle simulation.
+    uint clusterCountX;
+    uint clusterCountY;
+    uint clusterListBase;
+    uint boneOffset; // First joint matrix of the draw's skin palette in the bone buffer.
+    uint skinnedVertexCount; // Vertices of the submesh that the skinning pre-pass skins.
 };
 
 static float linstep( float low, float high, float v )
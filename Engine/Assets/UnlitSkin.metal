@@ -28,14 +28,15 @@ struct Vertex
 };
 
 vertex ColorInOut unlit_skin_vertex(Vertex vert [[stage_in]],
-                               constant Uniforms& uniforms [[ buffer(5) ]])
+                               constant Uniforms& uniforms [[ buffer(5) ]],
+                               const device matrix_float4x4* boneMatrices [[ buffer(6) ]])
 {
     ColorInOut out;
 
-    matrix_float4x4 boneTransform = uniforms.boneMatrices[ vert.boneIndex.x ] * vert.boneWeights.x +
-                                    uniforms.boneMatrices[ vert.boneIndex.y ] * vert.boneWeights.y +
-                                    uniforms.boneMatrices[ vert.boneIndex.z ] * vert.boneWeights.z +
-                                    uniforms.boneMatrices[ vert.boneIndex.w ] * vert.boneWeights.w;
+    matrix_float4x4 boneTransform = boneMatrices[ uniforms.boneOffset + vert.boneIndex.x ] * vert.boneWeights.x +
+                                    boneMatrices[ uniforms.boneOffset + vert.boneIndex.y ] * vert.boneWeights.y +
+                                    boneMatrices[ uniforms.boneOffset + vert.boneIndex.z ] * vert.boneWeights.z +
+                                    boneMatrices[ uniforms.boneOffset + vert.boneIndex.w ] * vert.boneWeights.w;
     
     float4 in_position = float4( vert.position, 1.0 );
     float4 position2 = boneTransform * in_position;
@@ -62,3 +63,50 @@ fragment float4 unlit_skin_fragment( ColorInOut in [[stage_in]],
     
     return sampledColor * float4( shadow, shadow, shadow, 1 );
 }
+
+// Skinning pre-pass. Vertices are read as floats, because the C++ vertex structs are not aligned like Metal vectors.
+// Must be kept in sync with VertexBuffer::VertexPTNTC_Skinned and VertexBuffer::VertexPTNTC.
+kernel void skin_vertices(
+                  constant Uniforms& uniforms [[ buffer(0) ]],
+                  const device matrix_float4x4* boneMatrices [[ buffer(1) ]],
+                  const device float* skinnedVertices [[ buffer(2) ]],
+                  device float* vertices [[ buffer(3) ]],
+                  uint gid [[thread_position_in_grid]])
+{
+    if (gid >= uniforms.skinnedVertexCount)
+    {
+        return;
+    }
+
+    const device float* in = skinnedVertices + gid * 24;
+    const float4 boneWeights = float4( in[ 16 ], in[ 17 ], in[ 18 ], in[ 19 ] );
+    const int4 boneIndex = int4( as_type< int >( in[ 20 ] ), as_type< int >( in[ 21 ] ), as_type< int >( in[ 22 ] ), as_type< int >( in[ 23 ] ) );
+
+    matrix_float4x4 boneTransform = boneMatrices[ uniforms.boneOffset + boneIndex.x ] * boneWeights.x +
+                                    boneMatrices[ uniforms.boneOffset + boneIndex.y ] * boneWeights.y +
+                                    boneMatrices[ uniforms.boneOffset + boneIndex.z ] * boneWeights.z +
+                                    boneMatrices[ uniforms.boneOffset + boneIndex.w ] * boneWeights.w;
+
+    const float3 position = (boneTransform * float4( in[ 0 ], in[ 1 ], in[ 2 ], 1.0f )).xyz;
+    const float3 normal = (boneTransform * float4( in[ 5 ], in[ 6 ], in[ 7 ], 0.0f )).xyz;
+    const float3 tangent = (boneTransform * float4( in[ 8 ], in[ 9 ], in[ 10 ], 0.0f )).xyz;
+
+    device float* out = vertices + gid * 16;
+    out[ 0 ] = position.x;
+    out[ 1 ] = position.y;
+    out[ 2 ] = position.z;
+    out[ 3 ] = in[ 3 ];
+    out[ 4 ] = in[ 4 ];
+    out[ 5 ] = normal.x;
+    out[ 6 ] = normal.y;
+    out[ 7 ] = normal.z;
+    out[ 8 ] = tangent.x;
+    out[ 9 ] = tangent.y;
+    out[ 10 ] = tangent.z;
+    out[ 11 ] = in[ 11 ];
+
+    for (int i = 12; i < 16; ++i)
+    {
+        out[ i ] = in[ i ];
+    }
+}
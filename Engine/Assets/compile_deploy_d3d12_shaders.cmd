@@ -39,4 +39,5 @@ SET COMPILER=dxc.exe
 %COMPILER% /nologo /all_resources_bound /Ges /WX /O3 -Qembed_debug /Zi /T cs_6_0 /Fo ..\..\..\aether3d_build\Samples\shaders\particle_cull.obj /E CSMain hlsl\particle_cull.hlsl
 %COMPILER% /nologo /all_resources_bound /Ges /WX /O3 -Qembed_debug /Zi /T cs_6_0 /Fo ..\..\..\aether3d_build\Samples\shaders\particle_draw.obj /E CSMain hlsl\particle_draw.hlsl
 %COMPILER% /nologo /all_resources_bound /Ges /WX /O3 -Qembed_debug /Zi /T cs_6_0 /Fo ..\..\..\aether3d_build\Samples\shaders\particle_simulate.obj /E CSMain hlsl\particle_simulate.hlsl
+%COMPILER% /nologo /all_resources_bound /Ges /WX /O3 -Qembed_debug /Zi /T cs_6_0 /Fo ..\..\..\aether3d_build\Samples\shaders\skin_vertices.obj /E CSMain hlsl\skin_vertices.hlsl
 pause
@@ -27,6 +27,7 @@
 %VULKAN_SDK%\bin\dxc.exe -DVULKAN -Ges -spirv -E CSMain -all-resources-bound -T cs_6_0 hlsl\outline.hlsl -Fo ..\..\..\aether3d_build\Samples\shaders\outline.spv
 %VULKAN_SDK%\bin\dxc.exe -DVULKAN -Ges -spirv -E CSMain -all-resources-bound -T cs_6_0 hlsl\particle_cull.hlsl -Fo ..\..\..\aether3d_build\Samples\shaders\particle_cull.spv
 %VULKAN_SDK%\bin\dxc.exe -DVULKAN -Ges -spirv -E CSMain -all-resources-bound -T cs_6_0 hlsl\particle_simulate.hlsl -Fo ..\..\..\aether3d_build\Samples\shaders\particle_simulate.spv
+%VULKAN_SDK%\bin\dxc.exe -DVULKAN -Ges -spirv -E CSMain -all-resources-bound -T cs_6_0 hlsl\skin_vertices.hlsl -Fo ..\..\..\aether3d_build\Samples\shaders\skin_vertices.spv
 %VULKAN_SDK%\bin\dxc.exe -DVULKAN -Ges -spirv -E CSMain -all-resources-bound -T cs_6_0 hlsl\particle_draw.hlsl -Fo ..\..\..\aether3d_build\Samples\shaders\particle_draw.spv
 pause
 
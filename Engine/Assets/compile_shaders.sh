@@ -28,4 +28,5 @@ dxc -DVULKAN -Ges -spirv -E CSMain -all-resources-bound -T cs_6_0 hlsl/outline.h
 dxc -DVULKAN -Ges -spirv -E CSMain -all-resources-bound -T cs_6_0 hlsl/particle_cull.hlsl -Fo ../../../aether3d_build/Samples/shaders/particle_cull.spv
 dxc -DVULKAN -Ges -spirv -E CSMain -all-resources-bound -T cs_6_0 hlsl/particle_draw.hlsl -Fo ../../../aether3d_build/Samples/shaders/particle_draw.spv
 dxc -DVULKAN -Ges -spirv -E CSMain -all-resources-bound -T cs_6_0 hlsl/particle_simulate.hlsl -Fo ../../../aether3d_build/Samples/shaders/particle_simulate.spv
+dxc -DVULKAN -Ges -spirv -E CSMain -all-resources-bound -T cs_6_0 hlsl/skin_vertices.hlsl -Fo ../../../aether3d_build/Samples/shaders/skin_vertices.spv
 
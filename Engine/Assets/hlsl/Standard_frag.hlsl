@@ -12,13 +12,14 @@ struct PS_INPUT
 };
 
 #define TILE_RES 16
+#define CLUSTER_RES 64
 #define LIGHT_INDEX_BUFFER_SENTINEL 0x7fffffff
 //#define DEBUG_LIGHT_COUNT
 
-uint GetNumLightsInThisTile( uint tileIndex )
+uint GetNumLightsInThisTile( uint lightListStart )
 {
     uint numLightsInThisTile = 0;
-    uint index = maxNumLightsPerTile * tileIndex;
+    uint index = lightListStart;
     uint nextLightIndex = perTileLightIndexBuffer[ index ];
 
     // count point lights
@@ -51,6 +52,23 @@ uint GetTileIndex( float2 screenPos )
     return tileIdx;
 }
 
+// Returns the start of the point light list for a tile or a cluster. Cluster lists are compact, so the
+// light index buffer begins with each cluster's list offset.
+uint GetLightListStart( float2 screenPos, float viewDepth )
+{
+    if (clusterSliceCount == 0)
+    {
+        return maxNumLightsPerTile * GetTileIndex( screenPos );
+    }
+
+    const float clusterRes = (float)CLUSTER_RES;
+    uint clusterX = min( (uint)floor( screenPos.x / clusterRes ), clusterCountX - 1 );
+    uint clusterY = min( (uint)floor( screenPos.y / clusterRes ), clusterCountY - 1 );
+    uint slice = (uint)clamp( log( viewDepth ) * clusterSliceScale + clusterSliceBias, 0.0f, (float)(clusterSliceCount - 1) );
+    uint clusterIdx = clusterX + clusterY * clusterCountX + slice * clusterCountX * clusterCountY;
+    return perTileLightIndexBuffer[ clusterListBase + clusterIdx ];
+}
+
 float3 tangentSpaceTransform( float3 tangent, float3 bitangent, float3 normal, float3 v )
 {
     return normalize( v.x * tangent + v.y * bitangent + v.z * normal );
@@ -139,8 +157,8 @@ float4 main( PS_INPUT input ) : SV_Target
     const float4 albedo = tex.Sample( sLinear, float2( input.positionVS_u.w, input.positionWS_v.w ) );
     const float4 normalTS = float4( normalTex.Sample( sLinear, float2(input.positionVS_u.w, input.positionWS_v.w) ).xyz * 2 - 1, 0 );
 
-    const uint tileIndex = GetTileIndex( input.pos.xy );
-    uint index = maxNumLightsPerTile * tileIndex;
+    const uint lightListStart = GetLightListStart( input.pos.xy, abs( input.positionVS_u.z ) );
+    uint index = lightListStart;
     uint nextLightIndex = perTileLightIndexBuffer[ index ];
 
     const float3 normalVS = tangentSpaceTransform( input.tangentVS, input.bitangentVS, input.normalVS, normalTS.xyz );
@@ -275,7 +293,7 @@ float4 main( PS_INPUT input ) : SV_Target
 
     //return float4(accumDiffuseAndSpecular, 1 );
 #ifdef DEBUG_LIGHT_COUNT
-    const uint numLights = GetNumLightsInThisTile( tileIndex );
+    const uint numLights = GetNumLightsInThisTile( lightListStart );
 
     if (numLights == 0)
     {
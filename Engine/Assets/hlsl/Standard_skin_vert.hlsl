@@ -24,10 +24,10 @@ struct PS_INPUT
 
 PS_INPUT main( VS_INPUT input )
 {
-    matrix boneTransform = boneMatrices[ input.boneIndex.x ] * input.boneWeights.x + 
-                           boneMatrices[ input.boneIndex.y ] * input.boneWeights.y +
-                           boneMatrices[ input.boneIndex.z ] * input.boneWeights.z +
-                           boneMatrices[ input.boneIndex.w ] * input.boneWeights.w;
+    matrix boneTransform = boneMatrices[ boneOffset + input.boneIndex.x ] * input.boneWeights.x + 
+                           boneMatrices[ boneOffset + input.boneIndex.y ] * input.boneWeights.y +
+                           boneMatrices[ boneOffset + input.boneIndex.z ] * input.boneWeights.z +
+                           boneMatrices[ boneOffset + input.boneIndex.w ] * input.boneWeights.w;
     const float4 position = mul( boneTransform, float4( input.pos, 1.0f ) );
     const float4 normal = mul( boneTransform, float4( input.normal, 0.0f ) );
     const float4 tangent = mul( boneTransform, float4( input.tangent.xyz, 0.0f ) );
@@ -10,10 +10,10 @@ struct VSOutput
 VSOutput main( float3 pos : POSITION, float2 uv : TEXCOORD, float3 normal : NORMAL, float4 tangent : TANGENT, float4 color : COLOR, float4 boneWeights : WEIGHTS, uint4 boneIndex : BONES )
 {
     VSOutput vsOut;
-    matrix boneTransform = boneMatrices[ boneIndex.x ] * boneWeights.x + 
-                           boneMatrices[ boneIndex.y ] * boneWeights.y +
-                           boneMatrices[ boneIndex.z ] * boneWeights.z +
-                           boneMatrices[ boneIndex.w ] * boneWeights.w;
+    matrix boneTransform = boneMatrices[ boneOffset + boneIndex.x ] * boneWeights.x + 
+                           boneMatrices[ boneOffset + boneIndex.y ] * boneWeights.y +
+                           boneMatrices[ boneOffset + boneIndex.z ] * boneWeights.z +
+                           boneMatrices[ boneOffset + boneIndex.w ] * boneWeights.w;
     const float4 position2 = mul( boneTransform, float4( pos, 1.0f ) );
     const float4 normal2 = mul( boneTransform, float4( normal, 0.0f ) );
 
@@ -8,6 +8,29 @@
 groupshared uint ldsParticleIdxCounter;
 groupshared uint ldsParticlesIdx[ MAX_NUM_PARTICLES_PER_TILE ];
 
+bool3 greaterThan( float3 a, float3 b )
+{
+    return bool3( a.x > b.x, a.y > b.y, a.z > b.z );
+}
+
+// Returns window coordinates in .xy, clip z in .z and 1 in .w or 666 in .w if the position is outside the view.
+float4 GetWindowPosition( float3 worldPosition )
+{
+    float4 clipPos = mul( viewToClip, float4( worldPosition, 1 ) );
+
+#if !VULKAN
+    clipPos.y = -clipPos.y;
+#endif
+    if (any( greaterThan( abs( clipPos.xyz ), float3( abs( clipPos.www ) ) ) ))
+    {
+        return float4( 0, 0, 0, 666 );
+    }
+
+    float3 ndc = clipPos.xyz / clipPos.w;
+    float3 unscaledWindowCoords = 0.5f * ndc + float3( 0.5f, 0.5f, 0.5f );
+    return float4( windowWidth * unscaledWindowCoords.x, windowHeight * unscaledWindowCoords.y, clipPos.z, 1 );
+}
+
 uint GetNumTilesX()
 {
     return (uint)((windowWidth + TILE_RES - 1) / (float)TILE_RES);
@@ -34,12 +57,25 @@ void CSMain( uint3 globalIdx : SV_DispatchThreadID, uint3 localIdx : SV_GroupThr
     for (uint i = 0; i < particleCount; i += NUM_THREADS_PER_TILE)
     {
         uint il = localIdxFlattened + i;
+
+        // Particles that were not simulated this frame belong to stopped or resized emitters.
+        if (il >= particleCount || particles[ il ].lifeTimeSecs.y != timeStamp || particles[ il ].positionAndSize.w == 0)
+        {
+            continue;
+        }
+
         const float sizePad = particles[ il ].positionAndSize.w * 2;
+        const float4 windowPosition = GetWindowPosition( particles[ il ].positionAndSize.xyz );
+
+        // Every tile's group goes through all particles, so the first one stores their positions for the draw pass.
+        if (tileIdxFlattened == 0)
+        {
+            particles[ il ].clipPosition = windowPosition;
+        }
 
-        if (il < particleCount &&
-            particles[ il ].clipPosition.w != 666 && 
-            particles[ il ].clipPosition.x > globalIdx.x - sizePad - TILE_RES && particles[ il ].clipPosition.x < globalIdx.x + TILE_RES + sizePad &&
-            particles[ il ].clipPosition.y > globalIdx.y - sizePad - TILE_RES && particles[ il ].clipPosition.y < globalIdx.y + TILE_RES + sizePad)
+        if (windowPosition.w != 666 && 
+            windowPosition.x > globalIdx.x - sizePad - TILE_RES && windowPosition.x < globalIdx.x + TILE_RES + sizePad &&
+            windowPosition.y > globalIdx.y - sizePad - TILE_RES && windowPosition.y < globalIdx.y + TILE_RES + sizePad)
         {
             uint dstIdx = 0;
             InterlockedAdd( ldsParticleIdxCounter, 1, dstIdx );
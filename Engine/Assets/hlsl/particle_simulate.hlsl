@@ -6,44 +6,74 @@ float rand_1_05( float2 uv )
     return abs( nois.x + nois.y ) * 0.5;
 }
 
-bool3 greaterThan( float3 a, float3 b )
+// Must match ParticleEmitter in Renderer.hpp.
+static const uint EmitterSize = 112;
+
+// Returns the emitter whose thread range contains threadIndex. Emitters are sorted by their first thread.
+uint FindEmitter( uint threadIndex )
 {
-    return bool3( a.x > b.x, a.y > b.y, a.z > b.z );
+    uint first = 0;
+    uint last = (uint)particleEmitterCount - 1;
+
+    while (first < last)
+    {
+        const uint middle = (first + last + 1) / 2;
+
+        if (computeInput.Load( middle * EmitterSize + 88 ) <= threadIndex)
+        {
+            first = middle;
+        }
+        else
+        {
+            last = middle - 1;
+        }
+    }
+
+    return first;
 }
 
 [numthreads( 64, 1, 1 )]
 void CSMain( uint3 globalIdx : SV_DispatchThreadID, uint3 localIdx : SV_GroupThreadID, uint3 groupIdx : SV_GroupID )
 {
-    const uint i = globalIdx.x;
-    float2 uv = globalIdx.xy;
-    float ra = rand_1_05( uv );
-    float x = 1;
-    float4 position = float4( x * 8 * sin( globalIdx.x * 20 + timeStamp ), globalIdx.x % 20, x * 8 * cos( globalIdx.x * 20 + timeStamp ), 1 );
-    position = mul( localToWorld, position );
-
-    if (particleReset == 1)
+    if (globalIdx.x >= (uint)particleCount)
     {
-        particles[ i ].lifeTimeSecs = float4( timeStamp, 0, 0, 0 );
+        return;
     }
-        
-    particles[ i ].positionAndSize = position;
-    particles[ i ].positionAndSize.w = 5;
-    particles[ i ].color = particleColor;
 
-    float4 clipPos = mul( viewToClip, position );
+    // One dispatch simulates the live ranges of all emitters back to back.
+    const uint emitter = FindEmitter( globalIdx.x ) * EmitterSize;
+    // Matrix44 is row-major in memory.
+    const float4x4 emitterLocalToWorld = transpose( float4x4( asfloat( computeInput.Load4( emitter ) ), asfloat( computeInput.Load4( emitter + 16 ) ),
+                                                              asfloat( computeInput.Load4( emitter + 32 ) ), asfloat( computeInput.Load4( emitter + 48 ) ) ) );
+    const float4 emitterColor = asfloat( computeInput.Load4( emitter + 64 ) );
+    const uint emitterParticleOffset = computeInput.Load( emitter + 80 );
+    const uint emitterFirstThread = computeInput.Load( emitter + 88 );
+    const float emitterEmissionRate = asfloat( computeInput.Load( emitter + 92 ) );
+    const float emitterLifeTime = asfloat( computeInput.Load( emitter + 96 ) );
+
+    const uint particleIndex = globalIdx.x - emitterFirstThread;
+    const uint i = emitterParticleOffset + particleIndex;
 
-#if !VULKAN
-    clipPos.y = -clipPos.y;
-#endif
-    if (any( greaterThan( abs( clipPos.xyz ), float3( abs( clipPos.www ) ) ) ))
+    // Particle n is emitted at n / emissionRate seconds and re-emitted after every lifetime, so the live particles
+    // are always the first particles of the emitter's range.
+    const float age = timeStamp - particleIndex / emitterEmissionRate;
+    particles[ i ].lifeTimeSecs = float4( fmod( max( age, 0 ), emitterLifeTime ), timeStamp, 0, 0 );
+
+    // Size 0 marks particles that have not been emitted yet.
+    if (age < 0)
     {
-        particles[ i ].clipPosition = float4( 0, 0, 0, 666 );
+        particles[ i ].positionAndSize.w = 0;
         return;
     }
-    
-    float3 ndc = clipPos.xyz / clipPos.w;
-    float3 unscaledWindowCoords = 0.5f * ndc + float3( 0.5f, 0.5f, 0.5f );
-    float3 windowCoords = float3( windowWidth * unscaledWindowCoords.x, windowHeight * unscaledWindowCoords.y, unscaledWindowCoords.z );
 
-    particles[ i ].clipPosition = float4( windowCoords.x, windowCoords.y, clipPos.z, 1 );
+    float2 uv = float2( particleIndex, globalIdx.y );
+    float ra = rand_1_05( uv );
+    float x = 1;
+    float4 position = float4( x * 8 * sin( particleIndex * 20 + timeStamp ), particleIndex % 20 + particles[ i ].lifeTimeSecs.x, x * 8 * cos( particleIndex * 20 + timeStamp ), 1 );
+    position = mul( emitterLocalToWorld, position );
+
+    // Simulation doesn't depend on the camera. Culling projects particles for each camera.
+    particles[ i ].positionAndSize = position;
+    particles[ i ].positionAndSize.w = 5;
+    particles[ i ].color = emitterColor;
 }
@@ -0,0 +1,39 @@
+#include "ubo.h"
+
+// Must be kept in sync with VertexBuffer::VertexPTNTC_Skinned and VertexBuffer::VertexPTNTC.
+static const uint SkinnedVertexStride = 96;
+static const uint VertexStride = 64;
+
+[numthreads( 64, 1, 1 )]
+void CSMain( uint3 globalIdx : SV_DispatchThreadID )
+{
+    if (globalIdx.x >= skinnedVertexCount)
+    {
+        return;
+    }
+
+    const uint inAddress = globalIdx.x * SkinnedVertexStride;
+    const float3 position = asfloat( computeInput.Load3( inAddress ) );
+    const float2 uv = asfloat( computeInput.Load2( inAddress + 12 ) );
+    const float3 normal = asfloat( computeInput.Load3( inAddress + 20 ) );
+    const float4 tangent = asfloat( computeInput.Load4( inAddress + 32 ) );
+    const float4 color = asfloat( computeInput.Load4( inAddress + 48 ) );
+    const float4 boneWeights = asfloat( computeInput.Load4( inAddress + 64 ) );
+    const uint4 boneIndex = computeInput.Load4( inAddress + 80 );
+
+    // Same as the skin vertex shaders.
+    matrix boneTransform = boneMatrices[ boneOffset + boneIndex.x ] * boneWeights.x + 
+                           boneMatrices[ boneOffset + boneIndex.y ] * boneWeights.y +
+                           boneMatrices[ boneOffset + boneIndex.z ] * boneWeights.z +
+                           boneMatrices[ boneOffset + boneIndex.w ] * boneWeights.w;
+    const float3 skinnedPosition = mul( boneTransform, float4( position, 1.0f ) ).xyz;
+    const float3 skinnedNormal = mul( boneTransform, float4( normal, 0.0f ) ).xyz;
+    const float3 skinnedTangent = mul( boneTransform, float4( tangent.xyz, 0.0f ) ).xyz;
+
+    const uint outAddress = globalIdx.x * VertexStride;
+    computeOutput.Store3( outAddress, asuint( skinnedPosition ) );
+    computeOutput.Store2( outAddress + 12, asuint( uv ) );
+    computeOutput.Store3( outAddress + 20, asuint( skinnedNormal ) );
+    computeOutput.Store4( outAddress + 32, asuint( float4( skinnedTangent, tangent.w ) ) );
+    computeOutput.Store4( outAddress + 48, asuint( color ) );
+}
@@ -4,7 +4,7 @@ struct Particle
     float4 positionAndSize;
     float4 color;
     float4 clipPosition; // Screen-space position.
-    float4 lifeTimeSecs;
+    float4 lifeTimeSecs; // .x: age, .y: timeStamp of the last simulation.
 };
 
 #if !VULKAN
@@ -36,7 +36,6 @@ cbuffer cbPerFrame : register(b0)
     float f0;
     float4 tex0scaleOffset;
     float4 tilesXY;
-    matrix boneMatrices[ 80 ];
     int isVR;
     int kernelSize;
     float2 bloomParams;
@@ -48,6 +47,15 @@ cbuffer cbPerFrame : register(b0)
     float timeStamp; // In seconds
     float roughness;
     float alphaThreshold;
+    float clusterSliceScale; // Depth slice is log( viewDepth ) * clusterSliceScale + clusterSliceBias.
+    float clusterSliceBias;
+    uint clusterSliceCount; // 0 when lights are culled per tile.
+    int particleEmitterCount; // Emitters in computeInput of the particle simulation.
+    uint clusterCountX; // Cluster grid size of the camera's render target.
+    uint clusterCountY;
+    uint clusterListBase; // First cluster offset of the camera in perTileLightIndexBuffer.
+    uint boneOffset; // First joint matrix of the draw's skin palette in boneMatrices.
+    uint skinnedVertexCount; // Vertices of the submesh that the skinning pre-pass skins.
 };
 Buffer<float4> pointLightBufferCenterAndRadius : register(t5);
 RWBuffer<uint> perTileLightIndexBuffer : register(u0);
@@ -58,6 +66,9 @@ Buffer<float4> spotLightColors : register(t9);
 RWTexture2D<float4> rwTexture : register(u1);
 RWStructuredBuffer< Particle > particles : register(u2);
 RWBuffer<uint> perTileParticleIndexBuffer : register(u3);
+StructuredBuffer< matrix > boneMatrices : register(t10);
+ByteAddressBuffer computeInput : register(t11); // Skinning: VertexPTNTC_Skinned vertices. Particle simulation: ParticleEmitters.
+RWByteAddressBuffer computeOutput : register(u4); // Skinning: VertexPTNTC vertices.
 
 #else
 
@@ -89,7 +100,6 @@ RWBuffer<uint> perTileParticleIndexBuffer : register(u3);
     float f0;
     float4 tex0scaleOffset;
     float4 tilesXY;
-    matrix boneMatrices[ 80 ];
     int isVR;
     int kernelSize;
     float2 bloomParams;
@@ -101,6 +111,15 @@ RWBuffer<uint> perTileParticleIndexBuffer : register(u3);
     float timeStamp; // In seconds.
     float roughness;
     float alphaThreshold;
+    float clusterSliceScale; // Depth slice is log( viewDepth ) * clusterSliceScale + clusterSliceBias.
+    float clusterSliceBias;
+    uint clusterSliceCount; // 0 when lights are culled per tile.
+    int particleEmitterCount; // Emitters in computeInput of the particle simulation.
+    uint clusterCountX; // Cluster grid size of the camera's render target.
+    uint clusterCountY;
+    uint clusterListBase; // First cluster offset of the camera in perTileLightIndexBuffer.
+    uint boneOffset; // First joint matrix of the draw's skin palette in boneMatrices.
+    uint skinnedVertexCount; // Vertices of the submesh that the skinning pre-pass skins.
 };
 [[vk::binding( 8 )]] Buffer<float4> pointLightBufferCenterAndRadius;
 [[vk::binding( 9 )]] RWBuffer<uint> perTileLightIndexBuffer;
@@ -111,4 +130,7 @@ RWBuffer<uint> perTileParticleIndexBuffer : register(u3);
 [[vk::binding( 14 )]] RWTexture2D<float4> rwTexture;
 [[vk::binding( 15 )]] RWStructuredBuffer< Particle > particles;
 [[vk::binding( 16 )]] RWBuffer<uint> perTileParticleIndexBuffer;
+[[vk::binding( 17 )]] StructuredBuffer< matrix > boneMatrices;
+[[vk::binding( 18 )]] ByteAddressBuffer computeInput; // Skinning: VertexPTNTC_Skinned vertices. Particle simulation: ParticleEmitters.
+[[vk::binding( 19 )]] RWByteAddressBuffer computeOutput; // Skinning: VertexPTNTC vertices.
 #endif
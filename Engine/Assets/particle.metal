@@ -16,7 +16,7 @@ struct Particle
     float4 positionAndSize;
     float4 color;
     float4 clipPosition;
-    float4 lifeTimeSecs;
+    float4 lifeTimeSecs; // .x: age, .y: timeStamp of the last simulation.
 };
 
 float rand_1_05( float2 uv )
@@ -25,33 +25,97 @@ float rand_1_05( float2 uv )
     return abs( nois.x + nois.y ) * 0.5;
 }
 
+// Must match Renderer.hpp.
+struct ParticleEmitter
+{
+    float4x4 localToWorld;
+    float4 color;
+    int particleOffset;
+    int particleCount;
+    int firstThread;
+    float emissionRate;
+    float lifeTime;
+    float padding[ 3 ];
+};
+
+// Returns the emitter whose thread range contains threadIndex. Emitters are sorted by their first thread.
+uint FindEmitter( const device ParticleEmitter* emitters, uint emitterCount, uint threadIndex )
+{
+    uint first = 0;
+    uint last = emitterCount - 1;
+
+    while (first < last)
+    {
+        const uint middle = (first + last + 1) / 2;
+
+        if ((uint)emitters[ middle ].firstThread <= threadIndex)
+        {
+            first = middle;
+        }
+        else
+        {
+            last = middle - 1;
+        }
+    }
+
+    return first;
+}
+
 kernel void particle_simulation(
                   constant Uniforms& uniforms [[ buffer(0) ]],
                   device Particle* particleBufferOut [[ buffer(1) ]],
-                  ushort2 gid [[thread_position_in_grid]],
+                  const device ParticleEmitter* emitters [[ buffer(2) ]],
+                  uint2 gid [[thread_position_in_grid]],
                   ushort2 tid [[thread_position_in_threadgroup]],
                   ushort2 dtid [[threadgroup_position_in_grid]])
 {
-    float2 uv = (float2)gid.xy;
+    if (gid.x >= (uint)uniforms.particleCount)
+    {
+        return;
+    }
+
+    // One dispatch simulates the live ranges of all emitters back to back.
+    const device ParticleEmitter& emitter = emitters[ FindEmitter( emitters, (uint)uniforms.particleEmitterCount, gid.x ) ];
+    const uint particleIndex = gid.x - (uint)emitter.firstThread;
+    const uint i = (uint)emitter.particleOffset + particleIndex;
+
+    // Particle n is emitted at n / emissionRate seconds and re-emitted after every lifetime, so the live particles
+    // are always the first particles of the emitter's range.
+    const float age = uniforms.timeStamp - particleIndex / emitter.emissionRate;
+    particleBufferOut[ i ].lifeTimeSecs = float4( fmod( max( age, 0.0f ), emitter.lifeTime ), uniforms.timeStamp, 0, 0 );
+
+    // Size 0 marks particles that have not been emitted yet.
+    if (age < 0)
+    {
+        particleBufferOut[ i ].positionAndSize.w = 0;
+        return;
+    }
+
+    float2 uv = float2( particleIndex, gid.y );
     float x = rand_1_05( uv );
-    float4 position = float4( x * 8 * sin( gid.x * 20 + uniforms.timeStamp ), gid.x % 20, x * 8 * cos( gid.x * 20 + uniforms.timeStamp ), 1 );
-    position = uniforms.localToWorld * position;
-    
-    float4 clipPos = uniforms.viewToClip * position;
-    clipPos.y = - clipPos.y;
-    float3 ndc = clipPos.xyz / clipPos.w;
-    float3 unscaledWindowCoords = 0.5f * ndc + float3( 0.5f, 0.5f, 0.5f );
-    float3 windowCoords = float3( uniforms.windowWidth * unscaledWindowCoords.x, uniforms.windowHeight * unscaledWindowCoords.y, unscaledWindowCoords.z );
+    float4 position = float4( x * 8 * sin( particleIndex * 20 + uniforms.timeStamp ), particleIndex % 20 + particleBufferOut[ i ].lifeTimeSecs.x, x * 8 * cos( particleIndex * 20 + uniforms.timeStamp ), 1 );
+    position = emitter.localToWorld * position;
 
-    particleBufferOut[ gid.x ].positionAndSize = position;
-    particleBufferOut[ gid.x ].positionAndSize.w = 5;
-    particleBufferOut[ gid.x ].color = uniforms.particleColor;
-    particleBufferOut[ gid.x ].clipPosition = float4( windowCoords.x, windowCoords.y, clipPos.z, clipPos.w );
-    
-    if (uniforms.particleReset == 1)
+    // Simulation doesn't depend on the camera. Culling projects particles for each camera.
+    particleBufferOut[ i ].positionAndSize = position;
+    particleBufferOut[ i ].positionAndSize.w = 5;
+    particleBufferOut[ i ].color = emitter.color;
+}
+
+// Returns window coordinates in .xy and clip z and w in .zw or 666 in .w if the position is outside the view.
+float4 GetWindowPosition( constant Uniforms& uniforms, float3 worldPosition )
+{
+    float4 clipPos = uniforms.viewToClip * float4( worldPosition, 1 );
+    clipPos.y = -clipPos.y;
+
+    if (any( abs( clipPos.xyz ) > abs( clipPos.www ) ))
     {
-        particleBufferOut[ gid.x ].lifeTimeSecs = float4( 0, 0, 0, 0 );
+        return float4( 0, 0, 0, 666 );
     }
+
+    float3 ndc = clipPos.xyz / clipPos.w;
+    float3 unscaledWindowCoords = 0.5f * ndc + float3( 0.5f, 0.5f, 0.5f );
+    return float4( uniforms.windowWidth * unscaledWindowCoords.x, uniforms.windowHeight * unscaledWindowCoords.y, clipPos.z, clipPos.w );
 }
 
 uint GetNumTilesX( uint windowWidth )
@@ -87,11 +151,25 @@ kernel void particle_cull(
     for (uint i = 0; i < (uint)uniforms.particleCount; i += NUM_THREADS_PER_TILE)
     {
         uint il = localIdxFlattened + i;
+
+        // Particles that were not simulated this frame belong to stopped or resized emitters.
+        if (il >= (uint)uniforms.particleCount || particles[ il ].lifeTimeSecs.y != uniforms.timeStamp || particles[ il ].positionAndSize.w == 0)
+        {
+            continue;
+        }
+
         const float sizePad = particles[ il ].positionAndSize.w * 2;
-        
-        if (il < (uint)uniforms.particleCount &&
-            particles[ il ].clipPosition.x > globalIdx.x - sizePad - TILE_RES && particles[ il ].clipPosition.x < globalIdx.x + TILE_RES + sizePad &&
-            particles[ il ].clipPosition.y > globalIdx.y - sizePad - TILE_RES && particles[ il ].clipPosition.y < globalIdx.y + TILE_RES + sizePad)
+        const float4 windowPosition = GetWindowPosition( uniforms, particles[ il ].positionAndSize.xyz );
+
+        // Every tile's threadgroup goes through all particles, so the first one stores their positions for the draw pass.
+        if (tileIdxFlattened == 0)
+        {
+            particles[ il ].clipPosition = windowPosition;
+        }
+
+        if (windowPosition.w != 666 &&
+            windowPosition.x > globalIdx.x - sizePad - TILE_RES && windowPosition.x < globalIdx.x + TILE_RES + sizePad &&
+            windowPosition.y > globalIdx.y - sizePad - TILE_RES && windowPosition.y < globalIdx.y + TILE_RES + sizePad)
         {
             uint dstIdx = atomic_fetch_add_explicit( &ldsParticleIdxCounter, 1, memory_order::memory_order_relaxed );
             ldsParticlesIdx[ dstIdx ] = il;
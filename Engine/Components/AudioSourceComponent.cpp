@@ -1,5 +1,7 @@
 #include "AudioSourceComponent.hpp"
 #include "AudioSystem.hpp"
+#include "GameObject.hpp"
+#include "TransformComponent.hpp"
 #include <string>
 
 static constexpr int MaxComponents = 30;
@@ -27,11 +29,13 @@ void ae3d::AudioSourceComponent::SetClipId( unsigned audioClipId )
     clipId = audioClipId;
 }
 
-void ae3d::AudioSourceComponent::Play() const
+void ae3d::AudioSourceComponent::Play()
 {
     if (isEnabled)
     {
-        AudioSystem::Play( clipId, isLooping );
+        TransformComponent* transform = gameObject ? gameObject->GetComponent< TransformComponent >() : nullptr;
+        const Vec3 position = transform ? transform->GetWorldPosition() : Vec3( 0, 0, 0 );
+        voiceId = AudioSystem::Play( clipId, isLooping, is3D, position.x, position.y, position.z );
     }
 }
 
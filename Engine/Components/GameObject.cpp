@@ -26,10 +26,16 @@ ae3d::GameObject::GameObject( const GameObject& other )
     *this = other;
 }
 
+void ae3d::GameObject::ReleaseComponent( ParticleSystemComponent* component )
+{
+    component->ReleaseParticles();
+}
+
 ae3d::GameObject::~GameObject()
 {
     if (GetComponent< ParticleSystemComponent >())
     {
+        ReleaseComponent( GetComponent< ParticleSystemComponent >() );
         GetComponent< ParticleSystemComponent >()->gameObject = nullptr;
     }
 }
@@ -37,6 +43,12 @@ ae3d::GameObject::~GameObject()
 GameObject& ae3d::GameObject::operator=( const GameObject& go )
 {
     name = go.name;
+
+    if (GetComponent< ParticleSystemComponent >())
+    {
+        ReleaseComponent( GetComponent< ParticleSystemComponent >() );
+        GetComponent< ParticleSystemComponent >()->gameObject = nullptr;
+    }
     
     for (unsigned i = 0; i < MaxComponents; ++i)
     {
@@ -119,6 +131,8 @@ GameObject& ae3d::GameObject::operator=( const GameObject& go )
         AddComponent< ParticleSystemComponent >();
         *GetComponent< ParticleSystemComponent >() = *go.GetComponent< ParticleSystemComponent >();
         GetComponent< ParticleSystemComponent >()->gameObject = this;
+        // The copy allocates its own range in its first QueueSimulation().
+        GetComponent< ParticleSystemComponent >()->particleOffset = -1;
     }
 
     if (go.GetComponent< DecalRendererComponent >())
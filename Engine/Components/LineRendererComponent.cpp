@@ -6,6 +6,11 @@ ae3d::LineRendererComponent::LineRendererComponent()
 
 }
 
+namespace SceneGlobal
+{
+    extern unsigned debugLineSourceVersion;
+}
+
 static constexpr int MaxComponents = 30;
 
 ae3d::LineRendererComponent lineRendererComponents[ MaxComponents ];
@@ -13,6 +18,8 @@ unsigned nextFreeLineRendererComponent = 0;
 
 unsigned ae3d::LineRendererComponent::New()
 {
+    ++SceneGlobal::debugLineSourceVersion;
+
     if (nextFreeLineRendererComponent == MaxComponents - 1)
     {
         return nextFreeLineRendererComponent;
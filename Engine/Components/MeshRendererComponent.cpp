@@ -3,12 +3,14 @@
 #include "MeshRendererComponent.hpp"
 #include <string>
 #include <vector>
+#include "ComputeShader.hpp"
 #include "Frustum.hpp"
 #include "GfxDevice.hpp"
 #include "Matrix.hpp"
 #include "Mesh.hpp"
 #include "Material.hpp"
 #include "Shader.hpp"
+#include "Profiler.hpp"
 #include "Statistics.hpp"
 #include "System.hpp"
 #include "SubMesh.hpp"
@@ -22,22 +24,44 @@ namespace GfxDeviceGlobal
     extern PerObjectUboStruct perObjectUboStruct;
 }
 
-namespace MathUtil
+#if RENDERER_D3D12
+void TransitionResource( GpuResource& gpuResource, D3D12_RESOURCE_STATES newState );
+#endif
+
+namespace SceneGlobal
 {
-    void GetMinMax( const Vec3* aPoints, int count, Vec3& outMin, Vec3& outMax );
-    void GetCorners( const Vec3& min, const Vec3& max, Vec3 outCorners[ 8 ] );
+    extern unsigned debugLineSourceVersion;
 }
 
 std::vector< ae3d::MeshRendererComponent > meshRendererComponents;
 unsigned nextFreeMeshRendererComponent = 0;
 
+// Output of the skinning pre-pass. Components refer to these by index, so VertexBuffer stays out of the public header.
+struct SkinnedVertexBuffer
+{
+    VertexBuffer vertexBuffer;
+    // Submesh buffer and counts that vertexBuffer's indices were generated from.
+    VertexBuffer* source = nullptr;
+    int vertexCount = 0;
+    int faceCount = 0;
+};
+
+std::vector< SkinnedVertexBuffer > skinnedVertexBuffers;
+
+static bool IsSame( const Vec3& a, const Vec3& b )
+{
+    return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
 unsigned ae3d::MeshRendererComponent::New()
 {
     if (nextFreeMeshRendererComponent == meshRendererComponents.size())
     {
         meshRendererComponents.resize( meshRendererComponents.size() + 10 );
     }
-    
+
+    // A copied renderer can have bounding box drawing enabled.
+    ++SceneGlobal::debugLineSourceVersion;
     return nextFreeMeshRendererComponent++;
 }
 
@@ -73,40 +97,78 @@ std::string GetSerialized( ae3d::MeshRendererComponent* component )
     return outStr;
 }
 
-void ae3d::MeshRendererComponent::Cull( const class Frustum& cameraFrustum, const struct Matrix44& localToWorld )
+bool ae3d::MeshRendererComponent::UpdateWorldAABB( const Matrix44& localToWorld )
+{
+    // Objects without a mesh still contribute a unit box to the scene AABB.
+    const Vec3 aabbMin = mesh ? mesh->GetAABBMin() : Vec3( -1, -1, -1 );
+    const Vec3 aabbMax = mesh ? mesh->GetAABBMax() : Vec3(  1,  1,  1 );
+
+    // Mesh's AABB is compared too, because hot-reloading can change it.
+    if (!isWorldAabbDirty && IsSame( aabbMin, aabbMinLocal ) && IsSame( aabbMax, aabbMaxLocal ))
+    {
+        bool isSameMatrix = true;
+
+        for (int i = 0; i < 16; ++i)
+        {
+            isSameMatrix &= localToWorld.m[ i ] == aabbLocalToWorld.m[ i ];
+        }
+
+        if (isSameMatrix)
+        {
+            return false;
+        }
+    }
+
+    isWorldAabbDirty = false;
+    aabbLocalToWorld = localToWorld;
+    aabbMinLocal = aabbMin;
+    aabbMaxLocal = aabbMax;
+    Matrix44::TransformAABB( aabbMin, aabbMax, localToWorld, aabbMinWorld, aabbMaxWorld );
+
+    int subMeshCount = 0;
+    SubMesh* subMeshes = mesh ? mesh->GetSubMeshes( subMeshCount ) : nullptr;
+
+    for (int subMeshIndex = 0; subMeshIndex < subMeshCount; ++subMeshIndex)
+    {
+        Matrix44::TransformAABB( subMeshes[ subMeshIndex ].aabbMin, subMeshes[ subMeshIndex ].aabbMax, localToWorld,
+                                 subMeshAabbMinWorld[ subMeshIndex ], subMeshAabbMaxWorld[ subMeshIndex ] );
+    }
+
+    return true;
+}
+
+void ae3d::MeshRendererComponent::GetSubMeshWorldAABB( unsigned subMeshIndex, Vec3& outMin, Vec3& outMax ) const
+{
+    System::Assert( subMeshIndex < subMeshAabbMinWorld.count, "GetSubMeshWorldAABB: invalid submesh index" );
+
+    if (subMeshIndex < subMeshAabbMinWorld.count)
+    {
+        outMin = subMeshAabbMinWorld[ subMeshIndex ];
+        outMax = subMeshAabbMaxWorld[ subMeshIndex ];
+    }
+}
+
+void ae3d::MeshRendererComponent::Cull( const class Frustum& cameraFrustum )
 {
     if (!mesh)
     {
         return;
     }
 
-    System::BeginTimer();
+    Profiler::BeginZone( "Frustum cull" );
 
     isCulled = false;
     
-    Vec3 aabbWorld[ 8 ];
-    MathUtil::GetCorners( mesh->GetAABBMin(), mesh->GetAABBMax(), aabbWorld );
-    
-    for (std::size_t v = 0; v < 8; ++v)
-    {
-        Matrix44::TransformPoint( aabbWorld[ v ], localToWorld, &aabbWorld[ v ] );
-    }
-    
-    Vec3 aabbMinWorld;
-    Vec3 aabbMaxWorld;
-    MathUtil::GetMinMax( aabbWorld, 8, aabbMinWorld, aabbMaxWorld );
-    
     if (!cameraFrustum.BoxInFrustum( aabbMinWorld, aabbMaxWorld ))
     {
         isCulled = true;
-        Statistics::IncFrustumCullTime( System::EndTimer() );
+        Statistics::IncFrustumCullTime( Profiler::EndZone() );
         return;
     }
 
-    int subMeshCount = 0;
-    SubMesh* subMeshes = mesh->GetSubMeshes( subMeshCount);
+    const unsigned subMeshCount = isSubMeshCulled.count;
 
-    for (int subMeshIndex = 0; subMeshIndex < subMeshCount; ++subMeshIndex)
+    for (unsigned subMeshIndex = 0; subMeshIndex < subMeshCount; ++subMeshIndex)
     {
         isSubMeshCulled[ subMeshIndex ] = false;
 
@@ -116,49 +178,238 @@ void ae3d::MeshRendererComponent::Cull( const class Frustum& cameraFrustum, cons
             continue;
         }
         
-        Vec3 meshAabbMinWorld = subMeshes[ subMeshIndex ].aabbMin;
-        Vec3 meshAabbMaxWorld = subMeshes[ subMeshIndex ].aabbMax;
-        
-        Vec3 meshAabbWorld[ 8 ];
-        MathUtil::GetCorners( meshAabbMinWorld, meshAabbMaxWorld, meshAabbWorld );
-        
-        for (std::size_t v = 0; v < 8; ++v)
-        {
-            Matrix44::TransformPoint( meshAabbWorld[ v ], localToWorld, &meshAabbWorld[ v ] );
-        }
-        
-        MathUtil::GetMinMax( meshAabbWorld, 8, meshAabbMinWorld, meshAabbMaxWorld );
-        
-        if (!cameraFrustum.BoxInFrustum( meshAabbMinWorld, meshAabbMaxWorld ))
+        if (!cameraFrustum.BoxInFrustum( subMeshAabbMinWorld[ subMeshIndex ], subMeshAabbMaxWorld[ subMeshIndex ] ))
         {
             isSubMeshCulled[ subMeshIndex ] = true;
         }
     }
     
-    Statistics::IncFrustumCullTime( System::EndTimer() );
+    Statistics::IncFrustumCullTime( Profiler::EndZone() );
 }
 
-void ae3d::MeshRendererComponent::ApplySkin( unsigned subMeshIndex )
+bool ae3d::MeshRendererComponent::IsSkinned()
 {
     int subMeshCount = 0;
-    SubMesh* subMeshes = mesh->GetSubMeshes( subMeshCount );
+    SubMesh* subMeshes = mesh ? mesh->GetSubMeshes( subMeshCount ) : nullptr;
 
-    if (!subMeshes[ subMeshIndex ].joints.empty())
+    for (int subMeshIndex = 0; subMeshIndex < subMeshCount; ++subMeshIndex)
     {
+        if (!subMeshes[ subMeshIndex ].joints.empty())
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void ae3d::MeshRendererComponent::UpdateSkinPalette()
+{
+    int subMeshCount = 0;
+    SubMesh* subMeshes = mesh ? mesh->GetSubMeshes( subMeshCount ) : nullptr;
+
+    unsigned jointCount = 0;
+
+    for (int subMeshIndex = 0; subMeshIndex < subMeshCount; ++subMeshIndex)
+    {
+        jointCount += static_cast< unsigned >( subMeshes[ subMeshIndex ].joints.size() );
+    }
+
+    if (isSkinPaletteValid && skinPaletteFrame == animFrame && skinPaletteMesh == mesh && skinPaletteJointCount == jointCount &&
+        subMeshPaletteOffsets.size() == static_cast< std::size_t >( subMeshCount ))
+    {
+        return;
+    }
+
+    subMeshPaletteOffsets.resize( subMeshCount );
+    skinPalette.resize( jointCount );
+    unsigned paletteOffset = 0;
+
+    for (int subMeshIndex = 0; subMeshIndex < subMeshCount; ++subMeshIndex)
+    {
+        subMeshPaletteOffsets[ subMeshIndex ] = paletteOffset;
+        Matrix44* palette = skinPalette.data() + paletteOffset;
+        paletteOffset += static_cast< unsigned >( subMeshes[ subMeshIndex ].joints.size() );
+
         for (std::size_t j = 0; j < subMeshes[ subMeshIndex ].joints.size(); ++j)
         {
             const auto& joint = subMeshes[ subMeshIndex ].joints[ j ];
             
-            if (!joint.animTransforms.empty())
+            if (joint.animation.frameCount > 0)
+            {
+                Matrix44 animTransform;
+                joint.animation.Sample( animFrame, animTransform );
+                Matrix44::Multiply( joint.globalBindposeInverse, animTransform, palette[ j ] );
+            }
+            else
             {
-                const std::size_t frames = joint.animTransforms.size();
-                Matrix44::Multiply( joint.globalBindposeInverse,
-                                   joint.animTransforms[ animFrame % frames ],
-                                   GfxDeviceGlobal::perObjectUboStruct.boneMatrices[ j ] );
+                palette[ j ].MakeIdentity();
             }
         }
     }
 
+    isSkinPaletteValid = true;
+    skinPaletteFrame = animFrame;
+    skinPaletteMesh = mesh;
+    skinPaletteJointCount = jointCount;
+    // The bone buffer has the old palette, if any.
+    skinPaletteBoneFrame = ~0u;
+    areSkinnedVerticesDirty = true;
+}
+
+void ae3d::MeshRendererComponent::PrepareSkinnedVertexBuffers()
+{
+    int subMeshCount = 0;
+    SubMesh* subMeshes = (isSkinningPrePassEnabled && mesh) ? mesh->GetSubMeshes( subMeshCount ) : nullptr;
+
+    if (skinnedVertexBufferIndices.size() < static_cast< std::size_t >( subMeshCount ))
+    {
+        skinnedVertexBufferIndices.resize( subMeshCount, -1 );
+    }
+
+    for (int subMeshIndex = 0; subMeshIndex < subMeshCount; ++subMeshIndex)
+    {
+        SubMesh& subMesh = subMeshes[ subMeshIndex ];
+
+        if (subMesh.joints.empty() || subMesh.verticesPTNTC_Skinned.empty())
+        {
+            continue;
+        }
+
+        int& bufferIndex = skinnedVertexBufferIndices[ subMeshIndex ];
+
+        if (bufferIndex == -1)
+        {
+            bufferIndex = static_cast< int >( skinnedVertexBuffers.size() );
+            skinnedVertexBuffers.push_back( SkinnedVertexBuffer() );
+        }
+
+        SkinnedVertexBuffer& skinned = skinnedVertexBuffers[ bufferIndex ];
+        const int vertexCount = static_cast< int >( subMesh.verticesPTNTC_Skinned.size() );
+        const int faceCount = static_cast< int >( subMesh.indices.size() );
+
+        // Indices are copied at generation, so the buffer is regenerated when the mesh changes.
+        if (skinned.source != &subMesh.vertexBuffer || skinned.vertexCount != vertexCount || skinned.faceCount != faceCount)
+        {
+            skinned.vertexBuffer.GenerateWritable( subMesh.indices.data(), faceCount, vertexCount );
+            skinned.source = &subMesh.vertexBuffer;
+            skinned.vertexCount = vertexCount;
+            skinned.faceCount = faceCount;
+            areSkinnedVerticesDirty = true;
+        }
+    }
+}
+
+void ae3d::MeshRendererComponent::SkinVertices( ComputeShader& skinningShader )
+{
+    if (!isSkinningPrePassEnabled || !areSkinnedVerticesDirty || !mesh)
+    {
+        return;
+    }
+
+    for (unsigned subMeshIndex = 0; subMeshIndex < skinnedVertexBufferIndices.size(); ++subMeshIndex)
+    {
+        VertexBuffer* skinnedVertexBuffer = GetSkinnedVertexBuffer( subMeshIndex );
+
+        if (!skinnedVertexBuffer)
+        {
+            continue;
+        }
+
+        const SkinnedVertexBuffer& skinned = skinnedVertexBuffers[ skinnedVertexBufferIndices[ subMeshIndex ] ];
+        const int vertexCount = skinned.vertexCount;
+        const unsigned groupCount = (vertexCount + 63) / 64;
+
+        GfxDeviceGlobal::perObjectUboStruct.boneOffset = skinPaletteBoneOffset + subMeshPaletteOffsets[ subMeshIndex ];
+        GfxDeviceGlobal::perObjectUboStruct.skinnedVertexCount = vertexCount;
+
+#if RENDERER_D3D12
+        D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+        srvDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+        srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+        srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+        srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
+        srvDesc.Buffer.NumElements = vertexCount * sizeof( VertexBuffer::VertexPTNTC_Skinned ) / 4;
+
+        D3D12_UNORDERED_ACCESS_VIEW_DESC uavDesc = {};
+        uavDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+        uavDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+        uavDesc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_RAW;
+        uavDesc.Buffer.NumElements = vertexCount * sizeof( VertexBuffer::VertexPTNTC ) / 4;
+
+        GpuResource* skinnedVertices = skinnedVertexBuffer->GetWritableVertices();
+        TransitionResource( *skinnedVertices, D3D12_RESOURCE_STATE_UNORDERED_ACCESS );
+        skinningShader.SetSRV( 11, skinned.source->GetVBResource(), srvDesc );
+        skinningShader.SetUAV( 4, skinnedVertices->resource, uavDesc );
+#endif
+#if RENDERER_VULKAN
+        // Sub-meshes' dispatches are recorded into one submission, so each one needs its own UBO.
+        GfxDevice::GetNewUniformBuffer();
+        skinningShader.SetBuffer( 0, *skinned.source->GetVertexBuffer() );
+        skinningShader.SetBuffer( 1, *skinnedVertexBuffer->GetVertexBuffer() );
+#endif
+#if RENDERER_METAL
+        skinningShader.SetUniformBuffer( 1, GfxDevice::GetCurrentBoneBuffer() );
+        skinningShader.SetUniformBuffer( 2, skinned.source->GetVertexBuffer() );
+        skinningShader.SetUniformBuffer( 3, skinnedVertexBuffer->GetVertexBuffer() );
+        skinningShader.Dispatch( groupCount, 1, 1, "Skinning", 64, 1 );
+#else
+        skinningShader.Dispatch( groupCount, 1, 1, "Skinning" );
+#endif
+#if RENDERER_D3D12
+        TransitionResource( *skinnedVertices, D3D12_RESOURCE_STATE_VERTEX_AND_CONSTANT_BUFFER );
+#endif
+    }
+
+    areSkinnedVerticesDirty = false;
+}
+
+VertexBuffer* ae3d::MeshRendererComponent::GetSkinnedVertexBuffer( unsigned subMeshIndex )
+{
+    if (!isSkinningPrePassEnabled || !mesh || subMeshIndex >= skinnedVertexBufferIndices.size() || skinnedVertexBufferIndices[ subMeshIndex ] == -1)
+    {
+        return nullptr;
+    }
+
+    // The submesh can have a buffer from an earlier mesh that was skinned.
+    int subMeshCount = 0;
+    SubMesh* subMeshes = mesh->GetSubMeshes( subMeshCount );
+
+    if (static_cast< int >( subMeshIndex ) >= subMeshCount || subMeshes[ subMeshIndex ].joints.empty() ||
+        skinnedVertexBuffers[ skinnedVertexBufferIndices[ subMeshIndex ] ].source != &subMeshes[ subMeshIndex ].vertexBuffer)
+    {
+        return nullptr;
+    }
+
+    return &skinnedVertexBuffers[ skinnedVertexBufferIndices[ subMeshIndex ] ].vertexBuffer;
+}
+
+void ae3d::MeshRendererComponent::UploadSkinPalette()
+{
+    if (skinPaletteBoneFrame == GfxDevice::GetBoneBufferFrame() || skinPalette.empty())
+    {
+        return;
+    }
+
+    skinPaletteBoneOffset = GfxDevice::UploadBoneMatrices( skinPalette.data(), static_cast< unsigned >( skinPalette.size() ) );
+    skinPaletteBoneFrame = GfxDevice::GetBoneBufferFrame();
+}
+
+void ae3d::MeshRendererComponent::ApplySkin( unsigned subMeshIndex )
+{
+    int subMeshCount = 0;
+    SubMesh* subMeshes = mesh->GetSubMeshes( subMeshCount );
+
+    if (subMeshes[ subMeshIndex ].joints.empty())
+    {
+        return;
+    }
+
+    // Scene::Render() updates and uploads palettes before rendering. This handles meshes that are rendered outside of it.
+    UpdateSkinPalette();
+    UploadSkinPalette();
+
+    GfxDeviceGlobal::perObjectUboStruct.boneOffset = skinPaletteBoneOffset + subMeshPaletteOffsets[ subMeshIndex ];
 }
 
 void ae3d::MeshRendererComponent::Render( const Matrix44& localToView, const Matrix44& localToClip, const Matrix44& localToWorld,
@@ -191,8 +442,9 @@ void ae3d::MeshRendererComponent::Render( const Matrix44& localToView, const Mat
         }
 
         Shader* shader = overrideShader ? overrideShader : materials[ subMeshIndex ]->GetShader();
+        VertexBuffer* skinnedVertexBuffer = GetSkinnedVertexBuffer( subMeshIndex );
         
-        if (overrideSkinShader && !subMeshes[ subMeshIndex ].joints.empty())
+        if (overrideSkinShader && !subMeshes[ subMeshIndex ].joints.empty() && !skinnedVertexBuffer)
         {
             shader = overrideSkinShader;
         }
@@ -217,7 +469,11 @@ void ae3d::MeshRendererComponent::Render( const Matrix44& localToView, const Mat
 
             GfxDeviceGlobal::perObjectUboStruct.localToClip = localToClip;
             GfxDeviceGlobal::perObjectUboStruct.localToView = localToView;
-            ApplySkin( subMeshIndex );
+
+            if (!skinnedVertexBuffer)
+            {
+                ApplySkin( subMeshIndex );
+            }
         }
         else
         {
@@ -235,7 +491,10 @@ void ae3d::MeshRendererComponent::Render( const Matrix44& localToView, const Mat
             GfxDeviceGlobal::perObjectUboStruct.localToWorld = localToWorld;
             GfxDeviceGlobal::perObjectUboStruct.localToShadowClip = localToShadowClip;
 
-            ApplySkin( subMeshIndex );
+            if (!skinnedVertexBuffer)
+            {
+                ApplySkin( subMeshIndex );
+            }
             
             if (!materials[ subMeshIndex ]->IsBackFaceCulled())
             {
@@ -264,54 +523,8 @@ void ae3d::MeshRendererComponent::Render( const Matrix44& localToView, const Mat
             depthFunc = GfxDevice::DepthFunc::NoneWriteOff;
         }
         
-        GfxDevice::Draw( subMeshes[ subMeshIndex ].vertexBuffer, 0, subMeshes[ subMeshIndex ].vertexBuffer.GetFaceCount() / 3,
+        GfxDevice::Draw( skinnedVertexBuffer ? *skinnedVertexBuffer : subMeshes[ subMeshIndex ].vertexBuffer, 0, subMeshes[ subMeshIndex ].vertexBuffer.GetFaceCount() / 3,
                          *shader, blendMode, depthFunc, cullMode, isWireframe ? GfxDevice::FillMode::Wireframe : GfxDevice::FillMode::Solid, GfxDevice::PrimitiveTopology::Triangles );
-
-        if (isAabbDrawingEnabled)
-        {
-            Vec3 aabb[ 8 ];
-            MathUtil::GetCorners( mesh->GetAABBMin(), mesh->GetAABBMax(), aabb );
-    
-            Vec3 aabbMin, aabbMax;
-            MathUtil::GetMinMax( aabb, 8, aabbMin, aabbMax );
-
-            const int lineCount = 24;
-            Vec3 lines[ lineCount ] =
-            {
-                Vec3( aabbMin.x, aabbMin.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMin.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMin.y, aabbMax.z ) * 1.1f,
-                Vec3( aabbMin.x, aabbMin.y, aabbMax.z ) * 1.1f,
-
-                Vec3( aabbMin.x, aabbMax.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMax.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMax.y, aabbMax.z ) * 1.1f,
-                Vec3( aabbMin.x, aabbMax.y, aabbMax.z ) * 1.1f,
-
-                Vec3( aabbMin.x, aabbMax.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMin.x, aabbMax.y, aabbMax.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMax.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMax.y, aabbMax.z ) * 1.1f,
-
-                Vec3( aabbMin.x, aabbMin.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMin.x, aabbMin.y, aabbMax.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMin.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMin.y, aabbMax.z ) * 1.1f,
-
-                Vec3( aabbMin.x, aabbMin.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMin.x, aabbMax.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMin.y, aabbMin.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMax.y, aabbMin.z ) * 1.1f,
-
-                Vec3( aabbMin.x, aabbMin.y, aabbMax.z ) * 1.1f,
-                Vec3( aabbMin.x, aabbMax.y, aabbMax.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMin.y, aabbMax.z ) * 1.1f,
-                Vec3( aabbMax.x, aabbMax.y, aabbMax.z ) * 1.1f,
-            };
-
-            GfxDevice::UpdateLineBuffer( aabbLineHandle, lines, lineCount, Vec3( 1, 0, 0 ) );
-            GfxDevice::DrawLines( aabbLineHandle, *shader );
-        }
     }
 }
 
@@ -325,20 +538,10 @@ void ae3d::MeshRendererComponent::SetMaterial( Material* material, unsigned subM
 
 void ae3d::MeshRendererComponent::EnableBoundingBoxDrawing( bool enable )
 {
-    isAabbDrawingEnabled = enable;
-
-    if (enable && aabbLineHandle == -1)
+    if (isAabbDrawingEnabled != enable)
     {
-        constexpr unsigned LineCount = 24;
-        Vec3 lines[ LineCount ];
-    
-        for (unsigned i = 0; i < LineCount / 2; ++i)
-        {
-            lines[ i * 2 + 0 ] = Vec3( 0, 0, 0 );
-            lines[ i * 2 + 1 ] = Vec3( 0, 0, 0 );
-        }
-
-        aabbLineHandle = GfxDevice::CreateLineBuffer( lines, LineCount, Vec3( 1, 1, 1 ) );
+        isAabbDrawingEnabled = enable;
+        ++SceneGlobal::debugLineSourceVersion;
     }
 }
 
@@ -350,6 +553,8 @@ bool ae3d::MeshRendererComponent::IsBoundingBoxDrawingEnabled() const
 void ae3d::MeshRendererComponent::SetMesh( Mesh* aMesh )
 {
     mesh = aMesh;
+    isWorldAabbDirty = true;
+    areSkinnedVerticesDirty = true;
 
     if (mesh != nullptr)
     {
@@ -357,5 +562,7 @@ void ae3d::MeshRendererComponent::SetMesh( Mesh* aMesh )
         mesh->GetSubMeshes( subMeshCount );
         materials.Allocate( subMeshCount );
         isSubMeshCulled.Allocate( subMeshCount );
+        subMeshAabbMinWorld.Allocate( subMeshCount );
+        subMeshAabbMaxWorld.Allocate( subMeshCount );
     }
 }
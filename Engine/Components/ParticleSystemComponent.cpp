@@ -1,4 +1,7 @@
 #include "ParticleSystemComponent.hpp"
+#include <algorithm>
+#include <cmath>
+#include <vector>
 #include "Array.hpp"
 #include "ComputeShader.hpp"
 #include "GfxDevice.hpp"
@@ -14,6 +17,9 @@ namespace GfxDeviceGlobal
 {
     extern ID3D12Resource* particleBuffer;
     extern ID3D12Resource* particleTileBuffer;
+    extern ID3D12Resource* particleEmitterBuffer;
+    extern ae3d::ParticleEmitter* particleEmitters;
+    extern D3D12_SHADER_RESOURCE_VIEW_DESC particleEmitterSrvDesc;
     extern D3D12_UNORDERED_ACCESS_VIEW_DESC uav2Desc;
     extern D3D12_UNORDERED_ACCESS_VIEW_DESC uav3Desc;
     extern ID3D12GraphicsCommandList* graphicsCommandList;
@@ -26,6 +32,7 @@ void TransitionResource( GpuResource& gpuResource, D3D12_RESOURCE_STATES newStat
 #if RENDERER_METAL
 extern id< MTLBuffer > particleBuffer;
 extern id< MTLBuffer > particleTileBuffer;
+extern id< MTLBuffer > particleEmitterBuffers[ 2 ];
 
 namespace GfxDeviceGlobal
 {
@@ -41,12 +48,112 @@ namespace GfxDeviceGlobal
 }
 
 extern VkBuffer particleTileBuffer;
+extern VkBuffer particleEmitterBuffer;
+extern ae3d::ParticleEmitter* particleEmitters;
 
 #endif
 
+#if RENDERER_NULL
+namespace GfxDeviceGlobal
+{
+    extern PerObjectUboStruct perObjectUboStruct;
+}
+#endif
+
 Array< ae3d::ParticleSystemComponent > particleSystemComponents;
 unsigned nextFreeParticleSystemComponent = 0;
 
+// Range of particles in the particle buffer.
+struct ParticleRange
+{
+    int offset;
+    int count;
+};
+
+namespace ParticleSystemGlobal
+{
+    std::vector< ParticleRange > freeRanges;
+    // Particles at and after this index have not been allocated, so culling doesn't look at them.
+    int usedCount = 0;
+    // Emitters queued for the next simulation dispatch, in the order of their first threads.
+    std::vector< ae3d::ParticleEmitter > emitters;
+    // Live particles of the queued emitters.
+    int queuedParticleCount = 0;
+    // Emitters that didn't fit in the emitter buffer since the last simulation.
+    int skippedEmitterCount = 0;
+#if RENDERER_METAL
+    unsigned simulationCount = 0;
+#endif
+}
+
+// Returns the first particle of the allocated range or -1 if the particle buffer is full.
+static int AllocateParticles( int count )
+{
+    for (std::size_t i = 0; i < ParticleSystemGlobal::freeRanges.size(); ++i)
+    {
+        ParticleRange& range = ParticleSystemGlobal::freeRanges[ i ];
+
+        if (range.count >= count)
+        {
+            const int offset = range.offset;
+            range.offset += count;
+            range.count -= count;
+
+            if (range.count == 0)
+            {
+                ParticleSystemGlobal::freeRanges.erase( ParticleSystemGlobal::freeRanges.begin() + i );
+            }
+
+            return offset;
+        }
+    }
+
+    if (ParticleSystemGlobal::usedCount + count > static_cast< int >( ae3d::MaxParticleCount ))
+    {
+        return -1;
+    }
+
+    const int offset = ParticleSystemGlobal::usedCount;
+    ParticleSystemGlobal::usedCount += count;
+    return offset;
+}
+
+static void FreeParticles( int offset, int count )
+{
+    std::vector< ParticleRange >& freeRanges = ParticleSystemGlobal::freeRanges;
+
+    // Free ranges are kept sorted by offset, so the freed range can be merged with its neighbours.
+    std::size_t next = 0;
+
+    while (next < freeRanges.size() && freeRanges[ next ].offset < offset)
+    {
+        ++next;
+    }
+
+    if (next > 0 && freeRanges[ next - 1 ].offset + freeRanges[ next - 1 ].count == offset)
+    {
+        --next;
+        freeRanges[ next ].count += count;
+    }
+    else
+    {
+        freeRanges.insert( freeRanges.begin() + next, { offset, count } );
+    }
+
+    if (next + 1 < freeRanges.size() && freeRanges[ next ].offset + freeRanges[ next ].count == freeRanges[ next + 1 ].offset)
+    {
+        freeRanges[ next ].count += freeRanges[ next + 1 ].count;
+        freeRanges.erase( freeRanges.begin() + next + 1 );
+    }
+
+    // Gives a free range at the end back to the unallocated space, so that culling has fewer particles to check.
+    if (!freeRanges.empty() && freeRanges.back().offset + freeRanges.back().count == ParticleSystemGlobal::usedCount)
+    {
+        ParticleSystemGlobal::usedCount = freeRanges.back().offset;
+        freeRanges.pop_back();
+    }
+}
+
 unsigned ae3d::ParticleSystemComponent::New()
 {
     if (nextFreeParticleSystemComponent == particleSystemComponents.count)
@@ -62,71 +169,138 @@ ae3d::ParticleSystemComponent* ae3d::ParticleSystemComponent::Get( unsigned inde
     return &particleSystemComponents[ index ];
 }
 
-bool ae3d::ParticleSystemComponent::IsAnyAlive()
+void ae3d::ParticleSystemComponent::ReleaseParticles()
 {
-    for (unsigned i = 0; i < particleSystemComponents.count; ++i)
+    if (particleOffset != -1)
     {
-        if (particleSystemComponents[ i ].gameObject != nullptr)
-        {
-            return true;
-        }
+        FreeParticles( particleOffset, maxParticles );
+        particleOffset = -1;
     }
-
-    return false;
 }
 
 void ae3d::ParticleSystemComponent::SetMaxParticles( int count )
 {
+    const int oldMaxParticles = maxParticles;
+
     if (count < 100000)
     {
-        maxParticles = count;
+        maxParticles = count > 0 ? count : 1;
     }
     else
     {
         System::Print( "Too many particles in SetMaxParticles! Tried to set %d, max is 100000.\n", count );
         maxParticles = 99999;
     }
+
+    // The range is allocated again with the new size in the next QueueSimulation().
+    if (particleOffset != -1 && maxParticles != oldMaxParticles)
+    {
+        FreeParticles( particleOffset, oldMaxParticles );
+        particleOffset = -1;
+    }
+}
+
+int ae3d::ParticleSystemComponent::GetLiveParticleCount() const
+{
+    return static_cast< int >( std::min( static_cast< float >( maxParticles ), std::ceil( emissionRate * lifeTime ) ) );
+}
+
+void ae3d::ParticleSystemComponent::QueueSimulation( const Matrix44& localToWorld )
+{
+    const int liveParticleCount = GetLiveParticleCount();
+
+    if (!isEnabled || liveParticleCount == 0)
+    {
+        return;
+    }
+
+    if (ParticleSystemGlobal::emitters.size() == MaxParticleEmitterCount)
+    {
+        ++ParticleSystemGlobal::skippedEmitterCount;
+        return;
+    }
+
+    if (particleOffset == -1)
+    {
+        particleOffset = AllocateParticles( maxParticles );
+
+        if (particleOffset == -1)
+        {
+            System::Print( "Particle buffer is full! Could not allocate %d particles.\n", maxParticles );
+            return;
+        }
+    }
+
+    ParticleEmitter emitter;
+    emitter.localToWorld = localToWorld;
+    emitter.color = Vec4( red, green, blue, 1 );
+    emitter.particleOffset = particleOffset;
+    emitter.particleCount = liveParticleCount;
+    // Emitters' threads follow each other, so the shader finds a thread's emitter with a binary search.
+    emitter.firstThread = ParticleSystemGlobal::queuedParticleCount;
+    emitter.emissionRate = emissionRate;
+    emitter.lifeTime = lifeTime;
+    ParticleSystemGlobal::emitters.push_back( emitter );
+    ParticleSystemGlobal::queuedParticleCount += liveParticleCount;
 }
 
 void ae3d::ParticleSystemComponent::Simulate( ComputeShader& simulationShader )
 {
-    if (!ParticleSystemComponent::IsAnyAlive() || !isEnabled)
+    std::vector< ParticleEmitter >& emitters = ParticleSystemGlobal::emitters;
+
+    if (ParticleSystemGlobal::skippedEmitterCount > 0)
+    {
+        System::Print( "Too many particle systems! Skipped %d, max is %u.\n", ParticleSystemGlobal::skippedEmitterCount, MaxParticleEmitterCount );
+        ParticleSystemGlobal::skippedEmitterCount = 0;
+    }
+
+    if (emitters.empty())
     {
         return;
     }
-    
-    GfxDeviceGlobal::perObjectUboStruct.particleCount = maxParticles;
-    GfxDeviceGlobal::perObjectUboStruct.particleColor.x = red;
-    GfxDeviceGlobal::perObjectUboStruct.particleColor.y = green;
-    GfxDeviceGlobal::perObjectUboStruct.particleColor.z = blue;
-    GfxDeviceGlobal::perObjectUboStruct.particleColor.w = 1;
-    
-    simulationShader.Begin();
+
+    GfxDeviceGlobal::perObjectUboStruct.particleCount = ParticleSystemGlobal::queuedParticleCount;
+    GfxDeviceGlobal::perObjectUboStruct.particleEmitterCount = static_cast< int >( emitters.size() );
+
+    // Only live particles are simulated, so an emitter's cost depends on its emission rate, not its max particles.
+    const unsigned groupCount = (ParticleSystemGlobal::queuedParticleCount + 63) / 64;
 
 #if RENDERER_D3D12
+    std::copy( emitters.begin(), emitters.end(), GfxDeviceGlobal::particleEmitters );
     simulationShader.SetUAV( 2, GfxDeviceGlobal::particleBuffer, GfxDeviceGlobal::uav2Desc );
+    simulationShader.SetSRV( 11, GfxDeviceGlobal::particleEmitterBuffer, GfxDeviceGlobal::particleEmitterSrvDesc );
+#endif
+#if RENDERER_VULKAN
+    std::copy( emitters.begin(), emitters.end(), particleEmitters );
+    simulationShader.SetBuffer( 0, particleEmitterBuffer );
 #endif
 #if RENDERER_METAL
+    id< MTLBuffer > emitterBuffer = particleEmitterBuffers[ ParticleSystemGlobal::simulationCount % 2 ];
+    ++ParticleSystemGlobal::simulationCount;
+    std::copy( emitters.begin(), emitters.end(), (ParticleEmitter*)[emitterBuffer contents] );
     simulationShader.SetUniformBuffer( 1, particleBuffer );
-    simulationShader.Dispatch( GfxDeviceGlobal::perObjectUboStruct.particleCount / 64, 1, 1, "Particle Simulation", 64, 1 );
+    simulationShader.SetUniformBuffer( 2, emitterBuffer );
+    simulationShader.Dispatch( groupCount, 1, 1, "Particle Simulation", 64, 1 );
 #else
-    simulationShader.Dispatch( GfxDeviceGlobal::perObjectUboStruct.particleCount / 64, 1, 1, "Particle Simulation" );
+    simulationShader.Dispatch( groupCount, 1, 1, "Particle Simulation" );
 #endif
-    simulationShader.End();
 
     GfxDeviceGlobal::perObjectUboStruct.particleReset = 0;
+    emitters.clear();
+    ParticleSystemGlobal::queuedParticleCount = 0;
 }
 
 void ae3d::ParticleSystemComponent::Cull( ComputeShader& cullShader )
 {
-    if (!ParticleSystemComponent::IsAnyAlive() || !isEnabled) 
+    if (ParticleSystemGlobal::usedCount == 0)
     {
         return;
     }
 
+    // Culling reads the whole allocated part of the particle buffer and skips particles that were not simulated this frame.
     GfxDeviceGlobal::perObjectUboStruct.windowWidth = GfxDevice::backBufferWidth;
     GfxDeviceGlobal::perObjectUboStruct.windowHeight = GfxDevice::backBufferHeight;
-    GfxDeviceGlobal::perObjectUboStruct.particleCount = maxParticles;
+    GfxDeviceGlobal::perObjectUboStruct.particleCount = ParticleSystemGlobal::usedCount;
     cullShader.Begin();
 
 #if RENDERER_D3D12
@@ -145,14 +319,14 @@ void ae3d::ParticleSystemComponent::Cull( ComputeShader& cullShader )
 
 void ae3d::ParticleSystemComponent::Draw( ComputeShader& drawShader, RenderTexture& target )
 {
-    if (!ParticleSystemComponent::IsAnyAlive() || !isEnabled)
+    if (ParticleSystemGlobal::usedCount == 0)
     {
         return;
     }
 
     GfxDeviceGlobal::perObjectUboStruct.windowWidth = GfxDevice::backBufferWidth;
     GfxDeviceGlobal::perObjectUboStruct.windowHeight = GfxDevice::backBufferHeight;
-    GfxDeviceGlobal::perObjectUboStruct.particleCount = maxParticles;
+    GfxDeviceGlobal::perObjectUboStruct.particleCount = ParticleSystemGlobal::usedCount;
     drawShader.Begin();
 #if RENDERER_D3D12
     TransitionResource( *target.GetGpuResource(), D3D12_RESOURCE_STATE_UNORDERED_ACCESS );
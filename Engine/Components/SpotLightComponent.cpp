@@ -51,7 +51,7 @@ std::string GetSerialized( const ae3d::SpotLightComponent* component )
 {
     std::string outStr = "spotlight\nshadow ";
     outStr += std::to_string( component->CastsShadow() ? 1 : 0 );
-    outStr += "\nconeAngle ";
+    outStr += "\nconeangle ";
     outStr += std::to_string( component->GetConeAngle() );
     outStr += "\nspotlight_enabled ";
     outStr += std::to_string( component->IsEnabled() ? 1 : 0 );
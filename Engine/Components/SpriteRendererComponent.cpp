@@ -26,6 +26,7 @@ namespace GfxDeviceGlobal
 struct Drawable
 {
     ae3d::TextureBase* texture = ae3d::Texture2D::GetDefaultTexture();
+    int chunk = 0;
     int bufferStart = 0;
     int bufferEnd = 0;
 };
@@ -36,129 +37,204 @@ struct Sprite
     ae3d::Vec3 position;
     ae3d::Vec3 dimension;
     ae3d::Vec4 tint;
+    ae3d::Vec4 scaleOffset;
 };
 
 namespace
 {
-void CreateVertexBuffer( std::vector< Sprite >& sprites, ae3d::VertexBuffer& outVertexBuffer )
+const int QuadVertexCount = 4;
+const int QuadFaceCount = 2;
+// Batches are split into chunks of as many sprites as 16-bit indices can address.
+const int MaxSpritesPerChunk = ae3d::VertexBuffer::MaxQuadCount;
+
+// Transparent sprites are drawn with alpha blending.
+bool IsTransparent( const ae3d::TextureBase* texture, const ae3d::Vec4& tint )
 {
-    const int quadVertexCount = 4;
-    const int quadFaceCount = 2;
-    std::vector< ae3d::VertexBuffer::VertexPTC > vertices( sprites.size() * quadVertexCount );
-    std::vector< ae3d::VertexBuffer::Face > faces( sprites.size() * quadFaceCount );
-    
-    // TODO: evaluate perf and consider other containers.
-    std::sort( sprites.begin(), sprites.end(), [](const Sprite& a, const Sprite& b) { return a.texture->GetID() < b.texture->GetID(); } );
-    
-    for (unsigned short i = 0; i < static_cast<unsigned short>(sprites.size()); ++i)
-    {
-        const auto& dim = sprites[ i ].dimension;
-        vertices[ i * quadVertexCount + 0 ].position = sprites[ i ].position;
-        vertices[ i * quadVertexCount + 1 ].position = sprites[ i ].position + ae3d::Vec3( dim.x, 0, 0 );
-        vertices[ i * quadVertexCount + 2 ].position = sprites[ i ].position + ae3d::Vec3( dim.x, dim.y, 0 );
-        vertices[ i * quadVertexCount + 3 ].position = sprites[ i ].position + ae3d::Vec3( 0, dim.y, 0 );
-        
-        for (int v = 0; v < quadVertexCount; ++v)
-        {
-            vertices[ i * quadVertexCount + v ].color = sprites[i].tint;
-        }
-        
-        const ae3d::Vec4& so = sprites[i].texture->GetScaleOffset();
+    return !texture->IsOpaque() || static_cast< int >( tint.w ) != 1;
+}
 
-        const float u0 = 0.0f * so.x + so.z;
-        const float u1 = 1.0f * so.x + so.z;
+void WriteQuad( const Sprite& sprite, ae3d::VertexBuffer::VertexPTNTC* outVertices )
+{
+    const auto& dim = sprite.dimension;
+    outVertices[ 0 ].position = sprite.position;
+    outVertices[ 1 ].position = sprite.position + ae3d::Vec3( dim.x, 0, 0 );
+    outVertices[ 2 ].position = sprite.position + ae3d::Vec3( dim.x, dim.y, 0 );
+    outVertices[ 3 ].position = sprite.position + ae3d::Vec3( 0, dim.y, 0 );
 
-        const float v0 = 0.0f * so.y + so.w;
-        const float v1 = 1.0f * so.y + so.w;
+    const ae3d::Vec4& so = sprite.scaleOffset;
 
-        vertices[ i * quadVertexCount + 0 ].u = u0;
-        vertices[ i * quadVertexCount + 0 ].v = v0;
-        
-        vertices[ i * quadVertexCount + 1 ].u = u1;
-        vertices[ i * quadVertexCount + 1 ].v = v0;
-        
-        vertices[ i * quadVertexCount + 2 ].u = u1;
-        vertices[ i * quadVertexCount + 2 ].v = v1;
-        
-        vertices[ i * quadVertexCount + 3 ].u = u0;
-        vertices[ i * quadVertexCount + 3 ].v = v1;
-        
-        auto& tri1 = faces[ i * quadFaceCount + 0 ];
-        tri1.a = i * quadVertexCount + 0;
-        tri1.b = i * quadVertexCount + 1;
-        tri1.c = i * quadVertexCount + 2;
-        
-        auto& tri2 = faces[ i * quadFaceCount + 1 ];
-        tri2.a = i * quadVertexCount + 2;
-        tri2.b = i * quadVertexCount + 3;
-        tri2.c = i * quadVertexCount + 0;
-    }
-    
-    outVertexBuffer.Generate( faces.data(), static_cast<int>(faces.size()), vertices.data(), static_cast<int>(vertices.size()), ae3d::VertexBuffer::Storage::GPU );
-    outVertexBuffer.SetDebugName( "sprite buffer" );
-}
+    const float u0 = 0.0f * so.x + so.z;
+    const float u1 = 1.0f * so.x + so.z;
 
-void CreateDrawables( const std::vector< Sprite >& sprites, std::vector< Drawable >& outDrawables )
-{
-    outDrawables.clear();
-    
-    if (sprites.empty())
+    const float v0 = 0.0f * so.y + so.w;
+    const float v1 = 1.0f * so.y + so.w;
+
+    outVertices[ 0 ].u = u0;
+    outVertices[ 0 ].v = v0;
+
+    outVertices[ 1 ].u = u1;
+    outVertices[ 1 ].v = v0;
+
+    outVertices[ 2 ].u = u1;
+    outVertices[ 2 ].v = v1;
+
+    outVertices[ 3 ].u = u0;
+    outVertices[ 3 ].v = v1;
+
+    for (int v = 0; v < QuadVertexCount; ++v)
     {
-        return;
-    }
-    
-    outDrawables.emplace_back( Drawable() );
-    auto& back = outDrawables.back();
-    back.texture = sprites[0].texture;
-    back.bufferStart = 0;
-    back.bufferEnd = 2;
-    
-    for (std::size_t s = 1; s < sprites.size(); ++s)
-    {
-        if (sprites[s].texture == sprites[s - 1].texture)
-        {
-            outDrawables.back().bufferEnd += 2;
-        }
-        else
-        {
-            const int oldEnd = outDrawables.back().bufferEnd;
-            
-            outDrawables.emplace_back( Drawable() );
-            auto& back2 = outDrawables.back();
-            back2.texture = sprites[s].texture;
-            back2.bufferStart = oldEnd;
-            back2.bufferEnd = oldEnd + 2;
-        }
+        outVertices[ v ].normal = ae3d::Vec3( 0, 0, 1 );
+        outVertices[ v ].tangent = ae3d::Vec4( 1, 0, 0, 0 );
+        outVertices[ v ].color = sprite.tint;
     }
 }
 }
 
+// Sprites are kept in a persistent vertex buffer ordered by texture. Adding a sprite re-sorts the queue,
+// moving or tinting one only rewrites its quad.
 struct RenderQueue
 {
     void Clear();
+    int Add( const Sprite& sprite, unsigned handle );
+    void Remove( int spriteIndex, std::vector< int >& spriteIndices );
+    void Update( int spriteIndex );
     void Build();
     void Render( ae3d::GfxDevice::BlendMode blendMode, const float* localToClip );
-    
+
     bool isDirty = true;
+    // Quads in [dirtyQuadBegin, dirtyQuadEnd) have changed since the last upload.
+    int dirtyQuadBegin = 0;
+    int dirtyQuadEnd = 0;
+    // In the order sprites were added to this queue.
     std::vector< Sprite > sprites;
+    // Sprite handle of each sprite.
+    std::vector< unsigned > spriteHandles;
+    // Sprite's quad index in the vertex buffer.
+    std::vector< int > spriteQuads;
     std::vector< Drawable > drawables;
-    ae3d::VertexBuffer vertexBuffer;
+    std::vector< ae3d::VertexBuffer::VertexPTNTC > vertices;
+    std::vector< ae3d::VertexBuffer > chunks;
+    // Sprite count allocated for each chunk.
+    std::vector< int > chunkCapacities;
 };
 
 void RenderQueue::Clear()
 {
     sprites.clear();
+    spriteHandles.clear();
+    spriteQuads.clear();
+    isDirty = true;
+}
+
+int RenderQueue::Add( const Sprite& sprite, unsigned handle )
+{
+    sprites.emplace_back( sprite );
+    spriteHandles.push_back( handle );
+    isDirty = true;
+    return static_cast< int >( sprites.size() ) - 1;
+}
+
+// Keeps the order of the remaining sprites and updates their indices in spriteIndices, which is indexed by sprite handle.
+void RenderQueue::Remove( int spriteIndex, std::vector< int >& spriteIndices )
+{
+    sprites.erase( sprites.begin() + spriteIndex );
+    spriteHandles.erase( spriteHandles.begin() + spriteIndex );
+
+    for (int i = spriteIndex; i < static_cast< int >( spriteHandles.size() ); ++i)
+    {
+        spriteIndices[ spriteHandles[ i ] ] = i;
+    }
+
     isDirty = true;
 }
 
+void RenderQueue::Update( int spriteIndex )
+{
+    if (isDirty)
+    {
+        // Build() writes all quads.
+        return;
+    }
+
+    const int quad = spriteQuads[ spriteIndex ];
+    WriteQuad( sprites[ spriteIndex ], &vertices[ quad * QuadVertexCount ] );
+
+    if (dirtyQuadBegin == dirtyQuadEnd)
+    {
+        dirtyQuadBegin = quad;
+        dirtyQuadEnd = quad + 1;
+    }
+    else
+    {
+        dirtyQuadBegin = std::min( dirtyQuadBegin, quad );
+        dirtyQuadEnd = std::max( dirtyQuadEnd, quad + 1 );
+    }
+}
+
 void RenderQueue::Build()
 {
-    if (!sprites.empty())
+    const int spriteCount = static_cast< int >( sprites.size() );
+
+    std::vector< int > order( spriteCount );
+
+    for (int i = 0; i < spriteCount; ++i)
+    {
+        order[ i ] = i;
+    }
+
+    // Stable, so sprites that share a texture are drawn in the order they were added.
+    std::stable_sort( order.begin(), order.end(), [&]( int a, int b ) { return sprites[ a ].texture->GetID() < sprites[ b ].texture->GetID(); } );
+
+    spriteQuads.resize( spriteCount );
+    vertices.resize( spriteCount * QuadVertexCount );
+    drawables.clear();
+
+    for (int quad = 0; quad < spriteCount; ++quad)
     {
-        CreateVertexBuffer( sprites, vertexBuffer );
-        CreateDrawables( sprites, drawables );
+        const Sprite& sprite = sprites[ order[ quad ] ];
+        spriteQuads[ order[ quad ] ] = quad;
+        WriteQuad( sprite, &vertices[ quad * QuadVertexCount ] );
+
+        const int chunk = quad / MaxSpritesPerChunk;
+        const int face = (quad % MaxSpritesPerChunk) * QuadFaceCount;
+
+        if (drawables.empty() || drawables.back().texture != sprite.texture || drawables.back().chunk != chunk)
+        {
+            drawables.emplace_back( Drawable() );
+            drawables.back().texture = sprite.texture;
+            drawables.back().chunk = chunk;
+            drawables.back().bufferStart = face;
+            drawables.back().bufferEnd = face;
+        }
+
+        drawables.back().bufferEnd += QuadFaceCount;
     }
 
+    const int chunkCount = (spriteCount + MaxSpritesPerChunk - 1) / MaxSpritesPerChunk;
+
+    if (static_cast< int >( chunks.size() ) < chunkCount)
+    {
+        chunks.resize( chunkCount );
+        chunkCapacities.resize( chunkCount, 0 );
+    }
+
+    for (int chunk = 0; chunk < chunkCount; ++chunk)
+    {
+        const int chunkSpriteCount = std::min( spriteCount - chunk * MaxSpritesPerChunk, MaxSpritesPerChunk );
+
+        if (chunkCapacities[ chunk ] < chunkSpriteCount)
+        {
+            chunkCapacities[ chunk ] = ae3d::VertexBuffer::GetGrownCapacity( chunkSpriteCount, chunkCapacities[ chunk ], MaxSpritesPerChunk );
+            chunks[ chunk ].GenerateDynamic( chunkCapacities[ chunk ] * QuadFaceCount, chunkCapacities[ chunk ] * QuadVertexCount );
+            chunks[ chunk ].SetDebugName( "sprite buffer" );
+        }
+
+        chunks[ chunk ].UpdateDynamic( ae3d::VertexBuffer::GetQuadFaces(), chunkSpriteCount * QuadFaceCount, &vertices[ chunk * MaxSpritesPerChunk * QuadVertexCount ],
+                                       chunkSpriteCount * QuadVertexCount );
+    }
+
+    dirtyQuadBegin = 0;
+    dirtyQuadEnd = 0;
     isDirty = false;
 }
 
@@ -168,7 +244,20 @@ void RenderQueue::Render( ae3d::GfxDevice::BlendMode blendMode, const float* loc
     {
         Build();
     }
-    
+    else if (dirtyQuadBegin != dirtyQuadEnd)
+    {
+        for (int chunk = dirtyQuadBegin / MaxSpritesPerChunk; chunk <= (dirtyQuadEnd - 1) / MaxSpritesPerChunk; ++chunk)
+        {
+            const int chunkBegin = std::max( dirtyQuadBegin, chunk * MaxSpritesPerChunk );
+            const int chunkEnd = std::min( dirtyQuadEnd, (chunk + 1) * MaxSpritesPerChunk );
+            chunks[ chunk ].UpdateDynamicVertices( &vertices[ chunkBegin * QuadVertexCount ], (chunkBegin - chunk * MaxSpritesPerChunk) * QuadVertexCount,
+                                                   (chunkEnd - chunkBegin) * QuadVertexCount );
+        }
+
+        dirtyQuadBegin = 0;
+        dirtyQuadEnd = 0;
+    }
+
     for (const auto& drawable : drawables)
     {
         renderer.builtinShaders.spriteRendererShader.Use();
@@ -184,7 +273,7 @@ void RenderQueue::Render( ae3d::GfxDevice::BlendMode blendMode, const float* loc
             renderer.builtinShaders.spriteRendererShader.SetTexture( static_cast< ae3d::Texture2D* >( drawable.texture ), 0 );
         }
         
-        ae3d::GfxDevice::Draw( vertexBuffer, drawable.bufferStart, drawable.bufferEnd, renderer.builtinShaders.spriteRendererShader, blendMode,
+        ae3d::GfxDevice::Draw( chunks[ drawable.chunk ], drawable.bufferStart, drawable.bufferEnd, renderer.builtinShaders.spriteRendererShader, blendMode,
                                ae3d::GfxDevice::DepthFunc::NoneWriteOff, ae3d::GfxDevice::CullMode::Off, ae3d::GfxDevice::FillMode::Solid, ae3d::GfxDevice::PrimitiveTopology::Triangles );
     }
 }
@@ -197,11 +286,35 @@ struct ae3d::SpriteRendererComponent::Impl
         static_assert( ae3d::SpriteRendererComponent::StorageAlign % alignof( ae3d::SpriteRendererComponent::Impl ) == 0, "Impl misaligned!");
     }
 
+    RenderQueue& GetQueue( unsigned handle ) { return spriteQueues[ handle ] ? transparentRenderQueue : opaqueRenderQueue; }
+    void SetTransparent( unsigned handle, bool isTransparent );
+
     RenderQueue opaqueRenderQueue;
     RenderQueue transparentRenderQueue;
+    // Indexed by sprite handle.
     std::vector< SpriteInfo > spriteInfos;
+    std::vector< bool > spriteQueues; // True if the sprite is in transparentRenderQueue.
+    std::vector< int > spriteIndices; // Index in its queue's sprites.
 };
 
+// Moves a sprite to the queue of its blend mode if it isn't already there. Rebuilds both queues.
+void ae3d::SpriteRendererComponent::Impl::SetTransparent( unsigned handle, bool isTransparent )
+{
+    const bool wasTransparent = spriteQueues[ handle ];
+
+    if (wasTransparent == isTransparent)
+    {
+        return;
+    }
+
+    RenderQueue& oldQueue = GetQueue( handle );
+    const Sprite sprite = oldQueue.sprites[ spriteIndices[ handle ] ];
+    oldQueue.Remove( spriteIndices[ handle ], spriteIndices );
+
+    spriteQueues[ handle ] = isTransparent;
+    spriteIndices[ handle ] = GetQueue( handle ).Add( sprite, handle );
+}
+
 unsigned ae3d::SpriteRendererComponent::New()
 {
     if (nextFreeSpriteComponent == spriteRendererComponents.size())
@@ -282,10 +395,13 @@ void ae3d::SpriteRendererComponent::Clear()
 {
     m().opaqueRenderQueue.Clear();
     m().transparentRenderQueue.Clear();
+    m().spriteInfos.clear();
+    m().spriteQueues.clear();
+    m().spriteIndices.clear();
 }
 
-void ae3d::SpriteRendererComponent::SetTexture( TextureBase* aTexture, const Vec3& position, const Vec3& dimensionPixels,
-                                                 const Vec4& tintColor )
+unsigned ae3d::SpriteRendererComponent::SetTexture( TextureBase* aTexture, const Vec3& position, const Vec3& dimensionPixels,
+                                                     const Vec4& tintColor )
 {
     if (aTexture == nullptr)
     {
@@ -297,19 +413,66 @@ void ae3d::SpriteRendererComponent::SetTexture( TextureBase* aTexture, const Vec
     sprite.position = position;
     sprite.dimension = dimensionPixels;
     sprite.tint = tintColor;
+    sprite.scaleOffset = aTexture->GetScaleOffset();
 
     m().spriteInfos.emplace_back( SpriteInfo{ aTexture->GetPath(), position.x, position.y, dimensionPixels.x, dimensionPixels.y, true } );
 
-    if (!aTexture->IsOpaque() || static_cast<int>(tintColor.w) != 1)
+    const unsigned handle = static_cast< unsigned >( m().spriteInfos.size() - 1 );
+    const bool isTransparent = IsTransparent( aTexture, tintColor );
+    m().spriteQueues.push_back( isTransparent );
+    m().spriteIndices.push_back( isTransparent ? m().transparentRenderQueue.Add( sprite, handle ) : m().opaqueRenderQueue.Add( sprite, handle ) );
+
+    return handle;
+}
+
+void ae3d::SpriteRendererComponent::SetSpritePosition( unsigned handle, const Vec3& position, const Vec3& dimensionPixels )
+{
+    if (handle >= m().spriteInfos.size())
+    {
+        System::Print( "SpriteRendererComponent: invalid sprite handle: %u\n", handle );
+        return;
+    }
+
+    RenderQueue& queue = m().GetQueue( handle );
+    const int spriteIndex = m().spriteIndices[ handle ];
+    queue.sprites[ spriteIndex ].position = position;
+    queue.sprites[ spriteIndex ].dimension = dimensionPixels;
+    queue.Update( spriteIndex );
+
+    SpriteInfo& info = m().spriteInfos[ handle ];
+    info.x = position.x;
+    info.y = position.y;
+    info.width = dimensionPixels.x;
+    info.height = dimensionPixels.y;
+}
+
+void ae3d::SpriteRendererComponent::SetSpriteTint( unsigned handle, const Vec4& tintColor )
+{
+    if (handle >= m().spriteInfos.size())
     {
-        m().transparentRenderQueue.sprites.emplace_back( sprite );
-        m().transparentRenderQueue.isDirty = true;
+        System::Print( "SpriteRendererComponent: invalid sprite handle: %u\n", handle );
+        return;
     }
-    else
+
+    RenderQueue& queue = m().GetQueue( handle );
+    const int spriteIndex = m().spriteIndices[ handle ];
+    queue.sprites[ spriteIndex ].tint = tintColor;
+    queue.Update( spriteIndex );
+    m().SetTransparent( handle, IsTransparent( queue.sprites[ spriteIndex ].texture, tintColor ) );
+}
+
+void ae3d::SpriteRendererComponent::SetSpriteScaleOffset( unsigned handle, const Vec4& scaleOffset )
+{
+    if (handle >= m().spriteInfos.size())
     {
-        m().opaqueRenderQueue.sprites.emplace_back( sprite );
-        m().opaqueRenderQueue.isDirty = true;
+        System::Print( "SpriteRendererComponent: invalid sprite handle: %u\n", handle );
+        return;
     }
+
+    RenderQueue& queue = m().GetQueue( handle );
+    const int spriteIndex = m().spriteIndices[ handle ];
+    queue.sprites[ spriteIndex ].scaleOffset = scaleOffset;
+    queue.Update( spriteIndex );
 }
 
 void ae3d::SpriteRendererComponent::Render( const float* localToClip )
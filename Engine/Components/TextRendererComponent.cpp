@@ -1,4 +1,6 @@
 #include "TextRendererComponent.hpp"
+#include <algorithm>
+#include <cstring>
 #include <locale>
 #include <vector>
 #include <sstream>
@@ -6,6 +8,7 @@
 #include "GfxDevice.hpp"
 #include "Renderer.hpp"
 #include "Shader.hpp"
+#include "System.hpp"
 #include "VertexBuffer.hpp"
 #include "Vec3.hpp"
 
@@ -34,6 +37,13 @@ ae3d::TextRendererComponent* ae3d::TextRendererComponent::Get( unsigned index )
     return &textComponents[ index ];
 }
 
+namespace
+{
+    const int QuadVertexCount = 4;
+    const int QuadFaceCount = 2;
+    const int MaxCharacterCount = ae3d::VertexBuffer::MaxQuadCount;
+}
+
 struct ae3d::TextRendererComponent::Impl
 {
     Impl() noexcept : vertexBuffer()
@@ -42,15 +52,136 @@ struct ae3d::TextRendererComponent::Impl
         static_assert( ae3d::TextRendererComponent::StorageAlign % alignof( ae3d::TextRendererComponent::Impl ) == 0, "Impl misaligned!");
     }
 
+    void Build();
+
     VertexBuffer vertexBuffer;
+    // Characters that use the same font page.
+    struct PageRun
+    {
+        int page;
+        int startFace;
+        int endFace;
+    };
+
+    // Layout of text ordered by font page, reused until text or font changes.
+    std::vector< Font::GlyphQuad > quads;
+    std::vector< PageRun > pageRuns;
+    // Vertices that are in vertexBuffer.
+    std::vector< VertexBuffer::VertexPTNTC > vertices;
+    int characterCapacity = 0;
     std::string text = "text";
-    std::string oldText;
     Font* font = nullptr;
     Vec4 color = { 1, 1, 1, 1 };
     bool isDirty = true;
+    bool isLayoutDirty = true;
     Shader* shader = &renderer.builtinShaders.spriteRendererShader;
 };
 
+void ae3d::TextRendererComponent::Impl::Build()
+{
+    if (isLayoutDirty)
+    {
+        font->LayoutText( text.c_str(), quads );
+        isLayoutDirty = false;
+
+        if (quads.size() > MaxCharacterCount)
+        {
+            System::Print( "TextRendererComponent: text has %d characters, rendering only the first %d\n", static_cast< int >( quads.size() ), MaxCharacterCount );
+            quads.resize( MaxCharacterCount );
+        }
+
+        // Stable, so characters on one page keep their order and only change where the text changes.
+        std::stable_sort( quads.begin(), quads.end(), []( const Font::GlyphQuad& a, const Font::GlyphQuad& b ) { return a.page < b.page; } );
+
+        pageRuns.clear();
+
+        for (std::size_t q = 0; q < quads.size(); ++q)
+        {
+            const int face = static_cast< int >( q ) * QuadFaceCount;
+
+            if (pageRuns.empty() || pageRuns.back().page != quads[ q ].page)
+            {
+                pageRuns.push_back( PageRun{ quads[ q ].page, face, face } );
+            }
+
+            pageRuns.back().endFace = face + QuadFaceCount;
+        }
+    }
+
+    const int quadCount = static_cast< int >( quads.size() );
+    std::vector< VertexBuffer::VertexPTNTC > newVertices( quads.size() * QuadVertexCount );
+    const float z = -0.6f;
+
+    for (int q = 0; q < quadCount; ++q)
+    {
+        const Font::GlyphQuad& quad = quads[ q ];
+        VertexBuffer::VertexPTNTC* quadVertices = &newVertices[ q * QuadVertexCount ];
+
+        quadVertices[ 0 ].position = Vec3( quad.x0, quad.y0, z );
+        quadVertices[ 0 ].u = quad.u0;
+        quadVertices[ 0 ].v = quad.v1;
+
+        quadVertices[ 1 ].position = Vec3( quad.x1, quad.y0, z );
+        quadVertices[ 1 ].u = quad.u1;
+        quadVertices[ 1 ].v = quad.v1;
+
+        quadVertices[ 2 ].position = Vec3( quad.x1, quad.y1, z );
+        quadVertices[ 2 ].u = quad.u1;
+        quadVertices[ 2 ].v = quad.v0;
+
+        quadVertices[ 3 ].position = Vec3( quad.x0, quad.y1, z );
+        quadVertices[ 3 ].u = quad.u0;
+        quadVertices[ 3 ].v = quad.v0;
+
+        for (int v = 0; v < QuadVertexCount; ++v)
+        {
+            quadVertices[ v ].normal = Vec3( 0, 0, 1 );
+            quadVertices[ v ].tangent = Vec4( 1, 0, 0, 0 );
+            quadVertices[ v ].color = color;
+        }
+    }
+
+    if (quadCount > characterCapacity)
+    {
+        characterCapacity = VertexBuffer::GetGrownCapacity( quadCount, characterCapacity, MaxCharacterCount );
+        vertexBuffer.GenerateDynamic( characterCapacity * QuadFaceCount, characterCapacity * QuadVertexCount );
+        vertexBuffer.SetDebugName( "text buffer" );
+
+        // Faces are uploaded only here, so they cover the whole capacity for text that later grows within it.
+        newVertices.resize( static_cast< std::size_t >( characterCapacity * QuadVertexCount ) );
+        vertexBuffer.UpdateDynamic( VertexBuffer::GetQuadFaces(), characterCapacity * QuadFaceCount, newVertices.data(), characterCapacity * QuadVertexCount );
+        newVertices.resize( static_cast< std::size_t >( quadCount * QuadVertexCount ) );
+    }
+    else
+    {
+        // Uploads only the vertices between the first and last changed ones.
+        const int oldVertexCount = static_cast< int >( vertices.size() );
+        const int newVertexCount = static_cast< int >( newVertices.size() );
+        int first = 0;
+        int end = newVertexCount;
+
+        while (first < std::min( oldVertexCount, newVertexCount ) && std::memcmp( &vertices[ first ], &newVertices[ first ], sizeof( VertexBuffer::VertexPTNTC ) ) == 0)
+        {
+            ++first;
+        }
+
+        if (oldVertexCount == newVertexCount)
+        {
+            while (end > first && std::memcmp( &vertices[ end - 1 ], &newVertices[ end - 1 ], sizeof( VertexBuffer::VertexPTNTC ) ) == 0)
+            {
+                --end;
+            }
+        }
+
+        if (end > first)
+        {
+            vertexBuffer.UpdateDynamicVertices( &newVertices[ first ], first, end - first );
+        }
+    }
+
+    vertices.swap( newVertices );
+}
+
 ae3d::TextRendererComponent::TextRendererComponent()
 {
     new(&_storage)Impl();
@@ -89,15 +220,21 @@ void ae3d::TextRendererComponent::SetColor( const Vec4& aColor )
 
 void ae3d::TextRendererComponent::SetText( const char* aText )
 {
-    std::string text = aText == nullptr ? std::string() : std::string( aText );
-    m().isDirty = true;
-    m().text = text;
+    const char* text = aText == nullptr ? "" : aText;
+
+    if (m().text != text)
+    {
+        m().text = text;
+        m().isDirty = true;
+        m().isLayoutDirty = true;
+    }
 }
 
 void ae3d::TextRendererComponent::SetFont( Font* aFont )
 {
     m().font = aFont;
     m().isDirty = true;
+    m().isLayoutDirty = true;
 }
 
 void ae3d::TextRendererComponent::Render( const float* localToClip )
@@ -109,24 +246,24 @@ void ae3d::TextRendererComponent::Render( const float* localToClip )
 
     if (m().isDirty)
     {
-        if (!m().text.empty() && m().oldText != m().text)
-        {
-            m().oldText = m().text;
-            m().font->CreateVertexBuffer( m().text.c_str(), m().color, m().vertexBuffer );
-        }
-
+        m().Build();
         m().isDirty = false;
     }
 
-    if (m().vertexBuffer.IsGenerated() && !m().text.empty())
+    if (!m().vertexBuffer.IsGenerated())
+    {
+        return;
+    }
+
+    for (const auto& run : m().pageRuns)
     {
         auto shader = m().shader;
         shader->Use();
-        shader->SetTexture(  m().font->GetTexture(), 0 );
+        shader->SetTexture(  m().font->GetTexture( run.page ), 0 );
         GfxDeviceGlobal::perObjectUboStruct.localToClip.InitFrom( localToClip );
         GfxDeviceGlobal::perObjectUboStruct.lightColor = Vec4( 1, 1, 1, 1 );
         
-        GfxDevice::Draw( m().vertexBuffer, 0, m().vertexBuffer.GetFaceCount() / 3, *m().shader, ae3d::GfxDevice::BlendMode::AlphaBlend,
+        GfxDevice::Draw( m().vertexBuffer, run.startFace, run.endFace, *m().shader, ae3d::GfxDevice::BlendMode::AlphaBlend,
                          ae3d::GfxDevice::DepthFunc::LessOrEqualWriteOff, ae3d::GfxDevice::CullMode::Off, ae3d::GfxDevice::FillMode::Solid, GfxDevice::PrimitiveTopology::Triangles );
     }
 }
@@ -5,4 +5,5 @@ void ae3d::AudioClip::Load( const FileSystem::FileContentsData& clipData )
 {
     handle = AudioSystem::GetClipIdForData( clipData );
     length = AudioSystem::GetClipLengthForId( handle );
+    isStreaming = AudioSystem::IsClipStreaming( handle );
 }
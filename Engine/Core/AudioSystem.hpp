@@ -18,6 +18,8 @@ namespace ae3d
         /*
           Loads a clip data and returns its handle that can be used to play the clip.
          
+          Ogg Vorbis clips that would decode to more than 1 MiB are streamed: they are decoded during playback on a background thread.
+
           \param clipData .wav or Ogg Vorbis audio data.
           \return Clip handle that can be passed to Play.
          */
@@ -25,10 +27,33 @@ namespace ae3d
         
         /// \return Length in seconds.
         float GetClipLengthForId( unsigned handle );
+
+        /// \return True, if the clip is decoded during playback instead of at load.
+        bool IsClipStreaming( unsigned handle );
         
-        /// \param clipId Clip handle from GetClipIdForData.
-        /// \param isLooping True, if the clip should loop
-        void Play( unsigned clipId, bool isLooping );
+        /**
+          Plays a clip on a new voice, so the same clip can play many times at once. When there are more voices than sources,
+          the least audible voices become virtual: they are silent but keep their playback position until they get a source.
+          Streamed clips play on their own source and don't get a voice.
+
+          \param clipId Clip handle from GetClipIdForData.
+          \param isLooping True, if the clip should loop
+          \param is3D True, if the voice is attenuated by its distance from the listener.
+          \param x X coordinate.
+          \param y Y coordinate.
+          \param z Z coordinate.
+          \return Voice handle for SetVoicePosition, or 0 if the clip was not played on a voice.
+         */
+        unsigned Play( unsigned clipId, bool isLooping, bool is3D, float x, float y, float z );
+
+        /// \param voiceId Voice handle from Play. Does nothing if the voice has finished.
+        /// \param x X coordinate.
+        /// \param y Y coordinate.
+        /// \param z Z coordinate.
+        void SetVoicePosition( unsigned voiceId, float x, float y, float z );
+
+        /// Removes finished voices and gives sources to the most audible voices. Call once per frame after moving the listener and voices.
+        void UpdateVoices();
         
         /// \param x X coordinate.
         /// \param y Y coordinate.
@@ -39,5 +64,34 @@ namespace ae3d
         /// \param forwardY Forward y.
         /// \param forwardZ Forward z.
         void SetListenerOrientation( float forwardX, float forwardY, float forwardZ );
+
+        /// Output sample rate of the software mixer.
+        static const int OutputSampleRate = 48000;
+
+        /**
+          Software mixer only (AudioSystemSoftware.cpp, used with the null renderer). When enabled, voices advance only in Mix,
+          so the output doesn't depend on frame times and can be rendered faster than real time. When disabled, UpdateVoices
+          advances voices by the elapsed time without mixing them.
+
+          \param enable True, if voices should advance only in Mix.
+         */
+        void SetOfflineRendering( bool enable );
+
+        /**
+          Software mixer only. Resamples and mixes the most audible voices into a stereo bus and advances all voices.
+
+          \param outSamples Receives frameCount interleaved stereo frames at OutputSampleRate. Not clamped.
+          \param frameCount Number of frames to mix.
+         */
+        void Mix( float* outSamples, int frameCount );
+
+        /**
+          Software mixer only. Mixes into a 16-bit stereo .wav file at OutputSampleRate.
+
+          \param path Path to the written file.
+          \param seconds Length of the mixed audio.
+          \return True, if the file was written.
+         */
+        bool MixToWav( const char* path, float seconds );
     }
 }
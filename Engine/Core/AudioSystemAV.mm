@@ -1,5 +1,10 @@
 #include "AudioSystem.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
 #include <string>
+#include <vector>
 #import <AVFoundation/AVFoundation.h>
 #import <Foundation/NSURL.h>
 #define STB_VORBIS_HEADER_ONLY
@@ -7,6 +12,7 @@
 #include "Array.hpp"
 #include "FileSystem.hpp"
 #include "FileWatcher.hpp"
+#include "Statistics.hpp"
 #include "System.hpp"
 
 extern ae3d::FileWatcher fileWatcher;
@@ -18,10 +24,34 @@ struct ClipInfo
     float lengthInSeconds = 0;
 };
 
+// Playing instance of a clip. Voices that don't have a player are virtual: they keep their playback
+// position, so they can continue when they get a player.
+struct Voice
+{
+    unsigned id = 0;
+    unsigned clipIndex = 0;
+    int playerIndex = -1;
+    float position[ 3 ] = {};
+    std::chrono::steady_clock::time_point startTime;
+    bool isLooping = false;
+    bool is3D = false;
+};
+
 namespace AudioGlobal
 {
+    // Number of voices that are audible at the same time.
+    static const int PlayerCount = 32;
+    // Virtual voices above this are not started.
+    static const unsigned MaxVoiceCount = 256;
+
     AVAudioEngine* engine = nullptr;
-    AVAudioPlayerNode* player = nullptr;
+    // Spatializes 3D voices. 2D voices bypass it.
+    AVAudioEnvironmentNode* environment = nullptr;
+    AVAudioPlayerNode* players[ PlayerCount ] = {};
+    bool isPlayerUsed[ PlayerCount ] = {};
+    std::vector< Voice > voices;
+    unsigned nextVoiceId = 1;
+    float listenerPosition[ 3 ] = {};
     Array< ClipInfo > clips;
 }
 
@@ -36,14 +66,172 @@ void AudioReload( const std::string& path )
     ae3d::System::Print( "AudioSystem: AudioReload not implemented on macOS/iOS\n" );
 }
 
+// Voices have the same gain, so the inverse distance model makes the farthest voice the quietest.
+float GetAudibility( const Voice& voice )
+{
+    if (!voice.is3D)
+    {
+        return 1;
+    }
+
+    const float x = voice.position[ 0 ] - AudioGlobal::listenerPosition[ 0 ];
+    const float y = voice.position[ 1 ] - AudioGlobal::listenerPosition[ 1 ];
+    const float z = voice.position[ 2 ] - AudioGlobal::listenerPosition[ 2 ];
+    return 1 / std::max( std::sqrt( x * x + y * y + z * z ), 1.0f );
+}
+
+float GetElapsedSeconds( const Voice& voice )
+{
+    return std::chrono::duration< float >( std::chrono::steady_clock::now() - voice.startTime ).count();
+}
+
+// \return Copy of buffer's frames starting from startFrame, or nil if the samples are neither float nor int16.
+AVAudioPCMBuffer* CreateTailBuffer( AVAudioPCMBuffer* buffer, AVAudioFrameCount startFrame )
+{
+    const AVAudioFrameCount frameCount = buffer.frameLength - startFrame;
+    AVAudioPCMBuffer* tail = [ [AVAudioPCMBuffer alloc] initWithPCMFormat:buffer.format frameCapacity:frameCount];
+    tail.frameLength = frameCount;
+
+    // Interleaved samples are all in the first channel's array.
+    const AVAudioChannelCount arrayCount = buffer.format.isInterleaved ? 1 : buffer.format.channelCount;
+    const std::size_t sampleOffset = static_cast< std::size_t >( startFrame ) * buffer.stride;
+    const std::size_t sampleCount = static_cast< std::size_t >( frameCount ) * buffer.stride;
+
+    for (AVAudioChannelCount i = 0; i < arrayCount; ++i)
+    {
+        if (buffer.floatChannelData)
+        {
+            std::memcpy( tail.floatChannelData[ i ], buffer.floatChannelData[ i ] + sampleOffset, sampleCount * sizeof( float ) );
+        }
+        else if (buffer.int16ChannelData)
+        {
+            std::memcpy( tail.int16ChannelData[ i ], buffer.int16ChannelData[ i ] + sampleOffset, sampleCount * sizeof( int16_t ) );
+        }
+        else
+        {
+            return nil;
+        }
+    }
+
+    return tail;
+}
+
+void ReleasePlayer( Voice& voice )
+{
+    if (voice.playerIndex != -1)
+    {
+        [AudioGlobal::players[ voice.playerIndex ] stop];
+        AudioGlobal::isPlayerUsed[ voice.playerIndex ] = false;
+        voice.playerIndex = -1;
+    }
+}
+
+void AcquirePlayer( Voice& voice )
+{
+    for (int i = 0; i < AudioGlobal::PlayerCount; ++i)
+    {
+        if (!AudioGlobal::isPlayerUsed[ i ])
+        {
+            AVAudioPCMBuffer* buffer = AudioGlobal::clips[ voice.clipIndex ].buffer;
+            AVAudioPlayerNode* player = AudioGlobal::players[ i ];
+            AudioGlobal::isPlayerUsed[ i ] = true;
+            voice.playerIndex = i;
+
+            // Clips can have different formats, and a player can only play buffers of its connection's format.
+            [AudioGlobal::engine connect:player to:AudioGlobal::environment format:buffer.format];
+            player.sourceMode = voice.is3D ? AVAudio3DMixingSourceModeSpatializeIfMono : AVAudio3DMixingSourceModeBypass;
+            player.position = AVAudioMake3DPoint( voice.position[ 0 ], voice.position[ 1 ], voice.position[ 2 ] );
+
+            // Virtual voices continue from where they would be if they had been audible.
+            const float elapsed = GetElapsedSeconds( voice );
+            const float lengthInSeconds = AudioGlobal::clips[ voice.clipIndex ].lengthInSeconds;
+            const float offset = voice.isLooping ? std::fmod( elapsed, lengthInSeconds ) : elapsed;
+            const AVAudioFrameCount startFrame = std::min( static_cast< AVAudioFrameCount >( offset * buffer.format.sampleRate ), buffer.frameLength );
+            AVAudioPCMBuffer* tail = (startFrame > 0 && startFrame < buffer.frameLength) ? CreateTailBuffer( buffer, startFrame ) : nil;
+
+            if (tail)
+            {
+                [player scheduleBuffer:tail completionHandler:nil];
+            }
+
+            if (voice.isLooping)
+            {
+                [player scheduleBuffer:buffer atTime:nil options:AVAudioPlayerNodeBufferLoops completionHandler:nil];
+            }
+            else if (!tail && startFrame < buffer.frameLength)
+            {
+                [player scheduleBuffer:buffer completionHandler:nil];
+            }
+
+            [player play];
+            return;
+        }
+    }
+}
+
+// Removes finished voices and gives players to the most audible voices.
+void AssignPlayers()
+{
+    auto& voices = AudioGlobal::voices;
+
+    for (std::size_t i = 0; i < voices.size();)
+    {
+        if (!voices[ i ].isLooping && GetElapsedSeconds( voices[ i ] ) >= AudioGlobal::clips[ voices[ i ].clipIndex ].lengthInSeconds)
+        {
+            ReleasePlayer( voices[ i ] );
+            voices[ i ] = voices.back();
+            voices.pop_back();
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    // Voices that have a player win ties, so equally audible voices don't swap players every frame.
+    std::sort( voices.begin(), voices.end(), []( const Voice& a, const Voice& b )
+    {
+        const float audibilityA = GetAudibility( a );
+        const float audibilityB = GetAudibility( b );
+        return audibilityA != audibilityB ? audibilityA > audibilityB : (a.playerIndex != -1 && b.playerIndex == -1);
+    } );
+
+    // Players are released first, so that the most audible voices can take them.
+    for (std::size_t i = AudioGlobal::PlayerCount; i < voices.size(); ++i)
+    {
+        ReleasePlayer( voices[ i ] );
+    }
+
+    for (std::size_t i = 0; i < voices.size() && i < static_cast< std::size_t >( AudioGlobal::PlayerCount ); ++i)
+    {
+        if (voices[ i ].playerIndex == -1)
+        {
+            AcquirePlayer( voices[ i ] );
+        }
+    }
+
+    const int activeCount = static_cast< int >( std::min( voices.size(), static_cast< std::size_t >( AudioGlobal::PlayerCount ) ) );
+    Statistics::SetAudioVoiceCounts( activeCount, static_cast< int >( voices.size() ) - activeCount );
+}
+
 void ae3d::AudioSystem::Init()
 {
     AudioGlobal::engine = [ [AVAudioEngine alloc] init];
-    AudioGlobal::player = [ [AVAudioPlayerNode alloc] init];
-    [AudioGlobal::engine attachNode:AudioGlobal::player];
-    
+    AudioGlobal::environment = [ [AVAudioEnvironmentNode alloc] init];
+    // Same model as OpenAL's default, so voices are prioritized by what is heard.
+    AudioGlobal::environment.distanceAttenuationParameters.distanceAttenuationModel = AVAudioEnvironmentDistanceAttenuationModelInverse;
+    AudioGlobal::environment.distanceAttenuationParameters.referenceDistance = 1;
+    [AudioGlobal::engine attachNode:AudioGlobal::environment];
+
     AVAudioMixerNode* mixer = AudioGlobal::engine.mainMixerNode;
-    [AudioGlobal::engine connect:AudioGlobal::player to:mixer format:[mixer outputFormatForBus:0]];
+    [AudioGlobal::engine connect:AudioGlobal::environment to:mixer format:nil];
+
+    for (int i = 0; i < AudioGlobal::PlayerCount; ++i)
+    {
+        AudioGlobal::players[ i ] = [ [AVAudioPlayerNode alloc] init];
+        [AudioGlobal::engine attachNode:AudioGlobal::players[ i ]];
+        [AudioGlobal::engine connect:AudioGlobal::players[ i ] to:AudioGlobal::environment format:nil];
+    }
     
     NSError* error;
     
@@ -55,6 +243,13 @@ void ae3d::AudioSystem::Init()
 
 void ae3d::AudioSystem::Deinit()
 {
+    for (auto& voice : AudioGlobal::voices)
+    {
+        ReleasePlayer( voice );
+    }
+
+    AudioGlobal::voices.clear();
+    [AudioGlobal::engine stop];
 }
 
 unsigned ae3d::AudioSystem::GetClipIdForData( const FileSystem::FileContentsData& clipData )
@@ -95,6 +290,8 @@ unsigned ae3d::AudioSystem::GetClipIdForData( const FileSystem::FileContentsData
             return clipId;
         }
 
+        AudioGlobal::clips[ clipId - 1 ].lengthInSeconds = len / static_cast< float >( samplerate );
+
         int error;
         stb_vorbis* vorbis = stb_vorbis_open_memory( clipData.data.data(), static_cast< int >( clipData.data.size() ), &error, nullptr );
         const stb_vorbis_info vinfo = stb_vorbis_get_info( vorbis );
@@ -139,6 +336,7 @@ unsigned ae3d::AudioSystem::GetClipIdForData( const FileSystem::FileContentsData
     AVAudioFrameCount capacity = (AVAudioFrameCount)avFile.length;
     AudioGlobal::clips[ clipId - 1 ].buffer = [ [AVAudioPCMBuffer alloc] initWithPCMFormat:format frameCapacity:capacity];
     [avFile readIntoBuffer:AudioGlobal::clips[ clipId - 1 ].buffer error:nil];
+    AudioGlobal::clips[ clipId - 1 ].lengthInSeconds = capacity / static_cast< float >( format.sampleRate );
 
     fileWatcher.AddFile( clipData.path, AudioReload );
 
@@ -147,26 +345,84 @@ unsigned ae3d::AudioSystem::GetClipIdForData( const FileSystem::FileContentsData
 
 float ae3d::AudioSystem::GetClipLengthForId( unsigned handle )
 {
-    return handle < AudioGlobal::clips.count ? AudioGlobal::clips[ handle ].lengthInSeconds : 1;
+    return (handle > 0 && handle <= AudioGlobal::clips.count) ? AudioGlobal::clips[ handle - 1 ].lengthInSeconds : 1;
 }
 
-void ae3d::AudioSystem::Play( unsigned clipId, bool isLooping )
+bool ae3d::AudioSystem::IsClipStreaming( unsigned /*handle*/ )
 {
-    if (clipId >= AudioGlobal::clips.count + 1)
+    return false;
+}
+
+unsigned ae3d::AudioSystem::Play( unsigned clipId, bool isLooping, bool is3D, float x, float y, float z )
+{
+    if (clipId == 0 || clipId >= AudioGlobal::clips.count + 1 || AudioGlobal::clips[ clipId - 1 ].buffer == nil ||
+        AudioGlobal::clips[ clipId - 1 ].lengthInSeconds <= 0)
     {
-        return;
+        return 0;
     }
-    
-    [AudioGlobal::player scheduleBuffer:AudioGlobal::clips[ clipId - 1 ].buffer completionHandler:nil];
-    [AudioGlobal::player play];
+
+    Voice voice;
+    voice.id = AudioGlobal::nextVoiceId++;
+    voice.clipIndex = clipId - 1;
+    voice.position[ 0 ] = x;
+    voice.position[ 1 ] = y;
+    voice.position[ 2 ] = z;
+    voice.startTime = std::chrono::steady_clock::now();
+    voice.isLooping = isLooping;
+    voice.is3D = is3D;
+
+    // AssignPlayers() sorts voices by audibility, so the last one is the least audible.
+    if (AudioGlobal::voices.size() >= AudioGlobal::MaxVoiceCount)
+    {
+        if (GetAudibility( voice ) <= GetAudibility( AudioGlobal::voices.back() ))
+        {
+            return 0;
+        }
+
+        ReleasePlayer( AudioGlobal::voices.back() );
+        AudioGlobal::voices.pop_back();
+    }
+
+    AudioGlobal::voices.push_back( voice );
+    AssignPlayers();
+
+    return voice.id;
+}
+
+void ae3d::AudioSystem::SetVoicePosition( unsigned voiceId, float x, float y, float z )
+{
+    for (auto& voice : AudioGlobal::voices)
+    {
+        if (voice.id == voiceId)
+        {
+            voice.position[ 0 ] = x;
+            voice.position[ 1 ] = y;
+            voice.position[ 2 ] = z;
+
+            if (voice.playerIndex != -1 && voice.is3D)
+            {
+                AudioGlobal::players[ voice.playerIndex ].position = AVAudioMake3DPoint( x, y, z );
+            }
+
+            return;
+        }
+    }
+}
+
+void ae3d::AudioSystem::UpdateVoices()
+{
+    AssignPlayers();
 }
 
 void ae3d::AudioSystem::SetListenerPosition( float x, float y, float z )
 {
-    // TODO: Implement
+    AudioGlobal::listenerPosition[ 0 ] = x;
+    AudioGlobal::listenerPosition[ 1 ] = y;
+    AudioGlobal::listenerPosition[ 2 ] = z;
+    AudioGlobal::environment.listenerPosition = AVAudioMake3DPoint( x, y, z );
 }
 
 void ae3d::AudioSystem::SetListenerOrientation( float forwardX, float forwardY, float forwardZ )
 {
-    // TODO: Implement
+    AudioGlobal::environment.listenerVectorOrientation = AVAudioMake3DVectorOrientation( AVAudioMake3DVector( forwardX, forwardY, forwardZ ), AVAudioMake3DVector( 0, 1, 0 ) );
 }
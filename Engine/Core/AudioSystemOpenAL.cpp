@@ -1,6 +1,14 @@
 #include "AudioSystem.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <mutex>
 #include <sstream>
 #include <string>
+#include <thread>
+#include <vector>
 #include <cstdint>
 #include "AL/al.h"
 #include "AL/alc.h"
@@ -9,23 +17,75 @@
 #include "Array.hpp"
 #include "FileSystem.hpp"
 #include "FileWatcher.hpp"
+#include "Statistics.hpp"
 #include "System.hpp"
 
 extern ae3d::FileWatcher fileWatcher;
 
+// Ogg Vorbis clip that is decoded during playback into a ring of queued buffers.
+struct OggStream
+{
+    static const int BufferCount = 4;
+    // Samples per buffer for all channels, about 0.4 seconds of 44.1 kHz stereo.
+    static const int BufferSamples = 32768;
+
+    std::vector< unsigned char > data; // Ogg file contents. The decoder reads them during playback.
+    std::vector< short > samples;
+    stb_vorbis* vorbis = nullptr;
+    ALuint buffers[ BufferCount ] = {};
+    ALuint srcID = 0;
+    ALenum format = AL_FORMAT_MONO16;
+    int channels = 0;
+    int sampleRate = 0;
+    bool isLooping = false;
+    bool isPlaying = false;
+};
+
 struct ClipInfo
 {
     ALuint bufID = 0;
     ALuint srcID = 0;
     std::string path;
     float lengthInSeconds = 0;
+    int streamIndex = -1; // Index into AudioGlobal::streams or -1 if the clip is decoded at load.
+};
+
+// Playing instance of a clip. Voices that don't have a source are virtual: they keep their playback
+// position, so they can continue when they get a source.
+struct Voice
+{
+    unsigned id = 0;
+    unsigned clipIndex = 0;
+    int sourceIndex = -1;
+    float position[ 3 ] = {};
+    std::chrono::steady_clock::time_point startTime;
+    bool isLooping = false;
+    bool is3D = false;
 };
 
 namespace AudioGlobal
 {
+    // Number of voices that are audible at the same time.
+    static const int SourceCount = 32;
+    // Virtual voices above this are not started.
+    static const unsigned MaxVoiceCount = 256;
+
+    ALuint sources[ SourceCount ] = {};
+    bool isSourceUsed[ SourceCount ] = {};
+    std::vector< Voice > voices;
+    unsigned nextVoiceId = 1;
+    float listenerPosition[ 3 ] = {};
     ALCdevice* device = nullptr;
     ALCcontext* context = nullptr;
     Array< ClipInfo > clips;
+    // Streams are not stored in ClipInfo because their decoder points into their data, so they can't be copied.
+    std::vector< std::unique_ptr< OggStream > > streams;
+    // Protects streams, because the stream thread refills them.
+    std::mutex mutex;
+    std::thread streamThread;
+    std::atomic< bool > isStreamThreadRunning( false );
+    // Ogg clips that decode to more bytes than this are streamed. 1 MiB is about 6 seconds of 44.1 kHz stereo.
+    const unsigned streamingThresholdBytes = 1024 * 1024;
 }
 
 namespace
@@ -77,6 +137,108 @@ void CheckOpenALError( const char* info )
     }
 }
 
+// Decodes the next samples into buffer. Returns the number of decoded samples for all channels, 0 at the end of a non-looping stream.
+int FillStreamBuffer( OggStream& stream, ALuint buffer )
+{
+    int sampleCount = 0;
+    bool isAtStart = false;
+
+    while (sampleCount < OggStream::BufferSamples)
+    {
+        const int frameCount = stb_vorbis_get_samples_short_interleaved( stream.vorbis, stream.channels, stream.samples.data() + sampleCount,
+                                                                         OggStream::BufferSamples - sampleCount );
+        if (frameCount > 0)
+        {
+            sampleCount += frameCount * stream.channels;
+            isAtStart = false;
+        }
+        else if (stream.isLooping && !isAtStart)
+        {
+            stb_vorbis_seek_start( stream.vorbis );
+            isAtStart = true;
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    if (sampleCount > 0)
+    {
+        alBufferData( buffer, stream.format, stream.samples.data(), sampleCount * static_cast< int >( sizeof( short ) ), stream.sampleRate );
+    }
+
+    return sampleCount;
+}
+
+// Refills buffers that the source has played. Called on the stream thread with AudioGlobal::mutex locked.
+void UpdateStream( OggStream& stream )
+{
+    if (!stream.isPlaying)
+    {
+        return;
+    }
+
+    ALint processedCount = 0;
+    alGetSourcei( stream.srcID, AL_BUFFERS_PROCESSED, &processedCount );
+
+    for (ALint i = 0; i < processedCount; ++i)
+    {
+        ALuint buffer = 0;
+        alSourceUnqueueBuffers( stream.srcID, 1, &buffer );
+
+        if (FillStreamBuffer( stream, buffer ) > 0)
+        {
+            alSourceQueueBuffers( stream.srcID, 1, &buffer );
+        }
+    }
+
+    ALint queuedCount = 0;
+    alGetSourcei( stream.srcID, AL_BUFFERS_QUEUED, &queuedCount );
+
+    if (queuedCount == 0)
+    {
+        stream.isPlaying = false;
+        return;
+    }
+
+    // The source stops if it plays all queued buffers before they are refilled.
+    ALint state = 0;
+    alGetSourcei( stream.srcID, AL_SOURCE_STATE, &state );
+
+    if (state != AL_PLAYING)
+    {
+        alSourcePlay( stream.srcID );
+    }
+
+    CheckOpenALError( "Updating ogg stream" );
+}
+
+void UpdateStreams()
+{
+    while (AudioGlobal::isStreamThreadRunning)
+    {
+        {
+            std::lock_guard< std::mutex > lock( AudioGlobal::mutex );
+
+            for (auto& stream : AudioGlobal::streams)
+            {
+                UpdateStream( *stream );
+            }
+        }
+
+        // Buffers hold about 0.4 seconds, so this refills them well before the source runs out.
+        std::this_thread::sleep_for( std::chrono::milliseconds( 20 ) );
+    }
+}
+
+void StopStream( OggStream& stream )
+{
+    alSourceStop( stream.srcID );
+    alSourcei( stream.srcID, AL_BUFFER, 0 );
+    stream.isPlaying = false;
+}
+
 void LoadOgg( const ae3d::FileSystem::FileContentsData& clipData, ClipInfo& info )
 {
     if (AudioGlobal::device == nullptr)
@@ -84,28 +246,64 @@ void LoadOgg( const ae3d::FileSystem::FileContentsData& clipData, ClipInfo& info
         return;
     }
 
-    short* decoded = nullptr;
-    int channels = 0;
-    int samplerate = 0;
-    const int len = stb_vorbis_decode_memory( clipData.data.data(), static_cast< int >( clipData.data.size() ), &channels, &samplerate, &decoded );
-    
-    if (len == 0)
+    int error = 0;
+    stb_vorbis* vorbis = stb_vorbis_open_memory( clipData.data.data(), static_cast< int >( clipData.data.size() ), &error, nullptr );
+
+    if (vorbis == nullptr)
     {
         ae3d::System::Print( "AudioSystem: Could not open %s\n", clipData.path.c_str() );
         return;
     }
 
-    int error;
-    stb_vorbis* vorbis = stb_vorbis_open_memory( clipData.data.data(), static_cast< int >( clipData.data.size() ), &error, nullptr );
     const stb_vorbis_info vinfo = stb_vorbis_get_info( vorbis );
-    
     const ALenum format = vinfo.channels == 2 ? AL_FORMAT_STEREO16 : AL_FORMAT_MONO16;
-    
-    alBufferData( info.bufID, format, &decoded[0], len, vinfo.sample_rate );
+    const unsigned sampleCount = stb_vorbis_stream_length_in_samples( vorbis ) * vinfo.channels;
 
     info.lengthInSeconds = stb_vorbis_stream_length_in_seconds( vorbis );
 
-    CheckOpenALError("Loading ogg");
+    if (info.streamIndex == -1 && sampleCount * sizeof( short ) <= AudioGlobal::streamingThresholdBytes)
+    {
+        std::vector< short > decoded( sampleCount );
+        const int frameCount = stb_vorbis_get_samples_short_interleaved( vorbis, vinfo.channels, decoded.data(), static_cast< int >( decoded.size() ) );
+        stb_vorbis_close( vorbis );
+
+        alSourcei( info.srcID, AL_BUFFER, 0 );
+        alBufferData( info.bufID, format, decoded.data(), frameCount * vinfo.channels * static_cast< int >( sizeof( short ) ), vinfo.sample_rate );
+        alSourcei( info.srcID, AL_BUFFER, info.bufID );
+        CheckOpenALError( "Loading ogg" );
+        return;
+    }
+
+    stb_vorbis_close( vorbis );
+
+    // A reloaded clip that was streamed keeps streaming, so its stream doesn't move under the stream thread.
+    std::lock_guard< std::mutex > lock( AudioGlobal::mutex );
+
+    if (info.streamIndex == -1)
+    {
+        info.streamIndex = static_cast< int >( AudioGlobal::streams.size() );
+        AudioGlobal::streams.push_back( std::unique_ptr< OggStream >( new OggStream() ) );
+        OggStream& stream = *AudioGlobal::streams.back();
+        stream.srcID = info.srcID;
+        stream.samples.resize( OggStream::BufferSamples );
+        alGenBuffers( OggStream::BufferCount, stream.buffers );
+    }
+
+    OggStream& stream = *AudioGlobal::streams[ info.streamIndex ];
+    StopStream( stream );
+
+    if (stream.vorbis != nullptr)
+    {
+        stb_vorbis_close( stream.vorbis );
+    }
+
+    stream.data = clipData.data;
+    stream.vorbis = stb_vorbis_open_memory( stream.data.data(), static_cast< int >( stream.data.size() ), &error, nullptr );
+    stream.format = format;
+    stream.channels = vinfo.channels;
+    stream.sampleRate = static_cast< int >( vinfo.sample_rate );
+
+    CheckOpenALError( "Loading ogg stream" );
 }
 
 void LoadWav( const ae3d::FileSystem::FileContentsData& clipData, ClipInfo& info )
@@ -232,6 +430,146 @@ void LoadWav( const ae3d::FileSystem::FileContentsData& clipData, ClipInfo& info
     
     info.lengthInSeconds = dataSize / static_cast< float >(wav.bytesPerSecond);
 }
+
+// Voices have the same gain, so the inverse distance model makes the farthest voice the quietest.
+float GetAudibility( const Voice& voice )
+{
+    if (!voice.is3D)
+    {
+        return 1;
+    }
+
+    const float x = voice.position[ 0 ] - AudioGlobal::listenerPosition[ 0 ];
+    const float y = voice.position[ 1 ] - AudioGlobal::listenerPosition[ 1 ];
+    const float z = voice.position[ 2 ] - AudioGlobal::listenerPosition[ 2 ];
+    return 1 / std::max( std::sqrt( x * x + y * y + z * z ), 1.0f );
+}
+
+float GetElapsedSeconds( const Voice& voice )
+{
+    return std::chrono::duration< float >( std::chrono::steady_clock::now() - voice.startTime ).count();
+}
+
+void ReleaseSource( Voice& voice )
+{
+    if (voice.sourceIndex != -1)
+    {
+        const ALuint source = AudioGlobal::sources[ voice.sourceIndex ];
+        alSourceStop( source );
+        alSourcei( source, AL_BUFFER, 0 );
+        AudioGlobal::isSourceUsed[ voice.sourceIndex ] = false;
+        voice.sourceIndex = -1;
+    }
+}
+
+void AcquireSource( Voice& voice )
+{
+    for (int i = 0; i < AudioGlobal::SourceCount; ++i)
+    {
+        if (!AudioGlobal::isSourceUsed[ i ])
+        {
+            const ClipInfo& clip = AudioGlobal::clips[ voice.clipIndex ];
+            const ALuint source = AudioGlobal::sources[ i ];
+            AudioGlobal::isSourceUsed[ i ] = true;
+            voice.sourceIndex = i;
+
+            alSourcei( source, AL_BUFFER, static_cast< ALint >( clip.bufID ) );
+            alSourcei( source, AL_LOOPING, voice.isLooping ? AL_TRUE : AL_FALSE );
+            alSourcei( source, AL_SOURCE_RELATIVE, voice.is3D ? AL_FALSE : AL_TRUE );
+            alSource3f( source, AL_POSITION, voice.is3D ? voice.position[ 0 ] : 0, voice.is3D ? voice.position[ 1 ] : 0, voice.is3D ? voice.position[ 2 ] : 0 );
+
+            // Virtual voices continue from where they would be if they had been audible.
+            const float elapsed = GetElapsedSeconds( voice );
+
+            if (elapsed > 0 && clip.lengthInSeconds > 0)
+            {
+                alSourcef( source, AL_SEC_OFFSET, voice.isLooping ? std::fmod( elapsed, clip.lengthInSeconds ) : elapsed );
+            }
+
+            alSourcePlay( source );
+            CheckOpenALError( "Starting voice" );
+            return;
+        }
+    }
+}
+
+// Removes finished voices and gives sources to the most audible voices.
+void AssignSources()
+{
+    auto& voices = AudioGlobal::voices;
+
+    for (std::size_t i = 0; i < voices.size();)
+    {
+        bool isFinished;
+
+        if (voices[ i ].sourceIndex != -1)
+        {
+            ALint state = AL_STOPPED;
+            alGetSourcei( AudioGlobal::sources[ voices[ i ].sourceIndex ], AL_SOURCE_STATE, &state );
+            isFinished = state == AL_STOPPED;
+        }
+        else
+        {
+            isFinished = !voices[ i ].isLooping && GetElapsedSeconds( voices[ i ] ) >= AudioGlobal::clips[ voices[ i ].clipIndex ].lengthInSeconds;
+        }
+
+        if (isFinished)
+        {
+            ReleaseSource( voices[ i ] );
+            voices[ i ] = voices.back();
+            voices.pop_back();
+        }
+        else
+        {
+            ++i;
+        }
+    }
+
+    // Voices that have a source win ties, so equally audible voices don't swap sources every frame.
+    std::sort( voices.begin(), voices.end(), []( const Voice& a, const Voice& b )
+    {
+        const float audibilityA = GetAudibility( a );
+        const float audibilityB = GetAudibility( b );
+        return audibilityA != audibilityB ? audibilityA > audibilityB : (a.sourceIndex != -1 && b.sourceIndex == -1);
+    } );
+
+    // Sources are released first, so that the most audible voices can take them.
+    for (std::size_t i = AudioGlobal::SourceCount; i < voices.size(); ++i)
+    {
+        ReleaseSource( voices[ i ] );
+    }
+
+    for (std::size_t i = 0; i < voices.size() && i < static_cast< std::size_t >( AudioGlobal::SourceCount ); ++i)
+    {
+        if (voices[ i ].sourceIndex == -1)
+        {
+            AcquireSource( voices[ i ] );
+        }
+    }
+
+    const int activeCount = static_cast< int >( std::min( voices.size(), static_cast< std::size_t >( AudioGlobal::SourceCount ) ) );
+    Statistics::SetAudioVoiceCounts( activeCount, static_cast< int >( voices.size() ) - activeCount );
+}
+
+// A buffer can't be changed while a source uses it.
+void StopVoicesForClip( const ClipInfo& clip )
+{
+    auto& voices = AudioGlobal::voices;
+
+    for (std::size_t i = 0; i < voices.size();)
+    {
+        if (&AudioGlobal::clips[ voices[ i ].clipIndex ] == &clip)
+        {
+            ReleaseSource( voices[ i ] );
+            voices[ i ] = voices.back();
+            voices.pop_back();
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
 }
 
 void AudioReload( const std::string& path )
@@ -240,6 +578,7 @@ void AudioReload( const std::string& path )
     {
         if (path == it->path)
         {
+            StopVoicesForClip( *it );
             const std::string extension = path.substr( path.length() - 3, path.length() );
             
             if (extension == "wav" || extension == "WAV")
@@ -270,11 +609,38 @@ void ae3d::AudioSystem::Init()
     }
     
     alListener3f( AL_POSITION, 0, 0, 1 );
+    alGenSources( AudioGlobal::SourceCount, AudioGlobal::sources );
     CheckOpenALError( "AudioImpl::Init" );
+
+    AudioGlobal::isStreamThreadRunning = true;
+    AudioGlobal::streamThread = std::thread( UpdateStreams );
 }
 
 void ae3d::AudioSystem::Deinit()
 {
+    if (AudioGlobal::isStreamThreadRunning)
+    {
+        AudioGlobal::isStreamThreadRunning = false;
+        AudioGlobal::streamThread.join();
+    }
+
+    for (auto& stream : AudioGlobal::streams)
+    {
+        StopStream( *stream );
+        alDeleteBuffers( OggStream::BufferCount, stream->buffers );
+        stb_vorbis_close( stream->vorbis );
+    }
+
+    AudioGlobal::streams.clear();
+
+    for (auto& voice : AudioGlobal::voices)
+    {
+        ReleaseSource( voice );
+    }
+
+    AudioGlobal::voices.clear();
+    alDeleteSources( AudioGlobal::SourceCount, AudioGlobal::sources );
+
     for (ClipInfo *it = AudioGlobal::clips.elements; it != AudioGlobal::clips.elements + AudioGlobal::clips.count; ++it)
     {
         alSourceStopv( 1, &it->srcID );
@@ -302,7 +668,7 @@ unsigned ae3d::AudioSystem::GetClipIdForData( const FileSystem::FileContentsData
     {
         if (AudioGlobal::clips[ i ].path == clipData.path)
         {
-            return i;
+            return i + 1;
         }
     }
     
@@ -319,7 +685,9 @@ unsigned ae3d::AudioSystem::GetClipIdForData( const FileSystem::FileContentsData
     alGenBuffers( 1, &info.bufID );
     alGenSources( 1, &info.srcID );
 
-    AudioGlobal::clips.Add( info );
+    alListener3f( AL_POSITION, 0.0f, 0.0f, 0.0f );
+    alSource3f( info.srcID, AL_POSITION, 0.0f, 0.0f, 0.0f );
+    alSourcef( info.srcID, AL_GAIN, 1.0f );
 
     const std::string extension = clipData.path.substr( clipData.path.length() - 3, clipData.path.length() );
     
@@ -335,11 +703,9 @@ unsigned ae3d::AudioSystem::GetClipIdForData( const FileSystem::FileContentsData
     {
         System::Print( "Unsupported audio file extension in %d. Must be .wav or .ogg.\n", clipData.path.c_str() );
     }
-    
-    alListener3f( AL_POSITION, 0.0f, 0.0f, 0.0f );
-    alSource3f( info.srcID, AL_POSITION, 0.0f, 0.0f, 0.0f );
-    alSourcei( info.srcID, AL_BUFFER, info.bufID );
-    alSourcef( info.srcID, AL_GAIN, 1.0f );
+
+    // Added after loading, because loading fills info.
+    AudioGlobal::clips.Add( info );
 
     fileWatcher.AddFile( clipData.path, AudioReload );
 
@@ -348,30 +714,110 @@ unsigned ae3d::AudioSystem::GetClipIdForData( const FileSystem::FileContentsData
 
 float ae3d::AudioSystem::GetClipLengthForId( unsigned handle )
 {
-    return handle < AudioGlobal::clips.count ? AudioGlobal::clips[ handle ].lengthInSeconds : 1;
+    return (handle > 0 && handle <= AudioGlobal::clips.count) ? AudioGlobal::clips[ handle - 1 ].lengthInSeconds : 1;
 }
 
-void ae3d::AudioSystem::Play( unsigned clipId, bool isLooping )
+bool ae3d::AudioSystem::IsClipStreaming( unsigned handle )
 {
-    if (clipId >= AudioGlobal::clips.count + 1)
+    return handle > 0 && handle <= AudioGlobal::clips.count && AudioGlobal::clips[ handle - 1 ].streamIndex != -1;
+}
+
+unsigned ae3d::AudioSystem::Play( unsigned clipId, bool isLooping, bool is3D, float x, float y, float z )
+{
+    if (clipId == 0 || clipId >= AudioGlobal::clips.count + 1)
     {
-        return;
+        return 0;
     }
-    
-    const auto srcID = AudioGlobal::clips[ clipId - 1 ].srcID;
-    
-    ALint state;
-    alGetSourcei( srcID, AL_SOURCE_STATE, &state );
-    alSourcei( srcID, AL_LOOPING, isLooping ? AL_TRUE : AL_FALSE );
-    
-    if (state != AL_PLAYING)
+
+    if (AudioGlobal::clips[ clipId - 1 ].streamIndex != -1)
+    {
+        std::lock_guard< std::mutex > lock( AudioGlobal::mutex );
+        OggStream& stream = *AudioGlobal::streams[ AudioGlobal::clips[ clipId - 1 ].streamIndex ];
+        stream.isLooping = isLooping;
+
+        if (stream.isPlaying || stream.vorbis == nullptr)
+        {
+            return 0;
+        }
+
+        // The queue is filled here, so that playback starts without waiting for the stream thread.
+        StopStream( stream );
+        stb_vorbis_seek_start( stream.vorbis );
+
+        for (int i = 0; i < OggStream::BufferCount; ++i)
+        {
+            if (FillStreamBuffer( stream, stream.buffers[ i ] ) > 0)
+            {
+                alSourceQueueBuffers( stream.srcID, 1, &stream.buffers[ i ] );
+            }
+        }
+
+        // Looping is done by the decoder, because AL_LOOPING would repeat the queued buffers.
+        alSourcei( stream.srcID, AL_LOOPING, AL_FALSE );
+        alSourcePlay( stream.srcID );
+        stream.isPlaying = true;
+        CheckOpenALError( "Playing ogg stream" );
+        return 0;
+    }
+
+    Voice voice;
+    voice.id = AudioGlobal::nextVoiceId++;
+    voice.clipIndex = clipId - 1;
+    voice.position[ 0 ] = x;
+    voice.position[ 1 ] = y;
+    voice.position[ 2 ] = z;
+    voice.startTime = std::chrono::steady_clock::now();
+    voice.isLooping = isLooping;
+    voice.is3D = is3D;
+
+    // AssignSources() sorts voices by audibility, so the last one is the least audible.
+    if (AudioGlobal::voices.size() >= AudioGlobal::MaxVoiceCount)
     {
-        alSourcePlay( srcID );
+        if (GetAudibility( voice ) <= GetAudibility( AudioGlobal::voices.back() ))
+        {
+            return 0;
+        }
+
+        ReleaseSource( AudioGlobal::voices.back() );
+        AudioGlobal::voices.pop_back();
     }
+
+    AudioGlobal::voices.push_back( voice );
+    AssignSources();
+
+    return voice.id;
+}
+
+void ae3d::AudioSystem::SetVoicePosition( unsigned voiceId, float x, float y, float z )
+{
+    for (auto& voice : AudioGlobal::voices)
+    {
+        if (voice.id == voiceId)
+        {
+            voice.position[ 0 ] = x;
+            voice.position[ 1 ] = y;
+            voice.position[ 2 ] = z;
+
+            if (voice.sourceIndex != -1 && voice.is3D)
+            {
+                alSource3f( AudioGlobal::sources[ voice.sourceIndex ], AL_POSITION, x, y, z );
+            }
+
+            return;
+        }
+    }
+}
+
+void ae3d::AudioSystem::UpdateVoices()
+{
+    AssignSources();
 }
 
 void ae3d::AudioSystem::SetListenerPosition( float x, float y, float z )
 {
+    AudioGlobal::listenerPosition[ 0 ] = x;
+    AudioGlobal::listenerPosition[ 1 ] = y;
+    AudioGlobal::listenerPosition[ 2 ] = z;
     alListener3f( AL_POSITION, x, y, z );
 }
 
@@ -0,0 +1,604 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "AudioSystem.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#if SIMD_SSE3
+#include <pmmintrin.h>
+#elif SIMD_NEON
+#include <arm_neon.h>
+#endif
+#define STB_VORBIS_HEADER_ONLY
+#include "stb_vorbis.c"
+#include "Array.hpp"
+#include "FileSystem.hpp"
+#include "FileWatcher.hpp"
+#include "Statistics.hpp"
+#include "System.hpp"
+
+extern ae3d::FileWatcher fileWatcher;
+
+// Clip decoded into interleaved float samples at its own sample rate. Voices resample it while mixing.
+struct ClipInfo
+{
+    std::vector< float > samples;
+    std::string path;
+    int channels = 1;
+    int sampleRate = 44100;
+    int frameCount = 0;
+    float lengthInSeconds = 0;
+};
+
+// Playing instance of a clip. Voices after MixedVoiceCount in audibility order are virtual: they advance but are not mixed.
+struct Voice
+{
+    unsigned id = 0;
+    unsigned clipIndex = 0;
+    double cursor = 0; // Playback position in the clip's frames.
+    float position[ 3 ] = {};
+    bool isLooping = false;
+    bool is3D = false;
+    bool isFinished = false;
+};
+
+namespace AudioGlobal
+{
+    // Number of voices that are mixed at the same time. Same as the OpenAL backend's source count, so both virtualize the same voices.
+    static const int MixedVoiceCount = 32;
+    // Virtual voices above this are not started.
+    static const unsigned MaxVoiceCount = 256;
+    // Voices are resampled into the scratch buffer in blocks of this many frames.
+    static const int BlockFrames = 256;
+
+    std::vector< Voice > voices;
+    unsigned nextVoiceId = 1;
+    float listenerPosition[ 3 ] = {};
+    float listenerForward[ 3 ] = { 0, 0, -1 };
+    Array< ClipInfo > clips;
+    float scratch[ BlockFrames * 2 ];
+    bool isOfflineRendering = false;
+    std::chrono::steady_clock::time_point lastUpdateTime;
+}
+
+namespace
+{
+std::uint16_t ReadU16( const unsigned char* bytes )
+{
+    return static_cast< std::uint16_t >( bytes[ 0 ] | (bytes[ 1 ] << 8) );
+}
+
+std::uint32_t ReadU32( const unsigned char* bytes )
+{
+    return bytes[ 0 ] | (bytes[ 1 ] << 8) | (bytes[ 2 ] << 16) | (static_cast< std::uint32_t >( bytes[ 3 ] ) << 24);
+}
+
+void WriteU16( std::vector< unsigned char >& bytes, std::uint16_t value )
+{
+    bytes.push_back( static_cast< unsigned char >( value & 0xFF ) );
+    bytes.push_back( static_cast< unsigned char >( value >> 8 ) );
+}
+
+void WriteU32( std::vector< unsigned char >& bytes, std::uint32_t value )
+{
+    WriteU16( bytes, static_cast< std::uint16_t >( value & 0xFFFF ) );
+    WriteU16( bytes, static_cast< std::uint16_t >( value >> 16 ) );
+}
+
+void LoadOgg( const ae3d::FileSystem::FileContentsData& clipData, ClipInfo& info )
+{
+    int channels = 0;
+    int sampleRate = 0;
+    short* decoded = nullptr;
+    const int frameCount = stb_vorbis_decode_memory( clipData.data.data(), static_cast< int >( clipData.data.size() ), &channels, &sampleRate, &decoded );
+
+    if (frameCount <= 0 || decoded == nullptr)
+    {
+        ae3d::System::Print( "AudioSystem: Could not decode %s\n", clipData.path.c_str() );
+        return;
+    }
+
+    // The mixer supports mono and stereo, so other layouts keep their first two channels.
+    info.channels = std::min( channels, 2 );
+    info.sampleRate = sampleRate;
+    info.frameCount = frameCount;
+    info.lengthInSeconds = frameCount / static_cast< float >( sampleRate );
+    info.samples.resize( frameCount * info.channels );
+
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+        for (int channel = 0; channel < info.channels; ++channel)
+        {
+            info.samples[ frame * info.channels + channel ] = decoded[ frame * channels + channel ] / 32768.0f;
+        }
+    }
+
+    std::free( decoded );
+}
+
+void LoadWav( const ae3d::FileSystem::FileContentsData& clipData, ClipInfo& info )
+{
+    const unsigned char* bytes = clipData.data.data();
+    const std::size_t size = clipData.data.size();
+
+    if (size < 12 || std::memcmp( bytes, "RIFF", 4 ) != 0 || std::memcmp( bytes + 8, "WAVE", 4 ) != 0)
+    {
+        ae3d::System::Print( "LoadWav: %s is not a valid .wav file!\n", clipData.path.c_str() );
+        return;
+    }
+
+    int channels = 0;
+    int bitsPerSample = 0;
+    int sampleRate = 0;
+    const unsigned char* data = nullptr;
+    std::size_t dataSize = 0;
+
+    // Chunks can be in any order and there can be chunks other than fmt and data.
+    for (std::size_t offset = 12; offset + 8 <= size;)
+    {
+        const std::size_t chunkSize = std::min( static_cast< std::size_t >( ReadU32( bytes + offset + 4 ) ), size - offset - 8 );
+
+        if (std::memcmp( bytes + offset, "fmt ", 4 ) == 0 && chunkSize >= 16)
+        {
+            if (ReadU16( bytes + offset + 8 ) != 1)
+            {
+                ae3d::System::Print( "%s does not contain uncompressed PCM audio data!\n", clipData.path.c_str() );
+                return;
+            }
+
+            channels = ReadU16( bytes + offset + 10 );
+            sampleRate = static_cast< int >( ReadU32( bytes + offset + 12 ) );
+            bitsPerSample = ReadU16( bytes + offset + 22 );
+        }
+        else if (std::memcmp( bytes + offset, "data", 4 ) == 0)
+        {
+            data = bytes + offset + 8;
+            dataSize = chunkSize;
+        }
+
+        offset += 8 + chunkSize + (chunkSize & 1);
+    }
+
+    if (data == nullptr || (channels != 1 && channels != 2) || (bitsPerSample != 8 && bitsPerSample != 16) || sampleRate <= 0)
+    {
+        ae3d::System::Print( "Audio: Unknown format in file %s\n", clipData.path.c_str() );
+        return;
+    }
+
+    const int bytesPerSample = bitsPerSample / 8;
+    const int sampleCount = static_cast< int >( dataSize / bytesPerSample );
+
+    info.channels = channels;
+    info.sampleRate = sampleRate;
+    info.frameCount = sampleCount / channels;
+    info.lengthInSeconds = info.frameCount / static_cast< float >( sampleRate );
+    info.samples.resize( info.frameCount * channels );
+
+    for (std::size_t i = 0; i < info.samples.size(); ++i)
+    {
+        // 8-bit samples are unsigned, 16-bit samples are signed.
+        info.samples[ i ] = bitsPerSample == 8 ? (data[ i ] - 128) / 128.0f : static_cast< std::int16_t >( ReadU16( data + i * 2 ) ) / 32768.0f;
+    }
+}
+
+// Voices have the same gain, so the inverse distance model makes the farthest voice the quietest.
+float GetAudibility( const Voice& voice )
+{
+    if (!voice.is3D)
+    {
+        return 1;
+    }
+
+    const float x = voice.position[ 0 ] - AudioGlobal::listenerPosition[ 0 ];
+    const float y = voice.position[ 1 ] - AudioGlobal::listenerPosition[ 1 ];
+    const float z = voice.position[ 2 ] - AudioGlobal::listenerPosition[ 2 ];
+    return 1 / std::max( std::sqrt( x * x + y * y + z * z ), 1.0f );
+}
+
+// Left and right gain. 3D voices are attenuated like OpenAL's clamped inverse distance model and panned
+// by their direction from the listener, so a voice in front is at full gain on both channels.
+void GetGains( const Voice& voice, float& outLeft, float& outRight )
+{
+    outLeft = 1;
+    outRight = 1;
+
+    if (!voice.is3D)
+    {
+        return;
+    }
+
+    const float x = voice.position[ 0 ] - AudioGlobal::listenerPosition[ 0 ];
+    const float y = voice.position[ 1 ] - AudioGlobal::listenerPosition[ 1 ];
+    const float z = voice.position[ 2 ] - AudioGlobal::listenerPosition[ 2 ];
+    const float distance = std::sqrt( x * x + y * y + z * z );
+
+    if (distance > 0.0001f)
+    {
+        // Right is forward cross up, up being +y.
+        const float* forward = AudioGlobal::listenerForward;
+        const float pan = (-forward[ 2 ] * x + forward[ 0 ] * z) / distance;
+        outLeft = std::min( 1.0f, 1 - pan );
+        outRight = std::min( 1.0f, 1 + pan );
+    }
+
+    const float attenuation = 1 / std::max( distance, 1.0f );
+    outLeft *= attenuation;
+    outRight *= attenuation;
+}
+
+// Resamples the voice into stereo frames with linear interpolation and advances it.
+// Returns the number of written frames, which is less than frameCount if a non-looping voice finished.
+int Resample( Voice& voice, float* outFrames, int frameCount )
+{
+    const ClipInfo& clip = AudioGlobal::clips[ voice.clipIndex ];
+    const double step = clip.sampleRate / static_cast< double >( ae3d::AudioSystem::OutputSampleRate );
+    const int last = clip.frameCount - 1;
+    const int channels = clip.channels;
+    const float* samples = clip.samples.data();
+
+    for (int i = 0; i < frameCount; ++i)
+    {
+        const int index0 = static_cast< int >( voice.cursor );
+        const int index1 = index0 < last ? index0 + 1 : (voice.isLooping ? 0 : last);
+        const float t = static_cast< float >( voice.cursor - index0 );
+
+        const float left0 = samples[ index0 * channels ];
+        const float left1 = samples[ index1 * channels ];
+        const float right0 = samples[ index0 * channels + channels - 1 ];
+        const float right1 = samples[ index1 * channels + channels - 1 ];
+        outFrames[ i * 2 + 0 ] = left0 + (left1 - left0) * t;
+        outFrames[ i * 2 + 1 ] = right0 + (right1 - right0) * t;
+
+        voice.cursor += step;
+
+        if (voice.cursor >= clip.frameCount)
+        {
+            if (!voice.isLooping)
+            {
+                voice.isFinished = true;
+                return i + 1;
+            }
+
+            voice.cursor = std::fmod( voice.cursor, static_cast< double >( clip.frameCount ) );
+        }
+    }
+
+    return frameCount;
+}
+
+// Adds gained stereo frames into the bus.
+void Accumulate( float* bus, const float* frames, int frameCount, float leftGain, float rightGain )
+{
+    int i = 0;
+#if SIMD_SSE3
+    const __m128 gains = _mm_setr_ps( leftGain, rightGain, leftGain, rightGain );
+
+    for (; i + 2 <= frameCount; i += 2)
+    {
+        const __m128 sum = _mm_add_ps( _mm_loadu_ps( bus + i * 2 ), _mm_mul_ps( _mm_loadu_ps( frames + i * 2 ), gains ) );
+        _mm_storeu_ps( bus + i * 2, sum );
+    }
+#elif SIMD_NEON
+    const float gainArray[ 4 ] = { leftGain, rightGain, leftGain, rightGain };
+    const float32x4_t gains = vld1q_f32( gainArray );
+
+    for (; i + 2 <= frameCount; i += 2)
+    {
+        vst1q_f32( bus + i * 2, vmlaq_f32( vld1q_f32( bus + i * 2 ), vld1q_f32( frames + i * 2 ), gains ) );
+    }
+#endif
+    for (; i < frameCount; ++i)
+    {
+        bus[ i * 2 + 0 ] += frames[ i * 2 + 0 ] * leftGain;
+        bus[ i * 2 + 1 ] += frames[ i * 2 + 1 ] * rightGain;
+    }
+}
+
+void MixVoice( Voice& voice, float* bus, int frameCount )
+{
+    float leftGain, rightGain;
+    GetGains( voice, leftGain, rightGain );
+
+    for (int frame = 0; frame < frameCount && !voice.isFinished;)
+    {
+        const int blockFrames = Resample( voice, AudioGlobal::scratch, std::min( frameCount - frame, AudioGlobal::BlockFrames ) );
+        Accumulate( bus + frame * 2, AudioGlobal::scratch, blockFrames, leftGain, rightGain );
+        frame += blockFrames;
+    }
+}
+
+// Advances a voice without mixing it.
+void AdvanceVoice( Voice& voice, int frameCount )
+{
+    const ClipInfo& clip = AudioGlobal::clips[ voice.clipIndex ];
+    voice.cursor += frameCount * (clip.sampleRate / static_cast< double >( ae3d::AudioSystem::OutputSampleRate ));
+
+    if (voice.cursor >= clip.frameCount)
+    {
+        if (voice.isLooping && clip.frameCount > 0)
+        {
+            voice.cursor = std::fmod( voice.cursor, static_cast< double >( clip.frameCount ) );
+        }
+        else
+        {
+            voice.isFinished = true;
+        }
+    }
+}
+
+// Removes finished voices and sorts the rest by audibility, so the first MixedVoiceCount voices are mixed.
+void SortVoices()
+{
+    auto& voices = AudioGlobal::voices;
+    voices.erase( std::remove_if( voices.begin(), voices.end(), []( const Voice& voice ) { return voice.isFinished; } ), voices.end() );
+
+    // Ties keep their order, so equally audible voices don't swap between mixed and virtual every frame.
+    std::stable_sort( voices.begin(), voices.end(), []( const Voice& a, const Voice& b )
+    {
+        return GetAudibility( a ) > GetAudibility( b );
+    } );
+
+    const int mixedCount = static_cast< int >( std::min( voices.size(), static_cast< std::size_t >( AudioGlobal::MixedVoiceCount ) ) );
+    Statistics::SetAudioVoiceCounts( mixedCount, static_cast< int >( voices.size() ) - mixedCount );
+}
+
+void StopVoicesForClip( unsigned clipIndex )
+{
+    for (auto& voice : AudioGlobal::voices)
+    {
+        if (voice.clipIndex == clipIndex)
+        {
+            voice.isFinished = true;
+        }
+    }
+
+    SortVoices();
+}
+
+void LoadClip( const ae3d::FileSystem::FileContentsData& clipData, ClipInfo& info )
+{
+    const std::string extension = clipData.path.substr( clipData.path.length() - 3, clipData.path.length() );
+
+    if (extension == "wav" || extension == "WAV")
+    {
+        LoadWav( clipData, info );
+    }
+    else if (extension == "ogg" || extension == "OGG")
+    {
+        LoadOgg( clipData, info );
+    }
+    else
+    {
+        ae3d::System::Print( "Unsupported audio file extension in %s. Must be .wav or .ogg.\n", clipData.path.c_str() );
+    }
+}
+}
+
+void AudioReload( const std::string& path )
+{
+    for (unsigned i = 0; i < AudioGlobal::clips.count; ++i)
+    {
+        if (path == AudioGlobal::clips[ i ].path)
+        {
+            StopVoicesForClip( i );
+            AudioGlobal::clips[ i ] = ClipInfo();
+            AudioGlobal::clips[ i ].path = path;
+            LoadClip( ae3d::FileSystem::FileContents( path.c_str() ), AudioGlobal::clips[ i ] );
+        }
+    }
+}
+
+void ae3d::AudioSystem::Init()
+{
+    AudioGlobal::lastUpdateTime = std::chrono::steady_clock::now();
+}
+
+void ae3d::AudioSystem::Deinit()
+{
+    AudioGlobal::voices.clear();
+
+    for (unsigned i = 0; i < AudioGlobal::clips.count; ++i)
+    {
+        AudioGlobal::clips[ i ] = ClipInfo();
+    }
+}
+
+unsigned ae3d::AudioSystem::GetClipIdForData( const FileSystem::FileContentsData& clipData )
+{
+    // Checks cache for an already loaded clip from the same path.
+    for (unsigned i = 0; i < AudioGlobal::clips.count; ++i)
+    {
+        if (AudioGlobal::clips[ i ].path == clipData.path)
+        {
+            return i + 1;
+        }
+    }
+
+    if (!clipData.isLoaded)
+    {
+        System::Print( "AudioSystem: File data %s not loaded!\n", clipData.path.c_str() );
+        return 0;
+    }
+
+    ClipInfo info;
+    info.path = clipData.path;
+    LoadClip( clipData, info );
+    AudioGlobal::clips.Add( info );
+
+    fileWatcher.AddFile( clipData.path, AudioReload );
+
+    return AudioGlobal::clips.count;
+}
+
+float ae3d::AudioSystem::GetClipLengthForId( unsigned handle )
+{
+    return (handle > 0 && handle <= AudioGlobal::clips.count) ? AudioGlobal::clips[ handle - 1 ].lengthInSeconds : 1;
+}
+
+bool ae3d::AudioSystem::IsClipStreaming( unsigned /*handle*/ )
+{
+    return false;
+}
+
+unsigned ae3d::AudioSystem::Play( unsigned clipId, bool isLooping, bool is3D, float x, float y, float z )
+{
+    if (clipId == 0 || clipId >= AudioGlobal::clips.count + 1 || AudioGlobal::clips[ clipId - 1 ].frameCount == 0)
+    {
+        return 0;
+    }
+
+    Voice voice;
+    voice.id = AudioGlobal::nextVoiceId++;
+    voice.clipIndex = clipId - 1;
+    voice.position[ 0 ] = x;
+    voice.position[ 1 ] = y;
+    voice.position[ 2 ] = z;
+    voice.isLooping = isLooping;
+    voice.is3D = is3D;
+
+    // SortVoices() sorts voices by audibility, so the last one is the least audible.
+    if (AudioGlobal::voices.size() >= AudioGlobal::MaxVoiceCount)
+    {
+        if (GetAudibility( voice ) <= GetAudibility( AudioGlobal::voices.back() ))
+        {
+            return 0;
+        }
+
+        AudioGlobal::voices.pop_back();
+    }
+
+    AudioGlobal::voices.push_back( voice );
+    SortVoices();
+
+    return voice.id;
+}
+
+void ae3d::AudioSystem::SetVoicePosition( unsigned voiceId, float x, float y, float z )
+{
+    for (auto& voice : AudioGlobal::voices)
+    {
+        if (voice.id == voiceId)
+        {
+            voice.position[ 0 ] = x;
+            voice.position[ 1 ] = y;
+            voice.position[ 2 ] = z;
+            return;
+        }
+    }
+}
+
+void ae3d::AudioSystem::UpdateVoices()
+{
+    // The null output consumes audio in real time without mixing it.
+    if (!AudioGlobal::isOfflineRendering)
+    {
+        const auto now = std::chrono::steady_clock::now();
+        const double elapsedSeconds = std::chrono::duration< double >( now - AudioGlobal::lastUpdateTime ).count();
+        const int frameCount = static_cast< int >( elapsedSeconds * OutputSampleRate );
+
+        // Keeps the remainder, so voices don't drift when frames are shorter than an output frame.
+        AudioGlobal::lastUpdateTime += std::chrono::duration_cast< std::chrono::steady_clock::duration >(
+                                           std::chrono::duration< double >( frameCount / static_cast< double >( OutputSampleRate ) ) );
+
+        for (auto& voice : AudioGlobal::voices)
+        {
+            AdvanceVoice( voice, frameCount );
+        }
+    }
+
+    SortVoices();
+}
+
+void ae3d::AudioSystem::SetListenerPosition( float x, float y, float z )
+{
+    AudioGlobal::listenerPosition[ 0 ] = x;
+    AudioGlobal::listenerPosition[ 1 ] = y;
+    AudioGlobal::listenerPosition[ 2 ] = z;
+}
+
+void ae3d::AudioSystem::SetListenerOrientation( float forwardX, float forwardY, float forwardZ )
+{
+    AudioGlobal::listenerForward[ 0 ] = forwardX;
+    AudioGlobal::listenerForward[ 1 ] = forwardY;
+    AudioGlobal::listenerForward[ 2 ] = forwardZ;
+}
+
+void ae3d::AudioSystem::SetOfflineRendering( bool enable )
+{
+    AudioGlobal::isOfflineRendering = enable;
+    AudioGlobal::lastUpdateTime = std::chrono::steady_clock::now();
+}
+
+void ae3d::AudioSystem::Mix( float* outSamples, int frameCount )
+{
+    std::fill( outSamples, outSamples + frameCount * 2, 0.0f );
+
+    for (std::size_t i = 0; i < AudioGlobal::voices.size(); ++i)
+    {
+        if (i < static_cast< std::size_t >( AudioGlobal::MixedVoiceCount ))
+        {
+            MixVoice( AudioGlobal::voices[ i ], outSamples, frameCount );
+        }
+        else
+        {
+            AdvanceVoice( AudioGlobal::voices[ i ], frameCount );
+        }
+    }
+
+    SortVoices();
+}
+
+bool ae3d::AudioSystem::MixToWav( const char* path, float seconds )
+{
+    const int frameCount = static_cast< int >( seconds * OutputSampleRate );
+    const std::uint32_t dataSize = static_cast< std::uint32_t >( frameCount ) * 2 * sizeof( std::int16_t );
+
+    std::vector< unsigned char > bytes;
+    bytes.reserve( 44 + dataSize );
+    bytes.insert( bytes.end(), { 'R', 'I', 'F', 'F' } );
+    WriteU32( bytes, 36 + dataSize );
+    bytes.insert( bytes.end(), { 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' } );
+    WriteU32( bytes, 16 );
+    WriteU16( bytes, 1 ); // PCM
+    WriteU16( bytes, 2 ); // Channels
+    WriteU32( bytes, OutputSampleRate );
+    WriteU32( bytes, OutputSampleRate * 2 * sizeof( std::int16_t ) );
+    WriteU16( bytes, 2 * sizeof( std::int16_t ) );
+    WriteU16( bytes, 16 );
+    bytes.insert( bytes.end(), { 'd', 'a', 't', 'a' } );
+    WriteU32( bytes, dataSize );
+
+    std::vector< float > block( AudioGlobal::BlockFrames * 4 * 2 );
+
+    for (int frame = 0; frame < frameCount;)
+    {
+        const int blockFrames = std::min( frameCount - frame, static_cast< int >( block.size() / 2 ) );
+        Mix( block.data(), blockFrames );
+
+        for (int i = 0; i < blockFrames * 2; ++i)
+        {
+            const float clamped = std::min( std::max( block[ i ], -1.0f ), 1.0f );
+            WriteU16( bytes, static_cast< std::uint16_t >( static_cast< std::int16_t >( std::lround( clamped * 32767.0f ) ) ) );
+        }
+
+        frame += blockFrames;
+    }
+
+    FILE* file = std::fopen( path, "wb" );
+
+    if (file == nullptr)
+    {
+        System::Print( "AudioSystem: Could not open %s for writing.\n", path );
+        return false;
+    }
+
+    const bool isWritten = std::fwrite( bytes.data(), 1, bytes.size(), file ) == bytes.size();
+    std::fclose( file );
+    return isWritten;
+}
@@ -1,14 +1,13 @@
 // This is an independent project of an individual developer. Dear PVS-Studio, please check it.
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 #include "Font.hpp"
+#include <cstring>
 #include <sstream>
 #include <string>
 #include "Array.hpp"
 #include "FileSystem.hpp"
 #include "System.hpp"
 #include "Texture2D.hpp"
-#include "VertexBuffer.hpp"
-#include "Vec3.hpp"
 
 namespace BlockType
 {
@@ -52,9 +51,67 @@ struct CommonBlock
     unsigned char  blue;
 };
 
+namespace
+{
+    // \return Code point at text and advances text past it. Invalid sequences return U+FFFD.
+    unsigned DecodeUtf8( const char*& text )
+    {
+        const unsigned char first = static_cast< unsigned char >( *text++ );
+
+        if (first < 0x80)
+        {
+            return first;
+        }
+
+        int continuationCount = 0;
+        unsigned codePoint = 0;
+
+        if ((first & 0xE0) == 0xC0)
+        {
+            continuationCount = 1;
+            codePoint = first & 0x1Fu;
+        }
+        else if ((first & 0xF0) == 0xE0)
+        {
+            continuationCount = 2;
+            codePoint = first & 0x0Fu;
+        }
+        else if ((first & 0xF8) == 0xF0)
+        {
+            continuationCount = 3;
+            codePoint = first & 0x07u;
+        }
+        else
+        {
+            return 0xFFFD;
+        }
+
+        for (int i = 0; i < continuationCount; ++i)
+        {
+            const unsigned char next = static_cast< unsigned char >( *text );
+
+            // Also stops at the terminator.
+            if ((next & 0xC0) != 0x80)
+            {
+                return 0xFFFD;
+            }
+
+            codePoint = (codePoint << 6) | (next & 0x3Fu);
+            ++text;
+        }
+
+        return codePoint;
+    }
+
+    std::uint64_t GetKerningKey( unsigned first, unsigned second )
+    {
+        return (static_cast< std::uint64_t >( first ) << 32) | second;
+    }
+}
+
 ae3d::Font::Font()
 {
-    texture = Texture2D::GetDefaultTexture();
+    textures.push_back( Texture2D::GetDefaultTexture() );
     padding[ 0 ] = 1;
     padding[ 1 ] = 2;
     padding[ 2 ] = 3;
@@ -63,90 +120,91 @@ ae3d::Font::Font()
     spacing[ 1 ] = 20;
 }
 
-void ae3d::Font::CreateVertexBuffer( const char* text, const Vec4& color, VertexBuffer& outVertexBuffer ) const
+const ae3d::Font::Character* ae3d::Font::FindCharacter( unsigned id ) const
 {
-    const std::string textStr( text );
-    
-    ae3d::VertexBuffer::VertexPTC* vertices = new ae3d::VertexBuffer::VertexPTC[ textStr.size() * 6 ];
-    ae3d::VertexBuffer::Face* faces = new ae3d::VertexBuffer::Face[ textStr.size() * 2 ];
+    if (id < 256)
+    {
+        return &asciiChars[ id ];
+    }
+
+    const auto it = chars.find( id );
+    return it != chars.end() ? &it->second : nullptr;
+}
+
+float ae3d::Font::GetKerning( unsigned first, unsigned second ) const
+{
+    if (kernings.empty())
+    {
+        return 0;
+    }
+
+    const auto it = kernings.find( GetKerningKey( first, second ) );
+    return it != kernings.end() ? it->second : 0;
+}
+
+void ae3d::Font::LayoutText( const char* text, std::vector< GlyphQuad >& outQuads ) const
+{
+    outQuads.clear();
 
     float accumX = 0;
     float y = 0;
+    unsigned previousId = 0;
     
-    for (unsigned short c = 0; c < static_cast<unsigned short>( textStr.size() ); ++c)
+    for (const char* c = text; *c != 0;)
     {
-        if (static_cast<int>(text[ c ]) < 0)
+        const unsigned id = DecodeUtf8( c );
+        const Character* ch = FindCharacter( id );
+
+        if (ch == nullptr)
         {
+            outQuads.push_back( GlyphQuad{ 0, 0, 0, 0, 0, 0, 0, 0, 0 } );
+            previousId = 0;
             continue;
         }
-        
-        const Character& ch = chars[ static_cast<int>(text[ c ]) ];
 
-        if (text[ c ] == '\n')
+        if (id == '\n')
         {
-            const Character& charA = chars[ static_cast<int>( 'a' )];
+            const Character& charA = asciiChars[ static_cast<int>( 'a' )];
             accumX = 0;
             y += charA.height + charA.yOffset;
         }
         else
         {
-            accumX += ch.xAdvance;
+            accumX += ch->xAdvance + GetKerning( previousId, id );
         }
-        
-        const float scale = 1;
-        float x = 0;
-        const float z = -0.6f;
-
-        float offx = x + ch.xOffset * scale + accumX * scale;
-        float offy = y + ch.yOffset * scale;
-        
-        auto tex = texture;
 
-        float u0 = ch.x / tex->GetWidth();
-        float u1 = (ch.x + ch.width) / tex->GetWidth();
-        
-        float v0 = (ch.y + ch.height) / tex->GetHeight();
-        float v1 = (ch.y) / tex->GetHeight();
+        previousId = id;
 
-        // Upper triangle.
-        faces[ c * 2 + 0 ].a = c * 6 + 0;
-        faces[ c * 2 + 0 ].b = c * 6 + 1;
-        faces[ c * 2 + 0 ].c = c * 6 + 2;
-        
-        vertices[ c * 6 + 0 ] = VertexBuffer::VertexPTC( ae3d::Vec3( offx, offy, z ), u0, v1 );
-        vertices[ c * 6 + 1 ] = VertexBuffer::VertexPTC( ae3d::Vec3( offx + ch.width * scale, offy, z ), u1, v1 );
-        vertices[ c * 6 + 2 ] = VertexBuffer::VertexPTC( ae3d::Vec3( offx, offy + ch.height * scale, z ), u0, v0 );
+        const float offx = ch->xOffset + accumX;
+        const float offy = y + ch->yOffset;
+        const int page = ch->page >= 0 && ch->page < static_cast< int >( textures.size() ) ? ch->page : 0;
+        const Texture2D* texture = textures[ page ];
         
-        // Lower triangle.
-        faces[ c * 2 + 1 ].a = c * 6 + 3;
-        faces[ c * 2 + 1 ].b = c * 6 + 4;
-        faces[ c * 2 + 1 ].c = c * 6 + 5;
-        
-        vertices[ c * 6 + 3 ] = VertexBuffer::VertexPTC( ae3d::Vec3( offx + ch.width * scale, offy, z ), u1, v1 );
-        vertices[ c * 6 + 4 ] = VertexBuffer::VertexPTC( ae3d::Vec3( offx + ch.width * scale, offy + ch.height * scale, z ), u1, v0 );
-        vertices[ c * 6 + 5 ] = VertexBuffer::VertexPTC( ae3d::Vec3( offx, offy + ch.height * scale, z ), u0, v0 );
-        
-        vertices[ c * 6 + 0 ].color = color;
-        vertices[ c * 6 + 1 ].color = color;
-        vertices[ c * 6 + 2 ].color = color;
-
-        vertices[ c * 6 + 3 ].color = color;
-        vertices[ c * 6 + 4 ].color = color;
-        vertices[ c * 6 + 5 ].color = color;
+        GlyphQuad quad;
+        quad.x0 = offx;
+        quad.y0 = offy;
+        quad.x1 = offx + ch->width;
+        quad.y1 = offy + ch->height;
+        quad.u0 = ch->x / texture->GetWidth();
+        quad.u1 = (ch->x + ch->width) / texture->GetWidth();
+        quad.v0 = (ch->y + ch->height) / texture->GetHeight();
+        quad.v1 = ch->y / texture->GetHeight();
+        quad.page = page;
+        outQuads.push_back( quad );
     }
-    
-    outVertexBuffer.Generate( faces, int( textStr.size() * 2 ), vertices, int( textStr.size() * 6 ), VertexBuffer::Storage::CPU );
-    outVertexBuffer.SetDebugName( text );
-
-    delete[] vertices;
-    delete[] faces;
 }
 
 void ae3d::Font::LoadBMFont( Texture2D* fontTex, const FileSystem::FileContentsData& metaData )
 {
-    if (fontTex != nullptr)
+    Texture2D* pageTexture = fontTex != nullptr ? fontTex : textures[ 0 ];
+    LoadBMFont( &pageTexture, 1, metaData );
+}
+
+void ae3d::Font::LoadBMFont( Texture2D* const* pageTextures, int pageCount, const FileSystem::FileContentsData& metaData )
+{
+    if (pageCount > 0)
     {
-        texture = fontTex;
+        textures.assign( pageTextures, pageTextures + pageCount );
     }
 
     std::stringstream metaStream( std::string( std::begin( metaData.data ), std::end( metaData.data ) ) );
@@ -224,46 +282,73 @@ void ae3d::Font::LoadBMFontMetaText( const FileSystem::FileContentsData& metaDat
         }
     }
     
-    // Third line (page)
-    std::getline( metaStream, line );
-    // Fourth line (chars)
-    std::getline( metaStream, line );
-    
-    // Character tags.
+    // The rest are page, chars, char and kerning tags.
     while (!metaStream.eof())
     {
         std::getline( metaStream, line );
-        std::stringstream charStream( line );
-        
-        charStream.seekg( line.find( "id=" ) + 3 );
-        int id;
-        charStream >> id;
+        std::stringstream tagStream( line );
 
-        if (id > 255)
+        if (line.compare( 0, 5, "char " ) == 0)
         {
-            continue;
+            tagStream.seekg( line.find( "id=" ) + 3 );
+            unsigned id;
+            tagStream >> id;
+
+            Character character;
+
+            tagStream.seekg( line.find( "x=" ) + 2 );
+            tagStream >> character.x;
+            
+            tagStream.seekg( line.find( "y=" ) + 2 );
+            tagStream >> character.y;
+            
+            tagStream.seekg( line.find( "width=" ) + 6 );
+            tagStream >> character.width;
+            
+            tagStream.seekg( line.find( "height=" ) + 7 );
+            tagStream >> character.height;
+            
+            tagStream.seekg( line.find( "xoffset=" ) + 8 );
+            tagStream >> character.xOffset;
+            
+            tagStream.seekg( line.find( "yoffset=" ) + 8 );
+            tagStream >> character.yOffset;
+            
+            tagStream.seekg( line.find( "xadvance=" ) + 9 );
+            tagStream >> character.xAdvance;
+
+            if (line.find( "page=" ) != std::string::npos)
+            {
+                tagStream.seekg( line.find( "page=" ) + 5 );
+                tagStream >> character.page;
+            }
+
+            if (id < 256)
+            {
+                asciiChars[ id ] = character;
+            }
+            else
+            {
+                chars[ id ] = character;
+            }
         }
+        else if (line.compare( 0, 8, "kerning " ) == 0)
+        {
+            unsigned first;
+            unsigned second;
+            float amount;
 
-        charStream.seekg( line.find( "x=" ) + 2 );
-        charStream >> chars[ id ].x;
-        
-        charStream.seekg( line.find( "y=" ) + 2 );
-        charStream >> chars[ id ].y;
-        
-        charStream.seekg( line.find( "width=" ) + 6 );
-        charStream >> chars[ id ].width;
-        
-        charStream.seekg( line.find( "height=" ) + 7 );
-        charStream >> chars[ id ].height;
-        
-        charStream.seekg( line.find( "xoffset=" ) + 8 );
-        charStream >> chars[ id ].xOffset;
-        
-        charStream.seekg( line.find( "yoffset=" ) + 8 );
-        charStream >> chars[ id ].yOffset;
-        
-        charStream.seekg( line.find( "xadvance=" ) + 9 );
-        charStream >> chars[ id ].xAdvance;
+            tagStream.seekg( line.find( "first=" ) + 6 );
+            tagStream >> first;
+
+            tagStream.seekg( line.find( "second=" ) + 7 );
+            tagStream >> second;
+
+            tagStream.seekg( line.find( "amount=" ) + 7 );
+            tagStream >> amount;
+
+            kernings[ GetKerningKey( first, second ) ] = amount;
+        }
     }
 }
 
@@ -288,10 +373,10 @@ void ae3d::Font::LoadBMFontMetaBinary(const FileSystem::FileContentsData& metaDa
         return;
     }
     
-    while (!ifs.eof())
+    unsigned char blockId;
+
+    while (ifs.read( (char*)&blockId, 1 ))
     {
-        unsigned char blockId;
-        ifs.read( (char*)&blockId, 1 );
         int blockType = (BlockType::Enum)blockId;
         
         int blockSize;
@@ -330,24 +415,44 @@ void ae3d::Font::LoadBMFontMetaBinary(const FileSystem::FileContentsData& metaDa
             blocks.Allocate( blockSize / sizeof( CharacterBlock ) );
             
             ifs.read( (char*)&blocks[ 0 ].id, blockSize );
-            System::Assert( blocks.count <= 256, "Too many glyphs." );
             
             for (unsigned c = 0; c < blocks.count; ++c)
             {
-                chars[ blocks[ c ].id ].x = blocks[ c ].x;
-                chars[ blocks[ c ].id ].y = blocks[ c ].y;
-                chars[ blocks[ c ].id ].width = blocks[ c ].width;
-                chars[ blocks[ c ].id ].height = blocks[ c ].height;
-                chars[ blocks[ c ].id ].xOffset = blocks[ c ].xOffset;
-                chars[ blocks[ c ].id ].yOffset = blocks[ c ].yOffset;
-                chars[ blocks[ c ].id ].xAdvance = blocks[ c ].xAdvance;
+                Character character;
+                character.x = blocks[ c ].x;
+                character.y = blocks[ c ].y;
+                character.width = blocks[ c ].width;
+                character.height = blocks[ c ].height;
+                character.xOffset = blocks[ c ].xOffset;
+                character.yOffset = blocks[ c ].yOffset;
+                character.xAdvance = blocks[ c ].xAdvance;
+                character.page = blocks[ c ].page;
+
+                if (blocks[ c ].id < 256)
+                {
+                    asciiChars[ blocks[ c ].id ] = character;
+                }
+                else
+                {
+                    chars[ blocks[ c ].id ] = character;
+                }
             }
-            
-            return;
         }
         else if (blockType == BlockType::Kerning)
         {
             ifs.read( (char*)&blockData[ 0 ], blockSize );
+
+            // Each pair is first (4 bytes), second (4 bytes) and amount (2 bytes).
+            for (int offset = 0; offset + 10 <= blockSize; offset += 10)
+            {
+                unsigned first;
+                unsigned second;
+                short amount;
+                std::memcpy( &first, &blockData[ offset ], 4 );
+                std::memcpy( &second, &blockData[ offset + 4 ], 4 );
+                std::memcpy( &amount, &blockData[ offset + 8 ], 2 );
+                kernings[ GetKerningKey( first, second ) ] = amount;
+            }
         }
         else
         {
@@ -363,5 +468,12 @@ int ae3d::Font::TextWidth( const char* text ) const
         return 0;
     }
 
-    return (int)(std::string( text ).length() * chars[ (int)'a' ].width);
+    int codePointCount = 0;
+
+    for (const char* c = text; *c != 0; DecodeUtf8( c ))
+    {
+        ++codePointCount;
+    }
+
+    return (int)(codePointCount * asciiChars[ (int)'a' ].width);
 }
@@ -0,0 +1,311 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "JointAnimation.hpp"
+#include <algorithm>
+#include <cmath>
+#include "Quaternion.hpp"
+
+using namespace ae3d;
+
+namespace
+{
+    // Max angle in radians between the removed rotation keys and the interpolated rotation.
+    const float maxRotationError = 0.001f;
+    const float maxScaleError = 0.0001f;
+
+    float Dot( const Quaternion& a, const Quaternion& b )
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    }
+
+    // Normalized linear interpolation. a and b must be in the same hemisphere.
+    Quaternion Nlerp( const Quaternion& a, const Quaternion& b, float t )
+    {
+        Quaternion result;
+        result.x = a.x + (b.x - a.x) * t;
+        result.y = a.y + (b.y - a.y) * t;
+        result.z = a.z + (b.z - a.z) * t;
+        result.w = a.w + (b.w - a.w) * t;
+
+        const float length = std::sqrt( Dot( result, result ) );
+        result.x /= length;
+        result.y /= length;
+        result.z /= length;
+        result.w /= length;
+        return result;
+    }
+
+    Vec3 Lerp( const Vec3& a, const Vec3& b, float t )
+    {
+        return a + (b - a) * t;
+    }
+
+    float MaxComponent( const Vec3& v )
+    {
+        return std::max( std::max( std::fabs( v.x ), std::fabs( v.y ) ), std::fabs( v.z ) );
+    }
+
+    // Splits matrix into scale, rotation and translation. The matrix must not contain shear.
+    void Decompose( const Matrix44& matrix, Vec3& outScale, Quaternion& outRotation, Vec3& outTranslation )
+    {
+        const Vec3 row0( matrix.m[ 0 ], matrix.m[ 1 ], matrix.m[  2 ] );
+        const Vec3 row1( matrix.m[ 4 ], matrix.m[ 5 ], matrix.m[  6 ] );
+        const Vec3 row2( matrix.m[ 8 ], matrix.m[ 9 ], matrix.m[ 10 ] );
+
+        outScale = Vec3( row0.Length(), row1.Length(), row2.Length() );
+
+        // Mirrored matrix.
+        if (Vec3::Dot( Vec3::Cross( row0, row1 ), row2 ) < 0)
+        {
+            outScale.x = -outScale.x;
+        }
+
+        Matrix44 rotation;
+
+        for (int column = 0; column < 3; ++column)
+        {
+            rotation.m[     column ] = outScale.x != 0 ? matrix.m[     column ] / outScale.x : 0;
+            rotation.m[ 4 + column ] = outScale.y != 0 ? matrix.m[ 4 + column ] / outScale.y : 0;
+            rotation.m[ 8 + column ] = outScale.z != 0 ? matrix.m[ 8 + column ] / outScale.z : 0;
+        }
+
+        // FromMatrix() returns the conjugate of the quaternion whose GetMatrix() gives the matrix.
+        Quaternion fromMatrix;
+        fromMatrix.FromMatrix( rotation );
+        outRotation = fromMatrix.Conjugate();
+        outRotation.Normalize();
+
+        outTranslation = Vec3( matrix.m[ 12 ], matrix.m[ 13 ], matrix.m[ 14 ] );
+    }
+
+    void Compose( const Vec3& scale, const Quaternion& rotation, const Vec3& translation, Matrix44& outMatrix )
+    {
+        rotation.GetMatrix( outMatrix );
+
+        for (int column = 0; column < 3; ++column)
+        {
+            outMatrix.m[     column ] *= scale.x;
+            outMatrix.m[ 4 + column ] *= scale.y;
+            outMatrix.m[ 8 + column ] *= scale.z;
+        }
+
+        outMatrix.m[ 12 ] = translation.x;
+        outMatrix.m[ 13 ] = translation.y;
+        outMatrix.m[ 14 ] = translation.z;
+    }
+
+    // Returns the frames of the keys that are kept. A key is removed if interpolating between the
+    // kept keys around it reproduces every removed value with error <= maxError.
+    template< typename T, typename Interpolate, typename Error >
+    std::vector< int > ReduceKeys( const std::vector< T >& values, float maxError, Interpolate interpolate, Error error )
+    {
+        std::vector< int > keptFrames;
+        keptFrames.push_back( 0 );
+
+        const int count = static_cast< int >( values.size() );
+        int start = 0;
+
+        for (int end = 2; end < count; ++end)
+        {
+            bool fits = true;
+
+            for (int i = start + 1; i < end && fits; ++i)
+            {
+                const float t = (i - start) / static_cast< float >( end - start );
+                fits = error( interpolate( values[ start ], values[ end ], t ), values[ i ] ) <= maxError;
+            }
+
+            if (!fits)
+            {
+                start = end - 1;
+                keptFrames.push_back( start );
+            }
+        }
+
+        if (count > 1)
+        {
+            keptFrames.push_back( count - 1 );
+        }
+
+        return keptFrames;
+    }
+
+    uint16_t Quantize( float value, float min, float range )
+    {
+        if (range <= 0)
+        {
+            return 0;
+        }
+
+        const float normalized = std::min( std::max( (value - min) / range, 0.0f ), 1.0f );
+        return static_cast< uint16_t >( normalized * 65535.0f + 0.5f );
+    }
+
+    float Dequantize( uint16_t value, float min, float range )
+    {
+        return min + range * (value / 65535.0f);
+    }
+
+    JointAnimation::Vec3Key QuantizeKey( int frame, const Vec3& value, const Vec3& min, const Vec3& range )
+    {
+        JointAnimation::Vec3Key key;
+        key.frame = static_cast< uint16_t >( frame );
+        key.xyz[ 0 ] = Quantize( value.x, min.x, range.x );
+        key.xyz[ 1 ] = Quantize( value.y, min.y, range.y );
+        key.xyz[ 2 ] = Quantize( value.z, min.z, range.z );
+        return key;
+    }
+
+    Vec3 DequantizeKey( const JointAnimation::Vec3Key& key, const Vec3& min, const Vec3& range )
+    {
+        return Vec3( Dequantize( key.xyz[ 0 ], min.x, range.x ),
+                     Dequantize( key.xyz[ 1 ], min.y, range.y ),
+                     Dequantize( key.xyz[ 2 ], min.z, range.z ) );
+    }
+
+    Quaternion DequantizeKey( const JointAnimation::RotationKey& key )
+    {
+        Quaternion rotation;
+        rotation.x = key.xyzw[ 0 ] / 32767.0f;
+        rotation.y = key.xyzw[ 1 ] / 32767.0f;
+        rotation.z = key.xyzw[ 2 ] / 32767.0f;
+        rotation.w = key.xyzw[ 3 ] / 32767.0f;
+        return rotation;
+    }
+
+    // Finds the keys around frame and the interpolation factor between them.
+    template< typename Key >
+    void FindKeys( const std::vector< Key >& keys, float frame, std::size_t& outIndex0, std::size_t& outIndex1, float& outT )
+    {
+        const auto after = std::upper_bound( std::begin( keys ), std::end( keys ), frame,
+                                             []( float aFrame, const Key& key ) { return aFrame < key.frame; } );
+        outIndex1 = static_cast< std::size_t >( after - std::begin( keys ) );
+
+        if (outIndex1 == 0)
+        {
+            outIndex0 = 0;
+            outT = 0;
+        }
+        else if (outIndex1 == keys.size())
+        {
+            outIndex0 = outIndex1 = keys.size() - 1;
+            outT = 0;
+        }
+        else
+        {
+            outIndex0 = outIndex1 - 1;
+            outT = (frame - keys[ outIndex0 ].frame) / static_cast< float >( keys[ outIndex1 ].frame - keys[ outIndex0 ].frame );
+        }
+    }
+}
+
+void JointAnimation::Build( const Matrix44* transforms, int count, float maxTranslationError )
+{
+    rotationKeys.clear();
+    translationKeys.clear();
+    scaleKeys.clear();
+    frameCount = std::min( count, 65535 );
+
+    if (frameCount <= 0)
+    {
+        frameCount = 0;
+        return;
+    }
+
+    std::vector< Vec3 > scales( frameCount );
+    std::vector< Quaternion > rotations( frameCount );
+    std::vector< Vec3 > translations( frameCount );
+
+    for (int frame = 0; frame < frameCount; ++frame)
+    {
+        Decompose( transforms[ frame ], scales[ frame ], rotations[ frame ], translations[ frame ] );
+
+        // Keeps consecutive rotations in the same hemisphere so that they interpolate along the short arc.
+        if (frame > 0 && Dot( rotations[ frame - 1 ], rotations[ frame ] ) < 0)
+        {
+            rotations[ frame ].x = -rotations[ frame ].x;
+            rotations[ frame ].y = -rotations[ frame ].y;
+            rotations[ frame ].z = -rotations[ frame ].z;
+            rotations[ frame ].w = -rotations[ frame ].w;
+        }
+    }
+
+    translationMin = translations[ 0 ];
+    Vec3 translationMax = translations[ 0 ];
+    scaleMin = scales[ 0 ];
+    Vec3 scaleMax = scales[ 0 ];
+
+    for (int frame = 1; frame < frameCount; ++frame)
+    {
+        translationMin = Vec3::Min2( translationMin, translations[ frame ] );
+        translationMax = Vec3::Max2( translationMax, translations[ frame ] );
+        scaleMin = Vec3::Min2( scaleMin, scales[ frame ] );
+        scaleMax = Vec3::Max2( scaleMax, scales[ frame ] );
+    }
+
+    translationRange = translationMax - translationMin;
+    scaleRange = scaleMax - scaleMin;
+
+    // 1 - cos( angle / 2 ) is the error of the dot product between unit quaternions that are angle apart.
+    const float maxRotationDotError = 1 - std::cos( maxRotationError * 0.5f );
+    auto rotationError = []( const Quaternion& a, const Quaternion& b ) { return 1 - std::fabs( Dot( a, b ) ); };
+    auto vec3Error = []( const Vec3& a, const Vec3& b ) { return MaxComponent( a - b ); };
+
+    for (int frame : ReduceKeys( rotations, maxRotationDotError, Nlerp, rotationError ))
+    {
+        RotationKey key;
+        key.frame = static_cast< uint16_t >( frame );
+        key.xyzw[ 0 ] = static_cast< int16_t >( std::lround( rotations[ frame ].x * 32767.0f ) );
+        key.xyzw[ 1 ] = static_cast< int16_t >( std::lround( rotations[ frame ].y * 32767.0f ) );
+        key.xyzw[ 2 ] = static_cast< int16_t >( std::lround( rotations[ frame ].z * 32767.0f ) );
+        key.xyzw[ 3 ] = static_cast< int16_t >( std::lround( rotations[ frame ].w * 32767.0f ) );
+        rotationKeys.push_back( key );
+    }
+
+    for (int frame : ReduceKeys( translations, maxTranslationError, Lerp, vec3Error ))
+    {
+        translationKeys.push_back( QuantizeKey( frame, translations[ frame ], translationMin, translationRange ) );
+    }
+
+    for (int frame : ReduceKeys( scales, maxScaleError, Lerp, vec3Error ))
+    {
+        scaleKeys.push_back( QuantizeKey( frame, scales[ frame ], scaleMin, scaleRange ) );
+    }
+}
+
+void JointAnimation::Sample( float frame, Matrix44& outTransform ) const
+{
+    if (frameCount == 0 || rotationKeys.empty() || translationKeys.empty() || scaleKeys.empty())
+    {
+        outTransform.MakeIdentity();
+        return;
+    }
+
+    frame = std::fmod( frame, static_cast< float >( frameCount ) );
+
+    if (frame < 0)
+    {
+        frame += frameCount;
+    }
+
+    std::size_t index0, index1;
+    float t;
+
+    FindKeys( rotationKeys, frame, index0, index1, t );
+    const Quaternion rotation = Nlerp( DequantizeKey( rotationKeys[ index0 ] ), DequantizeKey( rotationKeys[ index1 ] ), t );
+
+    FindKeys( translationKeys, frame, index0, index1, t );
+    const Vec3 translation = Lerp( DequantizeKey( translationKeys[ index0 ], translationMin, translationRange ),
+                                   DequantizeKey( translationKeys[ index1 ], translationMin, translationRange ), t );
+
+    FindKeys( scaleKeys, frame, index0, index1, t );
+    const Vec3 scale = Lerp( DequantizeKey( scaleKeys[ index0 ], scaleMin, scaleRange ),
+                             DequantizeKey( scaleKeys[ index1 ], scaleMin, scaleRange ), t );
+
+    Compose( scale, rotation, translation, outTransform );
+}
+
+std::size_t JointAnimation::GetKeySizeInBytes() const
+{
+    return rotationKeys.size() * sizeof( RotationKey ) + (translationKeys.size() + scaleKeys.size()) * sizeof( Vec3Key );
+}
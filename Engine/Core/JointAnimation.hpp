@@ -0,0 +1,63 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Matrix.hpp"
+#include "Vec3.hpp"
+
+namespace ae3d
+{
+    /// Animation of one joint stored as quantized rotation, translation and scale keys. Keys that can be
+    /// interpolated from their neighbours within tolerance are removed, so a joint that doesn't move has only
+    /// its first and last key.
+    struct JointAnimation
+    {
+        /// Rotation key. Quaternion components are quantized to [-32767, 32767].
+        struct RotationKey
+        {
+            uint16_t frame;
+            int16_t xyzw[ 4 ];
+        };
+
+        /// Translation or scale key. Components are quantized to [0, 65535] inside the track's range.
+        struct Vec3Key
+        {
+            uint16_t frame;
+            uint16_t xyz[ 3 ];
+        };
+
+        /// Max translation error for removed keys relative to the length of the model's AABB diagonal.
+        static constexpr float RelativeMaxTranslationError = 0.0001f;
+
+        /**
+         Builds keys from sampled transforms.
+
+         \param transforms Transform for every frame. Rotation, scale and translation, no shear.
+         \param count Number of transforms, max 65535.
+         \param maxTranslationError Max translation error in model units for removed keys. 0 keeps all keys that differ.
+         */
+        void Build( const Matrix44* transforms, int count, float maxTranslationError );
+
+        /**
+         \param frame Frame. Fractional frames are interpolated and frames outside the animation repeat it.
+         \param outTransform Transform at frame. Identity if there are no keys.
+         */
+        void Sample( float frame, Matrix44& outTransform ) const;
+
+        /// \return Size of keys in bytes.
+        std::size_t GetKeySizeInBytes() const;
+
+        std::vector< RotationKey > rotationKeys;
+        std::vector< Vec3Key > translationKeys;
+        std::vector< Vec3Key > scaleKeys;
+        /// Translation keys are quantized to [translationMin, translationMin + translationRange].
+        Vec3 translationMin;
+        Vec3 translationRange;
+        /// Scale keys are quantized to [scaleMin, scaleMin + scaleRange].
+        Vec3 scaleMin;
+        Vec3 scaleRange;
+        /// Number of frames in the animation. Can be larger than the number of keys.
+        int frameCount = 0;
+    };
+}
@@ -136,7 +136,7 @@ void Matrix44::Invert( const Matrix44& matrix, Matrix44& out )
 #endif
 }
 
-#ifndef SIMD_SSE3
+#if !defined( SIMD_SSE3 ) && !defined( SIMD_NEON )
 #if !(__i386__)
 void Matrix44::Multiply( const Matrix44& a, const Matrix44& b, Matrix44& out )
 {
@@ -174,6 +174,40 @@ void ae3d::Matrix44::TransformPoint( const Vec4& vec, const Matrix44& mat, Vec4*
 #endif
 #endif
 
+#if !defined( SIMD_SSE3 ) && !defined( SIMD_NEON )
+void Matrix44::MultiplyMany( const Matrix44* a, const Matrix44& b, int count, Matrix44* out )
+{
+    for (int i = 0; i < count; ++i)
+    {
+        Multiply( a[ i ], b, out[ i ] );
+    }
+}
+
+void Matrix44::TransformPoints( const Vec3* points, int count, const Matrix44& mat, Vec3* outPoints )
+{
+    for (int i = 0; i < count; ++i)
+    {
+        TransformPoint( points[ i ], mat, &outPoints[ i ] );
+    }
+}
+
+void Matrix44::TransformAABB( const Vec3& aabbMin, const Vec3& aabbMax, const Matrix44& mat, Vec3& outMin, Vec3& outMax )
+{
+    const Vec3 center = (aabbMin + aabbMax) * 0.5f;
+    const Vec3 extent = (aabbMax - aabbMin) * 0.5f;
+
+    Vec3 newCenter;
+    TransformPoint( center, mat, &newCenter );
+
+    const Vec3 newExtent( fabsf( mat.m[ 0 ] ) * extent.x + fabsf( mat.m[ 4 ] ) * extent.y + fabsf( mat.m[  8 ] ) * extent.z,
+                          fabsf( mat.m[ 1 ] ) * extent.x + fabsf( mat.m[ 5 ] ) * extent.y + fabsf( mat.m[  9 ] ) * extent.z,
+                          fabsf( mat.m[ 2 ] ) * extent.x + fabsf( mat.m[ 6 ] ) * extent.y + fabsf( mat.m[ 10 ] ) * extent.z );
+
+    outMin = newCenter - newExtent;
+    outMax = newCenter + newExtent;
+}
+#endif
+
 void Matrix44::TransformPoint( const Vec3& vec, const Matrix44& mat, Vec3* out )
 {
     Vec3 res;
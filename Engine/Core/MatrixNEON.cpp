@@ -1,4 +1,4 @@
-#if RENDERER_METAL && !(__i386__)
+#if SIMD_NEON || (RENDERER_METAL && !(__i386__))
 #include "Matrix.hpp"
 #include <cstring>
 #include <cmath>
@@ -52,4 +52,80 @@ void ae3d::Matrix44::TransformPoint( const Vec4& vec, const Matrix44& mat, Vec4*
 #endif
 }
 
+#if SIMD_NEON
+namespace
+{
+    // Matrix columns are in m[ 0-3 ], m[ 4-7 ] etc., so a transformed vector is a weighted sum of them.
+    float32x4_t TransformColumns( const float32x4_t columns[ 4 ], float x, float y, float z, float32x4_t w )
+    {
+        float32x4_t result = vmulq_f32( columns[ 3 ], w );
+        result = vmlaq_n_f32( result, columns[ 0 ], x );
+        result = vmlaq_n_f32( result, columns[ 1 ], y );
+        return vmlaq_n_f32( result, columns[ 2 ], z );
+    }
+
+    // Stores x, y and z without writing past them.
+    void StoreVec3( float32x4_t v, Vec3* out )
+    {
+        vst1_f32( &out->x, vget_low_f32( v ) );
+        vst1q_lane_f32( &out->z, v, 2 );
+    }
+
+    void LoadColumns( const Matrix44& mat, float32x4_t outColumns[ 4 ] )
+    {
+        outColumns[ 0 ] = vld1q_f32( &mat.m[  0 ] );
+        outColumns[ 1 ] = vld1q_f32( &mat.m[  4 ] );
+        outColumns[ 2 ] = vld1q_f32( &mat.m[  8 ] );
+        outColumns[ 3 ] = vld1q_f32( &mat.m[ 12 ] );
+    }
+}
+
+void Matrix44::MultiplyMany( const Matrix44* a, const Matrix44& b, int count, Matrix44* out )
+{
+    float32x4_t bRows[ 4 ];
+    LoadColumns( b, bRows );
+
+    for (int m = 0; m < count; ++m)
+    {
+        // Each row of out only reads the same row of a, so out can be the same array as a.
+        for (int i = 0; i < 16; i += 4)
+        {
+            float32x4_t row = vmulq_n_f32( bRows[ 0 ], a[ m ].m[ i ] );
+            row = vmlaq_n_f32( row, bRows[ 1 ], a[ m ].m[ i + 1 ] );
+            row = vmlaq_n_f32( row, bRows[ 2 ], a[ m ].m[ i + 2 ] );
+            row = vmlaq_n_f32( row, bRows[ 3 ], a[ m ].m[ i + 3 ] );
+            vst1q_f32( &out[ m ].m[ i ], row );
+        }
+    }
+}
+
+void Matrix44::TransformPoints( const Vec3* points, int count, const Matrix44& mat, Vec3* outPoints )
+{
+    float32x4_t columns[ 4 ];
+    LoadColumns( mat, columns );
+    const float32x4_t one = vdupq_n_f32( 1 );
+
+    for (int i = 0; i < count; ++i)
+    {
+        StoreVec3( TransformColumns( columns, points[ i ].x, points[ i ].y, points[ i ].z, one ), &outPoints[ i ] );
+    }
+}
+
+void Matrix44::TransformAABB( const Vec3& aabbMin, const Vec3& aabbMax, const Matrix44& mat, Vec3& outMin, Vec3& outMax )
+{
+    float32x4_t columns[ 4 ];
+    LoadColumns( mat, columns );
+
+    const Vec3 center = (aabbMin + aabbMax) * 0.5f;
+    const Vec3 extent = (aabbMax - aabbMin) * 0.5f;
+    const float32x4_t newCenter = TransformColumns( columns, center.x, center.y, center.z, vdupq_n_f32( 1 ) );
+
+    const float32x4_t absColumns[ 4 ] = { vabsq_f32( columns[ 0 ] ), vabsq_f32( columns[ 1 ] ), vabsq_f32( columns[ 2 ] ), vdupq_n_f32( 0 ) };
+    const float32x4_t newExtent = TransformColumns( absColumns, extent.x, extent.y, extent.z, vdupq_n_f32( 0 ) );
+
+    StoreVec3( vsubq_f32( newCenter, newExtent ), &outMin );
+    StoreVec3( vaddq_f32( newCenter, newExtent ), &outMax );
+}
+#endif
+
 #endif
@@ -5,56 +5,100 @@
 
 using namespace ae3d;
 
-void Matrix44::Multiply( const Matrix44& ma, const Matrix44& mb, Matrix44& out )
+namespace
 {
-    Matrix44 result;
-    Matrix44 matA = ma;
-    Matrix44 matB = mb;
-
-    const float* a = matA.m;
-    const float* b = matB.m;
-    __m128 a_line, b_line, r_line;
-
-    for (int i = 0; i < 16; i += 4)
+    // out = a * b, where b's rows are already loaded. Each row of out only reads the same row of a,
+    // so out can be the same matrix as a.
+    void MultiplyRows( const float* a, const __m128 bRows[ 4 ], float* out )
     {
-        // unroll the first step of the loop to avoid having to initialize r_line to zero
-        a_line = _mm_load_ps( b );
-        b_line = _mm_set1_ps( a[ i ] );
-        r_line = _mm_mul_ps( a_line, b_line );
-
-        for (int j = 1; j < 4; j++)
+        for (int i = 0; i < 16; i += 4)
         {
-            a_line = _mm_load_ps( &b[ j * 4 ] );
-            b_line = _mm_set1_ps(  a[ i + j ] );
-            r_line = _mm_add_ps(_mm_mul_ps( a_line, b_line ), r_line);
+            __m128 row = _mm_mul_ps( bRows[ 0 ], _mm_set1_ps( a[ i ] ) );
+            row = _mm_add_ps( row, _mm_mul_ps( bRows[ 1 ], _mm_set1_ps( a[ i + 1 ] ) ) );
+            row = _mm_add_ps( row, _mm_mul_ps( bRows[ 2 ], _mm_set1_ps( a[ i + 2 ] ) ) );
+            row = _mm_add_ps( row, _mm_mul_ps( bRows[ 3 ], _mm_set1_ps( a[ i + 3 ] ) ) );
+            _mm_storeu_ps( &out[ i ], row );
         }
+    }
+
+    // Matrix columns are in m[ 0-3 ], m[ 4-7 ] etc., so a transformed vector is a weighted sum of them.
+    __m128 TransformColumns( const __m128 columns[ 4 ], float x, float y, float z, __m128 w )
+    {
+        const __m128 xy = _mm_add_ps( _mm_mul_ps( columns[ 0 ], _mm_set1_ps( x ) ), _mm_mul_ps( columns[ 1 ], _mm_set1_ps( y ) ) );
+        const __m128 zw = _mm_add_ps( _mm_mul_ps( columns[ 2 ], _mm_set1_ps( z ) ), _mm_mul_ps( columns[ 3 ], w ) );
+        return _mm_add_ps( xy, zw );
+    }
+
+    // Stores x, y and z without writing past them.
+    void StoreVec3( __m128 v, Vec3* out )
+    {
+        _mm_storel_pi( reinterpret_cast< __m64* >( &out->x ), v );
+        _mm_store_ss( &out->z, _mm_movehl_ps( v, v ) );
+    }
 
-        _mm_store_ps( &result.m[ i ], r_line );
+    // Unaligned, because C++11 new doesn't guarantee Matrix44's alignment for arrays.
+    void LoadColumns( const Matrix44& mat, __m128 outColumns[ 4 ] )
+    {
+        outColumns[ 0 ] = _mm_loadu_ps( &mat.m[  0 ] );
+        outColumns[ 1 ] = _mm_loadu_ps( &mat.m[  4 ] );
+        outColumns[ 2 ] = _mm_loadu_ps( &mat.m[  8 ] );
+        outColumns[ 3 ] = _mm_loadu_ps( &mat.m[ 12 ] );
     }
+}
 
-    out = result;
+void Matrix44::Multiply( const Matrix44& a, const Matrix44& b, Matrix44& out )
+{
+    __m128 bRows[ 4 ];
+    LoadColumns( b, bRows );
+    MultiplyRows( a.m, bRows, out.m );
+}
+
+void Matrix44::MultiplyMany( const Matrix44* a, const Matrix44& b, int count, Matrix44* out )
+{
+    __m128 bRows[ 4 ];
+    LoadColumns( b, bRows );
+
+    for (int i = 0; i < count; ++i)
+    {
+        MultiplyRows( a[ i ].m, bRows, out[ i ].m );
+    }
 }
 
 void Matrix44::TransformPoint( const Vec4& vec, const Matrix44& mat, Vec4* out )
 {
-    Matrix44 transpose;
-    mat.Transpose( transpose );
-    alignas( 16 ) Vec4 v4 = vec;
-
-    __m128 vec4 = _mm_load_ps( &v4.x );
-    __m128 row1 = _mm_load_ps( &transpose.m[  0 ] );
-    __m128 row2 = _mm_load_ps( &transpose.m[  4 ] );
-    __m128 row3 = _mm_load_ps( &transpose.m[  8 ] );
-    __m128 row4 = _mm_load_ps( &transpose.m[ 12 ] );
-
-    __m128 r1 = _mm_mul_ps( row1, vec4 );
-    __m128 r2 = _mm_mul_ps( row2, vec4 );
-    __m128 r3 = _mm_mul_ps( row3, vec4 );
-    __m128 r4 = _mm_mul_ps( row4, vec4 );
-
-    __m128 sum_01 = _mm_hadd_ps( r1, r2 );
-    __m128 sum_23 = _mm_hadd_ps( r3, r4 );
-    __m128 result = _mm_hadd_ps( sum_01, sum_23 );
-    _mm_store_ps( &out->x, result );
+    __m128 columns[ 4 ];
+    LoadColumns( mat, columns );
+    _mm_storeu_ps( &out->x, TransformColumns( columns, vec.x, vec.y, vec.z, _mm_set1_ps( vec.w ) ) );
+}
+
+void Matrix44::TransformPoints( const Vec3* points, int count, const Matrix44& mat, Vec3* outPoints )
+{
+    __m128 columns[ 4 ];
+    LoadColumns( mat, columns );
+    const __m128 one = _mm_set1_ps( 1 );
+
+    for (int i = 0; i < count; ++i)
+    {
+        StoreVec3( TransformColumns( columns, points[ i ].x, points[ i ].y, points[ i ].z, one ), &outPoints[ i ] );
+    }
+}
+
+void Matrix44::TransformAABB( const Vec3& aabbMin, const Vec3& aabbMax, const Matrix44& mat, Vec3& outMin, Vec3& outMax )
+{
+    __m128 columns[ 4 ];
+    LoadColumns( mat, columns );
+
+    const Vec3 center = (aabbMin + aabbMax) * 0.5f;
+    const Vec3 extent = (aabbMax - aabbMin) * 0.5f;
+    const __m128 newCenter = TransformColumns( columns, center.x, center.y, center.z, _mm_set1_ps( 1 ) );
+
+    // Clears sign bits.
+    const __m128 absMask = _mm_castsi128_ps( _mm_set1_epi32( 0x7FFFFFFF ) );
+    const __m128 absColumns[ 4 ] = { _mm_and_ps( columns[ 0 ], absMask ), _mm_and_ps( columns[ 1 ], absMask ),
+                                     _mm_and_ps( columns[ 2 ], absMask ), _mm_setzero_ps() };
+    const __m128 newExtent = TransformColumns( absColumns, extent.x, extent.y, extent.z, _mm_setzero_ps() );
+
+    StoreVec3( _mm_sub_ps( newCenter, newExtent ), &outMin );
+    StoreVec3( _mm_add_ps( newCenter, newExtent ), &outMax );
 }
 #endif
@@ -272,7 +272,10 @@ ae3d::Mesh::LoadResult ae3d::Mesh::Load( const FileSystem::FileContentsData& mes
     imemstream is( (const char*)meshData.data.data(), meshData.data.size() );
     is.read( (char*)&magic[ 0 ], sizeof( magic ) );
 
-    if (magic[ 0 ] != 'a' || magic[ 1 ] != '9')
+    // a9 stores a matrix per joint per frame, b0 stores compressed keys.
+    const bool hasAnimationKeys = magic[ 0 ] == 'b' && magic[ 1 ] == '0';
+
+    if ((magic[ 0 ] != 'a' || magic[ 1 ] != '9') && !hasAnimationKeys)
     {
         System::Print( "%s is corrupted or old format: Wrong magic number!\n", meshData.path.c_str() );
         return LoadResult::Corrupted;
@@ -401,10 +404,38 @@ ae3d::Mesh::LoadResult ae3d::Mesh::Load( const FileSystem::FileContentsData& mes
 
                 is.read( subMesh.joints[ j ].name, jointNameLength );
                 subMesh.joints[ j ].name[ jointNameLength ] = 0;
-                int animLength;
-                is.read( (char*)&animLength, sizeof( int ) );
-                subMesh.joints[ j ].animTransforms.resize( animLength );
-                is.read( (char*)subMesh.joints[ j ].animTransforms.data(), subMesh.joints[ j ].animTransforms.size() * sizeof( ae3d::Matrix44 ) );
+                
+                JointAnimation& animation = subMesh.joints[ j ].animation;
+
+                if (hasAnimationKeys)
+                {
+                    is.read( (char*)&animation.frameCount, sizeof( int ) );
+                    is.read( (char*)&animation.translationMin, sizeof( Vec3 ) );
+                    is.read( (char*)&animation.translationRange, sizeof( Vec3 ) );
+                    is.read( (char*)&animation.scaleMin, sizeof( Vec3 ) );
+                    is.read( (char*)&animation.scaleRange, sizeof( Vec3 ) );
+
+                    uint16_t keyCount = 0;
+                    is.read( (char*)&keyCount, sizeof( keyCount ) );
+                    animation.rotationKeys.resize( keyCount );
+                    is.read( (char*)animation.rotationKeys.data(), keyCount * sizeof( JointAnimation::RotationKey ) );
+
+                    is.read( (char*)&keyCount, sizeof( keyCount ) );
+                    animation.translationKeys.resize( keyCount );
+                    is.read( (char*)animation.translationKeys.data(), keyCount * sizeof( JointAnimation::Vec3Key ) );
+
+                    is.read( (char*)&keyCount, sizeof( keyCount ) );
+                    animation.scaleKeys.resize( keyCount );
+                    is.read( (char*)animation.scaleKeys.data(), keyCount * sizeof( JointAnimation::Vec3Key ) );
+                }
+                else
+                {
+                    int animLength;
+                    is.read( (char*)&animLength, sizeof( int ) );
+                    std::vector< Matrix44 > animTransforms( animLength );
+                    is.read( (char*)animTransforms.data(), animTransforms.size() * sizeof( ae3d::Matrix44 ) );
+                    animation.Build( animTransforms.data(), animLength, (aabbMax - aabbMin).Length() * JointAnimation::RelativeMaxTranslationError );
+                }
             }
         }
         
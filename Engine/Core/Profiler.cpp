@@ -0,0 +1,278 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "Profiler.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "System.hpp"
+
+namespace ProfilerGlobal
+{
+    const unsigned RingSize = 1 << 16;
+    const int MaxDepth = 64;
+
+    // Only the owning thread writes events and the open zone stack. EndFrame() reads events up to committed.
+    struct ThreadBuffer
+    {
+        Profiler::ZoneEvent events[ RingSize ];
+        std::atomic< std::uint64_t > committed{ 0 };
+        std::uint64_t collected = 0;
+        long long openBeginNS[ MaxDepth ];
+        const char* openNames[ MaxDepth ];
+        int depth = 0;
+        unsigned index = 0;
+        bool isRetired = false; // Owning thread has exited.
+        bool isFree = false; // Retired and collected, can be reused.
+    };
+
+    const std::chrono::steady_clock::time_point startTime = std::chrono::steady_clock::now();
+
+    // A buffer outlives its thread until its zones are collected, then it is reused by the next new thread.
+    // Buffers are freed at exit.
+    std::mutex mutex;
+    std::vector< std::unique_ptr< ThreadBuffer > > threadBuffers;
+    std::vector< ThreadBuffer* > freeThreadBuffers;
+    thread_local ThreadBuffer* threadBuffer = nullptr;
+
+    // Retires the thread's buffer when the thread exits.
+    struct ThreadBufferOwner
+    {
+        ~ThreadBufferOwner()
+        {
+            if (threadBuffer != nullptr)
+            {
+                std::lock_guard< std::mutex > lock( mutex );
+                threadBuffer->isRetired = true;
+            }
+        }
+    };
+
+    thread_local ThreadBufferOwner threadBufferOwner;
+
+    std::vector< Profiler::ZoneEvent > frameZones;
+    std::vector< Profiler::ZoneEvent > captureZones;
+    int captureFramesLeft = 0;
+    long long frameBeginNS = 0;
+    std::string capturePath;
+}
+
+namespace
+{
+    long long NowNS()
+    {
+        return std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now() - ProfilerGlobal::startTime ).count();
+    }
+
+    ProfilerGlobal::ThreadBuffer* GetThreadBuffer()
+    {
+        if (ProfilerGlobal::threadBuffer == nullptr)
+        {
+            // Constructs the thread's owner, so the buffer is retired at thread exit.
+            (void)ProfilerGlobal::threadBufferOwner;
+
+            std::lock_guard< std::mutex > lock( ProfilerGlobal::mutex );
+
+            if (!ProfilerGlobal::freeThreadBuffers.empty())
+            {
+                ProfilerGlobal::threadBuffer = ProfilerGlobal::freeThreadBuffers.back();
+                ProfilerGlobal::freeThreadBuffers.pop_back();
+                ProfilerGlobal::threadBuffer->isRetired = false;
+                ProfilerGlobal::threadBuffer->isFree = false;
+                ProfilerGlobal::threadBuffer->depth = 0;
+            }
+            else
+            {
+                ProfilerGlobal::threadBuffers.emplace_back( new ProfilerGlobal::ThreadBuffer() );
+                ProfilerGlobal::threadBuffer = ProfilerGlobal::threadBuffers.back().get();
+                ProfilerGlobal::threadBuffer->index = (unsigned)ProfilerGlobal::threadBuffers.size() - 1;
+            }
+        }
+
+        return ProfilerGlobal::threadBuffer;
+    }
+
+    void WriteEscaped( FILE* file, const char* str )
+    {
+        for (; *str != '\0'; ++str)
+        {
+            if (*str == '"' || *str == '\\')
+            {
+                std::fputc( '\\', file );
+            }
+
+            std::fputc( *str, file );
+        }
+    }
+}
+
+void Profiler::BeginZone( const char* name )
+{
+    ProfilerGlobal::ThreadBuffer* buffer = GetThreadBuffer();
+
+    if (buffer->depth < ProfilerGlobal::MaxDepth)
+    {
+        buffer->openNames[ buffer->depth ] = name;
+        buffer->openBeginNS[ buffer->depth ] = NowNS();
+    }
+
+    ++buffer->depth;
+}
+
+float Profiler::EndZone()
+{
+    const long long endNS = NowNS();
+    ProfilerGlobal::ThreadBuffer* buffer = GetThreadBuffer();
+
+    ae3d::System::Assert( buffer->depth > 0, "EndZone called without BeginZone" );
+
+    if (buffer->depth <= 0)
+    {
+        return 0;
+    }
+
+    --buffer->depth;
+
+    if (buffer->depth >= ProfilerGlobal::MaxDepth)
+    {
+        return 0;
+    }
+
+    const std::uint64_t eventIndex = buffer->committed.load( std::memory_order_relaxed );
+    ZoneEvent& zoneEvent = buffer->events[ eventIndex % ProfilerGlobal::RingSize ];
+    zoneEvent.name = buffer->openNames[ buffer->depth ];
+    zoneEvent.beginNS = buffer->openBeginNS[ buffer->depth ];
+    zoneEvent.endNS = endNS;
+    zoneEvent.threadIndex = buffer->index;
+    zoneEvent.depth = buffer->depth;
+    buffer->committed.store( eventIndex + 1, std::memory_order_release );
+
+    return (endNS - zoneEvent.beginNS) / 1000000.0f;
+}
+
+void Profiler::EndFrame()
+{
+    const long long frameEndNS = NowNS();
+
+    ProfilerGlobal::frameZones.clear();
+
+    {
+        std::lock_guard< std::mutex > lock( ProfilerGlobal::mutex );
+
+        for (const auto& buffer : ProfilerGlobal::threadBuffers)
+        {
+            if (buffer->isFree)
+            {
+                continue;
+            }
+
+            const std::uint64_t committed = buffer->committed.load( std::memory_order_acquire );
+
+            // Zones that were overwritten before they were collected are lost.
+            if (committed - buffer->collected > ProfilerGlobal::RingSize)
+            {
+                buffer->collected = committed - ProfilerGlobal::RingSize;
+            }
+
+            for (std::uint64_t i = buffer->collected; i < committed; ++i)
+            {
+                ProfilerGlobal::frameZones.push_back( buffer->events[ i % ProfilerGlobal::RingSize ] );
+            }
+
+            buffer->collected = committed;
+
+            if (buffer->isRetired)
+            {
+                buffer->isFree = true;
+                ProfilerGlobal::freeThreadBuffers.push_back( buffer.get() );
+            }
+        }
+    }
+
+    // Zones are committed when they end, so parents follow their children.
+    std::sort( ProfilerGlobal::frameZones.begin(), ProfilerGlobal::frameZones.end(), []( const ZoneEvent& a, const ZoneEvent& b )
+    {
+        return a.threadIndex != b.threadIndex ? a.threadIndex < b.threadIndex : (a.beginNS != b.beginNS ? a.beginNS < b.beginNS : a.depth < b.depth);
+    } );
+
+    if (ProfilerGlobal::captureFramesLeft > 0)
+    {
+        ZoneEvent frameZone;
+        frameZone.name = "Frame";
+        frameZone.beginNS = ProfilerGlobal::frameBeginNS;
+        frameZone.endNS = frameEndNS;
+        frameZone.threadIndex = GetThreadBuffer()->index;
+        frameZone.depth = -1;
+
+        ProfilerGlobal::captureZones.push_back( frameZone );
+        ProfilerGlobal::captureZones.insert( ProfilerGlobal::captureZones.end(), ProfilerGlobal::frameZones.begin(), ProfilerGlobal::frameZones.end() );
+
+        if (--ProfilerGlobal::captureFramesLeft == 0)
+        {
+            if (!WriteChromeTrace( ProfilerGlobal::captureZones, ProfilerGlobal::capturePath.c_str() ))
+            {
+                ae3d::System::Print( "Could not write profiler capture to %s\n", ProfilerGlobal::capturePath.c_str() );
+            }
+
+            ProfilerGlobal::captureZones.clear();
+        }
+    }
+
+    ProfilerGlobal::frameBeginNS = frameEndNS;
+}
+
+const std::vector< Profiler::ZoneEvent >& Profiler::GetFrameZones()
+{
+    return ProfilerGlobal::frameZones;
+}
+
+float Profiler::GetFrameZoneTimeMS( const char* name )
+{
+    long long timeNS = 0;
+
+    for (const ZoneEvent& zone : ProfilerGlobal::frameZones)
+    {
+        if (zone.name == name || std::strcmp( zone.name, name ) == 0)
+        {
+            timeNS += zone.endNS - zone.beginNS;
+        }
+    }
+
+    return timeNS / 1000000.0f;
+}
+
+void Profiler::BeginCapture( int frameCount, const char* path )
+{
+    ProfilerGlobal::captureZones.clear();
+    ProfilerGlobal::captureFramesLeft = frameCount;
+    ProfilerGlobal::capturePath = path;
+}
+
+bool Profiler::WriteChromeTrace( const std::vector< ZoneEvent >& zones, const char* path )
+{
+    FILE* file = std::fopen( path, "wb" );
+
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    std::fprintf( file, "{\"traceEvents\":[\n" );
+
+    for (std::size_t i = 0; i < zones.size(); ++i)
+    {
+        std::fprintf( file, "{\"name\":\"" );
+        WriteEscaped( file, zones[ i ].name );
+        std::fprintf( file, "\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}%s\n", zones[ i ].depth < 0 ? "frame" : "zone",
+                      zones[ i ].threadIndex, zones[ i ].beginNS / 1000.0, (zones[ i ].endNS - zones[ i ].beginNS) / 1000.0, i + 1 < zones.size() ? "," : "" );
+    }
+
+    std::fprintf( file, "],\"displayTimeUnit\":\"ms\"}\n" );
+
+    return std::fclose( file ) == 0;
+}
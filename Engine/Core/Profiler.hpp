@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+
+/// Scoped CPU profiler. Each thread records completed zones into its own ring buffer without locks.
+/// Profiler::EndFrame() collects every thread's zones of the finished frame, so the frame's zone tree
+/// can be queried and a number of frames can be captured into a Chrome trace JSON file (chrome://tracing, Perfetto
+/// and Tracy's import-chrome read it).
+namespace Profiler
+{
+    struct ZoneEvent
+    {
+        const char* name = nullptr; // Must be a string literal or otherwise outlive the capture.
+        long long beginNS = 0; // Nanoseconds since profiler start.
+        long long endNS = 0;
+        unsigned threadIndex = 0;
+        int depth = 0;
+    };
+
+    /// Begins a zone on the calling thread.
+    /// \param name Zone name. Not copied.
+    void BeginZone( const char* name );
+
+    /// Ends the zone that was begun last on the calling thread.
+    /// \return Zone's duration in ms.
+    float EndZone();
+
+    /// Collects zones that have ended since the previous call. Call once per frame.
+    void EndFrame();
+
+    /// \return Zones of the previous frame from all threads, sorted by thread and begin time.
+    const std::vector< ZoneEvent >& GetFrameZones();
+
+    /// \param name Zone name.
+    /// \return Summed duration of zones with this name in the previous frame in ms.
+    float GetFrameZoneTimeMS( const char* name );
+
+    /// Starts capturing zones of the next frames.
+    /// \param frameCount Number of frames to capture.
+    /// \param path Path of the Chrome trace JSON file that is written when the capture is complete.
+    void BeginCapture( int frameCount, const char* path );
+
+    /// Writes zones into a Chrome trace JSON file.
+    /// \param zones Zones.
+    /// \param path File path.
+    /// \return True if the file could be written.
+    bool WriteChromeTrace( const std::vector< ZoneEvent >& zones, const char* path );
+
+    /// Times a scope.
+    class Zone
+    {
+    public:
+        explicit Zone( const char* name ) { BeginZone( name ); }
+        ~Zone() { EndZone(); }
+        Zone( const Zone& ) = delete;
+        Zone& operator=( const Zone& ) = delete;
+    };
+}
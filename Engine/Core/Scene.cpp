@@ -2,10 +2,14 @@
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 #include "Scene.hpp"
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <locale>
+#include <mutex>
 #include <string>
 #include <sstream>
+#include <thread>
 #include <vector>
 #include "AudioSourceComponent.hpp"
 #include "AudioSystem.hpp"
@@ -24,6 +28,7 @@
 #include "MeshRendererComponent.hpp"
 #include "ParticleSystemComponent.hpp"
 #include "PointLightComponent.hpp"
+#include "Profiler.hpp"
 #include "RenderTexture.hpp"
 #include "Renderer.hpp"
 #include "SpriteRendererComponent.hpp"
@@ -34,7 +39,6 @@
 #include "TransformComponent.hpp"
 #include "Texture2D.hpp"
 #if !TARGET_OS_IPHONE
-#include "Window.hpp"
 #else
 namespace ae3d
 {
@@ -50,6 +54,10 @@ extern Renderer renderer;
 float GetVRFov();
 void BeginOffscreen();
 void EndOffscreen( int profilerIndex, ae3d::RenderTexture* target );
+void DrawDebugLines( const ae3d::Matrix44& viewProjection, unsigned layerMask );
+void ClearDebugLines();
+void QueueLineBuffer( int handle, unsigned layer );
+
 std::string GetSerialized( const ae3d::TextRendererComponent* component );
 std::string GetSerialized( ae3d::CameraComponent* component );
 std::string GetSerialized( ae3d::AudioSourceComponent* component );
@@ -78,6 +86,54 @@ namespace Global
     extern Vec3 vrEyePosition;
 }
 
+namespace SkinningGlobal
+{
+    const unsigned MaxWorkers = 7;
+    // Smaller chunks don't win back the cost of fetching the next one.
+    const unsigned RenderersPerChunk = 16;
+
+    // Started when a frame first has enough skinned renderers, stopped by System::Deinit().
+    std::vector< std::thread > workers;
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable workDone;
+    unsigned generation = 0;
+    unsigned busyWorkers = 0;
+    bool quit = false;
+
+    const std::vector< ae3d::MeshRendererComponent* >* renderers = nullptr;
+    std::atomic< unsigned > nextRenderer{ 0 };
+}
+
+void StopSkinningWorkers();
+
+namespace SkinningGlobal
+{
+    // Joins the workers at exit if the application didn't call System::Deinit().
+    struct WorkerStopper
+    {
+        ~WorkerStopper() { StopSkinningWorkers(); }
+    } workerStopper;
+}
+
+void StopSkinningWorkers()
+{
+    {
+        std::lock_guard< std::mutex > lock( SkinningGlobal::mutex );
+        SkinningGlobal::quit = true;
+    }
+
+    SkinningGlobal::workAvailable.notify_all();
+
+    for (auto& worker : SkinningGlobal::workers)
+    {
+        worker.join();
+    }
+
+    SkinningGlobal::workers.clear();
+    SkinningGlobal::quit = false;
+}
+
 namespace VRGlobal
 {
     extern int eye;
@@ -89,6 +145,8 @@ namespace SceneGlobal
     bool isShadowCameraCreated = false;
     Matrix44 shadowCameraViewMatrix;
     Matrix44 shadowCameraProjectionMatrix;
+    // Incremented when mesh or line renderers are created or bounding box drawing is toggled.
+    unsigned debugLineSourceVersion = 0;
 }
 
 bool someLightCastsShadow = false;
@@ -130,17 +188,13 @@ void SetupCameraForDirectionalShadowCasting( const Vec3& lightDirection, const F
     const Matrix44& shadowCameraView = outCamera.GetView();
     
     // Transforms view camera frustum points to shadow camera space.
-    Vec3 viewFrustumLS[ 8 ];
-    
-    Matrix44::TransformPoint( eyeFrustum.NearTopLeft(), shadowCameraView, &viewFrustumLS[ 0 ] );
-    Matrix44::TransformPoint( eyeFrustum.NearTopRight(), shadowCameraView, &viewFrustumLS[ 1 ] );
-    Matrix44::TransformPoint( eyeFrustum.NearBottomLeft(), shadowCameraView, &viewFrustumLS[ 2 ] );
-    Matrix44::TransformPoint( eyeFrustum.NearBottomRight(), shadowCameraView, &viewFrustumLS[ 3 ] );
+    Vec3 viewFrustumLS[ 8 ] =
+    {
+        eyeFrustum.NearTopLeft(), eyeFrustum.NearTopRight(), eyeFrustum.NearBottomLeft(), eyeFrustum.NearBottomRight(),
+        eyeFrustum.FarTopLeft(), eyeFrustum.FarTopRight(), eyeFrustum.FarBottomLeft(), eyeFrustum.FarBottomRight()
+    };
     
-    Matrix44::TransformPoint( eyeFrustum.FarTopLeft(), shadowCameraView, &viewFrustumLS[ 4 ] );
-    Matrix44::TransformPoint( eyeFrustum.FarTopRight(), shadowCameraView, &viewFrustumLS[ 5 ] );
-    Matrix44::TransformPoint( eyeFrustum.FarBottomLeft(), shadowCameraView, &viewFrustumLS[ 6 ] );
-    Matrix44::TransformPoint( eyeFrustum.FarBottomRight(), shadowCameraView, &viewFrustumLS[ 7 ] );
+    Matrix44::TransformPoints( viewFrustumLS, 8, shadowCameraView, viewFrustumLS );
     
     // Gets light-space view frustum extremes.
     Vec3 viewMinLS, viewMaxLS;
@@ -148,29 +202,7 @@ void SetupCameraForDirectionalShadowCasting( const Vec3& lightDirection, const F
     
     // Transforms scene's AABB to light-space.
     Vec3 sceneAABBminLS, sceneAABBmaxLS;
-    const Vec3 min = sceneAABBmin;
-    const Vec3 max = sceneAABBmax;
-    
-    const Vec3 sceneCorners[] =
-    {
-        Vec3( min.x, min.y, min.z ),
-        Vec3( max.x, min.y, min.z ),
-        Vec3( min.x, max.y, min.z ),
-        Vec3( min.x, min.y, max.z ),
-        Vec3( max.x, max.y, min.z ),
-        Vec3( min.x, max.y, max.z ),
-        Vec3( max.x, max.y, max.z ),
-        Vec3( max.x, min.y, max.z )
-    };
-    
-    Vec3 sceneAABBLS[ 8 ];
-    
-    for (int i = 0; i < 8; ++i)
-    {
-        Matrix44::TransformPoint( sceneCorners[ i ], shadowCameraView, &sceneAABBLS[ i ] );
-    }
-    
-    MathUtil::GetMinMax( sceneAABBLS, 8, sceneAABBminLS, sceneAABBmaxLS );
+    Matrix44::TransformAABB( sceneAABBmin, sceneAABBmax, shadowCameraView, sceneAABBminLS, sceneAABBmaxLS );
     
     // Use world volume for near plane.
     viewMaxLS.z = sceneAABBmaxLS.z > viewMaxLS.z ? sceneAABBmaxLS.z : viewMaxLS.z;
@@ -195,6 +227,8 @@ void ae3d::Scene::Add( GameObject* gameObject )
     }
 
     gameObjects[ nextFreeGameObject++ ] = gameObject;
+    isAABBDirty = true;
+    isDebugLineObjectsDirty = true;
 }
 
 void ae3d::Scene::Remove( GameObject* gameObject )
@@ -204,6 +238,8 @@ void ae3d::Scene::Remove( GameObject* gameObject )
         if (gameObject == gameObjects[ i ])
         {
             gameObjects.erase( std::begin( gameObjects ) + i );
+            isAABBDirty = true;
+            isDebugLineObjectsDirty = true;
             return;
         }
     }
@@ -216,6 +252,26 @@ void ae3d::Scene::RenderDepthAndNormalsForAllCameras( std::vector< GameObject* >
     for (auto camera : cameras)
     {
         CameraComponent* cameraComponent = camera->GetComponent< CameraComponent >();
+#if RENDERER_VULKAN
+        cameraComponent->clusterSetIndex = -1;
+
+        // Clustered culling doesn't read depth, so lights are assigned before the prepass.
+        if (cameraComponent->GetLightCulling() == CameraComponent::LightCulling::Clustered)
+        {
+            UpdateLightTiler( cameraComponent->GetLayerMask() );
+            RenderTexture* target = cameraComponent->GetTargetTexture();
+            const int targetWidth = target ? target->GetWidth() : static_cast< int >( GfxDevice::backBufferWidth );
+            const int targetHeight = target ? target->GetHeight() : static_cast< int >( GfxDevice::backBufferHeight );
+            cameraComponent->clusterSetIndex = GfxDeviceGlobal::lightTiler.AssignLightsToClusters( cameraComponent->GetProjection(), cameraComponent->GetView(),
+                                                                                                  cameraComponent->GetNear(), cameraComponent->GetFar(),
+                                                                                                  targetWidth, targetHeight );
+        }
+
+        // Falls back to tiled culling if the cluster lists didn't fit.
+        const bool isClustered = cameraComponent->clusterSetIndex != -1;
+#else
+        const bool isClustered = false;
+#endif
 
         if (cameraComponent->GetDepthNormalsTexture().GetID() != 0)
         {
@@ -261,46 +317,80 @@ void ae3d::Scene::RenderDepthAndNormalsForAllCameras( std::vector< GameObject* >
 
             RenderDepthAndNormals( cameraComponent, view, gameObjectsWithMeshRenderer, 0, frustum );
 
-            GfxDeviceGlobal::lightTiler.ClearLightCount();
-
-            int goWithPointLightIndex = 0;
-            int goWithSpotLightIndex = 0;
-            
-            for (auto gameObject : gameObjects)
+            if (!isClustered)
             {
-                if (gameObject == nullptr || (gameObject->GetLayer() & cameraComponent->GetLayerMask()) == 0 || !gameObject->IsEnabled())
-                {
-                    continue;
-                }
+                UpdateLightTiler( cameraComponent->GetLayerMask() );
+                Statistics::BeginLightCullerProfiling();
+                GfxDeviceGlobal::lightTiler.CullLights( renderer.builtinShaders.lightCullShader, cameraComponent->GetProjection(),
+                                                        view, cameraComponent->GetDepthNormalsTexture() );
+                Statistics::EndLightCullerProfiling();
+            }
+        }
+    }
 
-                auto transform = gameObject->GetComponent< TransformComponent >();
-                auto pointLight = gameObject->GetComponent< PointLightComponent >();
-                auto spotLight = gameObject->GetComponent< SpotLightComponent >();
+    Statistics::EndDepthNormalsProfiling();
+}
 
-                if (transform && pointLight)
-                {
-                    auto worldPos = transform->GetWorldPosition();
-                    GfxDeviceGlobal::lightTiler.SetPointLightParameters( goWithPointLightIndex, worldPos, pointLight->GetRadius(), Vec4( pointLight->GetColor() ) );
-                    ++goWithPointLightIndex;
-                }
+void ae3d::Scene::GatherLights( unsigned layerMask )
+{
+    GfxDeviceGlobal::lightTiler.ClearLightCount();
 
-                if (transform && spotLight)
-                {
-                    auto worldPos = transform->GetWorldPosition();
-                    GfxDeviceGlobal::lightTiler.SetSpotLightParameters( goWithSpotLightIndex, worldPos, spotLight->GetRadius(), Vec4( spotLight->GetColor() ), transform->GetViewDirection(), spotLight->GetConeAngle(), 3 );
-                    ++goWithSpotLightIndex;
-                }
-            }
+    int goWithPointLightIndex = 0;
+    int goWithSpotLightIndex = 0;
+    unsigned layers = 0;
 
-            GfxDeviceGlobal::lightTiler.UpdateLightBuffers();
-            Statistics::BeginLightCullerProfiling();
-            GfxDeviceGlobal::lightTiler.CullLights( renderer.builtinShaders.lightCullShader, cameraComponent->GetProjection(),
-                                                    view, cameraComponent->GetDepthNormalsTexture() );
-            Statistics::EndLightCullerProfiling();
+    for (auto gameObject : gameObjects)
+    {
+        if (gameObject == nullptr || (gameObject->GetLayer() & layerMask) == 0 || !gameObject->IsEnabled())
+        {
+            continue;
+        }
+
+        auto transform = gameObject->GetComponent< TransformComponent >();
+        auto pointLight = gameObject->GetComponent< PointLightComponent >();
+        auto spotLight = gameObject->GetComponent< SpotLightComponent >();
+
+        if (transform && pointLight)
+        {
+            auto worldPos = transform->GetWorldPosition();
+            GfxDeviceGlobal::lightTiler.SetPointLightParameters( goWithPointLightIndex, worldPos, pointLight->GetRadius(), Vec4( pointLight->GetColor() ) );
+            ++goWithPointLightIndex;
+            layers |= gameObject->GetLayer();
+        }
+
+        if (transform && spotLight)
+        {
+            auto worldPos = transform->GetWorldPosition();
+            GfxDeviceGlobal::lightTiler.SetSpotLightParameters( goWithSpotLightIndex, worldPos, spotLight->GetRadius(), Vec4( spotLight->GetColor() ), transform->GetViewDirection(), spotLight->GetConeAngle(), 3 );
+            ++goWithSpotLightIndex;
+            layers |= gameObject->GetLayer();
         }
     }
 
-    Statistics::EndDepthNormalsProfiling();
+    if (layerMask == ~0u)
+    {
+        lightLayers = layers;
+    }
+
+    gatheredLightMask = layerMask;
+    areLightsGathered = true;
+    GfxDeviceGlobal::lightTiler.UpdateLightBuffers();
+}
+
+void ae3d::Scene::UpdateLightTiler( unsigned cameraLayerMask )
+{
+    if (!areLightsGathered)
+    {
+        GatherLights( ~0u );
+    }
+
+    // Cameras whose layer mask contains every light's layer see all lights, so they share the gather that was done once this frame.
+    const unsigned layerMask = (lightLayers & ~cameraLayerMask) == 0 ? ~0u : cameraLayerMask;
+
+    if (layerMask != gatheredLightMask)
+    {
+        GatherLights( layerMask );
+    }
 }
 
 const float scale = 2000;
@@ -330,8 +420,44 @@ void ae3d::Scene::SetAmbient( const Vec3& color )
     ambientColor = color;
 }
 
+void ae3d::Scene::SimulateParticles()
+{
+    for (auto go : gameObjects)
+    {
+        if (!go || !go->IsEnabled())
+        {
+            continue;
+        }
+
+        ParticleSystemComponent* particleSystem = go->GetComponent< ParticleSystemComponent >();
+        TransformComponent* transform = go->GetComponent< TransformComponent >();
+
+        if (particleSystem && transform)
+        {
+            particleSystem->QueueSimulation( transform->GetLocalMatrix() );
+        }
+    }
+
+    ComputeShader& simulationShader = renderer.builtinShaders.particleSimulationShader;
+    simulationShader.Begin();
+    ParticleSystemComponent::Simulate( simulationShader );
+    simulationShader.End();
+}
+
 void ae3d::Scene::RenderRTCameras( std::vector< GameObject* >& rtCameras )
 {
+    // Particles are simulated once per frame, so cameras only cull and draw them.
+    for (auto rtCamera : rtCameras)
+    {
+        CameraComponent* camera = rtCamera->GetComponent< CameraComponent >();
+
+        if (camera->ShouldRenderParticles() && camera->GetProjectionType() == ae3d::CameraComponent::ProjectionType::Perspective && !camera->GetTargetTexture()->IsCube())
+        {
+            SimulateParticles();
+            break;
+        }
+    }
+
     for (auto rtCamera : rtCameras)
     {
         auto transform = rtCamera->GetComponent< TransformComponent >();
@@ -341,24 +467,7 @@ void ae3d::Scene::RenderRTCameras( std::vector< GameObject* >& rtCameras )
             if (rtCamera->GetComponent< CameraComponent >()->ShouldRenderParticles() && rtCamera->GetComponent< CameraComponent >()->GetProjectionType() == ae3d::CameraComponent::ProjectionType::Perspective)
             {
                 Matrix44::Multiply( rtCamera->GetComponent< CameraComponent >()->GetView(), rtCamera->GetComponent< CameraComponent >()->GetProjection(), GfxDeviceGlobal::perObjectUboStruct.viewToClip );
-                
-                for (auto go : gameObjects)
-                {
-                    if (!go || !go->IsEnabled())
-                    {
-                        continue;
-                    }
-
-                    ParticleSystemComponent* particleSystem = go->GetComponent< ParticleSystemComponent >();
-                    
-                    if (particleSystem)
-                    {
-                        GfxDeviceGlobal::perObjectUboStruct.localToWorld = go->GetComponent< TransformComponent >()->GetLocalMatrix();
-                        
-                        particleSystem->Simulate( renderer.builtinShaders.particleSimulationShader );
-                        particleSystem->Cull( renderer.builtinShaders.particleCullShader );
-                    }
-                }
+                ParticleSystemComponent::Cull( renderer.builtinShaders.particleCullShader );
             }
             
             RenderWithCamera( rtCamera, 0, rtCamera->GetName() );
@@ -511,14 +620,61 @@ void ae3d::Scene::Render()
 #if RENDERER_VULKAN && !AE3D_OPENVR
     GfxDevice::BeginFrame();
 #endif
-    GenerateAABB();
+#if RENDERER_VULKAN
+    GfxDeviceGlobal::lightTiler.BeginClusterFrame();
+#endif
 #if RENDERER_D3D12
     GfxDevice::ResetCommandList();
 #endif
     Statistics::ResetFrameStatistics();
     TransformComponent::UpdateLocalMatrices();
+    GenerateAABB();
+    UpdateSkinning();
+    areLightsGathered = false;
+
+    if (isDebugLineObjectsDirty || debugLineObjectsVersion != SceneGlobal::debugLineSourceVersion)
+    {
+        debugLineObjects.clear();
+
+        for (auto gameObject : gameObjects)
+        {
+            auto meshRenderer = gameObject ? gameObject->GetComponent< MeshRendererComponent >() : nullptr;
+
+            if ((meshRenderer && meshRenderer->IsBoundingBoxDrawingEnabled()) || (gameObject && gameObject->GetComponent< LineRendererComponent >()))
+            {
+                debugLineObjects.push_back( gameObject );
+            }
+        }
+
+        debugLineObjectsVersion = SceneGlobal::debugLineSourceVersion;
+        isDebugLineObjectsDirty = false;
+    }
+
+    // Queued once per frame on the object's layer, so cameras share one upload and draw the lines of their layers.
+    for (auto gameObject : debugLineObjects)
+    {
+        if (!gameObject->IsEnabled())
+        {
+            continue;
+        }
+
+        auto meshRenderer = gameObject->GetComponent< MeshRendererComponent >();
+
+        if (meshRenderer && meshRenderer->IsBoundingBoxDrawingEnabled() && meshRenderer->GetMesh())
+        {
+            auto transform = gameObject->GetComponent< TransformComponent >();
+            System::DrawAABB( meshRenderer->GetMesh()->GetAABBMin() * 1.1f, meshRenderer->GetMesh()->GetAABBMax() * 1.1f,
+                              transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity, Vec4( 1, 0, 0, 1 ), true, gameObject->GetLayer() );
+        }
+
+        auto lineRenderer = gameObject->GetComponent< LineRendererComponent >();
+
+        if (lineRenderer && lineRenderer->isEnabled)
+        {
+            QueueLineBuffer( lineRenderer->lineHandle, gameObject->GetLayer() );
+        }
+    }
 
-    GfxDeviceGlobal::perObjectUboStruct.particleCount = 1000;//65535 * 2;
     GfxDeviceGlobal::perObjectUboStruct.timeStamp = System::SecondsSinceStartup();
     //printf("time: %f\n", GfxDeviceGlobal::perObjectUboStruct.timeStamp );
 
@@ -583,6 +739,22 @@ void ae3d::Scene::Render()
 
         RenderWithCamera( camera, 0, "Primary Pass" );
     }
+
+    // Voices are prioritized by their distance from the listener, so they are updated after it has moved.
+    for (auto gameObject : gameObjects)
+    {
+        auto audioSource = gameObject ? gameObject->GetComponent< AudioSourceComponent >() : nullptr;
+        auto transform = gameObject ? gameObject->GetComponent< TransformComponent >() : nullptr;
+
+        if (audioSource && transform && audioSource->voiceId != 0 && audioSource->Is3D())
+        {
+            const Vec3& position = transform->GetWorldPosition();
+            AudioSystem::SetVoicePosition( audioSource->voiceId, position.x, position.y, position.z );
+        }
+    }
+
+    AudioSystem::UpdateVoices();
+    ClearDebugLines();
     
     GfxDevice::SetRenderTarget( nullptr, 0 );
 #if RENDERER_D3D12
@@ -615,8 +787,11 @@ void ae3d::Scene::RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const
     GfxDevice::SetRenderTarget( camera->GetTargetTexture(), cubeMapFace );
 #endif
 #ifdef RENDERER_VULKAN
+    GfxDeviceGlobal::lightTiler.SetClusterSet( camera->GetLightCulling() == CameraComponent::LightCulling::Clustered ? camera->clusterSetIndex : -1 );
+
     if (camera->GetTargetTexture())
     {
+        GfxDevice::BeginParallelDraws( debugGroupName );
         BeginOffscreen();
     }
 
@@ -766,21 +941,6 @@ void ae3d::Scene::RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const
             textRenderer->Render( localToClip.m );
         }
 
-        auto lineRenderer = gameObject->GetComponent< LineRendererComponent >();
-
-        if (lineRenderer && lineRenderer->isEnabled)
-        {
-#if RENDERER_VULKAN
-            const float screenScale = 1;
-#else
-            const float screenScale = 2;
-#endif
-
-            int width = 0, height = 0;
-            Window::GetSize( width, height );
-            System::DrawLines( lineRenderer->lineHandle, camera->GetView(), camera->GetProjection(), (int)(width * screenScale), (int)(height * screenScale) );
-        }
-        
         auto meshRenderer = gameObject->GetComponent< MeshRendererComponent >();
 
         if (meshRenderer)
@@ -797,22 +957,30 @@ void ae3d::Scene::RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const
 
     std::sort( std::begin( gameObjectsWithMeshRenderer ), std::end( gameObjectsWithMeshRenderer ), meshSorterByMesh );
     
-    Array< Matrix44 > localToViews( (int)gameObjectsWithMeshRenderer.size() );
-    Array< Matrix44 > localToClips( (int)gameObjectsWithMeshRenderer.size() );
+    const int meshCount = (int)gameObjectsWithMeshRenderer.size();
+    Array< Matrix44 > localToWorlds( meshCount );
+    Array< Matrix44 > localToViews( meshCount );
+    Array< Matrix44 > localToClips( meshCount );
     
     int i = 0;
     
     for (auto j : gameObjectsWithMeshRenderer)
     {
         auto transform = gameObjects[ j ]->GetComponent< TransformComponent >();
-        auto meshLocalToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
+        localToWorlds[ i ] = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
+        ++i;
+    }
 
-        Matrix44::Multiply( meshLocalToWorld, view, localToViews[ i ] );
-        Matrix44::Multiply( localToViews[ i ], camera->GetProjection(), localToClips[ i ] );
+    Matrix44::MultiplyMany( localToWorlds.elements, view, meshCount, localToViews.elements );
+    Matrix44::MultiplyMany( localToViews.elements, camera->GetProjection(), meshCount, localToClips.elements );
 
+    i = 0;
+    
+    for (auto j : gameObjectsWithMeshRenderer)
+    {
         auto* meshRenderer = gameObjects[ j ]->GetComponent< MeshRendererComponent >();
-        meshRenderer->Cull( frustum, meshLocalToWorld );
-        meshRenderer->Render( localToViews[ i ], localToClips[ i ], meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, nullptr, nullptr, nullptr, MeshRendererComponent::RenderType::Opaque );
+        meshRenderer->Cull( frustum );
+        meshRenderer->Render( localToViews[ i ], localToClips[ i ], localToWorlds[ i ], SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, nullptr, nullptr, nullptr, MeshRendererComponent::RenderType::Opaque );
         
         ++i;
     }
@@ -821,20 +989,29 @@ void ae3d::Scene::RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const
     
     for (auto j : gameObjectsWithMeshRenderer)
     {
-        auto transform = gameObjects[ j ]->GetComponent< TransformComponent >();
-        auto meshLocalToWorld = transform ? transform->GetLocalToWorldMatrix() : Matrix44::identity;
-        
-        gameObjects[ j ]->GetComponent< MeshRendererComponent >()->Render( localToViews[ i ], localToClips[ i ], meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, nullptr, nullptr, nullptr, MeshRendererComponent::RenderType::Transparent );
+        gameObjects[ j ]->GetComponent< MeshRendererComponent >()->Render( localToViews[ i ], localToClips[ i ], localToWorlds[ i ], SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, nullptr, nullptr, nullptr, MeshRendererComponent::RenderType::Transparent );
         
         ++i;
     }
 
+    if (camera->GetTargetTexture() == nullptr || !camera->GetTargetTexture()->IsCube())
+    {
+        Matrix44 viewProjection;
+        Matrix44::Multiply( view, camera->GetProjection(), viewProjection );
+        DrawDebugLines( viewProjection, camera->GetLayerMask() );
+    }
+
     GfxDevice::PopGroupMarker();
 
 #if RENDERER_METAL
     GfxDevice::SetRenderTarget( nullptr, 0 );
 #endif
 #if RENDERER_VULKAN
+    if (camera->GetTargetTexture())
+    {
+        GfxDevice::EndParallelDraws();
+    }
+
     GfxDevice::SetRenderTarget( nullptr, 0 );
     
     if (camera->GetTargetTexture())
@@ -852,20 +1029,7 @@ void ae3d::Scene::RenderWithCamera( GameObject* cameraGo, int cubeMapFace, const
     
     if (camera->GetTargetTexture() && camera->GetProjectionType() == ae3d::CameraComponent::ProjectionType::Perspective && !camera->GetTargetTexture()->IsCube() && camera->ShouldRenderParticles())
     {
-        for (auto go : gameObjects)
-        {
-            if (!go || !go->IsEnabled())
-            {
-                continue;
-            }
-
-            ParticleSystemComponent* particleSystem = go->GetComponent< ParticleSystemComponent >();
-            
-            if (particleSystem)
-            {
-                particleSystem->Draw( renderer.builtinShaders.particleDrawShader, *camera->GetTargetTexture() );
-            }
-        }
+        ParticleSystemComponent::Draw( renderer.builtinShaders.particleDrawShader, *camera->GetTargetTexture() );
     }
 }
 
@@ -901,7 +1065,7 @@ void ae3d::Scene::RenderDepthAndNormals( CameraComponent* camera, const Matrix44
         
         auto meshRenderer = gameObjects[ j ]->GetComponent< MeshRendererComponent >();
 
-        meshRenderer->Cull( frustum, meshLocalToWorld );
+        meshRenderer->Cull( frustum );
         meshRenderer->Render( localToView, localToClip, meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, &renderer.builtinShaders.depthNormalsShader, &renderer.builtinShaders.depthNormalsSkinShader, nullptr, MeshRendererComponent::RenderType::Opaque );
         meshRenderer->Render( localToView, localToClip, meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, &renderer.builtinShaders.depthNormalsShader,
                              &renderer.builtinShaders.depthNormalsSkinShader, nullptr, MeshRendererComponent::RenderType::Transparent );
@@ -939,6 +1103,7 @@ void ae3d::Scene::RenderShadowsWithCamera( GameObject* cameraGo, int cubeMapFace
     GfxDevice::SetRenderTarget( camera->GetTargetTexture(), cubeMapFace );
 #endif
 #if RENDERER_VULKAN
+    GfxDevice::BeginParallelDraws( "Shadow maps" );
     BeginOffscreen();
     GfxDevice::SetScissor( viewport );
     GfxDevice::SetViewport( viewport );
@@ -1012,7 +1177,7 @@ void ae3d::Scene::RenderShadowsWithCamera( GameObject* cameraGo, int cubeMapFace
 
         auto* meshRenderer = gameObjects[ j ]->GetComponent< MeshRendererComponent >();
         
-        meshRenderer->Cull( frustum, meshLocalToWorld );
+        meshRenderer->Cull( frustum );
         meshRenderer->Render( localToView, localToClip, meshLocalToWorld, SceneGlobal::shadowCameraViewMatrix, SceneGlobal::shadowCameraProjectionMatrix, &renderer.builtinShaders.momentsShader,
                              &renderer.builtinShaders.momentsSkinShader, &renderer.builtinShaders.momentsAlphaTestShader, MeshRendererComponent::RenderType::Opaque );
     }
@@ -1023,6 +1188,7 @@ void ae3d::Scene::RenderShadowsWithCamera( GameObject* cameraGo, int cubeMapFace
     GfxDevice::SetRenderTarget( nullptr, 0 );
 #endif
 #if RENDERER_VULKAN
+    GfxDevice::EndParallelDraws();
     EndOffscreen( 1, camera->GetTargetTexture() );
 #endif
 }
@@ -1956,63 +2122,200 @@ ae3d::Scene::DeserializeResult ae3d::Scene::Deserialize( const FileSystem::FileC
     return DeserializeResult::Success;
 }
 
-void ae3d::Scene::GenerateAABB()
+void ae3d::Scene::UpdateSkinChunks()
 {
-    Statistics::BeginSceneAABB();
-    
-    const float maxValue = 99999999.0f;
-    aabbMin = {  maxValue,  maxValue,  maxValue };
-    aabbMax = { -maxValue, -maxValue, -maxValue };
-    
-    for (auto& o : gameObjects)
+    const unsigned rendererCount = static_cast< unsigned >( SkinningGlobal::renderers->size() );
+
+    while (true)
     {
-        if (!o)
+        const unsigned first = SkinningGlobal::nextRenderer.fetch_add( SkinningGlobal::RenderersPerChunk );
+
+        if (first >= rendererCount)
         {
-            continue;
+            return;
         }
 
-        auto meshRenderer = o->GetComponent< ae3d::MeshRendererComponent >();
-        auto meshTransform = o->GetComponent< ae3d::TransformComponent >();
+        for (unsigned i = first; i < first + SkinningGlobal::RenderersPerChunk && i < rendererCount; ++i)
+        {
+            (*SkinningGlobal::renderers)[ i ]->UpdateSkinPalette();
+        }
+    }
+}
 
-        if (meshRenderer == nullptr || meshTransform == nullptr)
+void ae3d::Scene::SkinningWorkerLoop( unsigned seenGeneration )
+{
+    while (true)
+    {
+        {
+            std::unique_lock< std::mutex > lock( SkinningGlobal::mutex );
+            SkinningGlobal::workAvailable.wait( lock, [&]() { return SkinningGlobal::quit || SkinningGlobal::generation != seenGeneration; } );
+
+            if (SkinningGlobal::quit)
+            {
+                return;
+            }
+
+            seenGeneration = SkinningGlobal::generation;
+        }
+
+        UpdateSkinChunks();
+
+        {
+            std::lock_guard< std::mutex > lock( SkinningGlobal::mutex );
+            --SkinningGlobal::busyWorkers;
+        }
+
+        SkinningGlobal::workDone.notify_one();
+    }
+}
+
+void ae3d::Scene::UpdateSkinning()
+{
+    Profiler::BeginZone( "Skinning" );
+
+    std::vector< MeshRendererComponent* > skinnedRenderers;
+
+    for (auto gameObject : gameObjects)
+    {
+        if (gameObject == nullptr || !gameObject->IsEnabled())
         {
             continue;
         }
-        
-        Vec3 oAABBmin = meshRenderer->GetMesh() ? meshRenderer->GetMesh()->GetAABBMin() : Vec3( -1, -1, -1 );
-        Vec3 oAABBmax = meshRenderer->GetMesh() ? meshRenderer->GetMesh()->GetAABBMax() : Vec3(  1,  1,  1 );
-        
-        Matrix44::TransformPoint( oAABBmin, meshTransform->GetLocalToWorldMatrix(), &oAABBmin );
-        Matrix44::TransformPoint( oAABBmax, meshTransform->GetLocalToWorldMatrix(), &oAABBmax );
-        
-        if (oAABBmin.x < aabbMin.x)
+
+        auto meshRenderer = gameObject->GetComponent< MeshRendererComponent >();
+
+        if (meshRenderer && meshRenderer->IsEnabled() && meshRenderer->IsSkinned())
         {
-            aabbMin.x = oAABBmin.x;
+            skinnedRenderers.push_back( meshRenderer );
+            meshRenderer->PrepareSkinnedVertexBuffers();
         }
-        
-        if (oAABBmin.y < aabbMin.y)
+    }
+
+    SkinningGlobal::renderers = &skinnedRenderers;
+    SkinningGlobal::nextRenderer = 0;
+
+    // A single chunk is updated on this thread without waking the workers.
+    if (skinnedRenderers.size() > SkinningGlobal::RenderersPerChunk)
+    {
+        if (SkinningGlobal::workers.empty())
         {
-            aabbMin.y = oAABBmin.y;
+            const unsigned hardwareThreads = std::max( std::thread::hardware_concurrency(), 1u );
+            const unsigned workerCount = std::min( hardwareThreads - 1, SkinningGlobal::MaxWorkers );
+
+            for (unsigned i = 0; i < workerCount; ++i)
+            {
+                SkinningGlobal::workers.push_back( std::thread( &Scene::SkinningWorkerLoop, SkinningGlobal::generation ) );
+            }
         }
-        
-        if (oAABBmin.z < aabbMin.z)
+
         {
-            aabbMin.z = oAABBmin.z;
+            std::lock_guard< std::mutex > lock( SkinningGlobal::mutex );
+            SkinningGlobal::busyWorkers = static_cast< unsigned >( SkinningGlobal::workers.size() );
+            ++SkinningGlobal::generation;
         }
-        
-        if (oAABBmax.x > aabbMax.x)
+
+        SkinningGlobal::workAvailable.notify_all();
+    }
+
+    UpdateSkinChunks();
+
+    {
+        std::unique_lock< std::mutex > lock( SkinningGlobal::mutex );
+        SkinningGlobal::workDone.wait( lock, []() { return SkinningGlobal::busyWorkers == 0; } );
+    }
+
+    // The bone buffer isn't thread-safe, so palettes are uploaded here instead of in the workers.
+    bool hasSkinningPrePass = false;
+
+    for (auto meshRenderer : skinnedRenderers)
+    {
+        meshRenderer->UploadSkinPalette();
+        hasSkinningPrePass |= meshRenderer->IsSkinningPrePassEnabled();
+    }
+
+    if (hasSkinningPrePass)
+    {
+        ComputeShader& skinningShader = renderer.builtinShaders.skinningShader;
+        skinningShader.Begin();
+
+        for (auto meshRenderer : skinnedRenderers)
         {
-            aabbMax.x = oAABBmax.x;
+            meshRenderer->SkinVertices( skinningShader );
         }
-        
-        if (oAABBmax.y > aabbMax.y)
+
+        skinningShader.End();
+    }
+
+    Profiler::EndZone();
+}
+
+void ae3d::Scene::GenerateAABB()
+{
+    Statistics::BeginSceneAABB();
+    
+    // Objects that didn't move keep their cached world AABB. Moved objects can only grow the scene AABB
+    // incrementally, unless their old AABB touched the scene AABB's bounds, in which case it's rebuilt.
+    unsigned objectCount = 0;
+    bool needsRebuild = false;
+
+    for (auto& o : gameObjects)
+    {
+        if (!o)
         {
-            aabbMax.y = oAABBmax.y;
+            continue;
+        }
+
+        auto meshRenderer = o->GetComponent< ae3d::MeshRendererComponent >();
+
+        if (meshRenderer == nullptr)
+        {
+            continue;
         }
         
-        if (oAABBmax.z > aabbMax.z)
+        auto meshTransform = o->GetComponent< ae3d::TransformComponent >();
+        ++objectCount;
+        const Vec3 oldMin = meshRenderer->GetWorldAABBMin();
+        const Vec3 oldMax = meshRenderer->GetWorldAABBMax();
+
+        if (meshRenderer->UpdateWorldAABB( meshTransform ? meshTransform->GetLocalToWorldMatrix() : Matrix44::identity ))
         {
-            aabbMax.z = oAABBmax.z;
+            needsRebuild |= oldMin.x <= aabbMin.x || oldMin.y <= aabbMin.y || oldMin.z <= aabbMin.z ||
+                            oldMax.x >= aabbMax.x || oldMax.y >= aabbMax.y || oldMax.z >= aabbMax.z;
+            aabbMin = Vec3::Min2( aabbMin, meshRenderer->GetWorldAABBMin() );
+            aabbMax = Vec3::Max2( aabbMax, meshRenderer->GetWorldAABBMax() );
+        }
+    }
+
+    // Removed objects and mesh renderers can shrink the scene AABB.
+    if (isAABBDirty || objectCount != aabbObjectCount)
+    {
+        needsRebuild = true;
+        isAABBDirty = false;
+        aabbObjectCount = objectCount;
+    }
+
+    if (needsRebuild)
+    {
+        const float maxValue = 99999999.0f;
+        aabbMin = {  maxValue,  maxValue,  maxValue };
+        aabbMax = { -maxValue, -maxValue, -maxValue };
+
+        for (auto& o : gameObjects)
+        {
+            if (!o)
+            {
+                continue;
+            }
+
+            auto meshRenderer = o->GetComponent< ae3d::MeshRendererComponent >();
+
+            if (meshRenderer == nullptr)
+            {
+                continue;
+            }
+
+            aabbMin = Vec3::Min2( aabbMin, meshRenderer->GetWorldAABBMin() );
+            aabbMax = Vec3::Max2( aabbMax, meshRenderer->GetWorldAABBMax() );
         }
     }
     
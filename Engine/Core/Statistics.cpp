@@ -1,6 +1,10 @@
 #include "Statistics.hpp"
 #include "GfxDevice.hpp"
+#include "Profiler.hpp"
+#include <algorithm>
 #include <chrono>
+#include <cstdio>
+#include <vector>
 
 namespace Statistics
 {
@@ -15,9 +19,11 @@ namespace Statistics
     int triangleCount = 0;
     int psoBindCount = 0;
     int queueSubmitCalls = 0;
+    int audioVoiceCount = 0;
+    int virtualAudioVoiceCount = 0;
     float depthNormalsTimeMS = 0;
     float depthNormalsTimeGpuMS = 0;
-    float shadowMapTimeMS = 0;
+    float shadowMapTimeMS = 0; // Summed over the frame's shadow casters, reset by ResetFrameStatistics().
     float shadowMapTimeGpuMS = 0;
     float frameTimeMS = 0;
     float presentTimeMS = 0;
@@ -32,27 +38,195 @@ namespace Statistics
     float lightUpdateTimeMS = 0;
     float acquireNextImageTimeMS = 0;
     
-    std::chrono::time_point< std::chrono::steady_clock > startAcquireNextImageTimePoint;
-    std::chrono::time_point< std::chrono::steady_clock > startLightUpdateTimePoint;
+    // Frame time spans frame boundaries, so it isn't a profiler zone.
     std::chrono::time_point< std::chrono::steady_clock > startFrameTimePoint;
-    std::chrono::time_point< std::chrono::steady_clock > startShadowMapTimePoint;
-    std::chrono::time_point< std::chrono::steady_clock > startPrimaryPassTimePoint;
-    std::chrono::time_point< std::chrono::steady_clock > startDepthNormalsTimePoint;
-    std::chrono::time_point< std::chrono::steady_clock > startPresentTimePoint;
-    std::chrono::time_point< std::chrono::steady_clock > startSceneAABBPoint;
-    std::chrono::time_point< std::chrono::steady_clock > startWaitForPreviousFrameTimePoint;
+
+    const int MetricCount = static_cast< int >( Metric::Count );
+    const char* metricNames[ MetricCount ] =
+    {
+        "frame_ms", "present_ms", "shadow_ms", "shadow_gpu_ms", "depth_normals_ms", "depth_normals_gpu_ms",
+        "light_culler_gpu_ms", "primary_pass_gpu_ms", "light_update_ms", "frustum_cull_ms", "queue_wait_ms", "scene_aabb_ms",
+        "draw_calls", "pso_binds", "shader_binds", "render_target_binds", "barrier_calls", "fence_calls", "alloc_calls", "queue_submits", "triangles",
+        "audio_voices", "virtual_audio_voices"
+    };
+
+    // Ring buffer of historyLength frames, MetricCount values per frame.
+    std::vector< float > history( 600 * MetricCount );
+    int historyLength = 600;
+    int historyFrameCount = 0;
+    int historyNextFrame = 0;
+    bool hasFrameToRecord = false;
+}
+
+namespace
+{
+    void RecordFrame()
+    {
+        using namespace Statistics;
+
+        if (historyLength == 0)
+        {
+            return;
+        }
+
+        float* values = &history[ historyNextFrame * MetricCount ];
+        values[ (int)Metric::FrameTime ] = frameTimeMS;
+        values[ (int)Metric::PresentTime ] = presentTimeMS;
+        values[ (int)Metric::ShadowMapTime ] = shadowMapTimeMS;
+        values[ (int)Metric::ShadowMapTimeGpu ] = shadowMapTimeGpuMS;
+        values[ (int)Metric::DepthNormalsTime ] = depthNormalsTimeMS;
+        values[ (int)Metric::DepthNormalsTimeGpu ] = depthNormalsTimeGpuMS;
+        values[ (int)Metric::LightCullerTimeGpu ] = lightCullerTimeGpuMS;
+        values[ (int)Metric::PrimaryPassTimeGpu ] = primaryPassTimeGpuMS;
+        values[ (int)Metric::LightUpdateTime ] = lightUpdateTimeMS;
+        values[ (int)Metric::FrustumCullTime ] = frustumCullTimeMS;
+        values[ (int)Metric::QueueWaitTime ] = queueWaitTimeMs;
+        values[ (int)Metric::SceneAABBTime ] = sceneAABBTimeMS;
+        values[ (int)Metric::DrawCalls ] = (float)drawCalls;
+        values[ (int)Metric::PSOBinds ] = (float)psoBindCount;
+        values[ (int)Metric::ShaderBinds ] = (float)shaderBinds;
+        values[ (int)Metric::RenderTargetBinds ] = (float)renderTargetBinds;
+        values[ (int)Metric::BarrierCalls ] = (float)barrierCalls;
+        values[ (int)Metric::FenceCalls ] = (float)fenceCalls;
+        values[ (int)Metric::AllocCalls ] = (float)allocCalls;
+        values[ (int)Metric::QueueSubmitCalls ] = (float)queueSubmitCalls;
+        values[ (int)Metric::Triangles ] = (float)triangleCount;
+        values[ (int)Metric::AudioVoices ] = (float)audioVoiceCount;
+        values[ (int)Metric::VirtualAudioVoices ] = (float)virtualAudioVoiceCount;
+
+        historyNextFrame = (historyNextFrame + 1) % historyLength;
+        historyFrameCount = std::min( historyFrameCount + 1, historyLength );
+    }
+
+    // Returns the value of a metric in the nth recorded frame, oldest first.
+    float GetHistoryValue( int frame, int metric )
+    {
+        using namespace Statistics;
+
+        const int oldestFrame = (historyNextFrame - historyFrameCount + historyLength) % historyLength;
+        return history[ ((oldestFrame + frame) % historyLength) * MetricCount + metric ];
+    }
+}
+
+void Statistics::SetHistoryLength( int frameCount )
+{
+    historyLength = std::max( frameCount, 0 );
+    history.assign( historyLength * MetricCount, 0.0f );
+    historyFrameCount = 0;
+    historyNextFrame = 0;
+}
+
+const char* Statistics::GetMetricName( Metric metric )
+{
+    return metricNames[ (int)metric ];
+}
+
+Statistics::Summary Statistics::GetHistorySummary( Metric metric )
+{
+    Summary summary;
+    summary.sampleCount = historyFrameCount;
+
+    if (historyFrameCount == 0)
+    {
+        return summary;
+    }
+
+    std::vector< float > samples( historyFrameCount );
+    double sum = 0;
+
+    for (int frame = 0; frame < historyFrameCount; ++frame)
+    {
+        samples[ frame ] = GetHistoryValue( frame, (int)metric );
+        sum += static_cast< double >( samples[ frame ] );
+    }
+
+    std::sort( samples.begin(), samples.end() );
+
+    // Nearest-rank, so a percentile is always a frame that really happened.
+    auto percentile = [ &samples ]( int p ) { return samples[ std::max( (int)((p * samples.size() + 99) / 100), 1 ) - 1 ]; };
+
+    summary.min = samples.front();
+    summary.max = samples.back();
+    summary.avg = (float)(sum / historyFrameCount);
+    summary.p50 = percentile( 50 );
+    summary.p95 = percentile( 95 );
+    summary.p99 = percentile( 99 );
+
+    return summary;
+}
+
+bool Statistics::WriteHistoryCSV( const char* path )
+{
+    FILE* file = std::fopen( path, "wb" );
+
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    std::fprintf( file, "frame" );
+
+    for (int metric = 0; metric < MetricCount; ++metric)
+    {
+        std::fprintf( file, ",%s", metricNames[ metric ] );
+    }
+
+    std::fprintf( file, "\n" );
+
+    for (int frame = 0; frame < historyFrameCount; ++frame)
+    {
+        std::fprintf( file, "%d", frame );
+
+        for (int metric = 0; metric < MetricCount; ++metric)
+        {
+            std::fprintf( file, ",%g", static_cast< double >( GetHistoryValue( frame, metric ) ) );
+        }
+
+        std::fprintf( file, "\n" );
+    }
+
+    return std::fclose( file ) == 0;
+}
+
+bool Statistics::WriteHistoryJSON( const char* path )
+{
+    FILE* file = std::fopen( path, "wb" );
+
+    if (file == nullptr)
+    {
+        return false;
+    }
+
+    std::fprintf( file, "{\"frames\":%d,\"metrics\":{\n", historyFrameCount );
+
+    for (int metric = 0; metric < MetricCount; ++metric)
+    {
+        const Summary summary = GetHistorySummary( (Metric)metric );
+        std::fprintf( file, "\"%s\":{\"min\":%g,\"avg\":%g,\"p50\":%g,\"p95\":%g,\"p99\":%g,\"max\":%g,\"samples\":[", metricNames[ metric ],
+                      static_cast< double >( summary.min ), static_cast< double >( summary.avg ), static_cast< double >( summary.p50 ),
+                      static_cast< double >( summary.p95 ), static_cast< double >( summary.p99 ), static_cast< double >( summary.max ) );
+
+        for (int frame = 0; frame < historyFrameCount; ++frame)
+        {
+            std::fprintf( file, frame == 0 ? "%g" : ",%g", static_cast< double >( GetHistoryValue( frame, metric ) ) );
+        }
+
+        std::fprintf( file, "]}%s\n", metric + 1 < MetricCount ? "," : "" );
+    }
+
+    std::fprintf( file, "}}\n" );
+
+    return std::fclose( file ) == 0;
 }
 
 void Statistics::BeginLightUpdateProfiling()
 {
-    startLightUpdateTimePoint = std::chrono::steady_clock::now();
+    Profiler::BeginZone( "Light update" );
 }
 
 void Statistics::EndLightUpdateProfiling()
 {
-    auto tEnd = std::chrono::steady_clock::now();
-    auto tDiff = std::chrono::duration< double, std::milli >( tEnd - Statistics::startLightUpdateTimePoint ).count();
-    lightUpdateTimeMS = static_cast< float >( tDiff );
+    lightUpdateTimeMS += Profiler::EndZone();
 }
 
 float Statistics::GetLightUpdateTimeMS()
@@ -62,14 +236,12 @@ float Statistics::GetLightUpdateTimeMS()
 
 void Statistics::BeginAcquireNextImageProfiling()
 {
-    startAcquireNextImageTimePoint = std::chrono::steady_clock::now();
+    Profiler::BeginZone( "Acquire next image" );
 }
 
 void Statistics::EndAcquireNextImageProfiling()
 {
-    auto tEnd = std::chrono::steady_clock::now();
-    auto tDiff = std::chrono::duration< double, std::milli >( tEnd - Statistics::startAcquireNextImageTimePoint ).count();
-    acquireNextImageTimeMS = static_cast< float >( tDiff );
+    acquireNextImageTimeMS = Profiler::EndZone();
 }
 
 float Statistics::GetAcquireNextImageTimeMS()
@@ -150,14 +322,12 @@ void Statistics::SetLightCullerGpuTime( float timeMS )
 
 void Statistics::BeginPresentTimeProfiling()
 {
-    Statistics::startPresentTimePoint = std::chrono::steady_clock::now();
+    Profiler::BeginZone( "Present" );
 }
 
 void Statistics::EndPresentTimeProfiling()
 {
-    auto tEnd = std::chrono::steady_clock::now();
-    auto tDiff = std::chrono::duration<double, std::milli>( tEnd - Statistics::startPresentTimePoint ).count();
-    Statistics::presentTimeMS = static_cast< float >(tDiff);
+    Statistics::presentTimeMS = Profiler::EndZone();
 }
 
 void Statistics::IncFrustumCullTime( float ms )
@@ -177,29 +347,25 @@ void Statistics::EndLightCullerProfiling()
 
 void Statistics::BeginShadowMapProfiling()
 {
-    Statistics::startShadowMapTimePoint = std::chrono::steady_clock::now();
+    Profiler::BeginZone( "Shadow map" );
     ae3d::GfxDevice::BeginShadowMapGpuQuery();
 }
 
 void Statistics::EndShadowMapProfiling()
 {
-    auto tEnd = std::chrono::steady_clock::now();
-    auto tDiff = std::chrono::duration<double, std::milli>( tEnd - Statistics::startShadowMapTimePoint ).count();
-    Statistics::shadowMapTimeMS = static_cast< float >(tDiff);
+    Statistics::shadowMapTimeMS += Profiler::EndZone();
     ae3d::GfxDevice::EndShadowMapGpuQuery();
 }
 
 void Statistics::BeginDepthNormalsProfiling()
 {
-    Statistics::startDepthNormalsTimePoint = std::chrono::steady_clock::now();
+    Profiler::BeginZone( "Depth and normals" );
     ae3d::GfxDevice::BeginDepthNormalsGpuQuery();
 }
 
 void Statistics::EndDepthNormalsProfiling()
 {
-    auto tEnd = std::chrono::steady_clock::now();
-    auto tDiff = std::chrono::duration<double, std::milli>( tEnd - Statistics::startDepthNormalsTimePoint ).count();
-    Statistics::depthNormalsTimeMS = static_cast< float >(tDiff);
+    Statistics::depthNormalsTimeMS = Profiler::EndZone();
     ae3d::GfxDevice::EndDepthNormalsGpuQuery();
 }
 
@@ -217,15 +383,12 @@ void Statistics::EndFrameTimeProfiling()
 
 void Statistics::BeginWaitForPreviousFrameProfiling()
 {
-    Statistics::startWaitForPreviousFrameTimePoint = std::chrono::steady_clock::now();
+    Profiler::BeginZone( "Wait for previous frame" );
 }
 
 void Statistics::EndWaitForPreviousFrameProfiling()
 {
-    auto tEnd = std::chrono::steady_clock::now();
-    auto tDiff = std::chrono::duration<double, std::milli>( tEnd - Statistics::startWaitForPreviousFrameTimePoint ).count();
-
-    Statistics::waitForPreviousFrameTimeMS = static_cast<float>( tDiff );
+    Statistics::waitForPreviousFrameTimeMS = Profiler::EndZone();
 }
 
 void Statistics::IncPSOBindCalls()
@@ -355,6 +518,14 @@ void Statistics::IncBarrierCalls()
 
 void Statistics::ResetFrameStatistics()
 {
+    // The first call has no finished frame to record.
+    if (hasFrameToRecord)
+    {
+        RecordFrame();
+    }
+
+    hasFrameToRecord = true;
+
     drawCalls = 0;
     barrierCalls = 0;
     fenceCalls = 0;
@@ -369,7 +540,9 @@ void Statistics::ResetFrameStatistics()
     frustumCullTimeMS = 0;
     waitForPreviousFrameTimeMS = 0;
     lightUpdateTimeMS = 0;
+    shadowMapTimeMS = 0;
 
+    Profiler::EndFrame();
     startFrameTimePoint = std::chrono::steady_clock::now();
 }
 
@@ -390,17 +563,31 @@ float Statistics::GetFrustumCullTimeMS()
 
 void Statistics::BeginSceneAABB()
 {
-    Statistics::startSceneAABBPoint = std::chrono::steady_clock::now();
+    Profiler::BeginZone( "Scene AABB" );
 }
 
 void Statistics::EndSceneAABB()
 {
-    auto tEnd = std::chrono::steady_clock::now();
-    auto tDiff = std::chrono::duration<double, std::milli>( tEnd - Statistics::startSceneAABBPoint ).count();
-    Statistics::sceneAABBTimeMS = static_cast< float >(tDiff);
+    Statistics::sceneAABBTimeMS = Profiler::EndZone();
 }
 
 void UpdateFrameTiming()
 {
     Statistics::EndFrameTimeProfiling();
 }
+
+void Statistics::SetAudioVoiceCounts( int activeCount, int virtualCount )
+{
+    audioVoiceCount = activeCount;
+    virtualAudioVoiceCount = virtualCount;
+}
+
+int Statistics::GetAudioVoiceCount()
+{
+    return audioVoiceCount;
+}
+
+int Statistics::GetVirtualAudioVoiceCount()
+{
+    return virtualAudioVoiceCount;
+}
@@ -2,6 +2,40 @@
 
 namespace Statistics
 {
+    /// Metrics that are recorded into the frame history.
+    enum class Metric
+    {
+        FrameTime, PresentTime, ShadowMapTime, ShadowMapTimeGpu, DepthNormalsTime, DepthNormalsTimeGpu,
+        LightCullerTimeGpu, PrimaryPassTimeGpu, LightUpdateTime, FrustumCullTime, QueueWaitTime, SceneAABBTime,
+        DrawCalls, PSOBinds, ShaderBinds, RenderTargetBinds, BarrierCalls, FenceCalls, AllocCalls, QueueSubmitCalls, Triangles,
+        AudioVoices, VirtualAudioVoices, Count
+    };
+
+    struct Summary
+    {
+        float min = 0;
+        float avg = 0;
+        float p50 = 0;
+        float p95 = 0;
+        float p99 = 0;
+        float max = 0;
+        int sampleCount = 0;
+    };
+
+    /// Sets the number of frames kept in the history and clears it.
+    /// \param frameCount Frame count. 0 disables recording.
+    void SetHistoryLength( int frameCount );
+    /// \return Name of a metric, used as a column/key in dumps.
+    const char* GetMetricName( Metric metric );
+    /// \return Min, avg and nearest-rank percentiles over the recorded frames.
+    Summary GetHistorySummary( Metric metric );
+    /// Writes one row per recorded frame, oldest first.
+    /// \return True if the file could be written.
+    bool WriteHistoryCSV( const char* path );
+    /// Writes summaries and samples of every metric.
+    /// \return True if the file could be written.
+    bool WriteHistoryJSON( const char* path );
+
     void BeginLightCullerProfiling();
     void EndLightCullerProfiling();
 
@@ -16,6 +50,7 @@ namespace Statistics
     float GetAcquireNextImageTimeMS();
     
     float GetFrameTimeMS();
+    /// \return CPU time of all shadow map passes since the last ResetFrameStatistics().
     float GetShadowMapTimeMS();
     float GetShadowMapTimeGpuMS();
     float GetDepthNormalsTimeMS();
@@ -77,4 +112,9 @@ namespace Statistics
     void SetShadowMapGpuTime( float timeMS );
     void SetLightCullerGpuTime( float timeMS );
     void SetPrimaryPassGpuTime( float timeMS );
+    /// \param activeCount Audible voices.
+    /// \param virtualCount Voices that are silent because all sources are used by more audible voices.
+    void SetAudioVoiceCounts( int activeCount, int virtualCount );
+    int GetAudioVoiceCount();
+    int GetVirtualAudioVoiceCount();
 }
@@ -2,6 +2,7 @@
 
 #include <string>
 #include <vector>
+#include "JointAnimation.hpp"
 #include "VertexBuffer.hpp"
 #include "Vec3.hpp"
 
@@ -10,7 +11,7 @@ namespace ae3d
     struct Joint
     {
         Matrix44 globalBindposeInverse;
-        std::vector< Matrix44 > animTransforms;
+        JointAnimation animation;
         int parentIndex = -1;
         char name[ 128 ];
     };
@@ -10,16 +10,25 @@
 #endif
 #include <stdarg.h>
 #include <assert.h>
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <vector>
 #include "AudioSystem.hpp"
 #include "GfxDevice.hpp"
 #include "FileWatcher.hpp"
+#include "Frustum.hpp"
 #include "Matrix.hpp"
+#include "Profiler.hpp"
 #include "Renderer.hpp"
 #include "Shader.hpp"
 #include "Statistics.hpp"
 #include "Texture2D.hpp"
 #include "Vec3.hpp"
+#include "VertexBuffer.hpp"
 
 extern ae3d::Renderer renderer;
 extern ae3d::FileWatcher fileWatcher;
@@ -30,11 +39,43 @@ namespace GfxDeviceGlobal
 }
 
 void PlatformInitGamePad();
-std::chrono::time_point<std::chrono::steady_clock> tStart;
+void StopSkinningWorkers();
 long double startTimeStamp;
 
 using namespace ae3d;
 
+namespace SystemGlobal
+{
+    std::string historyPathAtExit;
+}
+
+namespace DebugLineGlobal
+{
+    // Buffers are used in turn, one per frame, so the frame that is still on the GPU keeps its lines.
+    constexpr int BufferCount = 3;
+
+    // Queued lines that share a layer and a depth mode.
+    struct Batch
+    {
+        std::vector< VertexBuffer::VertexPTNTC > vertices;
+        unsigned layer = 0;
+        bool depthTest = true;
+        // Vertex range in the uploaded buffer, padded to a multiple of 6 vertices.
+        int start = 0;
+        int end = 0;
+    };
+
+    // Batches are kept over frames, so their vertex storage is reused.
+    std::vector< Batch > batches;
+    std::vector< VertexBuffer::VertexPTNTC > uploadVertices;
+    VertexBuffer buffers[ BufferCount ];
+    int capacities[ BufferCount ] = {};
+    int bufferIndex = 0;
+    bool isUploaded = false;
+    // Copies of line buffers indexed by line handle, so line renderers can be queued with the debug lines.
+    std::vector< std::vector< VertexBuffer::VertexPTNTC > > lineBufferVertices;
+}
+
 namespace MathUtil
 {
     bool IsPowerOfTwo( unsigned i );
@@ -75,14 +116,12 @@ void ae3d::System::EndFrame()
 
 void ae3d::System::BeginTimer()
 {
-    tStart = std::chrono::steady_clock::now();
+    Profiler::BeginZone( "Timer" );
 }
 
 float ae3d::System::EndTimer()
 {
-    auto tEnd = std::chrono::steady_clock::now();
-    auto tDiff = std::chrono::duration<double, std::milli>( tEnd - tStart ).count();
-    return (float)tDiff;
+    return Profiler::EndZone();
 }
 
 float ae3d::System::SecondsSinceStartup()
@@ -94,6 +133,12 @@ float ae3d::System::SecondsSinceStartup()
 
 void ae3d::System::Deinit()
 {
+    if (!SystemGlobal::historyPathAtExit.empty() && !ae3d::System::Statistics::WriteHistory( SystemGlobal::historyPathAtExit.c_str() ))
+    {
+        Print( "Could not write statistics history to %s\n", SystemGlobal::historyPathAtExit.c_str() );
+    }
+
+    StopSkinningWorkers();
     GfxDevice::ReleaseGPUObjects();
     AudioSystem::Deinit();
 }
@@ -258,14 +303,44 @@ void ae3d::System::Draw( TextureBase* texture, int x, int y, int xSize, int ySiz
                      GfxDevice::DepthFunc::NoneWriteOff, GfxDevice::CullMode::Off, GfxDevice::FillMode::Solid, GfxDevice::PrimitiveTopology::Triangles );
 }
 
+// Copies lines into the line handle's queueable vertices. An odd last point has no pair and is left out.
+static void CopyLineBufferVertices( int lineHandle, const Vec3* lines, int lineCount, const Vec3& color )
+{
+    if (lineHandle < 0 || !lines)
+    {
+        return;
+    }
+
+    if (static_cast< std::size_t >( lineHandle ) >= DebugLineGlobal::lineBufferVertices.size())
+    {
+        DebugLineGlobal::lineBufferVertices.resize( static_cast< std::size_t >( lineHandle ) + 1 );
+    }
+
+    std::vector< VertexBuffer::VertexPTNTC >& vertices = DebugLineGlobal::lineBufferVertices[ lineHandle ];
+    vertices.resize( static_cast< std::size_t >( lineCount - lineCount % 2 ) );
+
+    for (std::size_t i = 0; i < vertices.size(); ++i)
+    {
+        vertices[ i ].position = lines[ i ];
+        vertices[ i ].color = Vec4( color, 1 );
+    }
+}
+
 int ae3d::System::CreateLineBuffer( const Vec3* lines, int lineCount, const Vec3& color )
 {    
-    return GfxDevice::CreateLineBuffer( lines, lineCount, color );
+    const int handle = GfxDevice::CreateLineBuffer( lines, lineCount, color );
+    CopyLineBufferVertices( handle, lines, lineCount, color );
+    return handle;
 }
 
 void ae3d::System::UpdateLineBuffer( int lineHandle, const Vec3* lines, int lineCount, const Vec3& color )
 {
     GfxDevice::UpdateLineBuffer( lineHandle, lines, lineCount, color );
+
+    if (lineCount != 0)
+    {
+        CopyLineBufferVertices( lineHandle, lines, lineCount, color );
+    }
 }
 
 void ae3d::System::DrawLines( int handle, const Matrix44& view, const Matrix44& projection, int xScreenSize, int yScreenSize )
@@ -287,6 +362,233 @@ void ae3d::System::DrawLines( int handle, const Matrix44& view, const Matrix44&
     GfxDevice::DrawLines( handle, renderer.builtinShaders.spriteRendererShader );
 }
 
+// \return First of count new vertices in the batch of layer and depthTest. Attributes other than position and color are not used and stay zero.
+static VertexBuffer::VertexPTNTC* AppendLineVertices( int count, bool depthTest, unsigned layer )
+{
+    using namespace DebugLineGlobal;
+
+    std::size_t batchIndex = 0;
+
+    while (batchIndex < batches.size() && (batches[ batchIndex ].layer != layer || batches[ batchIndex ].depthTest != depthTest))
+    {
+        ++batchIndex;
+    }
+
+    if (batchIndex == batches.size())
+    {
+        batches.push_back( Batch() );
+        batches.back().layer = layer;
+        batches.back().depthTest = depthTest;
+    }
+
+    std::vector< VertexBuffer::VertexPTNTC >& vertices = batches[ batchIndex ].vertices;
+    const std::size_t oldSize = vertices.size();
+    vertices.resize( oldSize + static_cast< std::size_t >( count ) );
+    return &vertices[ oldSize ];
+}
+
+// Appends zero-length lines until vertices' size is a multiple of 6.
+static void PadLineVertices( std::vector< VertexBuffer::VertexPTNTC >& vertices )
+{
+    while (vertices.size() % 6 != 0)
+    {
+        vertices.push_back( vertices.back() );
+    }
+}
+
+// Draws lines from DrawLine() etc. whose layer is in layerMask. Called by Scene for every camera except cube map cameras.
+// Lines are uploaded once per frame.
+void DrawDebugLines( const Matrix44& viewProjection, unsigned layerMask )
+{
+    using namespace DebugLineGlobal;
+
+    if (!isUploaded)
+    {
+        uploadVertices.clear();
+
+        for (auto& batch : batches)
+        {
+            batch.start = static_cast< int >( uploadVertices.size() );
+
+            if (!batch.vertices.empty())
+            {
+                uploadVertices.insert( uploadVertices.end(), batch.vertices.begin(), batch.vertices.end() );
+                PadLineVertices( uploadVertices );
+            }
+
+            batch.end = static_cast< int >( uploadVertices.size() );
+        }
+
+        const int vertexCount = static_cast< int >( uploadVertices.size() );
+        isUploaded = true;
+
+        if (vertexCount == 0)
+        {
+            return;
+        }
+
+        bufferIndex = (bufferIndex + 1) % BufferCount;
+
+        if (capacities[ bufferIndex ] < vertexCount)
+        {
+            // Lines don't use indices, but backends address them in faces, so there is one face per vertex.
+            capacities[ bufferIndex ] = VertexBuffer::GetGrownCapacity( vertexCount, capacities[ bufferIndex ], std::numeric_limits< int >::max() );
+            buffers[ bufferIndex ].GenerateDynamic( capacities[ bufferIndex ], capacities[ bufferIndex ] );
+            buffers[ bufferIndex ].SetDebugName( "debug line buffer" );
+            uploadVertices.resize( static_cast< std::size_t >( capacities[ bufferIndex ] ), uploadVertices.back() );
+            const VertexBuffer::Face unusedFace;
+            buffers[ bufferIndex ].UpdateDynamic( &unusedFace, 0, uploadVertices.data(), capacities[ bufferIndex ] );
+            uploadVertices.resize( static_cast< std::size_t >( vertexCount ) );
+        }
+        else
+        {
+            buffers[ bufferIndex ].UpdateDynamicVertices( uploadVertices.data(), 0, vertexCount );
+        }
+    }
+
+    bool isShaderSet = false;
+
+    // Depth-tested lines are drawn before overlay lines.
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (const auto& batch : batches)
+        {
+            if (batch.depthTest != (pass == 0) || batch.start == batch.end || (batch.layer & layerMask) == 0)
+            {
+                continue;
+            }
+
+            if (!isShaderSet)
+            {
+                renderer.builtinShaders.spriteRendererShader.Use();
+                renderer.builtinShaders.spriteRendererShader.SetTexture( Texture2D::GetDefaultTexture(), 0 );
+                GfxDeviceGlobal::perObjectUboStruct.lightColor = Vec4( 1, 1, 1, 1 );
+                GfxDeviceGlobal::perObjectUboStruct.localToClip = viewProjection;
+                isShaderSet = true;
+            }
+
+            GfxDevice::DrawLines( buffers[ bufferIndex ], batch.start, batch.end, renderer.builtinShaders.spriteRendererShader,
+                                  batch.depthTest ? GfxDevice::DepthFunc::LessOrEqualWriteOff : GfxDevice::DepthFunc::NoneWriteOff );
+        }
+    }
+}
+
+// Queues a line buffer's lines as depth-tested debug lines on layer. Called by Scene once per frame for every enabled line renderer.
+void QueueLineBuffer( int handle, unsigned layer )
+{
+    if (handle < 0 || static_cast< std::size_t >( handle ) >= DebugLineGlobal::lineBufferVertices.size() || DebugLineGlobal::lineBufferVertices[ handle ].empty())
+    {
+        return;
+    }
+
+    const std::vector< VertexBuffer::VertexPTNTC >& lineVertices = DebugLineGlobal::lineBufferVertices[ handle ];
+    VertexBuffer::VertexPTNTC* vertices = AppendLineVertices( static_cast< int >( lineVertices.size() ), true, layer );
+    std::copy( lineVertices.begin(), lineVertices.end(), vertices );
+}
+
+// Called by Scene after all cameras have been rendered.
+void ClearDebugLines()
+{
+    for (auto& batch : DebugLineGlobal::batches)
+    {
+        batch.vertices.clear();
+    }
+
+    DebugLineGlobal::isUploaded = false;
+}
+
+void ae3d::System::DrawLine( const Vec3& from, const Vec3& to, const Vec4& color, bool depthTest, unsigned layer )
+{
+    VertexBuffer::VertexPTNTC* vertices = AppendLineVertices( 2, depthTest, layer );
+    vertices[ 0 ].position = from;
+    vertices[ 0 ].color = color;
+    vertices[ 1 ].position = to;
+    vertices[ 1 ].color = color;
+}
+
+// Corners are the bottom face in loop order followed by the corners above them.
+static void GetBoxCorners( const Vec3& min, const Vec3& max, Vec3 outCorners[ 8 ] )
+{
+    outCorners[ 0 ] = Vec3( min.x, min.y, min.z );
+    outCorners[ 1 ] = Vec3( max.x, min.y, min.z );
+    outCorners[ 2 ] = Vec3( max.x, min.y, max.z );
+    outCorners[ 3 ] = Vec3( min.x, min.y, max.z );
+    outCorners[ 4 ] = Vec3( min.x, max.y, min.z );
+    outCorners[ 5 ] = Vec3( max.x, max.y, min.z );
+    outCorners[ 6 ] = Vec3( max.x, max.y, max.z );
+    outCorners[ 7 ] = Vec3( min.x, max.y, max.z );
+}
+
+// Corners are ordered like in GetBoxCorners.
+static void DrawBoxCorners( const Vec3 corners[ 8 ], const Vec4& color, bool depthTest, unsigned layer )
+{
+    static const int edges[ 24 ] = { 0, 1, 1, 2, 2, 3, 3, 0, 4, 5, 5, 6, 6, 7, 7, 4, 0, 4, 1, 5, 2, 6, 3, 7 };
+
+    VertexBuffer::VertexPTNTC* vertices = AppendLineVertices( 24, depthTest, layer );
+
+    for (int i = 0; i < 24; ++i)
+    {
+        vertices[ i ].position = corners[ edges[ i ] ];
+        vertices[ i ].color = color;
+    }
+}
+
+void ae3d::System::DrawAABB( const Vec3& min, const Vec3& max, const Vec4& color, bool depthTest, unsigned layer )
+{
+    Vec3 corners[ 8 ];
+    GetBoxCorners( min, max, corners );
+    DrawBoxCorners( corners, color, depthTest, layer );
+}
+
+void ae3d::System::DrawAABB( const Vec3& min, const Vec3& max, const Matrix44& localToWorld, const Vec4& color, bool depthTest, unsigned layer )
+{
+    Vec3 localCorners[ 8 ];
+    GetBoxCorners( min, max, localCorners );
+
+    Vec3 corners[ 8 ];
+    Matrix44::TransformPoints( localCorners, 8, localToWorld, corners );
+    DrawBoxCorners( corners, color, depthTest, layer );
+}
+
+void ae3d::System::DrawSphere( const Vec3& center, float radius, const Vec4& color, bool depthTest, unsigned layer )
+{
+    constexpr int SegmentCount = 32;
+    const float step = 2 * 3.14159265358979f / SegmentCount;
+
+    for (int i = 0; i < SegmentCount; ++i)
+    {
+        const float c0 = std::cos( i * step ) * radius;
+        const float s0 = std::sin( i * step ) * radius;
+        const float c1 = std::cos( (i + 1) * step ) * radius;
+        const float s1 = std::sin( (i + 1) * step ) * radius;
+
+        DrawLine( center + Vec3( c0, s0, 0 ), center + Vec3( c1, s1, 0 ), color, depthTest, layer );
+        DrawLine( center + Vec3( c0, 0, s0 ), center + Vec3( c1, 0, s1 ), color, depthTest, layer );
+        DrawLine( center + Vec3( 0, c0, s0 ), center + Vec3( 0, c1, s1 ), color, depthTest, layer );
+    }
+}
+
+void ae3d::System::DrawFrustum( const Vec3& position, const Vec3& viewDirection, float fovDegrees, float aspect, float nearDepth, float farDepth, const Vec4& color, bool depthTest, unsigned layer )
+{
+    Frustum frustum;
+    frustum.SetProjection( fovDegrees, aspect, nearDepth, farDepth );
+    frustum.Update( position, viewDirection );
+
+    const Vec3 corners[ 8 ] =
+    {
+        frustum.NearBottomLeft(),
+        frustum.NearBottomRight(),
+        frustum.NearTopRight(),
+        frustum.NearTopLeft(),
+        frustum.FarBottomLeft(),
+        frustum.FarBottomRight(),
+        frustum.FarTopRight(),
+        frustum.FarTopLeft()
+    };
+
+    DrawBoxCorners( corners, color, depthTest, layer );
+}
+
 void ae3d::System::ReloadChangedAssets()
 {
     fileWatcher.Poll();
@@ -322,6 +624,55 @@ int ae3d::System::Statistics::GetBarrierCallCount()
     return ::Statistics::GetBarrierCalls();
 }
 
+void ae3d::System::Statistics::BeginProfilerCapture( int frameCount, const char* path )
+{
+    Profiler::BeginCapture( frameCount, path );
+}
+
+void ae3d::System::Statistics::SetHistoryLength( int frameCount )
+{
+    ::Statistics::SetHistoryLength( frameCount );
+}
+
+void ae3d::System::Statistics::GetHistorySummary( char* outStr, int outStrLength )
+{
+    if (outStrLength <= 0)
+    {
+        return;
+    }
+
+    int length = 0;
+    outStr[ 0 ] = '\0';
+
+    for (int metric = 0; metric < static_cast< int >( ::Statistics::Metric::Count ) && length < outStrLength; ++metric)
+    {
+        const ::Statistics::Summary summary = ::Statistics::GetHistorySummary( static_cast< ::Statistics::Metric >( metric ) );
+        const int written = std::snprintf( outStr + length, outStrLength - length, "%s: min %.3f, avg %.3f, p50 %.3f, p95 %.3f, p99 %.3f, max %.3f\n",
+                                           ::Statistics::GetMetricName( static_cast< ::Statistics::Metric >( metric ) ),
+                                           static_cast< double >( summary.min ), static_cast< double >( summary.avg ), static_cast< double >( summary.p50 ),
+                                           static_cast< double >( summary.p95 ), static_cast< double >( summary.p99 ), static_cast< double >( summary.max ) );
+        if (written < 0)
+        {
+            break;
+        }
+
+        length += written;
+    }
+}
+
+bool ae3d::System::Statistics::WriteHistory( const char* path )
+{
+    const std::string pathStr( path );
+    const bool isJson = pathStr.size() >= 5 && pathStr.compare( pathStr.size() - 5, 5, ".json" ) == 0;
+
+    return isJson ? ::Statistics::WriteHistoryJSON( path ) : ::Statistics::WriteHistoryCSV( path );
+}
+
+void ae3d::System::Statistics::SetHistoryPathAtExit( const char* path )
+{
+    SystemGlobal::historyPathAtExit = path != nullptr ? path : "";
+}
+
 int ae3d::System::Statistics::GetFenceCallCount()
 {
     return ::Statistics::GetFenceCalls();
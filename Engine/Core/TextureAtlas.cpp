@@ -0,0 +1,283 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "TextureAtlas.hpp"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include "stb_image.c"
+#include "FileSystem.hpp"
+#include "System.hpp"
+#include "Texture2D.hpp"
+
+// Horizontal segment of the packed area's top edge.
+struct SkylineNode
+{
+    int x;
+    int y;
+    int width;
+};
+
+struct ae3d::TextureAtlas::Page
+{
+    Texture2D texture;
+    std::vector< unsigned char > pixels;
+    // Sorted by x and covers the whole page width.
+    std::vector< SkylineNode > skyline;
+    // Rectangle that covers the images added since the last upload. Empty when dirtyRight <= dirtyLeft.
+    int dirtyLeft = 0;
+    int dirtyTop = 0;
+    int dirtyRight = 0;
+    int dirtyBottom = 0;
+    bool isUploaded = false;
+    bool isOpaque = true;
+};
+
+namespace
+{
+    // \return Top y-coordinate of a width x height rectangle placed at skyline[ index ].x, or -1 if it doesn't fit.
+    int GetSkylineFit( const std::vector< SkylineNode >& skyline, std::size_t index, int width, int height, int pageSize )
+    {
+        if (skyline[ index ].x + width > pageSize)
+        {
+            return -1;
+        }
+
+        int y = skyline[ index ].y;
+        int widthLeft = width;
+
+        while (widthLeft > 0 && index < skyline.size())
+        {
+            y = std::max( y, skyline[ index ].y );
+
+            if (y + height > pageSize)
+            {
+                return -1;
+            }
+
+            widthLeft -= skyline[ index ].width;
+            ++index;
+        }
+
+        return y;
+    }
+
+    // Finds the position that keeps the skyline lowest and raises the skyline over it.
+    bool Insert( std::vector< SkylineNode >& skyline, int width, int height, int pageSize, int& outX, int& outY )
+    {
+        std::size_t bestIndex = skyline.size();
+        int bestTop = pageSize + 1;
+        int bestWidth = pageSize + 1;
+
+        for (std::size_t i = 0; i < skyline.size(); ++i)
+        {
+            const int y = GetSkylineFit( skyline, i, width, height, pageSize );
+
+            if (y != -1 && (y + height < bestTop || (y + height == bestTop && skyline[ i ].width < bestWidth)))
+            {
+                bestIndex = i;
+                bestTop = y + height;
+                bestWidth = skyline[ i ].width;
+            }
+        }
+
+        if (bestIndex == skyline.size())
+        {
+            return false;
+        }
+
+        outX = skyline[ bestIndex ].x;
+        outY = bestTop - height;
+
+        const SkylineNode node = { outX, bestTop, width };
+        skyline.insert( skyline.begin() + static_cast< long >( bestIndex ), node );
+
+        // Shrinks or removes the nodes that are now under the new node.
+        for (std::size_t i = bestIndex + 1; i < skyline.size();)
+        {
+            const int previousEnd = skyline[ i - 1 ].x + skyline[ i - 1 ].width;
+
+            if (skyline[ i ].x >= previousEnd)
+            {
+                break;
+            }
+
+            const int shrink = previousEnd - skyline[ i ].x;
+            skyline[ i ].x += shrink;
+            skyline[ i ].width -= shrink;
+
+            if (skyline[ i ].width > 0)
+            {
+                break;
+            }
+
+            skyline.erase( skyline.begin() + static_cast< long >( i ) );
+        }
+
+        for (std::size_t i = 0; i + 1 < skyline.size();)
+        {
+            if (skyline[ i ].y == skyline[ i + 1 ].y)
+            {
+                skyline[ i ].width += skyline[ i + 1 ].width;
+                skyline.erase( skyline.begin() + static_cast< long >( i ) + 1 );
+            }
+            else
+            {
+                ++i;
+            }
+        }
+
+        return true;
+    }
+}
+
+ae3d::TextureAtlas::TextureAtlas( int aPageSize, int aPadding, ColorSpace aColorSpace )
+    : pageSize( aPageSize )
+    , padding( aPadding )
+    , colorSpace( aColorSpace )
+{
+}
+
+ae3d::TextureAtlas::~TextureAtlas()
+{
+}
+
+bool ae3d::TextureAtlas::Add( const FileSystem::FileContentsData& imageData, Region& outRegion )
+{
+    if (!imageData.isLoaded)
+    {
+        System::Print( "TextureAtlas: %s is not loaded\n", imageData.path.c_str() );
+        return false;
+    }
+
+    int width = 0;
+    int height = 0;
+    int components = 0;
+    unsigned char* data = stbi_load_from_memory( imageData.data.data(), static_cast< int >( imageData.data.size() ), &width, &height, &components, 4 );
+
+    if (data == nullptr)
+    {
+        const std::string reason( stbi_failure_reason() );
+        System::Print( "TextureAtlas: %s failed to load. stb_image's reason: %s\n", imageData.path.c_str(), reason.c_str() );
+        return false;
+    }
+
+    const bool result = Add( data, width, height, components == 3 || components == 1, outRegion );
+    stbi_image_free( data );
+
+    return result;
+}
+
+bool ae3d::TextureAtlas::Add( const unsigned char* rgbaPixels, int width, int height, bool isOpaque, Region& outRegion )
+{
+    if (width + padding > pageSize || height + padding > pageSize)
+    {
+        System::Print( "TextureAtlas: %dx%d image doesn't fit into a %dx%d page\n", width, height, pageSize, pageSize );
+        return false;
+    }
+
+    int x = 0;
+    int y = 0;
+    Page* page = nullptr;
+
+    for (auto& candidate : pages)
+    {
+        if (Insert( candidate->skyline, width + padding, height + padding, pageSize, x, y ))
+        {
+            page = candidate.get();
+            break;
+        }
+    }
+
+    if (page == nullptr)
+    {
+        pages.push_back( std::unique_ptr< Page >( new Page() ) );
+        page = pages.back().get();
+        page->pixels.resize( static_cast< std::size_t >( pageSize * pageSize * 4 ) );
+        page->skyline.push_back( SkylineNode{ 0, 0, pageSize } );
+        Insert( page->skyline, width + padding, height + padding, pageSize, x, y );
+    }
+
+    for (int row = 0; row < height; ++row)
+    {
+        std::memcpy( &page->pixels[ static_cast< std::size_t >( ((y + row) * pageSize + x) * 4 ) ], &rgbaPixels[ row * width * 4 ], static_cast< std::size_t >( width * 4 ) );
+    }
+
+    if (page->dirtyRight <= page->dirtyLeft)
+    {
+        page->dirtyLeft = x;
+        page->dirtyTop = y;
+        page->dirtyRight = x + width;
+        page->dirtyBottom = y + height;
+    }
+    else
+    {
+        page->dirtyLeft = std::min( page->dirtyLeft, x );
+        page->dirtyTop = std::min( page->dirtyTop, y );
+        page->dirtyRight = std::max( page->dirtyRight, x + width );
+        page->dirtyBottom = std::max( page->dirtyBottom, y + height );
+    }
+
+    page->isOpaque = page->isOpaque && isOpaque;
+    page->texture.opaque = page->isOpaque;
+
+    outRegion.page = &page->texture;
+    outRegion.scaleOffset = Vec4( width / static_cast< float >( pageSize ), height / static_cast< float >( pageSize ),
+                                  x / static_cast< float >( pageSize ), y / static_cast< float >( pageSize ) );
+    outRegion.width = width;
+    outRegion.height = height;
+
+    return true;
+}
+
+void ae3d::TextureAtlas::Upload()
+{
+    std::vector< unsigned char > regionPixels;
+
+    for (std::size_t pageIndex = 0; pageIndex < pages.size(); ++pageIndex)
+    {
+        Page& page = *pages[ pageIndex ];
+
+        if (page.dirtyRight <= page.dirtyLeft)
+        {
+            continue;
+        }
+
+        if (!page.isUploaded)
+        {
+            const std::string debugName = "atlas page " + std::to_string( pageIndex );
+            page.texture.colorSpace = colorSpace;
+            // Repeat would sample the opposite edge of the page for images at the border.
+            page.texture.wrap = TextureWrap::Clamp;
+            page.texture.LoadFromData( page.pixels.data(), pageSize, pageSize, debugName.c_str(), DataType::UByte );
+            page.isUploaded = true;
+        }
+        else
+        {
+            // Only the rectangle that covers the new images is sent, the rest of the page is already on the GPU.
+            const int regionWidth = page.dirtyRight - page.dirtyLeft;
+            const int regionHeight = page.dirtyBottom - page.dirtyTop;
+            regionPixels.resize( static_cast< std::size_t >( regionWidth * regionHeight * 4 ) );
+
+            for (int row = 0; row < regionHeight; ++row)
+            {
+                std::memcpy( &regionPixels[ static_cast< std::size_t >( row * regionWidth * 4 ) ],
+                             &page.pixels[ static_cast< std::size_t >( ((page.dirtyTop + row) * pageSize + page.dirtyLeft) * 4 ) ],
+                             static_cast< std::size_t >( regionWidth * 4 ) );
+            }
+
+            page.texture.UpdateRegion( regionPixels.data(), page.dirtyLeft, page.dirtyTop, regionWidth, regionHeight );
+        }
+
+        page.texture.opaque = page.isOpaque;
+        page.dirtyLeft = 0;
+        page.dirtyTop = 0;
+        page.dirtyRight = 0;
+        page.dirtyBottom = 0;
+    }
+}
+
+ae3d::Texture2D* ae3d::TextureAtlas::GetPage( int index )
+{
+    System::Assert( index >= 0 && index < GetPageCount(), "TextureAtlas: invalid page index" );
+    return &pages[ index ]->texture;
+}
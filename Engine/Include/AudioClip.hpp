@@ -11,6 +11,7 @@ namespace ae3d
     class AudioClip
     {
       public:
+        /// Long .ogg clips are streamed instead of decoded at load. \see IsStreaming
         /// \param clipData Clip data from .wav or .ogg file.
         void Load( const FileSystem::FileContentsData& clipData );
 
@@ -19,10 +20,14 @@ namespace ae3d
 
         /// \return Clip's length in seconds or 1 if the clip is not loaded.
         float LengthInSeconds() const { return length; }
+
+        /// \return True, if the clip is decoded during playback, because it would take over 1 MiB decoded. Not implemented on macOS/iOS.
+        bool IsStreaming() const { return isStreaming; }
         
       private:
         unsigned handle = 0;
         float length = 0;
+        bool isStreaming = false;
     };
 }
 
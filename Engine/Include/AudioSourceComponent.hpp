@@ -30,11 +30,12 @@ namespace ae3d
         /// \param enable True, if the clip will be looped when playing.
         void SetLooping( bool enable ) { isLooping = enable; }
         
-        /// Plays the clip.
-        void Play() const;
+        /// Plays the clip. Clips can overlap, so playing again while the clip is playing starts another instance.
+        void Play();
 
     private:
         friend class GameObject;
+        friend class Scene;
         
         /// \return Component's type code. Must be unique for each component type.
         static int Type() { return 3; }
@@ -47,6 +48,8 @@ namespace ae3d
         
         GameObject* gameObject = nullptr;
         unsigned clipId = 0;
+        /// Voice of the latest Play() call. Scene::Render() moves it with the game object.
+        unsigned voiceId = 0;
         bool is3D = false;
         bool isLooping = false;
         bool isEnabled = true;
@@ -17,6 +17,10 @@ namespace ae3d
         
         /// Clear flag.
         enum class ClearFlag { DepthAndColor, Depth, DontClear };
+
+        /// Light culling. Tiled culls lights per screen tile using the depth prepass. Clustered culls lights per screen tile and depth slice
+        /// on the CPU, so it doesn't need the depth prepass. Clustered is only implemented in Vulkan renderer, others use Tiled.
+        enum class LightCulling { Tiled, Clustered };
         
         /// \return GameObject that owns this component.
         class GameObject* GetGameObject() const { return gameObject; }
@@ -107,6 +111,12 @@ namespace ae3d
         
         /// \return Layer mask.
         unsigned GetLayerMask() const { return layerMask; }
+
+        /// \param culling Light culling. Defaults to Tiled.
+        void SetLightCulling( LightCulling culling ) { lightCulling = culling; }
+
+        /// \return Light culling.
+        LightCulling GetLightCulling() const { return lightCulling; }
         
         /// \return Clear flag.
         ClearFlag GetClearFlag() const { return clearFlag; }
@@ -183,6 +193,9 @@ namespace ae3d
         unsigned renderOrder = 0;
         ProjectionType projectionType = ProjectionType::Orthographic;
         ClearFlag clearFlag = ClearFlag::DepthAndColor;
+        LightCulling lightCulling = LightCulling::Tiled;
+        /// Cluster list set assigned this frame when using clustered culling, -1 if none.
+        int clusterSetIndex = -1;
         GameObject* gameObject = nullptr;
         int viewport[ 4 ];
         bool isEnabled = true;
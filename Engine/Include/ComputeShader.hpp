@@ -60,6 +60,11 @@ namespace ae3d
         /// \return PSO
         VkPipeline GetPSO() const { return pso; }
 
+        /// Sets a storage buffer for the next Dispatch(). Slot 0 is read-only and slot 1 is writable. Slots are unbound after Dispatch().
+        /// \param slot slot index. Range is 0-1.
+        /// \param buffer Buffer. Must have been created with VK_BUFFER_USAGE_STORAGE_BUFFER_BIT.
+        void SetBuffer( unsigned slot, VkBuffer buffer );
+
 #endif
         /// \param metalShaderName Vertex shader name for Metal renderer. Must be referenced by the application's Xcode project.
         /// \param dataHLSL HLSL shader file contents.
@@ -1,5 +1,9 @@
 #pragma once
 
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
 namespace ae3d
 {
     namespace FileSystem
@@ -19,10 +23,21 @@ namespace ae3d
           \param metaData BMFont metadata. Must be text or binary.
          */
         void LoadBMFont( class Texture2D* fontTex, const FileSystem::FileContentsData& metaData );
+
+        /**
+          \param pageTextures Font textures, one for each page in metadata. No outline support.
+          \param pageCount Number of pageTextures.
+          \param metaData BMFont metadata. Must be text or binary.
+         */
+        void LoadBMFont( Texture2D* const* pageTextures, int pageCount, const FileSystem::FileContentsData& metaData );
         
-        /** \return Font texture. */
-        Texture2D* GetTexture() { return texture; }
+        /** \return Font texture of the first page. */
+        Texture2D* GetTexture() { return textures[ 0 ]; }
+
+        /** \param page Page. \return Font texture of page or the first page's texture if page is invalid. */
+        Texture2D* GetTexture( int page ) { return page >= 0 && page < static_cast< int >( textures.size() ) ? textures[ page ] : textures[ 0 ]; }
         
+        /// \param text UTF-8 text.
         /// \return Text width.
         int TextWidth( const char* text ) const;
         
@@ -35,14 +50,22 @@ namespace ae3d
             float width = 0, height = 0;
             float xOffset = 0, yOffset = 0;
             float xAdvance = 0;
+            int page = 0;
+        };
+
+        /// Glyph's rectangle in text space and its texture coordinates.
+        struct GlyphQuad
+        {
+            float x0, y0, x1, y1;
+            float u0, v0, u1, v1;
+            int page;
         };
 
         /**
-         \param text Text.
-         \param color Color in range 0-1.
-         \param outVertexBuffer Vertex buffer created from text.
+         \param text UTF-8 text.
+         \param outQuads One quad for each character in text. Characters not in font get an empty quad.
          */
-        void CreateVertexBuffer( const char* text, const struct Vec4& color, class VertexBuffer& outVertexBuffer ) const;
+        void LayoutText( const char* text, std::vector< GlyphQuad >& outQuads ) const;
 
         /** \param metaData BMFont text metadata. */
         void LoadBMFontMetaText(const FileSystem::FileContentsData& metaData);
@@ -62,8 +85,22 @@ namespace ae3d
         /** The number of pixels from the absolute top of the line to the base of the characters. */
         int base = 32;
         
-        Character chars[ 256 ];
-        Texture2D* texture = nullptr;
+        /** \param id Unicode code point. \return Character or null if the font doesn't contain id. Latin-1 characters are never null. */
+        const Character* FindCharacter( unsigned id ) const;
+
+        /** \return Kerning between first and second code point. */
+        float GetKerning( unsigned first, unsigned second ) const;
+
+        /** Latin-1 characters, indexed by code point. Width 0 and xAdvance 0 if not in font. */
+        Character asciiChars[ 256 ];
+
+        /** Characters above Latin-1, by code point. */
+        std::unordered_map< unsigned, Character > chars;
+
+        /** Kerning amounts, by first code point in high and second in low 32 bits. */
+        std::unordered_map< std::uint64_t, float > kernings;
+
+        std::vector< Texture2D* > textures;
     };
 }
 
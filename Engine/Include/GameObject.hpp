@@ -4,6 +4,8 @@
 
 namespace ae3d
 {
+    class ParticleSystemComponent;
+
     /// GameObject is composed of components that define its behavior.
     class GameObject
     {
@@ -31,6 +33,7 @@ namespace ae3d
             {
                 if (components[ i ].type == T::Type())
                 {
+                    ReleaseComponent( GetComponent< T >() );
                     GetComponent< T >()->gameObject = nullptr;
                     components[ i ].handle = 0;
                     components[ i ].type = -1;
@@ -95,6 +98,12 @@ namespace ae3d
 
         unsigned GetNextComponentIndex();
 
+        /// Components that don't own GPU resources have nothing to release.
+        static void ReleaseComponent( const void* ) {}
+
+        /// Gives the particle system's range back to the particle buffer.
+        static void ReleaseComponent( ParticleSystemComponent* component );
+
         static const int MaxComponents = 10;
         unsigned nextFreeComponentIndex = 0;
         ComponentEntry components[ MaxComponents ];
@@ -4,6 +4,7 @@ namespace ae3d
 {
     /// Renders lines. Use this component to get proper depth testing relative to other objects in a scene.
     /// For debug visualization lines you can use System::DrawLines() which is simpler.
+    /// Scene::Render() queues enabled line renderers once per frame with the System::DrawLine() lines, on the game object's layer, so they are drawn into every camera whose layer mask contains it, except cube map cameras.
     class LineRendererComponent
     {
     public:
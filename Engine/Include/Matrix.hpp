@@ -64,7 +64,41 @@ namespace ae3d
          \param out dir * mat.
          */
         static void TransformDirection( const Vec3& dir, const Matrix44& mat, Vec3* out );
-        
+
+        /**
+         Multiplies many matrices with the same matrix. SSE3 and NEON builds keep b in registers for the whole array,
+         other builds call Multiply in a loop.
+
+         \param a First matrices.
+         \param b Second matrix.
+         \param count Number of matrices in a and out.
+         \param out a[ i ] * b. Can be the same array as a.
+         */
+        static void MultiplyMany( const Matrix44* a, const Matrix44& b, int count, Matrix44* out );
+
+        /**
+         Multiplies many points with a matrix. Points' missing w is treated as 1. SSE3 and NEON builds keep mat in registers
+         for the whole array, other builds call TransformPoint in a loop.
+
+         \param points Points.
+         \param count Number of points in points and outPoints.
+         \param mat Matrix.
+         \param outPoints points[ i ] * mat. Can be the same array as points.
+         */
+        static void TransformPoints( const Vec3* points, int count, const Matrix44& mat, Vec3* outPoints );
+
+        /**
+         Transforms an AABB and returns the AABB that encloses the result. Same result as transforming all 8 corners
+         with an affine matrix, but cheaper (Arvo's method: transform the center and sum the absolute extents).
+
+         \param aabbMin AABB min.
+         \param aabbMax AABB max.
+         \param mat Affine matrix.
+         \param outMin Transformed AABB min.
+         \param outMax Transformed AABB max.
+         */
+        static void TransformAABB( const Vec3& aabbMin, const Vec3& aabbMax, const Matrix44& mat, Vec3& outMin, Vec3& outMax );
+
         /** \brief Constructor. Inits to identity. */
         Matrix44() noexcept
         {
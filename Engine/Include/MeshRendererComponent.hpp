@@ -1,6 +1,9 @@
 #pragma once
 
+#include <vector>
 #include "Array.hpp"
+#include "Matrix.hpp"
+#include "Vec3.hpp"
 
 namespace ae3d
 {
@@ -40,17 +43,36 @@ namespace ae3d
         /// \return True, if bounding box should be drawn.
         bool IsBoundingBoxDrawingEnabled() const;
         
-        /// \param enable True, if AABB will be rendered. Defaults to false.
+        /// \param enable True, if AABB will be rendered. Defaults to false. Scene::Render() queues enabled AABBs with System::DrawAABB() on the game object's layer.
         void EnableBoundingBoxDrawing( bool enable );
         
-        /// \param frame Animation frame. If too high or low, repeats from the beginning using modulo.
-        void SetAnimationFrame( int frame ) { animFrame = frame; }
+        /// \param frame Animation frame. Fractional frames are interpolated. If too high or low, repeats from the beginning using modulo.
+        void SetAnimationFrame( float frame ) { animFrame = frame; }
+
+        /// \return True, if skinned submeshes are skinned once per frame before rendering.
+        bool IsSkinningPrePassEnabled() const { return isSkinningPrePassEnabled; }
+
+        /// Skinned submeshes are skinned once per frame by a compute shader into vertex buffers that depth, shadow and material passes share,
+        /// instead of skinning them in every pass. Materials of skinned submeshes must then use non-skinned shaders.
+        /// \param enable True, if skinned submeshes are skinned before rendering. Defaults to false.
+        void EnableSkinningPrePass( bool enable ) { isSkinningPrePassEnabled = enable; areSkinnedVerticesDirty = true; }
         
         /// \return True, if the mesh will be rendered as a wireframe.
         bool IsWireframe() const { return isWireframe; }
 
         /// \param enable True, if the mesh will be rendered as a wireframe.
         void EnableWireframe( bool enable ) { isWireframe = enable; }
+
+        /// \return World-space AABB min. Scene::Render() updates it once per frame.
+        const Vec3& GetWorldAABBMin() const { return aabbMinWorld; }
+
+        /// \return World-space AABB max. Scene::Render() updates it once per frame.
+        const Vec3& GetWorldAABBMax() const { return aabbMaxWorld; }
+
+        /// \param subMeshIndex Sub mesh index.
+        /// \param outMin World-space AABB min of the submesh.
+        /// \param outMax World-space AABB max of the submesh.
+        void GetSubMeshWorldAABB( unsigned subMeshIndex, Vec3& outMin, Vec3& outMax ) const;
         
     private:
         friend class GameObject;
@@ -67,13 +89,39 @@ namespace ae3d
         /// \return Component at index or null if index is invalid.
         static MeshRendererComponent* Get( unsigned index );
         
-        /// Applies skin
+        /// \return True, if a submesh has joints.
+        bool IsSkinned();
+
+        /// Evaluates joint matrices of all submeshes at the current animation frame, if the frame, mesh or joint count changed since the last call.
+        /// Scene::Render() calls this once per frame for every skinned mesh, so that all passes reuse the palette.
+        void UpdateSkinPalette();
+
+        /// Copies the skin palette into the bone buffer, if it isn't there already this frame. Must be called on the render thread.
+        void UploadSkinPalette();
+
+        /// Generates vertex buffers for skinned submeshes, if the skinning pre-pass is enabled. Must be called on the main thread.
+        void PrepareSkinnedVertexBuffers();
+
+        /// Records skinning dispatches into pre-skinned vertex buffers, if the palette changed since the last call. Must be called after UploadSkinPalette().
+        /// \param skinningShader Skinning compute shader. Must be between Begin() and End().
+        void SkinVertices( class ComputeShader& skinningShader );
+
+        /// \param subMeshIndex Submesh index
+        /// \return Pre-skinned vertex buffer of the submesh or null if the submesh isn't skinned by the pre-pass.
+        class VertexBuffer* GetSkinnedVertexBuffer( unsigned subMeshIndex );
+
+        /// Points the per-object uniforms to submesh's joint matrices in the bone buffer.
         /// \param subMeshIndex Submesh index
         void ApplySkin( unsigned subMeshIndex );
         
-        /// \param cameraFrustum cameraFrustum
+        /// Transforms mesh and submesh AABBs into world-space, if localToWorld or the mesh changed since the last call.
         /// \param localToWorld Local-to-World matrix
-        void Cull( const class Frustum& cameraFrustum, const struct Matrix44& localToWorld );
+        /// \return True, if the world-space AABB changed.
+        bool UpdateWorldAABB( const Matrix44& localToWorld );
+
+        /// Uses the world-space AABBs from the last UpdateWorldAABB() call.
+        /// \param cameraFrustum cameraFrustum
+        void Cull( const class Frustum& cameraFrustum );
         
         /// \param localToView Model-view matrix.
         /// \param localToClip Model-view-projection matrix.
@@ -84,20 +132,43 @@ namespace ae3d
         /// \param overrideSkinShader Override shader for skinned meshes. Used for shadow pass.
         /// \param overrideAlphaTestShader Override shader that does alpha testing. Used for shadow pass.
         /// \param renderType Renderer type.
-        void Render( const struct Matrix44& localToView, const Matrix44& localToClip, const Matrix44& localToWorld,
+        void Render( const Matrix44& localToView, const Matrix44& localToClip, const Matrix44& localToWorld,
                      const Matrix44& shadowView, const Matrix44& shadowProjection, class Shader* overrideShader,
                      Shader* overrideSkinShader, Shader* overrideAlphaTestShader, RenderType renderType );
 
         Mesh* mesh = nullptr;
         Array< Material* > materials;
         Array< bool > isSubMeshCulled;
+        Array< Vec3 > subMeshAabbMinWorld;
+        Array< Vec3 > subMeshAabbMaxWorld;
+        /// Local-to-World matrix and mesh AABB that aabbMinWorld and aabbMaxWorld were transformed from.
+        Matrix44 aabbLocalToWorld;
+        Vec3 aabbMinLocal;
+        Vec3 aabbMaxLocal;
+        Vec3 aabbMinWorld;
+        Vec3 aabbMaxWorld;
+        bool isWorldAabbDirty = true;
+        /// Joint matrices of all submeshes. Submesh's joints start at subMeshPaletteOffsets[ subMeshIndex ].
+        std::vector< Matrix44 > skinPalette;
+        std::vector< unsigned > subMeshPaletteOffsets;
+        /// Animation frame, mesh and total joint count that skinPalette was evaluated with.
+        float skinPaletteFrame = 0;
+        Mesh* skinPaletteMesh = nullptr;
+        unsigned skinPaletteJointCount = 0;
+        /// Bone buffer frame and offset that skinPalette was uploaded to.
+        unsigned skinPaletteBoneFrame = ~0u;
+        unsigned skinPaletteBoneOffset = 0;
+        bool isSkinPaletteValid = false;
+        /// Per-submesh index into pre-skinned vertex buffers or -1 if the submesh doesn't have one.
+        std::vector< int > skinnedVertexBufferIndices;
+        bool isSkinningPrePassEnabled = false;
+        bool areSkinnedVerticesDirty = false;
         GameObject* gameObject = nullptr;
-        int animFrame = 0;
+        float animFrame = 0;
         bool isCulled = false;
         bool isWireframe = false;
         bool isEnabled = true;
         bool castShadow = true;
         bool isAabbDrawingEnabled = false;
-        int aabbLineHandle = -1;
     };
 }
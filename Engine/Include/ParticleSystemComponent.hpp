@@ -9,8 +9,25 @@ namespace ae3d
         class GameObject* GetGameObject() const { return gameObject; }
 
         int GetMaxParticles() const { return maxParticles; }
+
+        /// \param count Size of the emitter's range in the shared particle buffer. Max 99999.
         void SetMaxParticles( int count );
 
+        /// \return Particles emitted per second.
+        float GetEmissionRate() const { return emissionRate; }
+
+        /// \param particlesPerSecond Particles emitted per second. 0 stops emitting and simulating.
+        void SetEmissionRate( float particlesPerSecond ) { emissionRate = particlesPerSecond > 0 ? particlesPerSecond : 0; }
+
+        /// \return Particle lifetime in seconds.
+        float GetLifeTime() const { return lifeTime; }
+
+        /// \param seconds Particle lifetime in seconds. A particle is re-emitted when its lifetime ends.
+        void SetLifeTime( float seconds ) { lifeTime = seconds > 0.001f ? seconds : 0.001f; }
+
+        /// \return Number of particles that are alive and simulated: emission rate times lifetime, clamped to max particles.
+        int GetLiveParticleCount() const;
+
         void GetColor( float& outR, float& outG, float& outB )
         {
             outR = red;
@@ -28,10 +45,27 @@ namespace ae3d
             blue = b;
         }
         
-        void Simulate( class ComputeShader& simulationShader );
-        void Cull( class ComputeShader& cullShader );
+        /// Adds this emitter's live particles to the next Simulate(). Allocates the emitter's particle range if needed.
+        /// \param localToWorld Emitter's transform.
+        void QueueSimulation( const struct Matrix44& localToWorld );
+
+        /**
+          Records one simulation dispatch for the live particles of all emitters queued by QueueSimulation() and clears the queue.
+          Emitters' parameters are read from the emitter buffer, so the dispatch doesn't need a constant buffer per emitter.
+          Call once per frame between simulationShader.Begin() and End(). Doesn't depend on the camera.
+
+          \param simulationShader Particle simulation shader.
+         */
+        static void Simulate( class ComputeShader& simulationShader );
+
+        /// Projects particles of all particle systems with the current viewToClip and bins them into screen tiles. Call once per camera.
+        /// \param cullShader Particle cull shader.
+        static void Cull( ComputeShader& cullShader );
 
-        void Draw( ComputeShader& drawShader, class RenderTexture& target );
+        /// Draws particles of all particle systems that were binned by the last Cull().
+        /// \param drawShader Particle draw shader.
+        /// \param target Render texture that particles are drawn into.
+        static void Draw( ComputeShader& drawShader, class RenderTexture& target );
 
         /// \return True, if enabled
         bool IsEnabled() const { return isEnabled; }
@@ -51,10 +85,14 @@ namespace ae3d
         /** \return Component at index or null if index is invalid. */
         static ParticleSystemComponent* Get( unsigned index );
 
-        static bool IsAnyAlive();
+        /** Gives the particle range back to the particle buffer. Called when the component is removed or its game object is destroyed. */
+        void ReleaseParticles();
 
         GameObject* gameObject = nullptr;
         int maxParticles = 1000;
+        int particleOffset = -1; // First particle in the particle buffer or -1 if the range is not allocated.
+        float emissionRate = 200;
+        float lifeTime = 5;
         float red = 1.0f;
         float green = 1.0f;
         float blue = 1.0f;
@@ -122,7 +122,8 @@ namespace ae3d
         VkFormat colorFormat = VK_FORMAT_B8G8R8A8_UNORM;
         VkRenderPass renderPass = VK_NULL_HANDLE;
         VkBuffer pixelBuffer = VK_NULL_HANDLE;
-        VkDeviceMemory pixelBufferMemory;
+        VkDeviceMemory pixelBufferMemory = VK_NULL_HANDLE;
+        VkDeviceSize pixelBufferMemoryOffset = 0;
 #endif
         int sampleCount = 1;
         DataType dataType = DataType::UByte;
@@ -58,16 +58,42 @@ namespace ae3d
         void RenderShadowsWithCamera( GameObject* cameraGo, int cubeMapFace );
         void RenderShadowMaps( std::vector< GameObject* >& cameras );
         void RenderRTCameras( std::vector< GameObject* >& rtCameras );
+        /// Simulates all particle systems with one dispatch. Called once per frame before cameras cull and draw particles.
+        void SimulateParticles();
         void RenderDepthAndNormalsForAllCameras( std::vector< GameObject* >& cameras );
         void RenderDepthAndNormals( class CameraComponent* camera, const struct Matrix44& view, std::vector< unsigned > gameObjectsWithMeshRenderer,
                                     int cubeMapFace, const class Frustum& frustum );
         void GenerateAABB();
+        /// Evaluates skin palettes of enabled skinned meshes, on persistent workers when there are many, and skins meshes that use the skinning pre-pass in one compute submission.
+        void UpdateSkinning();
+        /// Updates chunks of the skinned renderers of the current UpdateSkinning() call until none are left. Runs on the calling thread and on skinning workers.
+        static void UpdateSkinChunks();
+        /// Runs UpdateSkinChunks() once per UpdateSkinning() generation after seenGeneration, until the workers are stopped.
+        static void SkinningWorkerLoop( unsigned seenGeneration );
+        void GatherLights( unsigned layerMask );
+        void UpdateLightTiler( unsigned cameraLayerMask );
 
         std::vector< GameObject* > gameObjects;
         unsigned nextFreeGameObject = 0;
         TextureCube* skybox = nullptr;
         Vec3 aabbMin;
         Vec3 aabbMax;
+        /// Number of objects in aabbMin and aabbMax. When it changes, the AABB is rebuilt.
+        unsigned aabbObjectCount = 0;
+        /// Set when game objects are added or removed, so the AABB is rebuilt even if the object count didn't change.
+        bool isAABBDirty = true;
+        /// Game objects that have a line renderer or a mesh renderer with bounding box drawing enabled. Their lines are queued once per frame.
+        std::vector< GameObject* > debugLineObjects;
+        /// Value of SceneGlobal::debugLineSourceVersion when debugLineObjects was built.
+        unsigned debugLineObjectsVersion = 0;
+        /// Set when game objects are added or removed, so debugLineObjects is rebuilt.
+        bool isDebugLineObjectsDirty = true;
+        /// Layer mask of the lights currently in the light tiler. Valid if areLightsGathered is true.
+        unsigned gatheredLightMask = 0;
+        /// True after lights have been gathered this frame. A camera's layer mask can be 0, so gatheredLightMask can't be used for this.
+        bool areLightsGathered = false;
+        /// Union of enabled lights' layers, updated when all lights are gathered.
+        unsigned lightLayers = 0;
         Vec3 ambientColor = Vec3( 0.1f, 0.1f, 0.1f );
     };
 }
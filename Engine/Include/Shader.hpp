@@ -76,6 +76,13 @@ namespace ae3d
         ID3DBlob* blobShaderPixel = nullptr;
 #endif
 
+#if RENDERER_NULL
+        bool IsValid() const { return true; }
+
+        /// \return Handle that the null renderer's command log uses for this shader.
+        unsigned GetID() const { return id; }
+#endif
+
 #if RENDERER_METAL
         void LoadFromLibrary( const char* vertexShaderName, const char* fragmentShaderName );
         bool IsValid() const { return vertexProgram != nullptr; }
@@ -111,6 +118,9 @@ namespace ae3d
 #endif
 #if RENDERER_METAL
         std::string metalVertexShaderName;
+#endif
+#if RENDERER_NULL
+        unsigned id = 0;
 #endif
     };
 }
@@ -47,7 +47,7 @@ namespace ae3d
         /// \return Textual representation of component.
         std::string GetSerialized() const;
 
-        /// Removes all textures that were added using SetTexture.
+        /// Removes all textures that were added using SetTexture. Invalidates sprite handles.
         void Clear();
 
         /// \return Sprite info for index.
@@ -55,14 +55,41 @@ namespace ae3d
 
         /**
           Adds a texture to be rendered. The same texture can be added multiple
-          times.
+          times. Sprites with tint alpha below 1 or a non-opaque texture are rendered with alpha blending.
          
           \param texture Texture.
           \param position Position relative to the component's transform.
           \param dimensionPixels Dimension in pixels.
           \param tintColor Tint color in range 0-1.
+          \return Handle that can be used to update the sprite.
          */
-        void SetTexture( class TextureBase* texture, const struct Vec3& position, const Vec3& dimensionPixels, const struct Vec4& tintColor );
+        unsigned SetTexture( class TextureBase* texture, const struct Vec3& position, const Vec3& dimensionPixels, const struct Vec4& tintColor );
+
+        /**
+          Moves a sprite without rebuilding the batch.
+
+          \param handle Handle returned by SetTexture.
+          \param position Position relative to the component's transform.
+          \param dimensionPixels Dimension in pixels.
+         */
+        void SetSpritePosition( unsigned handle, const Vec3& position, const Vec3& dimensionPixels );
+
+        /**
+          Changes a sprite's tint without rebuilding the batch. If the tint's alpha changes whether the sprite is alpha blended,
+          the sprite moves between the opaque and the blended batch, which rebuilds both.
+
+          \param handle Handle returned by SetTexture.
+          \param tintColor Tint color in range 0-1.
+         */
+        void SetSpriteTint( unsigned handle, const Vec4& tintColor );
+
+        /**
+          Changes a sprite's texture coordinates without rebuilding the batch.
+
+          \param handle Handle returned by SetTexture.
+          \param scaleOffset UV scale in xy and offset in zw. Defaults to the texture's scale and offset.
+         */
+        void SetSpriteScaleOffset( unsigned handle, const Vec4& scaleOffset );
 
     private:
         friend class GameObject;
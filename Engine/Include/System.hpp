@@ -4,7 +4,7 @@
 #import <MetalKit/MetalKit.h>
 #endif
 
-#if !defined( RENDERER_D3D12 ) && !defined( RENDERER_VULKAN ) && !defined( RENDERER_METAL )
+#if !defined( RENDERER_D3D12 ) && !defined( RENDERER_VULKAN ) && !defined( RENDERER_METAL ) && !defined( RENDERER_NULL )
 #error No renderer defined
 #endif
 
@@ -127,9 +127,10 @@ namespace ae3d
         /// Inits the gamepad.
         void InitGamePad();
 
+        /// Begins a timer on the calling thread. Timers can be nested.
         void BeginTimer();
 
-        /// \return Time in ms since BeginTimer().
+        /// \return Time in ms since the matching BeginTimer() on the calling thread.
         float EndTimer();
         
         /// \return Seconds since application startup, including decimals.
@@ -168,7 +169,53 @@ namespace ae3d
         /// \param xScreenSize Window width in pixels.
         /// \param yScreenSize Window height in pixels.
         void DrawLines( int handle, const Matrix44& view, const Matrix44& projection, int xScreenSize, int yScreenSize );
-        
+
+        /// Queues a debug line for the current frame. Queued lines are drawn by Scene::Render() into every camera whose
+        /// layer mask contains the line's layer, except cube map cameras, and are cleared after it.
+        /// \param from Start point in world space.
+        /// \param to End point in world space.
+        /// \param color Color.
+        /// \param depthTest If false, the line is drawn over the scene.
+        /// \param layer Layer, like in GameObject::SetLayer().
+        void DrawLine( const Vec3& from, const Vec3& to, const Vec4& color, bool depthTest = true, unsigned layer = 1 );
+
+        /// Queues an axis-aligned box for the current frame. See DrawLine().
+        /// \param min Minimum corner in world space.
+        /// \param max Maximum corner in world space.
+        /// \param color Color.
+        /// \param depthTest If false, the box is drawn over the scene.
+        /// \param layer Layer, like in GameObject::SetLayer().
+        void DrawAABB( const Vec3& min, const Vec3& max, const Vec4& color, bool depthTest = true, unsigned layer = 1 );
+
+        /// Queues a box for the current frame. See DrawLine().
+        /// \param min Minimum corner in local space.
+        /// \param max Maximum corner in local space.
+        /// \param localToWorld Local-to-World matrix.
+        /// \param color Color.
+        /// \param depthTest If false, the box is drawn over the scene.
+        /// \param layer Layer, like in GameObject::SetLayer().
+        void DrawAABB( const Vec3& min, const Vec3& max, const Matrix44& localToWorld, const Vec4& color, bool depthTest = true, unsigned layer = 1 );
+
+        /// Queues a sphere as three axis-aligned circles for the current frame. See DrawLine().
+        /// \param center Center in world space.
+        /// \param radius Radius.
+        /// \param color Color.
+        /// \param depthTest If false, the sphere is drawn over the scene.
+        /// \param layer Layer, like in GameObject::SetLayer().
+        void DrawSphere( const Vec3& center, float radius, const Vec4& color, bool depthTest = true, unsigned layer = 1 );
+
+        /// Queues a perspective camera's view frustum for the current frame. See DrawLine().
+        /// \param position Camera's world position.
+        /// \param viewDirection Camera's view direction, as returned by TransformComponent::GetViewDirection().
+        /// \param fovDegrees Vertical field of view in degrees.
+        /// \param aspect Aspect ratio (width / height).
+        /// \param nearDepth Near clipping plane distance.
+        /// \param farDepth Far clipping plane distance.
+        /// \param color Color.
+        /// \param depthTest If false, the frustum is drawn over the scene.
+        /// \param layer Layer, like in GameObject::SetLayer().
+        void DrawFrustum( const Vec3& position, const Vec3& viewDirection, float fovDegrees, float aspect, float nearDepth, float farDepth, const Vec4& color, bool depthTest = true, unsigned layer = 1 );
+
         /// \param scX Scissor x.
         /// \param scY Scissor y.
         /// \param scWidth Scissor width.
@@ -223,6 +270,41 @@ namespace ae3d
         {
 			/// \param outStr Caller must allocate at least 512 bytes for the output.
             void GetStatistics( char* outStr );
+            /// Writes CPU and GPU times of passes and group markers from a few frames ago, one line per scope, nested scopes indented.
+            /// Only Vulkan times group markers. D3D12 writes GPU times of its depth-normals, light culler and shadow map passes, Metal writes an empty string.
+            /// \param outStr Output. Nothing is written if outStrLength is not positive.
+            /// \param outStrLength Size of outStr in bytes.
+            void GetPassTimings( char* outStr, int outStrLength );
+            /// Captures CPU profiler zones of all threads and writes them into a Chrome trace JSON file (chrome://tracing, Perfetto, Tracy's import-chrome).
+            /// \param frameCount Number of frames to capture, starting from the next frame.
+            /// \param path Output file path.
+            void BeginProfilerCapture( int frameCount, const char* path );
+            /// Sets the number of frames kept in the statistics history and clears it. Defaults to 600.
+            /// \param frameCount Frame count. 0 disables recording.
+            void SetHistoryLength( int frameCount );
+            /// Writes min, avg, p50, p95, p99 and max of every recorded metric, one line per metric.
+            /// \param outStr Output.
+            /// \param outStrLength Size of outStr in bytes.
+            void GetHistorySummary( char* outStr, int outStrLength );
+            /// Writes the statistics history. Paths ending in .json get summaries and samples as JSON, others get a CSV row per frame.
+            /// \param path Output file path.
+            /// \return True if the file could be written.
+            bool WriteHistory( const char* path );
+            /// Writes the statistics history in System::Deinit().
+            /// \param path Output file path, see WriteHistory(). nullptr disables writing.
+            void SetHistoryPathAtExit( const char* path );
+#if RENDERER_NULL
+            /// \return Number of commands the null renderer recorded before the latest Window::SwapBuffers(), including uploads made while loading.
+            int GetCommandCount();
+            /// \return Number of recorded state changes that set the state that was already bound.
+            int GetRedundantStateChangeCount();
+            /// \return Bytes uploaded into buffers and textures by the recorded commands.
+            unsigned long long GetUploadBytes();
+            /// Writes the recorded commands, one per line. The log doesn't contain pointers or timings, so logs of two runs can be diffed.
+            /// \param path Output file path.
+            /// \return True if the file could be written.
+            bool WriteCommandLog( const char* path );
+#endif
             int GetDrawCallCount();
             int GetShaderBindCount();
             int GetRenderTargetBindCount();
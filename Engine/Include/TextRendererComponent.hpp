@@ -46,7 +46,7 @@ namespace ae3d
         /// \return Text.
         const char* GetText() const;
         
-        /// \param text Text. Characters not in font are rendered empty.
+        /// \param text UTF-8 text. Characters not in font are rendered empty.
         void SetText( const char* text );
 
         /// \param shaderType Shader type.
@@ -73,6 +73,8 @@ namespace ae3d
         static void DestroyTextures();
 
     private:
+        friend class TextureAtlas;
+
         /// \param path Path.
         void LoadDDS( const char* path );
         
@@ -82,6 +84,17 @@ namespace ae3d
           \param textureData Texture data.
           */
         void LoadSTB( const FileSystem::FileContentsData& textureData );
+
+        /**
+          Replaces a rectangle of an RGBA8 texture created by LoadFromData. Used by TextureAtlas to upload only the changed part of a page.
+
+          \param rgbaPixels Pixels of the rectangle, 4 bytes per pixel, rows top to bottom.
+          \param x Left edge in pixels.
+          \param y Top edge in pixels.
+          \param regionWidth Width in pixels.
+          \param regionHeight Height in pixels.
+         */
+        void UpdateRegion( const void* rgbaPixels, int x, int y, int regionWidth, int regionHeight );
 #if RENDERER_METAL
         void LoadPVRv2( const char* path );
         void LoadPVRv3( const char* path );
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "TextureBase.hpp"
+
+namespace ae3d
+{
+    namespace FileSystem
+    {
+        struct FileContentsData;
+    }
+
+    /**
+      Packs images into shared atlas pages at runtime. Sprites that use the same page are drawn in one batch:
+      pass the region's page to SpriteRendererComponent::SetTexture and its scale and offset to SetSpriteScaleOffset.
+      Pages keep a CPU copy of their pixels, so images can be added after pages have been uploaded.
+     */
+    class TextureAtlas
+    {
+    public:
+        /// Location of an image in the atlas.
+        struct Region
+        {
+            /// Page that contains the image. Its contents are valid after Upload().
+            class Texture2D* page = nullptr;
+            /// Scale and offset of the image inside the page. x: scale x, y: scale y, z: offset x, w: offset y.
+            Vec4 scaleOffset;
+            /// Width in pixels.
+            int width = 0;
+            /// Height in pixels.
+            int height = 0;
+        };
+
+        /// \param pageSize Width and height of a page in pixels.
+        /// \param padding Empty pixels between images. Prevents bleeding from neighbours when filtering.
+        /// \param colorSpace Color space of pages.
+        explicit TextureAtlas( int pageSize = 2048, int padding = 1, ColorSpace colorSpace = ColorSpace::Linear );
+
+        /// Destructor.
+        ~TextureAtlas();
+
+        /**
+          Adds an image into the first page that has room for it. Creates a new page if none has.
+
+          \param imageData Image data. File format must be png, tga, jpg, bmp or gif.
+          \param outRegion Location of the image.
+          \return True if the image was loaded and is not larger than a page.
+         */
+        bool Add( const FileSystem::FileContentsData& imageData, Region& outRegion );
+
+        /**
+          Adds an image into the first page that has room for it. Creates a new page if none has.
+
+          \param rgbaPixels Pixels, 4 bytes per pixel, rows top to bottom.
+          \param width Width in pixels.
+          \param height Height in pixels.
+          \param isOpaque True if every pixel has alpha 255.
+          \param outRegion Location of the image.
+          \return True if the image is not larger than a page.
+         */
+        bool Add( const unsigned char* rgbaPixels, int width, int height, bool isOpaque, Region& outRegion );
+
+        /// Uploads pages that have changed since the last call. Call after adding a batch of images.
+        /// A page that is already uploaded only gets the rectangle that covers its new images.
+        void Upload();
+
+        /// \return Page count.
+        int GetPageCount() const { return static_cast< int >( pages.size() ); }
+
+        /// \param index Page index.
+        /// \return Page texture.
+        Texture2D* GetPage( int index );
+
+    private:
+        struct Page;
+
+        std::vector< std::unique_ptr< Page > > pages;
+        int pageSize;
+        int padding;
+        ColorSpace colorSpace;
+    };
+}
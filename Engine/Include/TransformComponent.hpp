@@ -99,6 +99,9 @@ namespace ae3d
 
         /// Updates local and global matrix.
         void UpdateLocalAndGlobalMatrix();
+
+        /// Updates local and local-to-world matrices of all transforms. Scene::Render() calls this every frame.
+        static void UpdateLocalMatrices();
         
     private:
         friend class GameObject;
@@ -113,9 +116,6 @@ namespace ae3d
         /// \return Component at index or null if index is invalid.
         static TransformComponent* Get( unsigned index );
 
-        /// Updates matrices.
-        static void UpdateLocalMatrices();
-
         void SolveLocalMatrix();
 
         Matrix44 localMatrix;
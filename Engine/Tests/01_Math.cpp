@@ -1,9 +1,12 @@
+#include <cmath>
 #include <iostream>
 #include <cassert>
+#include <vector>
 #include "Array.hpp"
 #include "Matrix.hpp"
 #include "Quaternion.hpp"
 #include "Vec3.hpp"
+#include "../Core/JointAnimation.hpp"
 
 using namespace ae3d;
 
@@ -398,6 +401,74 @@ bool TestArray4()
     return arr2[ 0 ] == 666;
 }
 
+// Like a 60-joint, 10-second clip sampled at 24 fps: most joints rotate smoothly, few translate, none scale.
+bool TestJointAnimation()
+{
+    const int jointCount = 60;
+    const int frameCount = 240;
+    const float maxTranslationError = 0.001f;
+    std::size_t matrixBytes = 0;
+    std::size_t keyBytes = 0;
+
+    for (int joint = 0; joint < jointCount; ++joint)
+    {
+        std::vector< Matrix44 > transforms( frameCount );
+
+        for (int frame = 0; frame < frameCount; ++frame)
+        {
+            const float angle = 30 * std::sin( frame * 0.05f + joint );
+            transforms[ frame ].MakeRotationXYZ( angle, angle * 0.5f, 10 );
+            transforms[ frame ].SetTranslation( Vec3( joint * 0.1f, joint % 4 == 0 ? std::sin( frame * 0.1f ) : 1.0f, 0 ) );
+        }
+
+        JointAnimation animation;
+        animation.Build( transforms.data(), frameCount, maxTranslationError );
+        matrixBytes += transforms.size() * sizeof( Matrix44 );
+        keyBytes += animation.GetKeySizeInBytes();
+
+        for (int frame = 0; frame < frameCount; ++frame)
+        {
+            Matrix44 sampled;
+            animation.Sample( (float)frame, sampled );
+
+            for (int i = 0; i < 16; ++i)
+            {
+                if (std::abs( sampled.m[ i ] - transforms[ frame ].m[ i ] ) > 0.005f)
+                {
+                    std::cerr << "JointAnimation: joint " << joint << ", frame " << frame << " differs from source!" << std::endl;
+                    return false;
+                }
+            }
+        }
+
+        // Sampling between frames must land between the frames and wrap around the end.
+        Matrix44 sampled;
+        animation.Sample( 10.5f, sampled );
+
+        if (std::abs( sampled.m[ 13 ] - (transforms[ 10 ].m[ 13 ] + transforms[ 11 ].m[ 13 ]) * 0.5f ) > 0.005f)
+        {
+            std::cerr << "JointAnimation: interpolation failed!" << std::endl;
+            return false;
+        }
+
+        animation.Sample( (float)frameCount + 3, sampled );
+
+        if (std::abs( sampled.m[ 13 ] - transforms[ 3 ].m[ 13 ] ) > 0.005f)
+        {
+            std::cerr << "JointAnimation: wrap-around failed!" << std::endl;
+            return false;
+        }
+    }
+
+    if (keyBytes * 10 > matrixBytes)
+    {
+        std::cerr << "JointAnimation: keys take " << keyBytes << " bytes, matrices " << matrixBytes << " bytes!" << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
 int main()
 {
     bool result = true;
@@ -412,6 +483,7 @@ int main()
     result &= TestArray2();
     result &= TestArray3();
     result &= TestArray4();
+    result &= TestJointAnimation();
 
     assert( result && "Math tests failed!" );
     
@@ -0,0 +1,712 @@
+// Headless benchmark for the CPU side of the frame pipeline. Doesn't create a window or a GPU device.
+// When built with RENDERER_NULL, also benchmarks rendering and deserialization with the null renderer,
+// mixing with the software audio mixer and writes the last frame's command log into benchmark_commands.txt.
+// Usage: 05_Benchmark [object count] [iterations]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <map>
+#include <string>
+#include <vector>
+#include "Array.hpp"
+#include "CameraComponent.hpp"
+#include "FileSystem.hpp"
+#include "Font.hpp"
+#include "Frustum.hpp"
+#include "GameObject.hpp"
+#include "Material.hpp"
+#include "Matrix.hpp"
+#include "Mesh.hpp"
+#include "MeshRendererComponent.hpp"
+#include "PointLightComponent.hpp"
+#include "Quaternion.hpp"
+#include "Scene.hpp"
+#include "Shader.hpp"
+#include "SpotLightComponent.hpp"
+#include "SpriteRendererComponent.hpp"
+#include "System.hpp"
+#include "TextRendererComponent.hpp"
+#include "Texture2D.hpp"
+#include "TextureAtlas.hpp"
+#include "TransformComponent.hpp"
+#include "Vec3.hpp"
+#include "Window.hpp"
+#if RENDERER_NULL
+#include "AudioSystem.hpp"
+#include "JointAnimation.hpp"
+#include "../Video/VertexBuffer.hpp"
+#endif
+
+using namespace ae3d;
+
+// Fixed seed so every run builds the same scenes.
+unsigned gRandomState = 1234567;
+
+float RandomFloat( float min, float max )
+{
+    gRandomState = gRandomState * 1664525u + 1013904223u;
+    return min + (max - min) * ((gRandomState >> 8) / 16777216.0f);
+}
+
+void RunBenchmark( const char* name, int objectCount, int iterations, const std::function< void() >& function )
+{
+    std::vector< double > timesMS( iterations );
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        timesMS[ i ] = std::chrono::duration< double, std::milli >( std::chrono::steady_clock::now() - start ).count();
+    }
+
+    std::sort( timesMS.begin(), timesMS.end() );
+    std::printf( "%-24s %8d %10.4f %10.4f %10.4f\n", name, objectCount, timesMS.front(), timesMS[ iterations / 2 ], timesMS.back() );
+}
+
+// Objects in a square grid on the XZ plane, random rotation and scale.
+void CreateGrid( std::vector< GameObject >& gameObjects, int count )
+{
+    gameObjects.resize( count );
+    const int side = (int)std::ceil( std::sqrt( (float)count ) );
+
+    for (int i = 0; i < count; ++i)
+    {
+        gameObjects[ i ].AddComponent< TransformComponent >();
+        gameObjects[ i ].AddComponent< MeshRendererComponent >();
+        TransformComponent* transform = gameObjects[ i ].GetComponent< TransformComponent >();
+        transform->SetLocalPosition( Vec3( (float)(i % side) * 4 - side * 2, 0, (float)(i / side) * 4 - side * 2 ) );
+        transform->SetLocalRotation( Quaternion::FromEuler( Vec3( 0, RandomFloat( 0, 360 ), 0 ) ) );
+        transform->SetLocalScale( RandomFloat( 0.5f, 2 ) );
+    }
+}
+
+// Chains of depth objects, each parented to the previous one.
+void CreateHierarchies( std::vector< GameObject >& gameObjects, int count, int depth )
+{
+    gameObjects.resize( count );
+
+    for (int i = 0; i < count; ++i)
+    {
+        gameObjects[ i ].AddComponent< TransformComponent >();
+        TransformComponent* transform = gameObjects[ i ].GetComponent< TransformComponent >();
+        transform->SetLocalPosition( Vec3( RandomFloat( -1, 1 ), 1, RandomFloat( -1, 1 ) ) );
+        transform->SetLocalRotation( Quaternion::FromEuler( Vec3( 0, RandomFloat( 0, 30 ), 0 ) ) );
+
+        if (i % depth != 0)
+        {
+            transform->SetParent( gameObjects[ i - 1 ].GetComponent< TransformComponent >() );
+        }
+    }
+}
+
+void CreateLights( std::vector< GameObject >& gameObjects, int count )
+{
+    gameObjects.resize( count );
+
+    for (int i = 0; i < count; ++i)
+    {
+        gameObjects[ i ].AddComponent< TransformComponent >();
+        gameObjects[ i ].GetComponent< TransformComponent >()->SetLocalPosition( Vec3( RandomFloat( -100, 100 ), RandomFloat( 0, 20 ), RandomFloat( -100, 100 ) ) );
+
+        if (i % 4 == 0)
+        {
+            gameObjects[ i ].AddComponent< SpotLightComponent >();
+            gameObjects[ i ].GetComponent< SpotLightComponent >()->SetRadius( RandomFloat( 2, 10 ) );
+            gameObjects[ i ].GetComponent< SpotLightComponent >()->SetColor( Vec3( 1, 1, 1 ) );
+        }
+        else
+        {
+            gameObjects[ i ].AddComponent< PointLightComponent >();
+            gameObjects[ i ].GetComponent< PointLightComponent >()->SetRadius( RandomFloat( 2, 10 ) );
+            gameObjects[ i ].GetComponent< PointLightComponent >()->SetColor( Vec3( RandomFloat( 0, 1 ), RandomFloat( 0, 1 ), RandomFloat( 0, 1 ) ) );
+        }
+    }
+}
+
+#if RENDERER_NULL
+template< typename T > void Append( std::vector< unsigned char >& data, const T& value )
+{
+    const unsigned char* bytes = reinterpret_cast< const unsigned char* >( &value );
+    data.insert( data.end(), bytes, bytes + sizeof( T ) );
+}
+
+template< typename T > void Append( std::vector< unsigned char >& data, const std::vector< T >& values )
+{
+    const unsigned char* bytes = reinterpret_cast< const unsigned char* >( values.data() );
+    data.insert( data.end(), bytes, bytes + values.size() * sizeof( T ) );
+}
+
+// .ae3d file with a skinned cube whose joints sway for 240 frames, like a character with a 10-second clip.
+FileSystem::FileContentsData CreateSkinnedMeshFile( int jointCount )
+{
+    const int frameCount = 240;
+    const Vec3 aabbMin( -1, -1, -1 );
+    const Vec3 aabbMax( 1, 1, 1 );
+
+    std::vector< VertexBuffer::VertexPTNTC_Skinned > vertices( 8 );
+
+    for (int v = 0; v < 8; ++v)
+    {
+        vertices[ v ].position = Vec3( (v & 1) ? 1.0f : -1.0f, (v & 2) ? 1.0f : -1.0f, (v & 4) ? 1.0f : -1.0f );
+        vertices[ v ].u = vertices[ v ].v = 0;
+        vertices[ v ].weights = Vec4( 1, 0, 0, 0 );
+
+        for (int b = 0; b < 4; ++b)
+        {
+            vertices[ v ].bones[ b ] = v % jointCount;
+        }
+    }
+
+    const std::vector< VertexBuffer::Face > faces = { { 0, 1, 3 }, { 0, 3, 2 }, { 4, 6, 7 }, { 4, 7, 5 }, { 0, 4, 5 }, { 0, 5, 1 },
+                                                      { 2, 3, 7 }, { 2, 7, 6 }, { 0, 2, 6 }, { 0, 6, 4 }, { 1, 5, 7 }, { 1, 7, 3 } };
+
+    FileSystem::FileContentsData file;
+    file.path = "skinned_cube.ae3d";
+    file.isLoaded = true;
+    std::vector< unsigned char >& data = file.data;
+
+    data.push_back( 'b' );
+    data.push_back( '0' );
+    Append( data, aabbMin );
+    Append( data, aabbMax );
+    Append( data, (uint16_t)1 );
+    Append( data, aabbMin );
+    Append( data, aabbMax );
+    Append( data, (uint16_t)0 );
+    Append( data, (uint16_t)vertices.size() );
+    Append( data, (uint8_t)2 );
+    Append( data, vertices );
+    Append( data, (uint16_t)faces.size() );
+    Append( data, faces );
+    Append( data, (uint16_t)jointCount );
+
+    std::vector< Matrix44 > transforms( frameCount );
+
+    for (int joint = 0; joint < jointCount; ++joint)
+    {
+        for (int frame = 0; frame < frameCount; ++frame)
+        {
+            const float angle = 20 * std::sin( frame * 0.05f + joint );
+            transforms[ frame ].MakeRotationXYZ( angle, 0, angle * 0.5f );
+            transforms[ frame ].SetTranslation( Vec3( 0, joint * 0.1f, 0 ) );
+        }
+
+        JointAnimation animation;
+        animation.Build( transforms.data(), frameCount, 0.0001f );
+
+        Append( data, Matrix44::identity );
+        Append( data, joint - 1 );
+        Append( data, 0 );
+        Append( data, animation.frameCount );
+        Append( data, animation.translationMin );
+        Append( data, animation.translationRange );
+        Append( data, animation.scaleMin );
+        Append( data, animation.scaleRange );
+        Append( data, (uint16_t)animation.rotationKeys.size() );
+        Append( data, animation.rotationKeys );
+        Append( data, (uint16_t)animation.translationKeys.size() );
+        Append( data, animation.translationKeys );
+        Append( data, (uint16_t)animation.scaleKeys.size() );
+        Append( data, animation.scaleKeys );
+    }
+
+    data.push_back( 100 );
+    return file;
+}
+
+// 16-bit mono .wav file with a one-second 440 Hz tone at 44.1 kHz, so the mixer resamples it.
+FileSystem::FileContentsData CreateWavFile()
+{
+    const uint32_t sampleRate = 44100;
+    std::vector< int16_t > samples( sampleRate );
+
+    for (std::size_t i = 0; i < samples.size(); ++i)
+    {
+        samples[ i ] = (int16_t)(std::sin( i * 2 * 3.14159265f * 440 / sampleRate ) * 16000);
+    }
+
+    const uint32_t dataSize = (uint32_t)(samples.size() * sizeof( int16_t ));
+
+    FileSystem::FileContentsData file;
+    file.path = "tone.wav";
+    file.isLoaded = true;
+    std::vector< unsigned char >& data = file.data;
+
+    data.insert( data.end(), { 'R', 'I', 'F', 'F' } );
+    Append( data, 36 + dataSize );
+    data.insert( data.end(), { 'W', 'A', 'V', 'E', 'f', 'm', 't', ' ' } );
+    Append( data, (uint32_t)16 );
+    Append( data, (uint16_t)1 );
+    Append( data, (uint16_t)1 );
+    Append( data, sampleRate );
+    Append( data, sampleRate * 2 );
+    Append( data, (uint16_t)2 );
+    Append( data, (uint16_t)16 );
+    data.insert( data.end(), { 'd', 'a', 't', 'a' } );
+    Append( data, dataSize );
+    Append( data, samples );
+    return file;
+}
+
+// BMFont text metadata with fixed-size glyphs for printable ASCII on page 0 and 256 CJK ideographs from U+4E00 on page 1.
+FileSystem::FileContentsData CreateFontFile()
+{
+    std::string meta = "info face=\"bench\" size=16 padding=0,0,0,0 spacing=1,1\ncommon lineHeight=20 base=16 scaleW=256 scaleH=256 pages=2\n"
+                       "page id=0 file=\"bench_0.png\"\npage id=1 file=\"bench_1.png\"\nchars count=351\n";
+
+    for (int id = 32; id < 127; ++id)
+    {
+        meta += "char id=" + std::to_string( id ) + " x=" + std::to_string( (id % 16) * 16 ) + " y=" + std::to_string( (id / 16) * 16 ) +
+                " width=10 height=16 xoffset=0 yoffset=0 xadvance=11 page=0 chnl=15\n";
+    }
+
+    for (int i = 0; i < 256; ++i)
+    {
+        meta += "char id=" + std::to_string( 0x4E00 + i ) + " x=" + std::to_string( (i % 16) * 16 ) + " y=" + std::to_string( (i / 16) * 16 ) +
+                " width=16 height=16 xoffset=0 yoffset=0 xadvance=17 page=1 chnl=15\n";
+    }
+
+    meta += "kernings count=1\nkerning first=83 second=99 amount=-1\n";
+
+    FileSystem::FileContentsData file;
+    file.path = "bench.fnt";
+    file.isLoaded = true;
+    file.data.assign( meta.begin(), meta.end() );
+    return file;
+}
+#endif
+
+int main( int argc, char* argv[] )
+{
+    const int objectCount = argc > 1 ? std::max( std::atoi( argv[ 1 ] ), 1 ) : 10000;
+    const int iterations = argc > 2 ? std::max( std::atoi( argv[ 2 ] ), 1 ) : 20;
+
+    std::printf( "%-24s %8s %10s %10s %10s\n", "benchmark", "objects", "min ms", "median ms", "max ms" );
+
+    std::vector< GameObject > grid;
+    CreateGrid( grid, objectCount );
+
+    RunBenchmark( "scene add", objectCount, iterations, [&]()
+    {
+        Scene scene;
+
+        for (auto& go : grid)
+        {
+            scene.Add( &go );
+        }
+    } );
+
+    // UpdateLocalMatrices() updates every transform that exists, so later benchmarks also update the grid.
+    RunBenchmark( "transform update grid", objectCount, iterations, []() { TransformComponent::UpdateLocalMatrices(); } );
+
+    Frustum frustum;
+    frustum.SetProjection( 45, 16.0f / 9.0f, 0.1f, 200 );
+    frustum.Update( Vec3( 0, 2, 0 ), Vec3( 0, 0, 1 ) );
+    int checksum = 0;
+
+    RunBenchmark( "frustum cull grid", objectCount, iterations, [&]()
+    {
+        for (auto& go : grid)
+        {
+            const Matrix44& localToWorld = go.GetComponent< TransformComponent >()->GetLocalToWorldMatrix();
+
+            Vec3 aabbMin, aabbMax;
+            Matrix44::TransformAABB( Vec3( -1, -1, -1 ), Vec3( 1, 1, 1 ), localToWorld, aabbMin, aabbMax );
+
+            checksum += frustum.BoxInFrustum( aabbMin, aabbMax ) ? 1 : 0;
+        }
+    } );
+
+    RunBenchmark( "scene serialize grid", objectCount, iterations, [&]()
+    {
+        Scene scene;
+
+        for (auto& go : grid)
+        {
+            scene.Add( &go );
+        }
+
+        const std::string serialized = scene.GetSerialized();
+        checksum += serialized.empty() ? 0 : 1;
+    } );
+
+    const int hierarchyDepth = 32;
+    std::vector< GameObject > hierarchies;
+    CreateHierarchies( hierarchies, objectCount, hierarchyDepth );
+    RunBenchmark( "transform update deep", objectCount * 2, iterations, []() { TransformComponent::UpdateLocalMatrices(); } );
+
+    const int lightCount = std::max( objectCount / 10, 1 );
+    std::vector< GameObject > lights;
+    CreateLights( lights, lightCount );
+
+    RunBenchmark( "scene serialize lights", lightCount, iterations, [&]()
+    {
+        Scene scene;
+
+        for (auto& go : lights)
+        {
+            scene.Add( &go );
+        }
+
+        const std::string serialized = scene.GetSerialized();
+        checksum += serialized.empty() ? 0 : 1;
+    } );
+
+#if RENDERER_NULL
+    const int width = 640;
+    const int height = 480;
+    Window::Create( width, height, WindowCreateFlags::Empty );
+    System::LoadBuiltinAssets();
+
+    GameObject camera;
+    camera.AddComponent< CameraComponent >();
+    camera.GetComponent< CameraComponent >()->SetProjectionType( CameraComponent::ProjectionType::Perspective );
+    camera.GetComponent< CameraComponent >()->SetProjection( 45, (float)width / (float)height, 0.1f, 200 );
+    camera.GetComponent< CameraComponent >()->SetClearFlag( CameraComponent::ClearFlag::DepthAndColor );
+    camera.AddComponent< TransformComponent >();
+    camera.GetComponent< TransformComponent >()->LookAt( { 0, 2, 0 }, { 0, 2, 1 }, { 0, 1, 0 } );
+
+    // Mesh data that isn't loaded generates the default cube.
+    Mesh cubeMesh;
+    cubeMesh.Load( FileSystem::FileContentsData() );
+
+    Shader shader;
+    shader.Load( "", "" );
+    Material material;
+    material.SetShader( &shader );
+    material.SetTexture( Texture2D::GetDefaultTexture(), 0 );
+
+    for (auto& go : grid)
+    {
+        go.GetComponent< MeshRendererComponent >()->SetMesh( &cubeMesh );
+        go.GetComponent< MeshRendererComponent >()->SetMaterial( &material, 0 );
+    }
+
+    Scene renderScene;
+    renderScene.Add( &camera );
+
+    for (auto& go : grid)
+    {
+        renderScene.Add( &go );
+    }
+
+    for (auto& go : lights)
+    {
+        renderScene.Add( &go );
+    }
+
+    RunBenchmark( "scene render grid", objectCount, iterations, [&]()
+    {
+        renderScene.Render();
+        renderScene.EndFrame();
+        Window::SwapBuffers();
+    } );
+
+    std::printf( "commands: %d, redundant state changes: %d, uploaded bytes: %llu\n", System::Statistics::GetCommandCount(),
+                 System::Statistics::GetRedundantStateChangeCount(), System::Statistics::GetUploadBytes() );
+    System::Statistics::WriteCommandLog( "benchmark_commands.txt" );
+
+    // Editor view with every bounding box visible. Boxes are batched into one line draw.
+    for (auto& go : grid)
+    {
+        go.GetComponent< MeshRendererComponent >()->EnableBoundingBoxDrawing( true );
+    }
+
+    RunBenchmark( "scene render grid aabbs", objectCount, iterations, [&]()
+    {
+        renderScene.Render();
+        renderScene.EndFrame();
+        Window::SwapBuffers();
+    } );
+
+    std::printf( "grid aabbs: draw calls: %d\n", System::Statistics::GetDrawCallCount() );
+
+    for (auto& go : grid)
+    {
+        go.GetComponent< MeshRendererComponent >()->EnableBoundingBoxDrawing( false );
+    }
+
+    // Skinned characters in front of the camera, each at a different animation frame.
+    const int crowdCount = 200;
+    Mesh skinnedMesh;
+    checksum += skinnedMesh.Load( CreateSkinnedMeshFile( 60 ) ) == Mesh::LoadResult::Success ? 1 : 0;
+
+    std::vector< GameObject > crowd;
+    CreateGrid( crowd, crowdCount );
+    Scene crowdScene;
+    crowdScene.Add( &camera );
+
+    for (auto& go : crowd)
+    {
+        go.GetComponent< MeshRendererComponent >()->SetMesh( &skinnedMesh );
+        go.GetComponent< MeshRendererComponent >()->SetMaterial( &material, 0 );
+        Vec3 position = go.GetComponent< TransformComponent >()->GetLocalPosition();
+        go.GetComponent< TransformComponent >()->SetLocalPosition( Vec3( position.x * 0.2f, 2, std::abs( position.z ) * 0.2f + 5 ) );
+        crowdScene.Add( &go );
+    }
+
+    for (auto& go : lights)
+    {
+        crowdScene.Add( &go );
+    }
+
+    float animationFrame = 0;
+
+    RunBenchmark( "scene render crowd", crowdCount, iterations, [&]()
+    {
+        animationFrame += 0.4f;
+
+        for (std::size_t i = 0; i < crowd.size(); ++i)
+        {
+            crowd[ i ].GetComponent< MeshRendererComponent >()->SetAnimationFrame( animationFrame + i );
+        }
+
+        crowdScene.Render();
+        crowdScene.EndFrame();
+        Window::SwapBuffers();
+    } );
+
+    for (auto& go : crowd)
+    {
+        go.GetComponent< MeshRendererComponent >()->EnableSkinningPrePass( true );
+    }
+
+    RunBenchmark( "crowd pre-skinned", crowdCount, iterations, [&]()
+    {
+        animationFrame += 0.4f;
+
+        for (std::size_t i = 0; i < crowd.size(); ++i)
+        {
+            crowd[ i ].GetComponent< MeshRendererComponent >()->SetAnimationFrame( animationFrame + i );
+        }
+
+        crowdScene.Render();
+        crowdScene.EndFrame();
+        Window::SwapBuffers();
+    } );
+
+    // Sprites that all move every frame. There are more than fit into one 16-bit indexed batch.
+    const int spriteCount = 20000;
+    GameObject spriteCamera;
+    spriteCamera.AddComponent< CameraComponent >();
+    spriteCamera.GetComponent< CameraComponent >()->SetProjection( 0, (float)width, (float)height, 0, 0, 1 );
+    spriteCamera.GetComponent< CameraComponent >()->SetClearFlag( CameraComponent::ClearFlag::DepthAndColor );
+    spriteCamera.AddComponent< TransformComponent >();
+
+    GameObject spriteContainer;
+    spriteContainer.AddComponent< SpriteRendererComponent >();
+    spriteContainer.AddComponent< TransformComponent >();
+    std::vector< unsigned > spriteHandles( spriteCount );
+
+    for (auto& handle : spriteHandles)
+    {
+        handle = spriteContainer.GetComponent< SpriteRendererComponent >()->SetTexture( Texture2D::GetDefaultTexture(), Vec3( RandomFloat( 0, width ), RandomFloat( 0, height ), -0.5f ),
+                                                                                         Vec3( 16, 16, 1 ), Vec4( 1, 1, 1, 1 ) );
+    }
+
+    Scene spriteScene;
+    spriteScene.Add( &spriteCamera );
+    spriteScene.Add( &spriteContainer );
+    float spriteOffset = 0;
+
+    RunBenchmark( "sprite move", spriteCount, iterations, [&]()
+    {
+        spriteOffset += 1;
+
+        for (int i = 0; i < spriteCount; ++i)
+        {
+            spriteContainer.GetComponent< SpriteRendererComponent >()->SetSpritePosition( spriteHandles[ i ], Vec3( std::fmod( i * 7 + spriteOffset, (float)width ), (float)(i % height), -0.5f ), Vec3( 16, 16, 1 ) );
+        }
+
+        spriteScene.Render();
+        spriteScene.EndFrame();
+        Window::SwapBuffers();
+    } );
+
+    // UI icons of different sizes packed into atlas pages, so their sprites batch into one draw per page.
+    const int iconCount = 800;
+    std::vector< unsigned char > iconPixels( 64 * 64 * 4, 255 );
+    std::vector< TextureAtlas::Region > iconRegions( iconCount );
+
+    RunBenchmark( "atlas pack icons", iconCount, iterations, [&]()
+    {
+        TextureAtlas atlas( 1024, 1 );
+
+        for (int i = 0; i < iconCount; ++i)
+        {
+            atlas.Add( iconPixels.data(), 16 + i % 49, 16 + (i * 7) % 49, true, iconRegions[ i ] );
+        }
+
+        checksum += atlas.GetPageCount();
+    } );
+
+    TextureAtlas iconAtlas( 1024, 1 );
+
+    for (int i = 0; i < iconCount; ++i)
+    {
+        iconAtlas.Add( iconPixels.data(), 16 + i % 49, 16 + (i * 7) % 49, true, iconRegions[ i ] );
+    }
+
+    iconAtlas.Upload();
+
+    GameObject iconContainer;
+    iconContainer.AddComponent< SpriteRendererComponent >();
+    iconContainer.AddComponent< TransformComponent >();
+
+    for (int i = 0; i < iconCount; ++i)
+    {
+        const TextureAtlas::Region& region = iconRegions[ i ];
+        const unsigned handle = iconContainer.GetComponent< SpriteRendererComponent >()->SetTexture( region.page, Vec3( (float)(i % 40) * 16, (float)(i / 40) * 24, -0.5f ),
+                                                                                                      Vec3( (float)region.width, (float)region.height, 1 ), Vec4( 1, 1, 1, 1 ) );
+        iconContainer.GetComponent< SpriteRendererComponent >()->SetSpriteScaleOffset( handle, region.scaleOffset );
+    }
+
+    Scene iconScene;
+    iconScene.Add( &spriteCamera );
+    iconScene.Add( &iconContainer );
+    iconScene.Render();
+    iconScene.EndFrame();
+    Window::SwapBuffers();
+    std::printf( "atlas icons: %d pages, %d draw calls\n", iconAtlas.GetPageCount(), System::Statistics::GetDrawCallCount() );
+
+    // HUD with numeric labels that all change every frame.
+    const int labelCount = 200;
+    Font font;
+    Texture2D* fontPages[] = { Texture2D::GetDefaultTexture(), Texture2D::GetDefaultTexture() };
+    font.LoadBMFont( fontPages, 2, CreateFontFile() );
+    std::vector< GameObject > labels( labelCount );
+    Scene labelScene;
+    labelScene.Add( &spriteCamera );
+
+    for (int i = 0; i < labelCount; ++i)
+    {
+        labels[ i ].AddComponent< TextRendererComponent >();
+        labels[ i ].GetComponent< TextRendererComponent >()->SetFont( &font );
+        labels[ i ].AddComponent< TransformComponent >();
+        labels[ i ].GetComponent< TransformComponent >()->SetLocalPosition( Vec3( (float)(i % 10) * 64, (float)(i / 10) * 20, 0 ) );
+        labelScene.Add( &labels[ i ] );
+    }
+
+    int score = 0;
+
+    RunBenchmark( "text labels", labelCount, iterations, [&]()
+    {
+        score += 7;
+
+        for (int i = 0; i < labelCount; ++i)
+        {
+            labels[ i ].GetComponent< TextRendererComponent >()->SetText( ("Score: " + std::to_string( score + i )).c_str() );
+        }
+
+        labelScene.Render();
+        labelScene.EndFrame();
+        Window::SwapBuffers();
+    } );
+
+    std::printf( "text labels: uploaded bytes: %llu\n", System::Statistics::GetUploadBytes() );
+
+    // Same labels with ideographs from the second font page. "\xE4\xB8\x80" is U+4E00.
+    RunBenchmark( "text labels utf-8", labelCount, iterations, [&]()
+    {
+        score += 7;
+
+        for (int i = 0; i < labelCount; ++i)
+        {
+            labels[ i ].GetComponent< TextRendererComponent >()->SetText( ("\xE4\xB8\x80\xE4\xB8\x81: " + std::to_string( score + i )).c_str() );
+        }
+
+        labelScene.Render();
+        labelScene.EndFrame();
+        Window::SwapBuffers();
+    } );
+
+    std::printf( "text labels utf-8: draw calls: %d\n", System::Statistics::GetDrawCallCount() );
+
+    // Dialog text revealed one character per frame, so labels grow within their buffer's capacity most frames.
+    const std::string dialog( "The quick brown fox jumps over the lazy dog." );
+    int revealFrame = 0;
+
+    RunBenchmark( "text labels typewriter", labelCount, iterations, [&]()
+    {
+        ++revealFrame;
+
+        for (int i = 0; i < labelCount; ++i)
+        {
+            labels[ i ].GetComponent< TextRendererComponent >()->SetText( dialog.substr( 0, 1 + (revealFrame + i) % dialog.size() ).c_str() );
+        }
+
+        labelScene.Render();
+        labelScene.EndFrame();
+        Window::SwapBuffers();
+    } );
+
+    std::printf( "text labels typewriter: uploaded bytes: %llu\n", System::Statistics::GetUploadBytes() );
+
+    // Offline mixing of looping 3D voices around the listener. Divide the time by the voice count for the cost per voice.
+    System::InitAudio();
+    AudioSystem::SetOfflineRendering( true );
+    const unsigned toneClip = AudioSystem::GetClipIdForData( CreateWavFile() );
+    const int voiceCount = 32;
+
+    for (int i = 0; i < voiceCount; ++i)
+    {
+        AudioSystem::Play( toneClip, true, true, RandomFloat( -20, 20 ), 0, RandomFloat( -20, 20 ) );
+    }
+
+    std::vector< float > mixBus( AudioSystem::OutputSampleRate / 10 * 2 );
+
+    RunBenchmark( "audio mix 100 ms", voiceCount, iterations, [&]()
+    {
+        AudioSystem::Mix( mixBus.data(), (int)mixBus.size() / 2 );
+        checksum += *std::max_element( mixBus.begin(), mixBus.end() ) > 0 ? 1 : 0;
+    } );
+
+    // Lights don't reference mesh or shader files that would be loaded from disk.
+    FileSystem::FileContentsData serializedLights;
+    {
+        Scene scene;
+
+        for (auto& go : lights)
+        {
+            scene.Add( &go );
+        }
+
+        const std::string serialized = scene.GetSerialized();
+        serializedLights.data.assign( serialized.begin(), serialized.end() );
+        serializedLights.isLoaded = true;
+        serializedLights.path = "lights.scene";
+    }
+
+    RunBenchmark( "scene deserialize lights", lightCount, iterations, [&]()
+    {
+        Scene scene;
+        std::vector< GameObject > gameObjects;
+        std::map< std::string, Texture2D* > textures;
+        std::map< std::string, Material* > materials;
+        Array< Mesh* > meshes;
+        checksum += scene.Deserialize( serializedLights, gameObjects, textures, materials, meshes ) == Scene::DeserializeResult::Success ? 1 : 0;
+
+        for (auto& texture : textures)
+        {
+            delete texture.second;
+        }
+
+        for (auto& mat : materials)
+        {
+            delete mat.second;
+        }
+
+        for (unsigned i = 0; i < meshes.count; ++i)
+        {
+            delete meshes[ i ];
+        }
+    } );
+#endif
+
+    std::printf( "checksum: %d\n", checksum );
+
+    return 0;
+}
@@ -0,0 +1,609 @@
+// Microbenchmark for Matrix44 operations. Build once per implementation (scalar, SIMD_SSE3 with MatrixSSE3.cpp,
+// SIMD_NEON with MatrixNEON.cpp) and compare the printed ns/op. Every operation is first checked against the scalar
+// reference in this file, so a SIMD path that drifts from it fails the run.
+// Array functions (MultiplyMany, TransformPoints) are timed with one element per call in the single column.
+// Usage: 06_MathBenchmark [batch size] [iterations]
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <vector>
+#include "Matrix.hpp"
+#include "Vec3.hpp"
+
+using namespace ae3d;
+
+#if SIMD_SSE3
+const char* implementationName = "SSE3";
+#elif SIMD_NEON || (RENDERER_METAL && !(__i386__))
+const char* implementationName = "NEON";
+#else
+const char* implementationName = "scalar";
+#endif
+
+// Relative tolerance, because SIMD paths can reorder additions.
+const float tolerance = 0.0001f;
+
+// Fixed seed so every run uses the same inputs.
+unsigned gRandomState = 1234567;
+
+// Written by every benchmark so the compiler can't remove the timed loops.
+float gSink = 0;
+
+float RandomFloat( float min, float max )
+{
+    gRandomState = gRandomState * 1664525u + 1013904223u;
+    return min + (max - min) * ((gRandomState >> 8) / 16777216.0f);
+}
+
+bool IsAlmost( float reference, float value )
+{
+    return std::abs( reference - value ) <= tolerance * std::max( 1.0f, std::abs( reference ) );
+}
+
+bool IsAlmost( const float* reference, const float* values, int count )
+{
+    for (int i = 0; i < count; ++i)
+    {
+        if (!IsAlmost( reference[ i ], values[ i ] ))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Rotation, scale and translation, like transforms in a scene. Well-conditioned so that inverses are stable.
+Matrix44 RandomMatrix()
+{
+    Matrix44 matrix;
+    matrix.MakeRotationXYZ( RandomFloat( 0, 360 ), RandomFloat( 0, 360 ), RandomFloat( 0, 360 ) );
+    matrix.Scale( RandomFloat( 0.5f, 2 ), RandomFloat( 0.5f, 2 ), RandomFloat( 0.5f, 2 ) );
+    matrix.SetTranslation( Vec3( RandomFloat( -100, 100 ), RandomFloat( -100, 100 ), RandomFloat( -100, 100 ) ) );
+    return matrix;
+}
+
+namespace Reference
+{
+    void Multiply( const Matrix44& a, const Matrix44& b, Matrix44& out )
+    {
+        for (int i = 0; i < 4; ++i)
+        {
+            for (int j = 0; j < 4; ++j)
+            {
+                out.m[ i * 4 + j ] = a.m[ i * 4 + 0 ] * b.m[ 0 * 4 + j ] + a.m[ i * 4 + 1 ] * b.m[ 1 * 4 + j ] +
+                                     a.m[ i * 4 + 2 ] * b.m[ 2 * 4 + j ] + a.m[ i * 4 + 3 ] * b.m[ 3 * 4 + j ];
+            }
+        }
+    }
+
+    void TransformPoint( const Vec4& vec, const Matrix44& mat, Vec4* out )
+    {
+        out->x = mat.m[ 0 ] * vec.x + mat.m[ 4 ] * vec.y + mat.m[  8 ] * vec.z + mat.m[ 12 ] * vec.w;
+        out->y = mat.m[ 1 ] * vec.x + mat.m[ 5 ] * vec.y + mat.m[  9 ] * vec.z + mat.m[ 13 ] * vec.w;
+        out->z = mat.m[ 2 ] * vec.x + mat.m[ 6 ] * vec.y + mat.m[ 10 ] * vec.z + mat.m[ 14 ] * vec.w;
+        out->w = mat.m[ 3 ] * vec.x + mat.m[ 7 ] * vec.y + mat.m[ 11 ] * vec.z + mat.m[ 15 ] * vec.w;
+    }
+
+    void TransformPoint( const Vec3& vec, const Matrix44& mat, Vec3* out )
+    {
+        Vec4 result;
+        TransformPoint( Vec4( vec.x, vec.y, vec.z, 1 ), mat, &result );
+        *out = Vec3( result.x, result.y, result.z );
+    }
+
+    void TransformDirection( const Vec3& dir, const Matrix44& mat, Vec3* out )
+    {
+        Vec4 result;
+        TransformPoint( Vec4( dir.x, dir.y, dir.z, 0 ), mat, &result );
+        *out = Vec3( result.x, result.y, result.z );
+    }
+
+    // Transforms all 8 corners.
+    void TransformAABB( const Vec3& aabbMin, const Vec3& aabbMax, const Matrix44& mat, Vec3& outMin, Vec3& outMax )
+    {
+        outMin = Vec3( 1e30f, 1e30f, 1e30f );
+        outMax = Vec3( -1e30f, -1e30f, -1e30f );
+
+        for (int corner = 0; corner < 8; ++corner)
+        {
+            const Vec3 point( (corner & 1) ? aabbMax.x : aabbMin.x, (corner & 2) ? aabbMax.y : aabbMin.y, (corner & 4) ? aabbMax.z : aabbMin.z );
+            Vec3 transformed;
+            TransformPoint( point, mat, &transformed );
+            outMin = Vec3::Min2( outMin, transformed );
+            outMax = Vec3::Max2( outMax, transformed );
+        }
+    }
+
+    void Transpose( const Matrix44& matrix, Matrix44& out )
+    {
+        for (int row = 0; row < 4; ++row)
+        {
+            for (int column = 0; column < 4; ++column)
+            {
+                out.m[ column * 4 + row ] = matrix.m[ row * 4 + column ];
+            }
+        }
+    }
+}
+
+struct BenchmarkResult
+{
+    double singleNs;
+    double batchNs;
+    bool isCorrect;
+};
+
+// Minimum time over iterations in nanoseconds per call of function, which is called opCount times per iteration.
+double MeasureNsPerOp( int iterations, int opCount, const std::function< void() >& function )
+{
+    double minNs = 1e30;
+
+    for (int i = 0; i < iterations; ++i)
+    {
+        const auto start = std::chrono::steady_clock::now();
+        function();
+        const double ns = std::chrono::duration< double, std::nano >( std::chrono::steady_clock::now() - start ).count();
+        minNs = std::min( minNs, ns / opCount );
+    }
+
+    return minNs;
+}
+
+void PrintResult( const char* name, const BenchmarkResult& result, int& outFailCount )
+{
+    std::printf( "%-24s %12.2f %12.2f %8s\n", name, result.singleNs, result.batchNs, result.isCorrect ? "ok" : "FAILED" );
+
+    if (!result.isCorrect)
+    {
+        ++outFailCount;
+    }
+}
+
+int main( int argc, char* argv[] )
+{
+    const int batchSize = argc > 1 ? std::max( std::atoi( argv[ 1 ] ), 1 ) : 4096;
+    const int iterations = argc > 2 ? std::max( std::atoi( argv[ 2 ] ), 1 ) : 50;
+    // Single operations feed their output back into the input, so they measure latency instead of throughput.
+    const int singleOpCount = batchSize;
+
+    std::vector< Matrix44 > matricesA( batchSize );
+    std::vector< Matrix44 > matricesB( batchSize );
+    std::vector< Matrix44 > matricesOut( batchSize );
+    std::vector< Vec4 > vec4s( batchSize );
+    std::vector< Vec4 > vec4sOut( batchSize );
+    std::vector< Vec3 > vec3s( batchSize );
+    std::vector< Vec3 > vec3sOut( batchSize );
+
+    for (int i = 0; i < batchSize; ++i)
+    {
+        matricesA[ i ] = RandomMatrix();
+        matricesB[ i ] = RandomMatrix();
+        vec4s[ i ] = Vec4( RandomFloat( -10, 10 ), RandomFloat( -10, 10 ), RandomFloat( -10, 10 ), 1 );
+        vec3s[ i ] = Vec3( RandomFloat( -10, 10 ), RandomFloat( -10, 10 ), RandomFloat( -10, 10 ) );
+    }
+
+    std::printf( "implementation: %s, batch size: %d, iterations: %d\n", implementationName, batchSize, iterations );
+    std::printf( "%-24s %12s %12s %8s\n", "operation", "single ns/op", "batch ns/op", "result" );
+
+    int failCount = 0;
+    BenchmarkResult result;
+
+    // Multiply
+    result.isCorrect = true;
+
+    for (int i = 0; i < batchSize; ++i)
+    {
+        Matrix44 reference;
+        Reference::Multiply( matricesA[ i ], matricesB[ i ], reference );
+        Matrix44::Multiply( matricesA[ i ], matricesB[ i ], matricesOut[ i ] );
+        result.isCorrect &= IsAlmost( reference.m, matricesOut[ i ].m, 16 );
+    }
+
+    result.singleNs = MeasureNsPerOp( iterations, singleOpCount, [&]()
+    {
+        // Rotation only, so the chain stays finite.
+        Matrix44 rotation;
+        rotation.MakeRotationXYZ( 1, 2, 3 );
+        Matrix44 accumulated = rotation;
+
+        for (int i = 0; i < singleOpCount; ++i)
+        {
+            Matrix44::Multiply( accumulated, rotation, accumulated );
+        }
+
+        gSink += accumulated.m[ 0 ];
+    } );
+
+    result.batchNs = MeasureNsPerOp( iterations, batchSize, [&]()
+    {
+        for (int i = 0; i < batchSize; ++i)
+        {
+            Matrix44::Multiply( matricesA[ i ], matricesB[ i ], matricesOut[ i ] );
+        }
+
+        gSink += matricesOut[ batchSize - 1 ].m[ 0 ];
+    } );
+
+    PrintResult( "Multiply", result, failCount );
+
+    // TransformPoint Vec4
+    result.isCorrect = true;
+
+    for (int i = 0; i < batchSize; ++i)
+    {
+        Vec4 reference;
+        Reference::TransformPoint( vec4s[ i ], matricesA[ i ], &reference );
+        Matrix44::TransformPoint( vec4s[ i ], matricesA[ i ], &vec4sOut[ i ] );
+        result.isCorrect &= IsAlmost( &reference.x, &vec4sOut[ i ].x, 4 );
+    }
+
+    result.singleNs = MeasureNsPerOp( iterations, singleOpCount, [&]()
+    {
+        Matrix44 rotation;
+        rotation.MakeRotationXYZ( 1, 2, 3 );
+        Vec4 point = vec4s[ 0 ];
+
+        for (int i = 0; i < singleOpCount; ++i)
+        {
+            Matrix44::TransformPoint( point, rotation, &point );
+        }
+
+        gSink += point.x;
+    } );
+
+    result.batchNs = MeasureNsPerOp( iterations, batchSize, [&]()
+    {
+        for (int i = 0; i < batchSize; ++i)
+        {
+            Matrix44::TransformPoint( vec4s[ i ], matricesA[ i ], &vec4sOut[ i ] );
+        }
+
+        gSink += vec4sOut[ batchSize - 1 ].x;
+    } );
+
+    PrintResult( "TransformPoint Vec4", result, failCount );
+
+    // TransformPoint Vec3
+    result.isCorrect = true;
+
+    for (int i = 0; i < batchSize; ++i)
+    {
+        Vec3 reference;
+        Reference::TransformPoint( vec3s[ i ], matricesA[ i ], &reference );
+        Matrix44::TransformPoint( vec3s[ i ], matricesA[ i ], &vec3sOut[ i ] );
+        result.isCorrect &= IsAlmost( &reference.x, &vec3sOut[ i ].x, 3 );
+    }
+
+    result.singleNs = MeasureNsPerOp( iterations, singleOpCount, [&]()
+    {
+        Matrix44 rotation;
+        rotation.MakeRotationXYZ( 1, 2, 3 );
+        Vec3 point = vec3s[ 0 ];
+
+        for (int i = 0; i < singleOpCount; ++i)
+        {
+            Matrix44::TransformPoint( point, rotation, &point );
+        }
+
+        gSink += point.x;
+    } );
+
+    result.batchNs = MeasureNsPerOp( iterations, batchSize, [&]()
+    {
+        for (int i = 0; i < batchSize; ++i)
+        {
+            Matrix44::TransformPoint( vec3s[ i ], matricesA[ i ], &vec3sOut[ i ] );
+        }
+
+        gSink += vec3sOut[ batchSize - 1 ].x;
+    } );
+
+    PrintResult( "TransformPoint Vec3", result, failCount );
+
+    // TransformDirection
+    result.isCorrect = true;
+
+    for (int i = 0; i < batchSize; ++i)
+    {
+        Vec3 reference;
+        Reference::TransformDirection( vec3s[ i ], matricesA[ i ], &reference );
+        Matrix44::TransformDirection( vec3s[ i ], matricesA[ i ], &vec3sOut[ i ] );
+        result.isCorrect &= IsAlmost( &reference.x, &vec3sOut[ i ].x, 3 );
+    }
+
+    result.singleNs = MeasureNsPerOp( iterations, singleOpCount, [&]()
+    {
+        Matrix44 rotation;
+        rotation.MakeRotationXYZ( 1, 2, 3 );
+        Vec3 direction = vec3s[ 0 ];
+
+        for (int i = 0; i < singleOpCount; ++i)
+        {
+            Matrix44::TransformDirection( direction, rotation, &direction );
+        }
+
+        gSink += direction.x;
+    } );
+
+    result.batchNs = MeasureNsPerOp( iterations, batchSize, [&]()
+    {
+        for (int i = 0; i < batchSize; ++i)
+        {
+            Matrix44::TransformDirection( vec3s[ i ], matricesA[ i ], &vec3sOut[ i ] );
+        }
+
+        gSink += vec3sOut[ batchSize - 1 ].x;
+    } );
+
+    PrintResult( "TransformDirection", result, failCount );
+
+    // Transpose
+    result.isCorrect = true;
+
+    for (int i = 0; i < batchSize; ++i)
+    {
+        Matrix44 reference;
+        Reference::Transpose( matricesA[ i ], reference );
+        matricesA[ i ].Transpose( matricesOut[ i ] );
+        result.isCorrect &= IsAlmost( reference.m, matricesOut[ i ].m, 16 );
+    }
+
+    result.singleNs = MeasureNsPerOp( iterations, singleOpCount, [&]()
+    {
+        Matrix44 matrix = matricesA[ 0 ];
+
+        for (int i = 0; i < singleOpCount; ++i)
+        {
+            matrix.Transpose( matrix );
+        }
+
+        gSink += matrix.m[ 1 ];
+    } );
+
+    result.batchNs = MeasureNsPerOp( iterations, batchSize, [&]()
+    {
+        for (int i = 0; i < batchSize; ++i)
+        {
+            matricesA[ i ].Transpose( matricesOut[ i ] );
+        }
+
+        gSink += matricesOut[ batchSize - 1 ].m[ 1 ];
+    } );
+
+    PrintResult( "Transpose", result, failCount );
+
+    // Invert. There's no SIMD path, so the result is checked by multiplying with the original.
+    result.isCorrect = true;
+
+    for (int i = 0; i < batchSize; ++i)
+    {
+        Matrix44::Invert( matricesA[ i ], matricesOut[ i ] );
+        Matrix44 product;
+        Reference::Multiply( matricesA[ i ], matricesOut[ i ], product );
+        result.isCorrect &= IsAlmost( Matrix44::identity.m, product.m, 16 );
+    }
+
+    result.singleNs = MeasureNsPerOp( iterations, singleOpCount, [&]()
+    {
+        Matrix44 matrix = matricesA[ 0 ];
+
+        for (int i = 0; i < singleOpCount; ++i)
+        {
+            Matrix44::Invert( matrix, matrix );
+        }
+
+        gSink += matrix.m[ 0 ];
+    } );
+
+    result.batchNs = MeasureNsPerOp( iterations, batchSize, [&]()
+    {
+        for (int i = 0; i < batchSize; ++i)
+        {
+            Matrix44::Invert( matricesA[ i ], matricesOut[ i ] );
+        }
+
+        gSink += matricesOut[ batchSize - 1 ].m[ 0 ];
+    } );
+
+    PrintResult( "Invert", result, failCount );
+
+    // InverseTranspose
+    result.isCorrect = true;
+
+    for (int i = 0; i < batchSize; ++i)
+    {
+        Matrix44 inverse;
+        Matrix44::Invert( matricesA[ i ], inverse );
+        Matrix44 reference;
+        Reference::Transpose( inverse, reference );
+        Matrix44::InverseTranspose( matricesA[ i ].m, matricesOut[ i ].m );
+        result.isCorrect &= IsAlmost( reference.m, matricesOut[ i ].m, 16 );
+    }
+
+    result.singleNs = MeasureNsPerOp( iterations, singleOpCount, [&]()
+    {
+        Matrix44 matrix = matricesA[ 0 ];
+
+        for (int i = 0; i < singleOpCount; ++i)
+        {
+            Matrix44 inverseTranspose;
+            Matrix44::InverseTranspose( matrix.m, inverseTranspose.m );
+            matrix = inverseTranspose;
+        }
+
+        gSink += matrix.m[ 0 ];
+    } );
+
+    result.batchNs = MeasureNsPerOp( iterations, batchSize, [&]()
+    {
+        for (int i = 0; i < batchSize; ++i)
+        {
+            Matrix44::InverseTranspose( matricesA[ i ].m, matricesOut[ i ].m );
+        }
+
+        gSink += matricesOut[ batchSize - 1 ].m[ 0 ];
+    } );
+
+    PrintResult( "InverseTranspose", result, failCount );
+
+    // MultiplyMany
+    result.isCorrect = true;
+    Matrix44::MultiplyMany( matricesA.data(), matricesB[ 0 ], batchSize, matricesOut.data() );
+
+    for (int i = 0; i < batchSize; ++i)
+    {
+        Matrix44 reference;
+        Reference::Multiply( matricesA[ i ], matricesB[ 0 ], reference );
+        result.isCorrect &= IsAlmost( reference.m, matricesOut[ i ].m, 16 );
+    }
+
+    result.singleNs = MeasureNsPerOp( iterations, batchSize, [&]()
+    {
+        for (int i = 0; i < batchSize; ++i)
+        {
+            Matrix44::MultiplyMany( &matricesA[ i ], matricesB[ 0 ], 1, &matricesOut[ i ] );
+        }
+
+        gSink += matricesOut[ batchSize - 1 ].m[ 0 ];
+    } );
+
+    result.batchNs = MeasureNsPerOp( iterations, batchSize, [&]()
+    {
+        Matrix44::MultiplyMany( matricesA.data(), matricesB[ 0 ], batchSize, matricesOut.data() );
+        gSink += matricesOut[ batchSize - 1 ].m[ 0 ];
+    } );
+
+    PrintResult( "MultiplyMany", result, failCount );
+
+    // TransformPoints
+    result.isCorrect = true;
+    Matrix44::TransformPoints( vec3s.data(), batchSize, matricesA[ 0 ], vec3sOut.data() );
+
+    for (int i = 0; i < batchSize; ++i)
+    {
+        Vec3 reference;
+        Reference::TransformPoint( vec3s[ i ], matricesA[ 0 ], &reference );
+        result.isCorrect &= IsAlmost( &reference.x, &vec3sOut[ i ].x, 3 );
+    }
+
+    // Transforming in place must give the same result.
+    std::vector< Vec3 > inPlace = vec3s;
+    Matrix44::TransformPoints( inPlace.data(), batchSize, matricesA[ 0 ], inPlace.data() );
+
+    for (int i = 0; i < batchSize; ++i)
+    {
+        result.isCorrect &= IsAlmost( &vec3sOut[ i ].x, &inPlace[ i ].x, 3 );
+    }
+
+    result.singleNs = MeasureNsPerOp( iterations, batchSize, [&]()
+    {
+        for (int i = 0; i < batchSize; ++i)
+        {
+            Matrix44::TransformPoints( &vec3s[ i ], 1, matricesA[ 0 ], &vec3sOut[ i ] );
+        }
+
+        gSink += vec3sOut[ batchSize - 1 ].x;
+    } );
+
+    result.batchNs = MeasureNsPerOp( iterations, batchSize, [&]()
+    {
+        Matrix44::TransformPoints( vec3s.data(), batchSize, matricesA[ 0 ], vec3sOut.data() );
+        gSink += vec3sOut[ batchSize - 1 ].x;
+    } );
+
+    PrintResult( "TransformPoints", result, failCount );
+
+    // TransformAABB. AABB 8 corners is the loop that TransformAABB replaces.
+    std::vector< Vec3 > aabbMins( batchSize );
+    std::vector< Vec3 > aabbMaxs( batchSize );
+
+    for (int i = 0; i < batchSize; ++i)
+    {
+        aabbMins[ i ] = Vec3::Min2( vec3s[ i ], vec3s[ (i + 1) % batchSize ] );
+        aabbMaxs[ i ] = Vec3::Max2( vec3s[ i ], vec3s[ (i + 1) % batchSize ] );
+    }
+
+    result.isCorrect = true;
+
+    for (int i = 0; i < batchSize; ++i)
+    {
+        Vec3 referenceMin, referenceMax;
+        Reference::TransformAABB( aabbMins[ i ], aabbMaxs[ i ], matricesA[ i ], referenceMin, referenceMax );
+        Vec3 outMin, outMax;
+        Matrix44::TransformAABB( aabbMins[ i ], aabbMaxs[ i ], matricesA[ i ], outMin, outMax );
+        result.isCorrect &= IsAlmost( &referenceMin.x, &outMin.x, 3 ) && IsAlmost( &referenceMax.x, &outMax.x, 3 );
+    }
+
+    result.singleNs = MeasureNsPerOp( iterations, singleOpCount, [&]()
+    {
+        Matrix44 rotation;
+        rotation.MakeRotationXYZ( 1, 2, 3 );
+        Vec3 aabbMin = aabbMins[ 0 ];
+        Vec3 aabbMax = aabbMaxs[ 0 ];
+
+        for (int i = 0; i < singleOpCount; ++i)
+        {
+            Matrix44::TransformAABB( aabbMin, aabbMax, rotation, aabbMin, aabbMax );
+            // Keeps the box from growing without bounds.
+            aabbMin = aabbMin * 0.5f;
+            aabbMax = aabbMax * 0.5f;
+        }
+
+        gSink += aabbMin.x;
+    } );
+
+    result.batchNs = MeasureNsPerOp( iterations, batchSize, [&]()
+    {
+        for (int i = 0; i < batchSize; ++i)
+        {
+            Matrix44::TransformAABB( aabbMins[ i ], aabbMaxs[ i ], matricesA[ i ], vec3sOut[ i ], vec3s[ i ] );
+        }
+
+        gSink += vec3sOut[ batchSize - 1 ].x;
+    } );
+
+    PrintResult( "TransformAABB", result, failCount );
+
+    result.singleNs = MeasureNsPerOp( iterations, singleOpCount, [&]()
+    {
+        Matrix44 rotation;
+        rotation.MakeRotationXYZ( 1, 2, 3 );
+        Vec3 aabbMin = aabbMins[ 0 ];
+        Vec3 aabbMax = aabbMaxs[ 0 ];
+
+        for (int i = 0; i < singleOpCount; ++i)
+        {
+            Reference::TransformAABB( aabbMin, aabbMax, rotation, aabbMin, aabbMax );
+            aabbMin = aabbMin * 0.5f;
+            aabbMax = aabbMax * 0.5f;
+        }
+
+        gSink += aabbMin.x;
+    } );
+
+    result.batchNs = MeasureNsPerOp( iterations, batchSize, [&]()
+    {
+        for (int i = 0; i < batchSize; ++i)
+        {
+            Reference::TransformAABB( aabbMins[ i ], aabbMaxs[ i ], matricesA[ i ], vec3sOut[ i ], vec3s[ i ] );
+        }
+
+        gSink += vec3sOut[ batchSize - 1 ].x;
+    } );
+
+    PrintResult( "AABB 8 corners", result, failCount );
+
+    std::printf( "sink: %f\n", gSink );
+
+    if (failCount > 0)
+    {
+        std::printf( "%d operations differ from the scalar reference!\n", failCount );
+        return 1;
+    }
+
+    return 0;
+}
@@ -15,6 +15,7 @@ extern int AE3D_CB_SIZE;
 
 void TransitionResource( GpuResource& gpuResource, D3D12_RESOURCE_STATES newState );
 void UploadPerObjectUbo();
+D3D12_SHADER_RESOURCE_VIEW_DESC GetBoneBufferSRVDesc();
 
 namespace GfxDeviceGlobal
 {
@@ -23,6 +24,7 @@ namespace GfxDeviceGlobal
     extern ID3D12RootSignature* rootSignatureCompute;
     extern ID3D12DescriptorHeap* computeCbvSrvUavHeaps[ 8 ];
     extern ID3D12PipelineState* cachedPSO;
+    extern ID3D12Resource* boneBuffer;
 	extern PerObjectUboStruct perObjectUboStruct;
 }
 
@@ -120,6 +122,11 @@ void ae3d::ComputeShader::Dispatch( unsigned groupCountX, unsigned groupCountY,
     cpuHandle.ptr += incrementSize;
     GfxDeviceGlobal::device->CreateShaderResourceView( textureBuffers[ 9 ], &srvDescs[ 9 ], cpuHandle );
     cpuHandle.ptr += incrementSize;
+    const D3D12_SHADER_RESOURCE_VIEW_DESC boneSrvDesc = GetBoneBufferSRVDesc();
+    GfxDeviceGlobal::device->CreateShaderResourceView( GfxDeviceGlobal::boneBuffer, &boneSrvDesc, cpuHandle );
+    cpuHandle.ptr += incrementSize;
+    GfxDeviceGlobal::device->CreateShaderResourceView( textureBuffers[ 11 ], &srvDescs[ 11 ], cpuHandle );
+    cpuHandle.ptr += incrementSize;
 
     GfxDeviceGlobal::device->CreateUnorderedAccessView( uavBuffers[ 0 ], nullptr, &uavDescs[ 0 ], cpuHandle );
     cpuHandle.ptr += incrementSize;
@@ -128,6 +135,8 @@ void ae3d::ComputeShader::Dispatch( unsigned groupCountX, unsigned groupCountY,
     GfxDeviceGlobal::device->CreateUnorderedAccessView( uavBuffers[ 2 ], nullptr, &uavDescs[ 2 ], cpuHandle );
     cpuHandle.ptr += incrementSize;
     GfxDeviceGlobal::device->CreateUnorderedAccessView( uavBuffers[ 3 ], nullptr, &uavDescs[ 3 ], cpuHandle );
+    cpuHandle.ptr += incrementSize;
+    GfxDeviceGlobal::device->CreateUnorderedAccessView( uavBuffers[ 4 ], nullptr, &uavDescs[ 4 ], cpuHandle );
 
     GfxDeviceGlobal::cachedPSO = pso;
     Statistics::IncPSOBindCalls();
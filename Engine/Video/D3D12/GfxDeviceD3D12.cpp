@@ -11,6 +11,8 @@
 #include <string>
 #include <sstream>
 #include <cmath>
+#include <algorithm>
+#include <limits>
 #include "ComputeShader.hpp"
 #include "DescriptorHeapManager.hpp"
 #include "GfxDevice.hpp"
@@ -26,13 +28,13 @@
 #include "TextureCube.hpp"
 #include "VertexBuffer.hpp"
 
-int AE3D_CB_SIZE = 256 * 3 + 80 * 64 + 128 * 16;
+int AE3D_CB_SIZE = 256 * 3 + 128 * 16;
 
 void DestroyShaders(); // Defined in ShaderD3D12.cpp
 void DestroyComputeShaders(); // Defined in ComputeShaderD3D12.cpp
 float GetFloatAnisotropy( ae3d::Anisotropy anisotropy );
 extern ae3d::Renderer renderer;
-constexpr int RESOURCE_BINDING_COUNT = 15;
+constexpr int RESOURCE_BINDING_COUNT = 18;
 
 namespace WindowGlobal
 {
@@ -65,6 +67,7 @@ namespace ae3d
                 stm << "barrier calls: " << ::Statistics::GetBarrierCalls() << "\n";
                 stm << "triangles: " << ::Statistics::GetTriangleCount() << "\n";
                 stm << "PSO binds: " << ::Statistics::GetPSOBindCalls() << "\n";
+                stm << "audio voices: " << ::Statistics::GetAudioVoiceCount() << ", virtual: " << ::Statistics::GetVirtualAudioVoiceCount() << "\n";
 
 				std::strcpy( outStr, stm.str().c_str() );
 	    }
@@ -198,6 +201,8 @@ namespace GfxDeviceGlobal
     D3D12_UNORDERED_ACCESS_VIEW_DESC uav2Desc = {};
     D3D12_UNORDERED_ACCESS_VIEW_DESC uav3Desc = {};
     std::vector< ae3d::VertexBuffer > lineBuffers;
+    // Replaced resources that the frame being rendered may still use. Released after the frame has completed.
+    std::vector< ID3D12Resource* > pendingFreeResources;
     std::vector< ID3D12Resource* > constantBuffers;
     std::vector< void* > mappedConstantBuffers;
     int currentConstantBufferIndex = 0;
@@ -223,6 +228,16 @@ namespace GfxDeviceGlobal
     ID3D12PipelineState* cachedPSO = nullptr;
     ID3D12Resource* particleBuffer;
     ID3D12Resource* particleTileBuffer;
+    // Parameters of the emitters in the particle simulation dispatch. In an upload heap, because it's rewritten every frame.
+    ID3D12Resource* particleEmitterBuffer = nullptr;
+    ae3d::ParticleEmitter* particleEmitters = nullptr;
+    D3D12_SHADER_RESOURCE_VIEW_DESC particleEmitterSrvDesc = {};
+    // Joint matrices of this frame's skinned draws. In an upload heap, because it's rewritten every frame.
+    ID3D12Resource* boneBuffer = nullptr;
+    ae3d::Matrix44* boneMatrices = nullptr;
+    unsigned boneMatrixCapacity = 0;
+    unsigned boneMatrixCount = 0;
+    unsigned boneBufferFrame = 0;
 }
 
 const char* GpuAllocationType( D3D12_DRED_ALLOCATION_TYPE type )
@@ -412,6 +427,27 @@ void TimerQuery::UpdateProfile( std::uint64_t index, std::uint64_t* queryData )
     profiles[ index ].isActive = false;
 }
 
+void ae3d::System::Statistics::GetPassTimings( char* outStr, int outStrLength )
+{
+    if (outStrLength <= 0)
+    {
+        return;
+    }
+
+    // Group markers are not timed in this renderer, only the passes that have a TimerQuery.
+    std::string str;
+
+    for (int profileIdx = 0; profileIdx < GfxDeviceGlobal::timerQuery.profileCount; ++profileIdx)
+    {
+        const ProfileData& profile = GfxDeviceGlobal::timerQuery.profiles[ profileIdx ];
+        const std::uint64_t lastSample = (profile.currSample + ProfileData::filterSize - 1) % ProfileData::filterSize;
+        str += std::string( profile.name ) + ": GPU " + std::to_string( profile.timeSamples[ lastSample ] ) + " ms\n";
+    }
+
+    std::strncpy( outStr, str.c_str(), outStrLength );
+    outStr[ outStrLength - 1 ] = '\0';
+}
+
 namespace ae3d
 {
     void CreateRenderer( int samples, bool apiValidation );
@@ -653,8 +689,8 @@ void CreateRootSignature()
 
     {
         descRange1[ 0 ].Init( D3D12_DESCRIPTOR_RANGE_TYPE_CBV, 1, 0 );
-        descRange1[ 1 ].Init( D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 10, 0 );
-        descRange1[ 2 ].Init( D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 4, 0 );
+        descRange1[ 1 ].Init( D3D12_DESCRIPTOR_RANGE_TYPE_SRV, 12, 0 );
+        descRange1[ 2 ].Init( D3D12_DESCRIPTOR_RANGE_TYPE_UAV, 5, 0 );
 		ae3d::System::Assert( descRange1[ 0 ].NumDescriptors + descRange1[ 1 ].NumDescriptors + descRange1[ 2 ].NumDescriptors == RESOURCE_BINDING_COUNT, "Resource count mismatch!" );
 
         CD3DX12_DESCRIPTOR_RANGE descRange2[ 1 ];
@@ -975,7 +1011,7 @@ void CreateDepthStencil()
 
 void CreateParticleBuffer()
 {
-    const unsigned maxParticles = 1000000;
+    const unsigned maxParticles = ae3d::MaxParticleCount;
 
     D3D12_HEAP_PROPERTIES heapProp = {};
     heapProp.Type = D3D12_HEAP_TYPE_DEFAULT;
@@ -1053,6 +1089,35 @@ void CreateParticleBuffer()
     GfxDeviceGlobal::uav3Desc.Buffer.StructureByteStride = sizeof( unsigned );
     GfxDeviceGlobal::uav3Desc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_NONE;
     GfxDeviceGlobal::uav3Desc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+
+    // Particle emitter buffer
+    heapProp.Type = D3D12_HEAP_TYPE_UPLOAD;
+    bufferProp.Flags = D3D12_RESOURCE_FLAG_NONE;
+    bufferProp.Width = ae3d::MaxParticleEmitterCount * sizeof( ae3d::ParticleEmitter );
+
+    hr = GfxDeviceGlobal::device->CreateCommittedResource(
+        &heapProp,
+        D3D12_HEAP_FLAG_NONE,
+        &bufferProp,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS( &GfxDeviceGlobal::particleEmitterBuffer ) );
+    if (FAILED( hr ))
+    {
+        ae3d::System::Assert( false, "Unable to create particle emitter buffer!" );
+        return;
+    }
+
+    GfxDeviceGlobal::particleEmitterBuffer->SetName( L"Particle Emitter Buffer" );
+    D3D12_RANGE emptyRange{};
+    hr = GfxDeviceGlobal::particleEmitterBuffer->Map( 0, &emptyRange, reinterpret_cast< void** >( &GfxDeviceGlobal::particleEmitters ) );
+    AE3D_CHECK_D3D( hr, "Unable to map particle emitter buffer" );
+
+    GfxDeviceGlobal::particleEmitterSrvDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+    GfxDeviceGlobal::particleEmitterSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+    GfxDeviceGlobal::particleEmitterSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    GfxDeviceGlobal::particleEmitterSrvDesc.Buffer.NumElements = (UINT)(bufferProp.Width / 4);
+    GfxDeviceGlobal::particleEmitterSrvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
 }
 
 void CreateConstantBuffers()
@@ -1112,6 +1177,68 @@ void CreateConstantBuffers()
     }
 }
 
+void CreateBoneBuffer( unsigned capacity )
+{
+    D3D12_HEAP_PROPERTIES heapProp = {};
+    heapProp.Type = D3D12_HEAP_TYPE_UPLOAD;
+    heapProp.CreationNodeMask = 1;
+    heapProp.VisibleNodeMask = 1;
+
+    D3D12_RESOURCE_DESC bufferProp = {};
+    bufferProp.Alignment = 0;
+    bufferProp.DepthOrArraySize = 1;
+    bufferProp.Dimension = D3D12_RESOURCE_DIMENSION_BUFFER;
+    bufferProp.Flags = D3D12_RESOURCE_FLAG_NONE;
+    bufferProp.Format = DXGI_FORMAT_UNKNOWN;
+    bufferProp.Height = 1;
+    bufferProp.Layout = D3D12_TEXTURE_LAYOUT_ROW_MAJOR;
+    bufferProp.MipLevels = 1;
+    bufferProp.SampleDesc.Count = 1;
+    bufferProp.SampleDesc.Quality = 0;
+    bufferProp.Width = capacity * sizeof( ae3d::Matrix44 );
+
+    ID3D12Resource* newBuffer = nullptr;
+    HRESULT hr = GfxDeviceGlobal::device->CreateCommittedResource(
+        &heapProp,
+        D3D12_HEAP_FLAG_NONE,
+        &bufferProp,
+        D3D12_RESOURCE_STATE_GENERIC_READ,
+        nullptr,
+        IID_PPV_ARGS( &newBuffer ) );
+    AE3D_CHECK_D3D( hr, "Unable to create bone buffer" );
+    newBuffer->SetName( L"Bone Buffer" );
+
+    ae3d::Matrix44* newMatrices = nullptr;
+    D3D12_RANGE emptyRange{};
+    hr = newBuffer->Map( 0, &emptyRange, reinterpret_cast< void** >( &newMatrices ) );
+    AE3D_CHECK_D3D( hr, "Unable to map bone buffer" );
+
+    if (GfxDeviceGlobal::boneBuffer != nullptr)
+    {
+        // Views created after this point use the new buffer, so it needs the matrices of earlier draws too.
+        std::copy( GfxDeviceGlobal::boneMatrices, GfxDeviceGlobal::boneMatrices + GfxDeviceGlobal::boneMatrixCount, newMatrices );
+        GfxDeviceGlobal::pendingFreeResources.push_back( GfxDeviceGlobal::boneBuffer );
+    }
+
+    GfxDeviceGlobal::boneBuffer = newBuffer;
+    GfxDeviceGlobal::boneMatrices = newMatrices;
+    GfxDeviceGlobal::boneMatrixCapacity = capacity;
+}
+
+D3D12_SHADER_RESOURCE_VIEW_DESC GetBoneBufferSRVDesc()
+{
+    D3D12_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+    srvDesc.Format = DXGI_FORMAT_UNKNOWN;
+    srvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+    srvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    srvDesc.Buffer.FirstElement = 0;
+    srvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_NONE;
+    srvDesc.Buffer.NumElements = GfxDeviceGlobal::boneMatrixCapacity;
+    srvDesc.Buffer.StructureByteStride = sizeof( ae3d::Matrix44 );
+
+    return srvDesc;
+}
+
 void ae3d::CreateRenderer( int samples, bool apiValidation )
 {
     if (samples > 0 && samples < 17)
@@ -1247,13 +1374,15 @@ void ae3d::CreateRenderer( int samples, bool apiValidation )
     CreateSamplers();
     CreateConstantBuffers();
     CreateParticleBuffer();
+    // Draws need a bone buffer even when nothing is skinned.
+    CreateBoneBuffer( 1024 );
 
     // Compute heap
     for (int i = 0; i < ae3d::GfxDevice::computeHeapCount; ++i)
     {
         D3D12_DESCRIPTOR_HEAP_DESC desc = {};
         desc.Type = D3D12_DESCRIPTOR_HEAP_TYPE_CBV_SRV_UAV;
-        desc.NumDescriptors = ComputeShader::SLOT_COUNT;
+        desc.NumDescriptors = RESOURCE_BINDING_COUNT;
         desc.Flags = D3D12_DESCRIPTOR_HEAP_FLAG_SHADER_VISIBLE;
         desc.NodeMask = 0;
 
@@ -1343,6 +1472,27 @@ void ae3d::GfxDevice::GetNewUniformBuffer()
     GfxDeviceGlobal::currentConstantBufferIndex = (GfxDeviceGlobal::currentConstantBufferIndex + 1) % GfxDeviceGlobal::mappedConstantBuffers.size();
 }
 
+unsigned ae3d::GfxDevice::UploadBoneMatrices( const Matrix44* matrices, unsigned count )
+{
+    const unsigned offset = GfxDeviceGlobal::boneMatrixCount;
+
+    if (offset + count > GfxDeviceGlobal::boneMatrixCapacity)
+    {
+        CreateBoneBuffer( static_cast< unsigned >( VertexBuffer::GetGrownCapacity( static_cast< int >( offset + count ), static_cast< int >( GfxDeviceGlobal::boneMatrixCapacity ),
+                                                                                   std::numeric_limits< int >::max() / static_cast< int >( sizeof( Matrix44 ) ) ) ) );
+    }
+
+    std::copy( matrices, matrices + count, GfxDeviceGlobal::boneMatrices + offset );
+    GfxDeviceGlobal::boneMatrixCount += count;
+
+    return offset;
+}
+
+unsigned ae3d::GfxDevice::GetBoneBufferFrame()
+{
+    return GfxDeviceGlobal::boneBufferFrame;
+}
+
 void* ae3d::GfxDevice::GetCurrentMappedConstantBuffer()
 {
     return GfxDeviceGlobal::mappedConstantBuffers[ GfxDeviceGlobal::currentConstantBufferIndex ];
@@ -1373,6 +1523,12 @@ void ae3d::GfxDevice::DrawLines( int handle, Shader& shader )
     Draw( GfxDeviceGlobal::lineBuffers[ handle ], 0, GfxDeviceGlobal::lineBuffers[ handle ].GetFaceCount(), shader, BlendMode::Off, DepthFunc::NoneWriteOff, CullMode::Off, FillMode::Solid, GfxDevice::PrimitiveTopology::Lines );
 }
 
+void ae3d::GfxDevice::DrawLines( VertexBuffer& vertexBuffer, int startVertex, int endVertex, Shader& shader, DepthFunc depthFunc )
+{
+    // Draw() converts line ranges with a divisor of 6.
+    Draw( vertexBuffer, startVertex * 6, endVertex * 6, shader, BlendMode::Off, depthFunc, CullMode::Off, FillMode::Solid, GfxDevice::PrimitiveTopology::Lines );
+}
+
 void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startFace, int endFace, Shader& shader, BlendMode blendMode, DepthFunc depthFunc,
                             CullMode cullMode, FillMode fillMode, PrimitiveTopology topology )
 {
@@ -1444,6 +1600,17 @@ void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startFace, int endFa
     cpuHandle.ptr += incrementSize;
     GfxDeviceGlobal::device->CreateShaderResourceView( GfxDeviceGlobal::lightTiler.GetSpotLightColorBuffer(), &srvDesc, cpuHandle );
     cpuHandle.ptr += incrementSize;
+    const D3D12_SHADER_RESOURCE_VIEW_DESC boneSrvDesc = GetBoneBufferSRVDesc();
+    GfxDeviceGlobal::device->CreateShaderResourceView( GfxDeviceGlobal::boneBuffer, &boneSrvDesc, cpuHandle );
+    cpuHandle.ptr += incrementSize;
+    // Skinning pre-pass buffers are only used by compute shaders.
+    D3D12_SHADER_RESOURCE_VIEW_DESC skinningSrvDesc = {};
+    skinningSrvDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+    skinningSrvDesc.ViewDimension = D3D12_SRV_DIMENSION_BUFFER;
+    skinningSrvDesc.Shader4ComponentMapping = D3D12_DEFAULT_SHADER_4_COMPONENT_MAPPING;
+    skinningSrvDesc.Buffer.Flags = D3D12_BUFFER_SRV_FLAG_RAW;
+    GfxDeviceGlobal::device->CreateShaderResourceView( nullptr, &skinningSrvDesc, cpuHandle );
+    cpuHandle.ptr += incrementSize;
 
     GfxDeviceGlobal::device->CreateUnorderedAccessView( GfxDeviceGlobal::uav0, nullptr, &GfxDeviceGlobal::uav0Desc, cpuHandle );
     cpuHandle.ptr += incrementSize;
@@ -1453,6 +1620,12 @@ void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startFace, int endFa
     cpuHandle.ptr += incrementSize;
     GfxDeviceGlobal::device->CreateUnorderedAccessView( GfxDeviceGlobal::uav3, nullptr, &GfxDeviceGlobal::uav3Desc, cpuHandle );
     cpuHandle.ptr += incrementSize;
+    D3D12_UNORDERED_ACCESS_VIEW_DESC skinningUavDesc = {};
+    skinningUavDesc.Format = DXGI_FORMAT_R32_TYPELESS;
+    skinningUavDesc.ViewDimension = D3D12_UAV_DIMENSION_BUFFER;
+    skinningUavDesc.Buffer.Flags = D3D12_BUFFER_UAV_FLAG_RAW;
+    GfxDeviceGlobal::device->CreateUnorderedAccessView( nullptr, nullptr, &skinningUavDesc, cpuHandle );
+    cpuHandle.ptr += incrementSize;
 
     const unsigned activePointLights = GfxDeviceGlobal::lightTiler.GetPointLightCount();
     const unsigned activeSpotLights = GfxDeviceGlobal::lightTiler.GetSpotLightCount();
@@ -1570,6 +1743,13 @@ void ae3d::GfxDevice::GetGpuMemoryUsage( unsigned& outUsedMBytes, unsigned& outB
 
 void ae3d::GfxDevice::ReleaseGPUObjects()
 {
+    for (std::size_t i = 0; i < GfxDeviceGlobal::pendingFreeResources.size(); ++i)
+    {
+        AE3D_SAFE_RELEASE( GfxDeviceGlobal::pendingFreeResources[ i ] );
+    }
+
+    AE3D_SAFE_RELEASE( GfxDeviceGlobal::boneBuffer );
+    AE3D_SAFE_RELEASE( GfxDeviceGlobal::particleEmitterBuffer );
     VertexBuffer::DestroyBuffers();
     DestroyShaders();
     DestroyComputeShaders();
@@ -1747,6 +1927,15 @@ void ae3d::GfxDevice::Present()
 
     WaitForPreviousFrame();
 
+    for (std::size_t i = 0; i < GfxDeviceGlobal::pendingFreeResources.size(); ++i)
+    {
+        AE3D_SAFE_RELEASE( GfxDeviceGlobal::pendingFreeResources[ i ] );
+    }
+
+    GfxDeviceGlobal::pendingFreeResources.clear();
+    GfxDeviceGlobal::boneMatrixCount = 0;
+    ++GfxDeviceGlobal::boneBufferFrame;
+
     hr = GfxDeviceGlobal::commandListAllocator->Reset();
     if (hr == DXGI_ERROR_DEVICE_REMOVED)
     {
@@ -3,6 +3,7 @@
 #include "Texture2D.hpp"
 #include <vector>
 #include <map>
+#include <cstring>
 #include <d3d12.h>
 #define D3DX12_NO_STATE_OBJECT_HELPERS
 #include <d3dx12.h>
@@ -321,7 +322,6 @@ void ae3d::Texture2D::LoadFromData( const void* imageData, int aWidth, int aHeig
 {
 	width = aWidth;
 	height = aHeight;
-	wrap = TextureWrap::Repeat;
 	filter = TextureFilter::Linear;
 
 	D3D12_RESOURCE_DESC descTex = {};
@@ -399,6 +399,71 @@ void ae3d::Texture2D::LoadFromData( const void* imageData, int aWidth, int aHeig
     GfxDeviceGlobal::device->CreateShaderResourceView( gpuResource.resource, &srvDesc, srv );
 }
 
+void ae3d::Texture2D::UpdateRegion( const void* rgbaPixels, int x, int y, int regionWidth, int regionHeight )
+{
+    System::Assert( gpuResource.resource != nullptr, "UpdateRegion needs a texture created by LoadFromData" );
+    System::Assert( x >= 0 && y >= 0 && x + regionWidth <= width && y + regionHeight <= height, "UpdateRegion: region is outside the texture" );
+
+    const UINT rowPitch = (regionWidth * 4 + D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1) & ~(D3D12_TEXTURE_DATA_PITCH_ALIGNMENT - 1);
+
+    D3D12_HEAP_PROPERTIES heapProps = {};
+    heapProps.Type = D3D12_HEAP_TYPE_UPLOAD;
+    heapProps.CPUPageProperty = D3D12_CPU_PAGE_PROPERTY_UNKNOWN;
+    heapProps.MemoryPoolPreference = D3D12_MEMORY_POOL_UNKNOWN;
+    heapProps.CreationNodeMask = 1;
+    heapProps.VisibleNodeMask = 1;
+
+    ID3D12Resource* uploadBuffer = nullptr;
+    const auto buffer = CD3DX12_RESOURCE_DESC::Buffer( rowPitch * regionHeight );
+    HRESULT hr = GfxDeviceGlobal::device->CreateCommittedResource( &heapProps, D3D12_HEAP_FLAG_NONE, &buffer,
+        D3D12_RESOURCE_STATE_GENERIC_READ, nullptr, IID_PPV_ARGS( &uploadBuffer ) );
+    AE3D_CHECK_D3D( hr, "Failed to create texture region upload resource" );
+
+    if (hr != S_OK)
+    {
+        return;
+    }
+
+    uploadBuffer->SetName( L"Texture Region Upload Buffer" );
+    Texture2DGlobal::uploadBuffers.push_back( uploadBuffer );
+
+    unsigned char* mappedData = nullptr;
+    D3D12_RANGE emptyRange{};
+    hr = uploadBuffer->Map( 0, &emptyRange, reinterpret_cast< void** >( &mappedData ) );
+    AE3D_CHECK_D3D( hr, "Unable to map texture region upload buffer" );
+
+    for (int row = 0; row < regionHeight; ++row)
+    {
+        std::memcpy( mappedData + row * rowPitch, static_cast< const unsigned char* >( rgbaPixels ) + row * regionWidth * 4, regionWidth * 4 );
+    }
+
+    uploadBuffer->Unmap( 0, nullptr );
+
+    hr = GfxDeviceGlobal::graphicsCommandList->Reset( GfxDeviceGlobal::commandListAllocator, nullptr );
+    AE3D_CHECK_D3D( hr, "command list reset in UpdateRegion" );
+
+    TransitionResource( gpuResource, D3D12_RESOURCE_STATE_COPY_DEST );
+
+    D3D12_PLACED_SUBRESOURCE_FOOTPRINT footprint = {};
+    footprint.Footprint.Format = srvDesc.Format;
+    footprint.Footprint.Width = regionWidth;
+    footprint.Footprint.Height = regionHeight;
+    footprint.Footprint.Depth = 1;
+    footprint.Footprint.RowPitch = rowPitch;
+
+    const CD3DX12_TEXTURE_COPY_LOCATION source( uploadBuffer, footprint );
+    const CD3DX12_TEXTURE_COPY_LOCATION destination( gpuResource.resource, 0 );
+    GfxDeviceGlobal::graphicsCommandList->CopyTextureRegion( &destination, x, y, 0, &source, nullptr );
+
+    TransitionResource( gpuResource, D3D12_RESOURCE_STATE_PIXEL_SHADER_RESOURCE | D3D12_RESOURCE_STATE_NON_PIXEL_SHADER_RESOURCE );
+
+    hr = GfxDeviceGlobal::graphicsCommandList->Close();
+    AE3D_CHECK_D3D( hr, "command list close in UpdateRegion" );
+
+    ID3D12CommandList* ppCommandLists[] = { GfxDeviceGlobal::graphicsCommandList };
+    GfxDeviceGlobal::commandQueue->ExecuteCommandLists( 1, &ppCommandLists[ 0 ] );
+}
+
 int GetTextureMemoryUsageBytes( int width, int height, DXGI_FORMAT format, bool hasMips )
 {
     int bytesPerPixel = 2;
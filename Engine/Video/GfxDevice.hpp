@@ -30,7 +30,6 @@ struct PerObjectUboStruct
     float f0 = 0.8f;
     ae3d::Vec4 tex0scaleOffset = ae3d::Vec4( 1, 1, 0, 0 );
     ae3d::Vec4 tilesXY = ae3d::Vec4( 0, 0, 0, 0 );
-    ae3d::Matrix44 boneMatrices[ 80 ];
     int isVR = 0;
     int kernelSize;
     float bloomThreshold = 0.8f;
@@ -43,6 +42,15 @@ struct PerObjectUboStruct
     float timeStamp; // In seconds.
     float roughness;
     float alphaThreshold;
+    float clusterSliceScale = 0; // Depth slice is log( viewDepth ) * clusterSliceScale + clusterSliceBias.
+    float clusterSliceBias = 0;
+    unsigned clusterSliceCount = 0; // 0 when lights are culled per tile.
+    int particleEmitterCount = 0; // Emitters in the emitter buffer of the particle simulation.
+    unsigned clusterCountX = 0; // Cluster grid size of the camera's render target.
+    unsigned clusterCountY = 0;
+    unsigned clusterListBase = 0; // First cluster offset of the camera in the light index buffer.
+    unsigned boneOffset = 0; // First joint matrix of the draw's skin palette in the bone buffer.
+    unsigned skinnedVertexCount = 0; // Vertices of the submesh that the skinning pre-pass skins.
 };
 
 namespace ae3d
@@ -102,6 +110,13 @@ namespace ae3d
         int CreateLineBuffer( const Vec3* lines, int lineCount, const Vec3& color );
         void UpdateLineBuffer( int lineHandle, const Vec3* lines, int lineCount, const Vec3& color );
         void GetNewUniformBuffer();
+        /// Copies joint matrices into the bone buffer that skinned shaders index with PerObjectUboStruct::boneOffset. The buffer grows as needed and is emptied in Present().
+        /// \param matrices Joint matrices.
+        /// \param count Matrix count.
+        /// \return Index of the first copied matrix in the bone buffer.
+        unsigned UploadBoneMatrices( const Matrix44* matrices, unsigned count );
+        /// \return Frame number that UploadBoneMatrices() indices are valid for. Incremented in Present().
+        unsigned GetBoneBufferFrame();
 #if RENDERER_D3D12
         void ResetCommandList();
         void* GetCurrentMappedConstantBuffer();
@@ -116,6 +131,8 @@ namespace ae3d
         id <MTLDevice> GetMetalDevice();
         id <MTLLibrary> GetDefaultMetalShaderLibrary();
         id <MTLBuffer> GetCurrentUniformBuffer();
+        /// \return Bone buffer that UploadBoneMatrices() writes into this frame.
+        id <MTLBuffer> GetCurrentBoneBuffer();
         void PresentDrawable();
         void BeginFrame();
         void BeginBackBufferEncoding();
@@ -131,10 +148,57 @@ namespace ae3d
         void EndRenderPass();
         void EndCommandBuffer();
         void BeginFrame();
+        /// Draws until EndParallelDraws() are recorded into secondary command buffers on worker threads. Call before BeginOffscreen().
+        /// \param debugName Debug region name for the recorded draws. Group markers are ignored until EndParallelDraws().
+        void BeginParallelDraws( const char* debugName );
+        /// Records draws captured since BeginParallelDraws() and executes them in the offscreen command buffer. Call before EndOffscreen().
+        void EndParallelDraws();
+#endif
+#if RENDERER_NULL
+        /// Commands in the null renderer's command log. Comments list the arguments.
+        enum class Command : std::uint8_t
+        {
+            ClearScreen, // clear flags
+            SetClearColor, // red, green, blue in range 0-255
+            SetRenderTarget, // render texture ID or 0 for the back buffer, cube map face
+            SetViewport, // x, y, width, height
+            SetScissor, // x, y, width, height
+            SetPolygonOffset, // enable, factor bits, units bits
+            PushGroupMarker, // name
+            PopGroupMarker,
+            BindShader, // shader ID
+            BindTexture, // texture unit, texture type, texture ID
+            BindPipeline, // vertex format, blend mode, depth func, cull mode | fill mode << 4 | topology << 8
+            BindVertexBuffer, // vertex buffer ID
+            Draw, // start index, end index
+            DrawUI, // element count, offset
+            Dispatch, // group count x, y, z, name
+            UploadBuffer, // buffer ID, bytes
+            UploadTexture, // texture type, texture ID, bytes
+            Present,
+            Count
+        };
+
+        /// Texture types in BindTexture and UploadTexture commands. Each type has its own IDs.
+        enum class CommandTextureType : unsigned { Texture2D, TextureCube, RenderTexture };
+
+        /// Records a command. State changes that set the state that is already bound are marked redundant.
+        /// \param command Command.
+        /// \param a First argument, see Command.
+        /// \param b Second argument.
+        /// \param c Third argument.
+        /// \param d Fourth argument.
+        void RecordCommand( Command command, unsigned a, unsigned b, unsigned c, unsigned d );
+
+        /// \param name Marker or dispatch name.
+        /// \return Index of the name in the command log's string table.
+        unsigned GetCommandStringIndex( const char* name );
 #endif
         void ClearScreen( unsigned clearFlags );
         void Draw( VertexBuffer& vertexBuffer, int startIndex, int endIndex, Shader& shader, BlendMode blendMode, DepthFunc depthFunc, CullMode cullMode, FillMode fillMode, PrimitiveTopology topology );
         void DrawLines( int handle, Shader& shader );
+        /// Draws vertices [startVertex, endVertex) as a line list. Both must be multiples of 6, because backends address lines in face units.
+        void DrawLines( VertexBuffer& vertexBuffer, int startVertex, int endVertex, Shader& shader, DepthFunc depthFunc );
 
         void BeginDepthNormalsGpuQuery();
         void EndDepthNormalsGpuQuery();
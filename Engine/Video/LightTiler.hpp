@@ -6,13 +6,15 @@
 #if RENDERER_VULKAN
 #include <vulkan/vulkan.h>
 #endif
+#include <vector>
 #include "Vec3.hpp"
 
 struct ID3D12Resource;
 
 namespace ae3d
 {
-    /// Implements Forward+ light culler
+    /// Implements Forward+ light culler. Lights are culled either per screen tile in a compute shader that reads the depth prepass,
+    /// or per cluster (screen tile split into exponential depth slices) on the CPU, which doesn't need depth.
     class LightTiler
     {
     public:
@@ -21,9 +23,35 @@ namespace ae3d
         void Init();
         void SetPointLightParameters( int bufferIndex, const Vec3& position, float radius, const Vec4& color );
         void SetSpotLightParameters( int bufferIndex, Vec3& position, float radius, const Vec4& color, const Vec3& direction, float coneAngle, float falloffRadius );
+        /// Uploads lights that have changed since the last call. Lights past the active count are uploaded when they become active.
         void UpdateLightBuffers();
         void CullLights( class ComputeShader& shader, const struct Matrix44& projection, const Matrix44& view,  class RenderTexture& depthNormalTarget );
         void ClearLightCount() { activePointLights = activeSpotLights = 0; }
+#if RENDERER_VULKAN
+        /// Starts a new frame's cluster assignments. Each frame in flight writes its own part of the cluster buffer.
+        void BeginClusterFrame();
+        /// Assigns lights to clusters and uploads compact per-cluster light lists into this frame's part of the cluster buffer.
+        /// Every camera gets its own lists, so cameras can be assigned before any of them draws. Doesn't need a depth prepass.
+        /// \param projection Camera's projection matrix.
+        /// \param localToView Camera's view matrix.
+        /// \param nearPlane Camera's near plane.
+        /// \param farPlane Camera's far plane.
+        /// \param targetWidth Width of the camera's render target in pixels.
+        /// \param targetHeight Height of the camera's render target in pixels.
+        /// \return Cluster set index for SetClusterSet(), or -1 if this frame's part of the buffer is full.
+        int AssignLightsToClusters( const Matrix44& projection, const Matrix44& localToView, float nearPlane, float farPlane, int targetWidth, int targetHeight );
+        /// \param index Cluster set returned by AssignLightsToClusters() this frame that following draws read, or -1 for tile light lists.
+        void SetClusterSet( int index ) { currentClusterSet = (index >= 0 && index < (int)clusterSets.size()) ? index : -1; }
+        /// \return True if following draws read cluster light lists.
+        bool IsClusteredCulling() const { return currentClusterSet != -1; }
+        float GetClusterSliceScale() const { return IsClusteredCulling() ? clusterSets[ currentClusterSet ].sliceScale : 0; }
+        float GetClusterSliceBias() const { return IsClusteredCulling() ? clusterSets[ currentClusterSet ].sliceBias : 0; }
+        /// \return Index of the current cluster set's offset table in the cluster buffer.
+        unsigned GetClusterListBase() const { return IsClusteredCulling() ? clusterSets[ currentClusterSet ].listBase : 0; }
+        unsigned GetNumClustersX() const { return IsClusteredCulling() ? clusterSets[ currentClusterSet ].numClustersX : 0; }
+        unsigned GetNumClustersY() const { return IsClusteredCulling() ? clusterSets[ currentClusterSet ].numClustersY : 0; }
+        static const unsigned ClusterSlices = 24;
+#endif
         
 #if RENDERER_METAL
         id< MTLBuffer > GetPerTileLightIndexBuffer() const { return perTileLightIndexBuffer; }
@@ -57,7 +85,7 @@ namespace ae3d
         VkBufferView* GetSpotLightColorBufferView() { return &spotLightColorView; }
         VkBufferView* GetSpotLightBufferView() { return &spotLightBufferView; }
         VkBufferView* GetSpotLightParamsView() { return &spotLightParamsView; }
-        VkBufferView* GetLightIndexBufferView() { return &perTileLightIndexBufferView; }
+        VkBufferView* GetLightIndexBufferView() { return IsClusteredCulling() ? &clusterLightIndexBufferView : &perTileLightIndexBufferView; }
 #endif
         unsigned GetNumTilesX() const;
         unsigned GetNumTilesY() const;
@@ -83,32 +111,79 @@ namespace ae3d
 #if RENDERER_VULKAN
         VkBuffer pointLightCenterAndRadiusBuffer = VK_NULL_HANDLE;
         VkDeviceMemory pointLightCenterAndRadiusMemory = VK_NULL_HANDLE;
+        VkDeviceSize pointLightCenterAndRadiusMemoryOffset = 0;
         void* mappedPointLightCenterAndRadiusMemory = nullptr;
         VkBufferView pointLightBufferView = VK_NULL_HANDLE;
         
         VkBuffer pointLightColorBuffer = VK_NULL_HANDLE;
         VkDeviceMemory pointLightColorMemory = VK_NULL_HANDLE;
+        VkDeviceSize pointLightColorMemoryOffset = 0;
         void* mappedPointLightColorMemory = nullptr;
         VkBufferView pointLightColorView = VK_NULL_HANDLE;
 
         VkBuffer spotLightColorBuffer = VK_NULL_HANDLE;
         VkDeviceMemory spotLightColorMemory = VK_NULL_HANDLE;
+        VkDeviceSize spotLightColorMemoryOffset = 0;
         void* mappedSpotLightColorMemory = nullptr;
         VkBufferView spotLightColorView = VK_NULL_HANDLE;
 
         VkBuffer spotLightCenterAndRadiusBuffer = VK_NULL_HANDLE;
         VkDeviceMemory spotLightCenterAndRadiusMemory = VK_NULL_HANDLE;
+        VkDeviceSize spotLightCenterAndRadiusMemoryOffset = 0;
         void* mappedSpotLightCenterAndRadiusMemory = nullptr;
         VkBufferView spotLightBufferView = VK_NULL_HANDLE;
 
         VkBuffer spotLightParamsBuffer = VK_NULL_HANDLE;
         VkDeviceMemory spotLightParamsMemory = VK_NULL_HANDLE;
+        VkDeviceSize spotLightParamsMemoryOffset = 0;
         void* mappedSpotLightParamsMemory = nullptr;
         VkBufferView spotLightParamsView = VK_NULL_HANDLE;
         
         VkBuffer perTileLightIndexBuffer = VK_NULL_HANDLE;
         VkDeviceMemory perTileLightIndexBufferMemory = VK_NULL_HANDLE;
+        VkDeviceSize perTileLightIndexBufferMemoryOffset = 0;
         VkBufferView perTileLightIndexBufferView = VK_NULL_HANDLE;
+
+        // One part per frame in flight. A part contains a cluster set per clustered camera: cluster offsets followed by
+        // each cluster's point light list, sentinel, spot light list and sentinel. Offsets are indices into the whole buffer.
+        VkBuffer clusterLightIndexBuffer = VK_NULL_HANDLE;
+        VkDeviceMemory clusterLightIndexBufferMemory = VK_NULL_HANDLE;
+        VkDeviceSize clusterLightIndexBufferMemoryOffset = 0;
+        void* mappedClusterLightIndexMemory = nullptr;
+        VkBufferView clusterLightIndexBufferView = VK_NULL_HANDLE;
+
+        struct ClusterRange
+        {
+            int minX, maxX, minY, maxY, minZ, maxZ;
+        };
+
+        struct ClusterSet
+        {
+            unsigned listBase;
+            unsigned numClustersX;
+            unsigned numClustersY;
+            int targetWidth;
+            int targetHeight;
+            float sliceScale;
+            float sliceBias;
+        };
+
+        bool GetClusterRange( const Vec4& centerAndRadius, const Matrix44& projection, const Matrix44& localToView, float nearPlane, float farPlane,
+                              const ClusterSet& clusterSet, ClusterRange& outRange ) const;
+
+        static const int ClusterTileRes = 64;
+        static const unsigned ClusterFrameCount = 3;
+        // Offsets, sentinels and light indices of all cluster sets of a frame.
+        static const unsigned ClusterIndicesPerFrame = 1 << 20;
+        std::vector< ClusterSet > clusterSets;
+        int currentClusterSet = -1;
+        unsigned clusterFrame = 0;
+        // Next free index in the current frame's part of the cluster buffer.
+        unsigned clusterWriteCursor = 0;
+        std::vector< ClusterRange > lightClusterRanges;
+        std::vector< unsigned > clusterLightCounts;
+        std::vector< unsigned > clusterWriteOffsets;
+        std::vector< unsigned > clusterLightIndices;
 #endif
         static const int TileRes = 16;
         static const unsigned MaxLightsPerTile = 544;
@@ -119,6 +194,11 @@ namespace ae3d
         Vec4 spotLightParams[ MaxLights ];
         int activePointLights = 0;
         int activeSpotLights = 0;
+        // Inclusive index ranges of lights that have changed since they were last uploaded. Empty when first > last.
+        int firstDirtyPointLight = 0;
+        int lastDirtyPointLight = MaxLights - 1;
+        int firstDirtySpotLight = 0;
+        int lastDirtySpotLight = MaxLights - 1;
     };
 }
 
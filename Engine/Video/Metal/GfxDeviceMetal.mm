@@ -1,6 +1,8 @@
 #import <Foundation/Foundation.h>
 #import <MetalKit/MetalKit.h>
 #include <string.h>
+#include <algorithm>
+#include <limits>
 #include <unordered_map>
 #include <vector>
 #include "GfxDevice.hpp"
@@ -111,6 +113,11 @@ namespace GfxDeviceGlobal
     ae3d::VertexBuffer uiBuffer2;
     PerObjectUboStruct perObjectUboStruct;
     id <MTLRenderPipelineState> cachedPSO;
+    // Joint matrices of skinned draws, alternated by frameIndex like the UI buffers so the CPU doesn't overwrite the frame in flight.
+    id<MTLBuffer> boneBuffers[ 2 ];
+    unsigned boneMatrixCapacities[ 2 ] = {};
+    unsigned boneMatrixCount = 0;
+    unsigned boneBufferFrame = 0;
     
     struct Samplers
     {
@@ -247,6 +254,15 @@ namespace ae3d
                 str += " MiB\n";
                 std::strcpy( outStr, str.c_str() );
             }
+
+            void GetPassTimings( char* outStr, int outStrLength )
+            {
+                // Pass timings are not collected in this renderer.
+                if (outStrLength > 0)
+                {
+                    outStr[ 0 ] = '\0';
+                }
+            }
         }
     }
 }
@@ -261,6 +277,49 @@ void ae3d::GfxDevice::GetNewUniformBuffer()
     GfxDeviceGlobal::currentUboIndex = (GfxDeviceGlobal::currentUboIndex + 1) % UboCount;
 }
 
+static void CreateBoneBuffer( unsigned bufferIndex, unsigned capacity )
+{
+    id<MTLBuffer> newBuffer = [ae3d::GfxDevice::GetMetalDevice() newBufferWithLength:capacity * sizeof( ae3d::Matrix44 ) options:MTLResourceStorageModeShared];
+    newBuffer.label = @"bone buffer";
+
+    if (GfxDeviceGlobal::boneBuffers[ bufferIndex ] != nil)
+    {
+        // Draws encoded earlier this frame keep the old buffer alive, but draws encoded after this point need their matrices too.
+        memcpy( [newBuffer contents], [GfxDeviceGlobal::boneBuffers[ bufferIndex ] contents], GfxDeviceGlobal::boneMatrixCount * sizeof( ae3d::Matrix44 ) );
+    }
+
+    GfxDeviceGlobal::boneBuffers[ bufferIndex ] = newBuffer;
+    GfxDeviceGlobal::boneMatrixCapacities[ bufferIndex ] = capacity;
+}
+
+unsigned ae3d::GfxDevice::UploadBoneMatrices( const Matrix44* matrices, unsigned count )
+{
+    const unsigned bufferIndex = GfxDeviceGlobal::frameIndex % 2;
+    const unsigned offset = GfxDeviceGlobal::boneMatrixCount;
+
+    if (offset + count > GfxDeviceGlobal::boneMatrixCapacities[ bufferIndex ])
+    {
+        CreateBoneBuffer( bufferIndex, (unsigned)VertexBuffer::GetGrownCapacity( (int)(offset + count), (int)GfxDeviceGlobal::boneMatrixCapacities[ bufferIndex ],
+                                                                                 std::numeric_limits< int >::max() / (int)sizeof( Matrix44 ) ) );
+    }
+
+    Matrix44* boneMatrices = (Matrix44*)[GfxDeviceGlobal::boneBuffers[ bufferIndex ] contents];
+    std::copy( matrices, matrices + count, boneMatrices + offset );
+    GfxDeviceGlobal::boneMatrixCount += count;
+
+    return offset;
+}
+
+unsigned ae3d::GfxDevice::GetBoneBufferFrame()
+{
+    return GfxDeviceGlobal::boneBufferFrame;
+}
+
+id <MTLBuffer> ae3d::GfxDevice::GetCurrentBoneBuffer()
+{
+    return GfxDeviceGlobal::boneBuffers[ GfxDeviceGlobal::frameIndex % 2 ];
+}
+
 id <MTLBuffer> ae3d::GfxDevice::GetCurrentUniformBuffer()
 {
     return GfxDeviceGlobal::uniformBuffers[ GfxDeviceGlobal::currentUboIndex ];
@@ -395,6 +454,9 @@ void ae3d::GfxDevice::InitMetal( id <MTLDevice> metalDevice, MTKView* aView, int
 #endif
         GfxDeviceGlobal::uniformBuffers[ uboIndex ].label = @"uniform buffer";
     }
+
+    CreateBoneBuffer( 0, 1024 );
+    CreateBoneBuffer( 1, 1024 );
     
     MTLDepthStencilDescriptor *depthStateDesc = [[MTLDepthStencilDescriptor alloc] init];
     depthStateDesc.depthCompareFunction = MTLCompareFunctionLessEqual;
@@ -704,7 +766,12 @@ void ae3d::GfxDevice::DrawLines( int handle, Shader& shader )
         return;
     }
     
-    Draw( GfxDeviceGlobal::lineBuffers[ handle ], 0, GfxDeviceGlobal::lineBuffers[ handle ].GetFaceCount(), shader, BlendMode::Off, DepthFunc::LessOrEqualWriteOn, CullMode::Off, FillMode::Solid, GfxDevice::PrimitiveTopology::Lines );
+    Draw( GfxDeviceGlobal::lineBuffers[ handle ], 0, GfxDeviceGlobal::lineBuffers[ handle ].GetFaceCount() / 3, shader, BlendMode::Off, DepthFunc::LessOrEqualWriteOn, CullMode::Off, FillMode::Solid, GfxDevice::PrimitiveTopology::Lines );
+}
+
+void ae3d::GfxDevice::DrawLines( VertexBuffer& vertexBuffer, int startVertex, int endVertex, Shader& shader, DepthFunc depthFunc )
+{
+    Draw( vertexBuffer, startVertex / 3, endVertex / 3, shader, BlendMode::Off, depthFunc, CullMode::Off, FillMode::Solid, GfxDevice::PrimitiveTopology::Lines );
 }
 
 void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startIndex, int endIndex, Shader& shader, BlendMode blendMode, DepthFunc depthFunc, CullMode cullMode, FillMode fillMode, PrimitiveTopology topology )
@@ -741,6 +808,7 @@ void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startIndex, int endI
     
     [renderEncoder setVertexBuffer:vertexBuffer.GetVertexBuffer() offset:0 atIndex:0];
     [renderEncoder setVertexBuffer:GetCurrentUniformBuffer() offset:0 atIndex:5];
+    [renderEncoder setVertexBuffer:GfxDeviceGlobal::boneBuffers[ GfxDeviceGlobal::frameIndex % 2 ] offset:0 atIndex:6];
     
     MTLViewport viewport;
     viewport.originX = GfxDeviceGlobal::viewport[ 0 ];
@@ -846,7 +914,7 @@ void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startIndex, int endI
     }
     else // MTLPrimitiveTypeLine
     {
-        [renderEncoder drawPrimitives:MTLPrimitiveTypeLine vertexStart:0 vertexCount:vertexBuffer.GetFaceCount()];
+        [renderEncoder drawPrimitives:MTLPrimitiveTypeLine vertexStart:startIndex * 3 vertexCount:(endIndex - startIndex) * 3];
     }
     
     textures[ 12 ] = TextureCube::GetDefaultTexture()->GetMetalTexture();
@@ -882,6 +950,8 @@ void ae3d::GfxDevice::PresentDrawable()
     }
     
     ++GfxDeviceGlobal::frameIndex;
+    GfxDeviceGlobal::boneMatrixCount = 0;
+    ++GfxDeviceGlobal::boneBufferFrame;
 }
 
 void ae3d::GfxDevice::SetClearColor( float red, float green, float blue )
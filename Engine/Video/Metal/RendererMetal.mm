@@ -7,6 +7,8 @@ ae3d::Renderer renderer;
 
 id< MTLBuffer > particleBuffer;
 id< MTLBuffer > particleTileBuffer;
+// Parameters of the emitters in the particle simulation dispatch. Alternates between frames, because the CPU writes the next frame's emitters while the GPU reads.
+id< MTLBuffer > particleEmitterBuffers[ 2 ];
 
 void ae3d::BuiltinShaders::Load()
 {
@@ -22,10 +24,10 @@ void ae3d::BuiltinShaders::Load()
     particleSimulationShader.Load( "particle_simulation", FileSystem::FileContents(""), FileSystem::FileContents("") );
     particleDrawShader.Load( "particle_draw", FileSystem::FileContents(""), FileSystem::FileContents("") );
     particleCullShader.Load( "particle_cull", FileSystem::FileContents( "" ), FileSystem::FileContents( "" ) );
+    skinningShader.Load( "skin_vertices", FileSystem::FileContents( "" ), FileSystem::FileContents( "" ) );
     uiShader.LoadFromLibrary( "sprite_vertex", "sprite_fragment" );
     
-    const unsigned maxParticleCount = 1000000;
-    particleBuffer = [GfxDevice::GetMetalDevice() newBufferWithLength:sizeof( Particle ) * maxParticleCount
+    particleBuffer = [GfxDevice::GetMetalDevice() newBufferWithLength:sizeof( Particle ) * MaxParticleCount
                               options:MTLResourceStorageModePrivate];
     particleBuffer.label = @"Particle buffer";
     
@@ -35,4 +37,11 @@ void ae3d::BuiltinShaders::Load()
     particleTileBuffer = [GfxDevice::GetMetalDevice() newBufferWithLength:maxParticlesPerTile * tileCount * sizeof( unsigned )
                   options:MTLResourceStorageModePrivate];
     particleTileBuffer.label = @"particleTileBuffer";
+
+    for (int i = 0; i < 2; ++i)
+    {
+        particleEmitterBuffers[ i ] = [GfxDevice::GetMetalDevice() newBufferWithLength:sizeof( ParticleEmitter ) * MaxParticleEmitterCount
+                                       options:MTLResourceStorageModeShared];
+        particleEmitterBuffers[ i ].label = @"Particle emitter buffer";
+    }
 }
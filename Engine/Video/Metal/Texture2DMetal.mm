@@ -396,7 +396,6 @@ void ae3d::Texture2D::LoadFromData( const void* imageData, int aWidth, int aHeig
 {
     width = aWidth;
     height = aHeight;
-    wrap = TextureWrap::Repeat;
     filter = TextureFilter::Linear;
     opaque = true;
     
@@ -457,6 +456,40 @@ void ae3d::Texture2D::LoadFromData( const void* imageData, int aWidth, int aHeig
     }
 }
 
+void ae3d::Texture2D::UpdateRegion( const void* rgbaPixels, int x, int y, int regionWidth, int regionHeight )
+{
+    System::Assert( metalTexture != nil, "UpdateRegion needs a texture created by LoadFromData" );
+    System::Assert( x >= 0 && y >= 0 && x + regionWidth <= width && y + regionHeight <= height, "UpdateRegion: region is outside the texture" );
+
+    // The texture is private, so the region goes through a shared staging texture like in LoadFromData.
+    MTLTextureDescriptor* textureDescriptor =
+    [MTLTextureDescriptor texture2DDescriptorWithPixelFormat:metalTexture.pixelFormat
+                                                       width:regionWidth
+                                                      height:regionHeight
+                                                   mipmapped:NO];
+    textureDescriptor.usage = MTLTextureUsageShaderRead;
+    id<MTLTexture> stagingTexture = [GfxDevice::GetMetalDevice() newTextureWithDescriptor:textureDescriptor];
+    stagingTexture.label = @"Texture2D region staging";
+
+    [stagingTexture replaceRegion:MTLRegionMake2D( 0, 0, regionWidth, regionHeight ) mipmapLevel:0 withBytes:rgbaPixels bytesPerRow:regionWidth * 4];
+
+    id <MTLCommandBuffer> cmd_buffer = [commandQueue commandBuffer];
+    cmd_buffer.label = @"BlitCommandBuffer";
+    id <MTLBlitCommandEncoder> blit_encoder = [cmd_buffer blitCommandEncoder];
+    [blit_encoder copyFromTexture:stagingTexture
+                      sourceSlice:0
+                      sourceLevel:0
+                     sourceOrigin:MTLOriginMake( 0, 0, 0 )
+                       sourceSize:MTLSizeMake( regionWidth, regionHeight, 1 )
+                        toTexture:metalTexture
+                 destinationSlice:0
+                 destinationLevel:0
+                destinationOrigin:MTLOriginMake( x, y, 0 ) ];
+    [blit_encoder endEncoding];
+    [cmd_buffer commit];
+    [cmd_buffer waitUntilCompleted];
+}
+
 void ae3d::Texture2D::SetLayout( TextureLayout aLayout )
 {
     // Not needed on Metal.
@@ -597,6 +597,29 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
     vertexBufferMemoryUsage += [colorBuffer allocatedSize];
 }
 
+void ae3d::VertexBuffer::GenerateWritable( const Face* faces, int faceCount, int vertexCount )
+{
+    if (faceCount == 0)
+    {
+        return;
+    }
+
+    vertexFormat = VertexFormat::PTNTC;
+    vertexBuffer = [GfxDevice::GetMetalDevice() newBufferWithLength:sizeof( VertexPTNTC ) * vertexCount
+                      options:MTLResourceStorageModePrivate];
+    vertexBuffer.label = @"Writable vertex buffer PTNTC";
+
+    indexBuffer = [GfxDevice::GetMetalDevice() newBufferWithBytes:faces
+                      length:sizeof( Face ) * faceCount
+                     options:MTLResourceCPUCacheModeDefaultCache];
+    indexBuffer.label = @"Index buffer";
+
+    elementCount = faceCount * 3;
+
+    vertexBufferMemoryUsage += [vertexBuffer allocatedSize];
+    vertexBufferMemoryUsage += [indexBuffer allocatedSize];
+}
+
 void ae3d::VertexBuffer::GenerateDynamic( int faceCount, int vertexCount )
 {
     vertexFormat = VertexFormat::PTC;
@@ -627,3 +650,27 @@ void ae3d::VertexBuffer::UpdateDynamic( const Face* faces, int faceCount, const
     memcpy( [vertexBuffer contents], vertices, sizeof( VertexPTC ) * vertexCount );
     memcpy( [indexBuffer contents], faces, sizeof( Face ) * faceCount );
 }
+
+void ae3d::VertexBuffer::UpdateDynamic( const Face* faces, int faceCount, const VertexPTNTC* vertices, int vertexCount )
+{
+    // GenerateDynamic() creates a PTC buffer, so it's replaced on the first PTNTC update.
+    if (vertexFormat != VertexFormat::PTNTC || [vertexBuffer length] < sizeof( VertexPTNTC ) * vertexCount)
+    {
+        vertexFormat = VertexFormat::PTNTC;
+        vertexBuffer = [GfxDevice::GetMetalDevice() newBufferWithLength:sizeof( VertexPTNTC ) * vertexCount
+                                  options:MTLResourceCPUCacheModeDefaultCache];
+        vertexBuffer.label = @"Dynamic Vertex buffer PTNTC";
+        vertexBufferMemoryUsage += [vertexBuffer allocatedSize];
+    }
+
+    memcpy( [vertexBuffer contents], vertices, sizeof( VertexPTNTC ) * vertexCount );
+    memcpy( [indexBuffer contents], faces, sizeof( Face ) * faceCount );
+}
+
+void ae3d::VertexBuffer::UpdateDynamicVertices( const VertexPTNTC* vertices, int firstVertex, int vertexCount )
+{
+    System::Assert( vertexFormat == VertexFormat::PTNTC, "Must call UpdateDynamic with PTNTC vertices before UpdateDynamicVertices!" );
+    System::Assert( [vertexBuffer length] >= sizeof( VertexPTNTC ) * (firstVertex + vertexCount), "UpdateDynamicVertices is outside the buffer" );
+
+    memcpy( static_cast< char* >( [vertexBuffer contents] ) + sizeof( VertexPTNTC ) * firstVertex, vertices, sizeof( VertexPTNTC ) * vertexCount );
+}
@@ -0,0 +1,86 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "ComputeShader.hpp"
+#include "FileSystem.hpp"
+#include "GfxDevice.hpp"
+#include "Matrix.hpp"
+#include "System.hpp"
+
+namespace GfxDeviceGlobal
+{
+    extern PerObjectUboStruct perObjectUboStruct;
+}
+
+void ae3d::ComputeShader::Begin()
+{
+}
+
+void ae3d::ComputeShader::End()
+{
+}
+
+void ae3d::ComputeShader::SetUniform( UniformName uniform, float x, float y )
+{
+    if (uniform == UniformName::TilesZW)
+    {
+        GfxDeviceGlobal::perObjectUboStruct.tilesXY.z = x;
+        GfxDeviceGlobal::perObjectUboStruct.tilesXY.w = y;
+    }
+    else if (uniform == UniformName::BloomThreshold)
+    {
+        GfxDeviceGlobal::perObjectUboStruct.bloomThreshold = x;
+    }
+    else if (uniform == UniformName::BloomIntensity)
+    {
+        GfxDeviceGlobal::perObjectUboStruct.bloomIntensity = x;
+    }
+}
+
+void ae3d::ComputeShader::SetProjectionMatrix( const struct Matrix44& projection )
+{
+    GfxDeviceGlobal::perObjectUboStruct.viewToClip = projection;
+    Matrix44::Invert( GfxDeviceGlobal::perObjectUboStruct.viewToClip, GfxDeviceGlobal::perObjectUboStruct.clipToView );
+}
+
+void ae3d::ComputeShader::Dispatch( unsigned groupCountX, unsigned groupCountY, unsigned groupCountZ, const char* debugName )
+{
+    GfxDevice::RecordCommand( GfxDevice::Command::Dispatch, groupCountX, groupCountY, groupCountZ, GfxDevice::GetCommandStringIndex( debugName ) );
+}
+
+void ae3d::ComputeShader::Load( const char* /*source*/ )
+{
+    for (int slot = 0; slot < SLOT_COUNT; ++slot)
+    {
+        renderTextures[ slot ] = nullptr;
+        renderTextureDepths[ slot ] = nullptr;
+    }
+}
+
+void ae3d::ComputeShader::Load( const char* /*metalShaderName*/, const FileSystem::FileContentsData& /*dataHLSL*/, const FileSystem::FileContentsData& /*dataSPIRV*/ )
+{
+    Load( "" );
+}
+
+void ae3d::ComputeShader::SetTexture2D( Texture2D* /*texture*/, unsigned /*slot*/ )
+{
+}
+
+void ae3d::ComputeShader::SetRenderTexture( RenderTexture* renderTexture, unsigned slot )
+{
+    System::Assert( slot < SLOT_COUNT, "ComputeShader::SetRenderTexture: Too high slot!" );
+
+    if (slot < SLOT_COUNT)
+    {
+        renderTextures[ slot ] = renderTexture;
+    }
+}
+
+void ae3d::ComputeShader::SetRenderTextureDepth( RenderTexture* renderTexture, unsigned slot )
+{
+    System::Assert( slot < SLOT_COUNT, "ComputeShader::SetRenderTextureDepth: Too high slot!" );
+
+    if (slot < SLOT_COUNT)
+    {
+        renderTextureDepths[ slot ] = renderTexture;
+    }
+}
@@ -0,0 +1,498 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "GfxDevice.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "LightTiler.hpp"
+#include "RenderTexture.hpp"
+#include "Renderer.hpp"
+#include "Shader.hpp"
+#include "Statistics.hpp"
+#include "System.hpp"
+#include "Texture2D.hpp"
+#include "TextureCube.hpp"
+#include "VertexBuffer.hpp"
+
+extern ae3d::Renderer renderer;
+
+namespace GfxDeviceGlobal
+{
+    struct CommandRecord
+    {
+        ae3d::GfxDevice::Command command = ae3d::GfxDevice::Command::Present;
+        bool isRedundant = false;
+        unsigned args[ 4 ] = {};
+    };
+
+    struct BoundState
+    {
+        unsigned args[ 4 ] = {};
+        bool isBound = false;
+    };
+
+    const unsigned MaxTextureUnits = 16;
+
+    PerObjectUboStruct perObjectUboStruct;
+    ae3d::LightTiler lightTiler;
+    std::vector< ae3d::VertexBuffer > lineBuffers;
+    std::vector< CommandRecord > commands;
+    std::vector< CommandRecord > presentedCommands;
+    std::vector< std::string > commandStrings;
+    BoundState boundStates[ static_cast< int >( ae3d::GfxDevice::Command::Count ) ];
+    BoundState boundTextures[ MaxTextureUnits ];
+    std::vector< char > uiVertices;
+    std::vector< char > uiIndices;
+    std::vector< ae3d::Matrix44 > boneMatrices;
+    unsigned boneMatrixCount = 0;
+    unsigned boneBufferFrame = 0;
+    unsigned long long totalUploadBytes = 0;
+    int sampleCount = 1;
+}
+
+namespace
+{
+    struct CommandInfo
+    {
+        const char* name;
+        int argCount;
+        int stringArg; // Index of the argument that indexes the string table, -1 for none.
+        bool isStateChange;
+    };
+
+    const CommandInfo commandInfos[] =
+    {
+        { "ClearScreen", 1, -1, false },
+        { "SetClearColor", 3, -1, true },
+        { "SetRenderTarget", 2, -1, true },
+        { "SetViewport", 4, -1, true },
+        { "SetScissor", 4, -1, true },
+        { "SetPolygonOffset", 3, -1, true },
+        { "PushGroupMarker", 1, 0, false },
+        { "PopGroupMarker", 0, -1, false },
+        { "BindShader", 1, -1, true },
+        { "BindTexture", 3, -1, true },
+        { "BindPipeline", 4, -1, true },
+        { "BindVertexBuffer", 1, -1, true },
+        { "Draw", 2, -1, false },
+        { "DrawUI", 2, -1, false },
+        { "Dispatch", 4, 3, false },
+        { "UploadBuffer", 2, -1, false },
+        { "UploadTexture", 3, -1, false },
+        { "Present", 0, -1, false },
+    };
+
+    static_assert( sizeof( commandInfos ) / sizeof( commandInfos[ 0 ] ) == static_cast< int >( ae3d::GfxDevice::Command::Count ), "commandInfos must have an entry for every command" );
+
+    unsigned FloatBits( float f )
+    {
+        unsigned bits;
+        std::memcpy( &bits, &f, sizeof( bits ) );
+        return bits;
+    }
+
+    void ResetBoundStates()
+    {
+        for (auto& state : GfxDeviceGlobal::boundStates)
+        {
+            state.isBound = false;
+        }
+
+        for (auto& state : GfxDeviceGlobal::boundTextures)
+        {
+            state.isBound = false;
+        }
+    }
+}
+
+namespace ae3d
+{
+    namespace System
+    {
+        namespace Statistics
+        {
+            void GetStatistics( char* outStr )
+            {
+                std::stringstream stm;
+                stm << "frame time: " << ::Statistics::GetFrameTimeMS() << "ms\n";
+                stm << "shadow pass time CPU: " << ::Statistics::GetShadowMapTimeMS() << "ms\n";
+                stm << "depth pass time CPU: " << ::Statistics::GetDepthNormalsTimeMS() << "ms\n";
+                stm << "light update time CPU: " << ::Statistics::GetLightUpdateTimeMS() << "ms\n";
+                stm << "draw calls: " << ::Statistics::GetDrawCalls() << "\n";
+                stm << "triangles: " << ::Statistics::GetTriangleCount() << "\n";
+                stm << "PSO binds: " << ::Statistics::GetPSOBindCalls() << "\n";
+                stm << "audio voices: " << ::Statistics::GetAudioVoiceCount() << ", virtual: " << ::Statistics::GetVirtualAudioVoiceCount() << "\n";
+                stm << "recorded commands: " << GetCommandCount() << "\n";
+                stm << "redundant state changes: " << GetRedundantStateChangeCount() << "\n";
+                stm << "upload bytes: " << GetUploadBytes() << "\n";
+
+                std::strcpy( outStr, stm.str().c_str() );
+            }
+
+            void GetPassTimings( char* outStr, int outStrLength )
+            {
+                // Not implemented in this renderer.
+                if (outStrLength > 0)
+                {
+                    outStr[ 0 ] = '\0';
+                }
+            }
+
+            int GetCommandCount()
+            {
+                return static_cast< int >( GfxDeviceGlobal::presentedCommands.size() );
+            }
+
+            int GetRedundantStateChangeCount()
+            {
+                int count = 0;
+
+                for (const auto& record : GfxDeviceGlobal::presentedCommands)
+                {
+                    count += record.isRedundant ? 1 : 0;
+                }
+
+                return count;
+            }
+
+            unsigned long long GetUploadBytes()
+            {
+                unsigned long long bytes = 0;
+
+                for (const auto& record : GfxDeviceGlobal::presentedCommands)
+                {
+                    if (record.command == GfxDevice::Command::UploadBuffer)
+                    {
+                        bytes += record.args[ 1 ];
+                    }
+                    else if (record.command == GfxDevice::Command::UploadTexture)
+                    {
+                        bytes += record.args[ 2 ];
+                    }
+                }
+
+                return bytes;
+            }
+
+            bool WriteCommandLog( const char* path )
+            {
+                FILE* file = std::fopen( path, "wb" );
+
+                if (file == nullptr)
+                {
+                    return false;
+                }
+
+                int depth = 0;
+
+                for (const auto& record : GfxDeviceGlobal::presentedCommands)
+                {
+                    const CommandInfo& info = commandInfos[ static_cast< int >( record.command ) ];
+
+                    if (record.command == GfxDevice::Command::PopGroupMarker && depth > 0)
+                    {
+                        --depth;
+                    }
+
+                    std::fprintf( file, "%*s%s", depth * 2, "", info.name );
+
+                    for (int argIndex = 0; argIndex < info.argCount; ++argIndex)
+                    {
+                        if (argIndex == info.stringArg)
+                        {
+                            std::fprintf( file, " \"%s\"", GfxDeviceGlobal::commandStrings[ record.args[ argIndex ] ].c_str() );
+                        }
+                        else
+                        {
+                            std::fprintf( file, " %u", record.args[ argIndex ] );
+                        }
+                    }
+
+                    std::fprintf( file, "%s\n", record.isRedundant ? " redundant" : "" );
+
+                    if (record.command == GfxDevice::Command::PushGroupMarker)
+                    {
+                        ++depth;
+                    }
+                }
+
+                return std::fclose( file ) == 0;
+            }
+        }
+    }
+
+    namespace GfxDevice
+    {
+        unsigned backBufferWidth = 640;
+        unsigned backBufferHeight = 480;
+    }
+
+    void CreateRenderer( int samples, bool /*apiValidation*/ )
+    {
+        renderer.GenerateSSAOKernel( 16, GfxDeviceGlobal::perObjectUboStruct.kernelOffsets );
+        GfxDeviceGlobal::perObjectUboStruct.kernelSize = 16;
+        GfxDeviceGlobal::perObjectUboStruct.particleReset = 1;
+        GfxDeviceGlobal::sampleCount = samples;
+        GfxDeviceGlobal::lightTiler.Init();
+    }
+}
+
+void ae3d::GfxDevice::RecordCommand( Command command, unsigned a, unsigned b, unsigned c, unsigned d )
+{
+    GfxDeviceGlobal::CommandRecord record;
+    record.command = command;
+    record.args[ 0 ] = a;
+    record.args[ 1 ] = b;
+    record.args[ 2 ] = c;
+    record.args[ 3 ] = d;
+
+    if (commandInfos[ static_cast< int >( command ) ].isStateChange)
+    {
+        // Texture bindings are tracked per unit, other state per command.
+        GfxDeviceGlobal::BoundState* state = &GfxDeviceGlobal::boundStates[ static_cast< int >( command ) ];
+
+        if (command == Command::BindTexture)
+        {
+            state = a < GfxDeviceGlobal::MaxTextureUnits ? &GfxDeviceGlobal::boundTextures[ a ] : nullptr;
+        }
+
+        if (state != nullptr)
+        {
+            record.isRedundant = state->isBound && std::memcmp( state->args, record.args, sizeof( record.args ) ) == 0;
+            std::memcpy( state->args, record.args, sizeof( record.args ) );
+            state->isBound = true;
+        }
+    }
+
+    if (command == Command::UploadBuffer)
+    {
+        GfxDeviceGlobal::totalUploadBytes += b;
+    }
+    else if (command == Command::UploadTexture)
+    {
+        GfxDeviceGlobal::totalUploadBytes += c;
+    }
+
+    GfxDeviceGlobal::commands.push_back( record );
+}
+
+unsigned ae3d::GfxDevice::GetCommandStringIndex( const char* name )
+{
+    const char* str = name != nullptr ? name : "";
+
+    for (std::size_t i = 0; i < GfxDeviceGlobal::commandStrings.size(); ++i)
+    {
+        if (GfxDeviceGlobal::commandStrings[ i ] == str)
+        {
+            return static_cast< unsigned >( i );
+        }
+    }
+
+    GfxDeviceGlobal::commandStrings.push_back( str );
+    return static_cast< unsigned >( GfxDeviceGlobal::commandStrings.size() - 1 );
+}
+
+void ae3d::GfxDevice::Init( int width, int height )
+{
+    backBufferWidth = width;
+    backBufferHeight = height;
+}
+
+void ae3d::GfxDevice::DrawUI( int scX, int scY, int scWidth, int scHeight, int elemCount, int offset )
+{
+    int scissor[ 4 ] = { scX, scY, scWidth, scHeight };
+    SetScissor( scissor );
+    RecordCommand( Command::DrawUI, elemCount, offset, 0, 0 );
+    Statistics::IncTriangleCount( elemCount / 3 );
+    Statistics::IncDrawCalls();
+}
+
+void ae3d::GfxDevice::MapUIVertexBuffer( int vertexSize, int indexSize, void** outMappedVertices, void** outMappedIndices )
+{
+    GfxDeviceGlobal::uiVertices.resize( vertexSize );
+    GfxDeviceGlobal::uiIndices.resize( indexSize );
+    *outMappedVertices = GfxDeviceGlobal::uiVertices.data();
+    *outMappedIndices = GfxDeviceGlobal::uiIndices.data();
+}
+
+void ae3d::GfxDevice::UnmapUIVertexBuffer()
+{
+    RecordCommand( Command::UploadBuffer, 0, static_cast< unsigned >( GfxDeviceGlobal::uiVertices.size() + GfxDeviceGlobal::uiIndices.size() ), 0, 0 );
+}
+
+void ae3d::GfxDevice::GetNewUniformBuffer()
+{
+}
+
+unsigned ae3d::GfxDevice::UploadBoneMatrices( const Matrix44* matrices, unsigned count )
+{
+    const unsigned offset = GfxDeviceGlobal::boneMatrixCount;
+
+    if (offset + count > GfxDeviceGlobal::boneMatrices.size())
+    {
+        GfxDeviceGlobal::boneMatrices.resize( offset + count );
+    }
+
+    std::copy( matrices, matrices + count, GfxDeviceGlobal::boneMatrices.data() + offset );
+    GfxDeviceGlobal::boneMatrixCount += count;
+    RecordCommand( Command::UploadBuffer, 0, static_cast< unsigned >( count * sizeof( Matrix44 ) ), 0, 0 );
+
+    return offset;
+}
+
+unsigned ae3d::GfxDevice::GetBoneBufferFrame()
+{
+    return GfxDeviceGlobal::boneBufferFrame;
+}
+
+void ae3d::GfxDevice::ClearScreen( unsigned clearFlags )
+{
+    RecordCommand( Command::ClearScreen, clearFlags, 0, 0, 0 );
+}
+
+void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startIndex, int endIndex, Shader& shader, BlendMode blendMode, DepthFunc depthFunc,
+                            CullMode cullMode, FillMode fillMode, PrimitiveTopology topology )
+{
+    System::Assert( shader.GetID() != 0, "Shader is not loaded" );
+    // Lines are drawn without indices.
+    System::Assert( topology == PrimitiveTopology::Lines || endIndex <= vertexBuffer.GetUploadedFaceCount(), "Draw reads faces whose indices were not uploaded" );
+
+    // Pipeline and vertex buffer are bound only when they change, like a real backend does.
+    const unsigned rasterState = static_cast< unsigned >( cullMode ) | static_cast< unsigned >( fillMode ) << 4 | static_cast< unsigned >( topology ) << 8;
+    const GfxDeviceGlobal::BoundState& pipeline = GfxDeviceGlobal::boundStates[ static_cast< int >( Command::BindPipeline ) ];
+    const unsigned pipelineArgs[ 4 ] = { static_cast< unsigned >( vertexBuffer.GetVertexFormat() ), static_cast< unsigned >( blendMode ), static_cast< unsigned >( depthFunc ), rasterState };
+
+    if (!pipeline.isBound || std::memcmp( pipeline.args, pipelineArgs, sizeof( pipelineArgs ) ) != 0)
+    {
+        RecordCommand( Command::BindPipeline, pipelineArgs[ 0 ], pipelineArgs[ 1 ], pipelineArgs[ 2 ], pipelineArgs[ 3 ] );
+        Statistics::IncPSOBindCalls();
+    }
+
+    const GfxDeviceGlobal::BoundState& boundVertexBuffer = GfxDeviceGlobal::boundStates[ static_cast< int >( Command::BindVertexBuffer ) ];
+
+    if (!boundVertexBuffer.isBound || boundVertexBuffer.args[ 0 ] != vertexBuffer.GetID())
+    {
+        vertexBuffer.Bind();
+    }
+
+    RecordCommand( Command::Draw, startIndex, endIndex, 0, 0 );
+
+    Statistics::IncTriangleCount( endIndex - startIndex );
+    Statistics::IncDrawCalls();
+}
+
+void ae3d::GfxDevice::DrawLines( int handle, Shader& shader )
+{
+    if (handle < 0)
+    {
+        return;
+    }
+
+    Draw( GfxDeviceGlobal::lineBuffers[ handle ], 0, GfxDeviceGlobal::lineBuffers[ handle ].GetFaceCount(), shader, BlendMode::Off, DepthFunc::NoneWriteOff, CullMode::Off, FillMode::Solid, PrimitiveTopology::Lines );
+}
+
+void ae3d::GfxDevice::DrawLines( VertexBuffer& vertexBuffer, int startVertex, int endVertex, Shader& shader, DepthFunc depthFunc )
+{
+    Draw( vertexBuffer, startVertex / 3, endVertex / 3, shader, BlendMode::Off, depthFunc, CullMode::Off, FillMode::Solid, PrimitiveTopology::Lines );
+}
+
+void ae3d::GfxDevice::BeginDepthNormalsGpuQuery()
+{
+}
+
+void ae3d::GfxDevice::EndDepthNormalsGpuQuery()
+{
+}
+
+void ae3d::GfxDevice::BeginShadowMapGpuQuery()
+{
+}
+
+void ae3d::GfxDevice::EndShadowMapGpuQuery()
+{
+}
+
+void ae3d::GfxDevice::BeginLightCullerGpuQuery()
+{
+}
+
+void ae3d::GfxDevice::EndLightCullerGpuQuery()
+{
+}
+
+void ae3d::GfxDevice::SetClearColor( float red, float green, float blue )
+{
+    RecordCommand( Command::SetClearColor, static_cast< unsigned >( red * 255 + 0.5f ), static_cast< unsigned >( green * 255 + 0.5f ), static_cast< unsigned >( blue * 255 + 0.5f ), 0 );
+}
+
+void ae3d::GfxDevice::SetRenderTarget( RenderTexture* target, unsigned cubeMapFace )
+{
+    System::Assert( !target || target->IsRenderTexture(), "target must be render texture" );
+    System::Assert( cubeMapFace < 6, "invalid cube map face" );
+
+    RecordCommand( Command::SetRenderTarget, target != nullptr ? target->GetID() : 0, cubeMapFace, 0, 0 );
+
+    if (!GfxDeviceGlobal::commands.back().isRedundant)
+    {
+        Statistics::IncRenderTargetBinds();
+    }
+}
+
+void ae3d::GfxDevice::SetViewport( int viewport[ 4 ] )
+{
+    RecordCommand( Command::SetViewport, viewport[ 0 ], viewport[ 1 ], viewport[ 2 ], viewport[ 3 ] );
+}
+
+void ae3d::GfxDevice::SetScissor( int scissor[ 4 ] )
+{
+    RecordCommand( Command::SetScissor, scissor[ 0 ], scissor[ 1 ], scissor[ 2 ], scissor[ 3 ] );
+}
+
+void ae3d::GfxDevice::PushGroupMarker( const char* name )
+{
+    RecordCommand( Command::PushGroupMarker, GetCommandStringIndex( name ), 0, 0, 0 );
+}
+
+void ae3d::GfxDevice::PopGroupMarker()
+{
+    RecordCommand( Command::PopGroupMarker, 0, 0, 0, 0 );
+}
+
+void ae3d::GfxDevice::SetPolygonOffset( bool enable, float factor, float units )
+{
+    RecordCommand( Command::SetPolygonOffset, enable ? 1 : 0, enable ? FloatBits( factor ) : 0, enable ? FloatBits( units ) : 0, 0 );
+}
+
+void ae3d::GfxDevice::GetGpuMemoryUsage( unsigned& outUsedMBytes, unsigned& outBudgetMBytes )
+{
+    outUsedMBytes = static_cast< unsigned >( GfxDeviceGlobal::totalUploadBytes / (1024 * 1024) );
+    outBudgetMBytes = 0;
+}
+
+void ae3d::GfxDevice::Present()
+{
+    RecordCommand( Command::Present, 0, 0, 0, 0 );
+
+    GfxDeviceGlobal::presentedCommands.swap( GfxDeviceGlobal::commands );
+    GfxDeviceGlobal::commands.clear();
+    ResetBoundStates();
+    GfxDeviceGlobal::boneMatrixCount = 0;
+    ++GfxDeviceGlobal::boneBufferFrame;
+
+    Statistics::EndFrameTimeProfiling();
+}
+
+void ae3d::GfxDevice::ReleaseGPUObjects()
+{
+    GfxDeviceGlobal::lightTiler.DestroyBuffers();
+    VertexBuffer::DestroyBuffers();
+    Shader::DestroyShaders();
+    Texture2D::DestroyTextures();
+    TextureCube::DestroyTextures();
+    RenderTexture::DestroyTextures();
+    GfxDeviceGlobal::commands.clear();
+    GfxDeviceGlobal::presentedCommands.clear();
+}
@@ -0,0 +1,100 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "LightTiler.hpp"
+#include "ComputeShader.hpp"
+#include "GfxDevice.hpp"
+#include "Macros.hpp"
+#include "Matrix.hpp"
+#include "RenderTexture.hpp"
+#include "Statistics.hpp"
+#include "System.hpp"
+
+using namespace ae3d;
+
+namespace MathUtil
+{
+    int Max( int x, int y );
+    int Min( int x, int y );
+}
+
+namespace GfxDeviceGlobal
+{
+    extern PerObjectUboStruct perObjectUboStruct;
+}
+
+void ae3d::LightTiler::DestroyBuffers()
+{
+}
+
+void ae3d::LightTiler::Init()
+{
+}
+
+void ae3d::LightTiler::UpdateLightBuffers()
+{
+    Statistics::BeginLightUpdateProfiling();
+
+    const int lastPointLight = MathUtil::Min( lastDirtyPointLight, activePointLights - 1 );
+
+    if (firstDirtyPointLight <= lastPointLight)
+    {
+        // Center and radius, color.
+        const unsigned size = (lastPointLight - firstDirtyPointLight + 1) * sizeof( Vec4 );
+        GfxDevice::RecordCommand( GfxDevice::Command::UploadBuffer, 0, size * 2, 0, 0 );
+    }
+
+    // Dirty lights past the active count stay dirty so they are uploaded when they become active.
+    if (lastDirtyPointLight > lastPointLight)
+    {
+        firstDirtyPointLight = MathUtil::Max( firstDirtyPointLight, lastPointLight + 1 );
+    }
+    else
+    {
+        firstDirtyPointLight = MaxLights;
+        lastDirtyPointLight = -1;
+    }
+
+    const int lastSpotLight = MathUtil::Min( lastDirtySpotLight, activeSpotLights - 1 );
+
+    if (firstDirtySpotLight <= lastSpotLight)
+    {
+        // Center and radius, params, color.
+        const unsigned size = (lastSpotLight - firstDirtySpotLight + 1) * sizeof( Vec4 );
+        GfxDevice::RecordCommand( GfxDevice::Command::UploadBuffer, 0, size * 3, 0, 0 );
+    }
+
+    if (lastDirtySpotLight > lastSpotLight)
+    {
+        firstDirtySpotLight = MathUtil::Max( firstDirtySpotLight, lastSpotLight + 1 );
+    }
+    else
+    {
+        firstDirtySpotLight = MaxLights;
+        lastDirtySpotLight = -1;
+    }
+
+    Statistics::EndLightUpdateProfiling();
+}
+
+void ae3d::LightTiler::CullLights( ComputeShader& shader, const Matrix44& projection, const Matrix44& localToView, RenderTexture& depthNormalTarget )
+{
+    Matrix44::Invert( projection, GfxDeviceGlobal::perObjectUboStruct.clipToView );
+
+    GfxDeviceGlobal::perObjectUboStruct.localToView = localToView;
+    GfxDeviceGlobal::perObjectUboStruct.windowWidth = depthNormalTarget.GetWidth();
+    GfxDeviceGlobal::perObjectUboStruct.windowHeight = depthNormalTarget.GetHeight();
+    GfxDeviceGlobal::perObjectUboStruct.numLights = (((unsigned)activeSpotLights & 0xFFFFu) << 16) | ((unsigned)activePointLights & 0xFFFFu);
+    GfxDeviceGlobal::perObjectUboStruct.maxNumLightsPerTile = GetMaxNumLightsPerTile();
+
+    shader.Dispatch( GetNumTilesX(), GetNumTilesY(), 1, "LightCuller" );
+}
+
+unsigned ae3d::LightTiler::GetNumTilesX() const
+{
+    return (unsigned)((GfxDevice::backBufferWidth + TileRes - 1) / (float)TileRes);
+}
+
+unsigned ae3d::LightTiler::GetNumTilesY() const
+{
+    return (unsigned)((GfxDevice::backBufferHeight + TileRes - 1) / (float)TileRes);
+}
@@ -0,0 +1,92 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "RenderTexture.hpp"
+#include <map>
+#include <vector>
+#include "GfxDevice.hpp"
+#include "System.hpp"
+
+namespace RenderTextureGlobal
+{
+    unsigned nextTextureID = 1;
+    std::map< unsigned, std::vector< unsigned char > > handleToPixels; // Pixels of textures that have called MakeCpuReadable().
+}
+
+void ae3d::RenderTexture::DestroyTextures()
+{
+    RenderTextureGlobal::handleToPixels.clear();
+}
+
+void ae3d::RenderTexture::Create2D( int aWidth, int aHeight, DataType aDataType, TextureWrap aWrap, TextureFilter aFilter, const char* /*debugName*/, bool isMultisampled, UavFlag aUavFlag )
+{
+    if (aWidth <= 0 || aHeight <= 0)
+    {
+        System::Print( "Render texture has invalid dimension!\n" );
+        return;
+    }
+
+    width = aWidth;
+    height = aHeight;
+    wrap = aWrap;
+    filter = aFilter;
+    isRenderTexture = true;
+    dataType = aDataType;
+    isCube = false;
+    sampleCount = isMultisampled ? 4 : 1;
+    uavFlag = aUavFlag;
+    isCreated = true;
+
+    if (handle == 0)
+    {
+        handle = RenderTextureGlobal::nextTextureID++;
+    }
+}
+
+void ae3d::RenderTexture::CreateCube( int aDimension, DataType aDataType, TextureWrap aWrap, TextureFilter aFilter, const char* /*debugName*/ )
+{
+    if (aDimension <= 0)
+    {
+        System::Print( "Render texture has invalid dimension!\n" );
+        return;
+    }
+
+    width = height = aDimension;
+    wrap = aWrap;
+    filter = aFilter;
+    isRenderTexture = true;
+    dataType = aDataType;
+    isCube = true;
+    isCreated = true;
+
+    if (handle == 0)
+    {
+        handle = RenderTextureGlobal::nextTextureID++;
+    }
+}
+
+void ae3d::RenderTexture::ResolveTo( ae3d::RenderTexture* /*target*/ )
+{
+}
+
+void ae3d::RenderTexture::SetLayout( TextureLayout /*layout*/ )
+{
+}
+
+void ae3d::RenderTexture::MakeCpuReadable( const char* /*debugName*/ )
+{
+    System::Assert( width > 0 && height > 0, "MakeCpuReadable must be called after Create2D()!" );
+
+    RenderTextureGlobal::handleToPixels[ handle ].resize( width * height * 4 );
+}
+
+void* ae3d::RenderTexture::Map()
+{
+    auto pixels = RenderTextureGlobal::handleToPixels.find( handle );
+    System::Assert( pixels != RenderTextureGlobal::handleToPixels.end(), "Map(): Did you forget to call MakeCpuReadable?" );
+
+    return pixels != RenderTextureGlobal::handleToPixels.end() ? pixels->second.data() : nullptr;
+}
+
+void ae3d::RenderTexture::Unmap()
+{
+}
@@ -0,0 +1,26 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "Renderer.hpp"
+#include "ComputeShader.hpp"
+
+ae3d::Renderer renderer;
+
+void ae3d::BuiltinShaders::Load()
+{
+    // Null renderer doesn't compile shaders, so shader files are not read.
+    spriteRendererShader.Load( "", "" );
+    sdfShader.Load( "", "" );
+    skyboxShader.Load( "", "" );
+    momentsShader.Load( "", "" );
+    momentsAlphaTestShader.Load( "", "" );
+    momentsSkinShader.Load( "", "" );
+    depthNormalsShader.Load( "", "" );
+    depthNormalsSkinShader.Load( "", "" );
+    uiShader.Load( "", "" );
+
+    lightCullShader.Load( "" );
+    particleCullShader.Load( "" );
+    particleSimulationShader.Load( "" );
+    particleDrawShader.Load( "" );
+    skinningShader.Load( "" );
+}
@@ -0,0 +1,100 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "Shader.hpp"
+#include <cstring>
+#include "FileSystem.hpp"
+#include "GfxDevice.hpp"
+#include "RenderTexture.hpp"
+#include "System.hpp"
+#include "Texture2D.hpp"
+#include "TextureCube.hpp"
+
+namespace GfxDeviceGlobal
+{
+    extern PerObjectUboStruct perObjectUboStruct;
+}
+
+namespace Global
+{
+    unsigned nextShaderID = 1;
+}
+
+void ae3d::Shader::DestroyShaders()
+{
+}
+
+int ae3d::Shader::GetUniformLocation( const char* name )
+{
+    for (unsigned i = 0; i < uniformLocations.count; ++i)
+    {
+        if (std::strcmp( uniformLocations[ i ].uniformName, name ) == 0)
+        {
+            return uniformLocations[ i ].offset;
+        }
+    }
+
+    return -1;
+}
+
+void ae3d::Shader::Load( const char* /*vertexSource*/, const char* /*fragmentSource*/ )
+{
+    if (id == 0)
+    {
+        id = Global::nextShaderID++;
+    }
+}
+
+void ae3d::Shader::Load( const char* /*metalVertexShaderName*/, const char* /*metalFragmentShaderName*/,
+                         const FileSystem::FileContentsData& vertexDataHLSL, const FileSystem::FileContentsData& fragmentDataHLSL,
+                         const FileSystem::FileContentsData& /*spirvData*/, const FileSystem::FileContentsData& /*spirvData*/ )
+{
+    vertexPath = vertexDataHLSL.path;
+    fragmentPath = fragmentDataHLSL.path;
+
+    Load( "", "" );
+}
+
+void ae3d::Shader::Use()
+{
+    System::Assert( id != 0, "Shader not loaded" );
+    GfxDevice::RecordCommand( GfxDevice::Command::BindShader, id, 0, 0, 0 );
+}
+
+void ae3d::Shader::SetUniform( int /*offset*/, void* /*data*/, int /*dataBytes*/ )
+{
+}
+
+void ae3d::Shader::SetTexture( ae3d::Texture2D* texture, int textureUnit )
+{
+    if (texture == nullptr)
+    {
+        texture = Texture2D::GetDefaultTexture();
+    }
+
+    if (textureUnit == 0)
+    {
+        GfxDeviceGlobal::perObjectUboStruct.tex0scaleOffset = texture->GetScaleOffset();
+    }
+
+    GfxDevice::RecordCommand( GfxDevice::Command::BindTexture, textureUnit, static_cast< unsigned >( GfxDevice::CommandTextureType::Texture2D ), texture->GetID(), 0 );
+}
+
+void ae3d::Shader::SetTexture( ae3d::TextureCube* texture, int textureUnit )
+{
+    if (texture != nullptr && textureUnit == 0)
+    {
+        GfxDeviceGlobal::perObjectUboStruct.tex0scaleOffset = texture->GetScaleOffset();
+    }
+
+    GfxDevice::RecordCommand( GfxDevice::Command::BindTexture, textureUnit, static_cast< unsigned >( GfxDevice::CommandTextureType::TextureCube ), texture != nullptr ? texture->GetID() : 0, 0 );
+}
+
+void ae3d::Shader::SetRenderTexture( ae3d::RenderTexture* texture, int textureUnit )
+{
+    if (texture != nullptr && textureUnit == 0)
+    {
+        GfxDeviceGlobal::perObjectUboStruct.tex0scaleOffset = texture->GetScaleOffset();
+    }
+
+    GfxDevice::RecordCommand( GfxDevice::Command::BindTexture, textureUnit, static_cast< unsigned >( GfxDevice::CommandTextureType::RenderTexture ), texture != nullptr ? texture->GetID() : 0, 0 );
+}
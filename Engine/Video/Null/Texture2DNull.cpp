@@ -0,0 +1,172 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "Texture2D.hpp"
+#include <string>
+#define STB_IMAGE_IMPLEMENTATION
+#include "stb_image.c"
+#include "DDSLoader.hpp"
+#include "FileSystem.hpp"
+#include "GfxDevice.hpp"
+#include "System.hpp"
+
+bool HasStbExtension( const std::string& path ); // Defined in TextureCommon.cpp
+
+namespace MathUtil
+{
+    int GetMipmapCount( int width, int height );
+}
+
+namespace Texture2DGlobal
+{
+    ae3d::Texture2D defaultTexture;
+    unsigned nextTextureID = 1;
+}
+
+namespace
+{
+    int GetBytesPerPixel( ae3d::DataType format )
+    {
+        if (format == ae3d::DataType::Float)
+        {
+            return 4 * 4;
+        }
+        else if (format == ae3d::DataType::Float16 || format == ae3d::DataType::R32G32)
+        {
+            return 4 * 2;
+        }
+
+        return 4;
+    }
+
+    void RecordUpload( unsigned& handle, unsigned bytes )
+    {
+        if (handle == 0)
+        {
+            handle = Texture2DGlobal::nextTextureID++;
+        }
+
+        ae3d::GfxDevice::RecordCommand( ae3d::GfxDevice::Command::UploadTexture, static_cast< unsigned >( ae3d::GfxDevice::CommandTextureType::Texture2D ), handle, bytes, 0 );
+    }
+}
+
+void ae3d::Texture2D::DestroyTextures()
+{
+}
+
+void ae3d::Texture2D::SetLayout( TextureLayout /*layout*/ )
+{
+}
+
+void ae3d::Texture2D::SetLayouts( Texture2D* /*textures*/[], TextureLayout /*layouts*/[], int /*count*/ )
+{
+}
+
+ae3d::Texture2D* ae3d::Texture2D::GetDefaultTexture()
+{
+    if (Texture2DGlobal::defaultTexture.GetWidth() == 0)
+    {
+        Texture2DGlobal::defaultTexture.width = 128;
+        Texture2DGlobal::defaultTexture.height = 128;
+        RecordUpload( Texture2DGlobal::defaultTexture.handle, 128 * 128 * 4 );
+    }
+
+    return &Texture2DGlobal::defaultTexture;
+}
+
+ae3d::Texture2D* ae3d::Texture2D::GetDefaultTextureUAV()
+{
+    return GetDefaultTexture();
+}
+
+void ae3d::Texture2D::CreateUAV( int aWidth, int aHeight, const char* debugName, DataType format, const void* imageData )
+{
+    LoadFromData( imageData, aWidth, aHeight, debugName, format );
+}
+
+void ae3d::Texture2D::LoadFromData( const void* /*imageData*/, int aWidth, int aHeight, const char* /*debugName*/, DataType format )
+{
+    width = aWidth;
+    height = aHeight;
+    filter = TextureFilter::Linear;
+    opaque = true;
+
+    RecordUpload( handle, static_cast< unsigned >( width * height * GetBytesPerPixel( format ) ) );
+}
+
+void ae3d::Texture2D::UpdateRegion( const void* /*rgbaPixels*/, int x, int y, int regionWidth, int regionHeight )
+{
+    System::Assert( handle != 0, "UpdateRegion needs a texture created by LoadFromData" );
+    System::Assert( x >= 0 && y >= 0 && x + regionWidth <= width && y + regionHeight <= height, "UpdateRegion: region is outside the texture" );
+
+    RecordUpload( handle, static_cast< unsigned >( regionWidth * regionHeight * 4 ) );
+}
+
+void ae3d::Texture2D::Load( const FileSystem::FileContentsData& fileContents, TextureWrap aWrap, TextureFilter aFilter, Mipmaps aMipmaps, ColorSpace aColorSpace, Anisotropy aAnisotropy )
+{
+    filter = aFilter;
+    wrap = aWrap;
+    mipmaps = aMipmaps;
+    anisotropy = aAnisotropy;
+    colorSpace = aColorSpace;
+    path = fileContents.path;
+
+    if (!fileContents.isLoaded)
+    {
+        *this = *GetDefaultTexture();
+        return;
+    }
+
+    const bool isDDS = fileContents.path.find( ".dds" ) != std::string::npos || fileContents.path.find( ".DDS" ) != std::string::npos;
+
+    if (HasStbExtension( fileContents.path ))
+    {
+        LoadSTB( fileContents );
+    }
+    else if (isDDS)
+    {
+        LoadDDS( fileContents.path.c_str() );
+    }
+    else
+    {
+        System::Print( "Unknown texture file extension: %s\n", fileContents.path.c_str() );
+    }
+}
+
+void ae3d::Texture2D::LoadDDS( const char* aPath )
+{
+    DDSLoader::Output ddsOutput;
+    const auto fileContents = FileSystem::FileContents( aPath );
+    const DDSLoader::LoadResult loadResult = DDSLoader::Load( fileContents, width, height, opaque, ddsOutput );
+
+    if (loadResult != DDSLoader::LoadResult::Success)
+    {
+        System::Print( "DDS Loader could not load %s", aPath );
+        return;
+    }
+
+    mipLevelCount = ddsOutput.dataOffsets.count;
+    RecordUpload( handle, ddsOutput.imageData.count );
+}
+
+void ae3d::Texture2D::LoadSTB( const FileSystem::FileContentsData& fileContents )
+{
+    int components;
+    unsigned char* data = stbi_load_from_memory( fileContents.data.data(), static_cast< int >( fileContents.data.size() ), &width, &height, &components, 4 );
+
+    if (data == nullptr)
+    {
+        const std::string reason( stbi_failure_reason() );
+        System::Print( "%s failed to load. stb_image's reason: %s\n", fileContents.path.c_str(), reason.c_str() );
+        *this = *GetDefaultTexture();
+        return;
+    }
+
+    opaque = (components == 3 || components == 1);
+    mipLevelCount = mipmaps == Mipmaps::Generate ? MathUtil::GetMipmapCount( width, height ) : 1;
+
+    // Mip chain adds a third of the base level.
+    const unsigned baseLevelBytes = static_cast< unsigned >( width * height * 4 );
+    RecordUpload( handle, mipLevelCount > 1 ? baseLevelBytes + baseLevelBytes / 3 : baseLevelBytes );
+
+    stbi_image_free( data );
+}
@@ -0,0 +1,108 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "TextureCube.hpp"
+#include <string>
+#include "stb_image.c"
+#include "DDSLoader.hpp"
+#include "FileSystem.hpp"
+#include "GfxDevice.hpp"
+#include "System.hpp"
+
+bool HasStbExtension( const std::string& path ); // Defined in TextureCommon.cpp
+
+namespace TextureCubeGlobal
+{
+    ae3d::TextureCube defaultTexture;
+    unsigned nextTextureID = 1;
+}
+
+void ae3d::TextureCube::DestroyTextures()
+{
+}
+
+ae3d::TextureCube* ae3d::TextureCube::GetDefaultTexture()
+{
+    if (TextureCubeGlobal::defaultTexture.GetID() == 0)
+    {
+        TextureCubeGlobal::defaultTexture.width = 32;
+        TextureCubeGlobal::defaultTexture.height = 32;
+        TextureCubeGlobal::defaultTexture.isCube = true;
+        TextureCubeGlobal::defaultTexture.handle = TextureCubeGlobal::nextTextureID++;
+        GfxDevice::RecordCommand( GfxDevice::Command::UploadTexture, static_cast< unsigned >( GfxDevice::CommandTextureType::TextureCube ),
+                                  TextureCubeGlobal::defaultTexture.handle, 32 * 32 * 4 * 6, 0 );
+    }
+
+    return &TextureCubeGlobal::defaultTexture;
+}
+
+void ae3d::TextureCube::Load( const FileSystem::FileContentsData& negX, const FileSystem::FileContentsData& posX,
+          const FileSystem::FileContentsData& negY, const FileSystem::FileContentsData& posY,
+          const FileSystem::FileContentsData& negZ, const FileSystem::FileContentsData& posZ,
+          TextureWrap aWrap, TextureFilter aFilter, Mipmaps aMipmaps, ColorSpace aColorSpace )
+{
+    filter = aFilter;
+    wrap = aWrap;
+    mipmaps = aMipmaps;
+    colorSpace = aColorSpace;
+    path = negX.path;
+    isCube = true;
+
+    posXpath = posX.path;
+    negXpath = negX.path;
+    posYpath = posY.path;
+    negYpath = negY.path;
+    posZpath = posZ.path;
+    negZpath = negZ.path;
+
+    const FileSystem::FileContentsData* faces[ 6 ] = { &posX, &negX, &posY, &negY, &posZ, &negZ };
+    unsigned bytes = 0;
+
+    for (int face = 0; face < 6; ++face)
+    {
+        const std::string& facePath = faces[ face ]->path;
+        const bool isDDS = facePath.find( ".dds" ) != std::string::npos || facePath.find( ".DDS" ) != std::string::npos;
+
+        if (isDDS)
+        {
+            DDSLoader::Output ddsOutput;
+            const DDSLoader::LoadResult loadResult = DDSLoader::Load( *faces[ face ], width, height, opaque, ddsOutput );
+
+            if (loadResult != DDSLoader::LoadResult::Success)
+            {
+                System::Print( "DDS Loader could not load %s", facePath.c_str() );
+                return;
+            }
+
+            mipLevelCount = mipmaps == Mipmaps::Generate ? ddsOutput.dataOffsets.count : 1;
+            bytes += ddsOutput.imageData.count;
+        }
+        else if (HasStbExtension( facePath ))
+        {
+            int components;
+            unsigned char* data = stbi_load_from_memory( faces[ face ]->data.data(), static_cast< int >( faces[ face ]->data.size() ), &width, &height, &components, 4 );
+
+            if (data == nullptr)
+            {
+                const std::string reason( stbi_failure_reason() );
+                System::Print( "%s failed to load. stb_image's reason: %s\n", facePath.c_str(), reason.c_str() );
+                *this = *GetDefaultTexture();
+                return;
+            }
+
+            opaque = (components == 3 || components == 1);
+            bytes += static_cast< unsigned >( width * height * 4 );
+            stbi_image_free( data );
+        }
+        else
+        {
+            System::Print( "Unknown texture file extension: %s\n", facePath.c_str() );
+        }
+    }
+
+    if (handle == 0)
+    {
+        handle = TextureCubeGlobal::nextTextureID++;
+    }
+
+    GfxDevice::RecordCommand( GfxDevice::Command::UploadTexture, static_cast< unsigned >( GfxDevice::CommandTextureType::TextureCube ), handle, bytes, 0 );
+}
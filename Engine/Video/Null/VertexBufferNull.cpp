@@ -0,0 +1,121 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "VertexBuffer.hpp"
+#include "GfxDevice.hpp"
+#include "System.hpp"
+
+namespace Global
+{
+    unsigned nextVertexBufferID = 1;
+}
+
+namespace
+{
+    // PTC and PTN vertices are expanded into PTNTC like on D3D12.
+    void RecordUpload( unsigned& id, int vertexBytes, int elementCount )
+    {
+        if (id == 0)
+        {
+            id = Global::nextVertexBufferID++;
+        }
+
+        ae3d::GfxDevice::RecordCommand( ae3d::GfxDevice::Command::UploadBuffer, id, static_cast< unsigned >( vertexBytes + elementCount * 2 ), 0, 0 );
+    }
+}
+
+void ae3d::VertexBuffer::DestroyBuffers()
+{
+}
+
+void ae3d::VertexBuffer::SetDebugName( const char* /*name*/ )
+{
+}
+
+void ae3d::VertexBuffer::GenerateDynamic( int faceCount, int vertexCount )
+{
+    vertexFormat = VertexFormat::PTNTC;
+    elementCount = faceCount * 3;
+    ibOffset = static_cast< long >( sizeof( VertexPTNTC ) ) * vertexCount;
+    uploadedFaceCount = 0;
+
+    if (id == 0)
+    {
+        id = Global::nextVertexBufferID++;
+    }
+}
+
+void ae3d::VertexBuffer::UpdateDynamic( const Face* /*faces*/, int faceCount, const VertexPTC* /*vertices*/, int vertexCount )
+{
+    System::Assert( id != 0, "Must call GenerateDynamic before UpdateDynamic!" );
+    System::Assert( static_cast< long >( sizeof( VertexPTNTC ) ) * vertexCount <= ibOffset, "UpdateDynamic has more vertices than GenerateDynamic" );
+    System::Assert( faceCount * 3 <= elementCount, "UpdateDynamic has more faces than GenerateDynamic" );
+
+    uploadedFaceCount = faceCount > uploadedFaceCount ? faceCount : uploadedFaceCount;
+
+    RecordUpload( id, static_cast< int >( sizeof( VertexPTNTC ) ) * vertexCount, elementCount );
+}
+
+void ae3d::VertexBuffer::UpdateDynamic( const Face* /*faces*/, int faceCount, const VertexPTNTC* /*vertices*/, int vertexCount )
+{
+    System::Assert( id != 0, "Must call GenerateDynamic before UpdateDynamic!" );
+    System::Assert( static_cast< long >( sizeof( VertexPTNTC ) ) * vertexCount <= ibOffset, "UpdateDynamic has more vertices than GenerateDynamic" );
+    System::Assert( faceCount * 3 <= elementCount, "UpdateDynamic has more faces than GenerateDynamic" );
+
+    uploadedFaceCount = faceCount > uploadedFaceCount ? faceCount : uploadedFaceCount;
+
+    RecordUpload( id, static_cast< int >( sizeof( VertexPTNTC ) ) * vertexCount, elementCount );
+}
+
+void ae3d::VertexBuffer::UpdateDynamicVertices( const VertexPTNTC* /*vertices*/, int firstVertex, int vertexCount )
+{
+    System::Assert( id != 0, "Must call GenerateDynamic before UpdateDynamicVertices!" );
+    System::Assert( static_cast< long >( sizeof( VertexPTNTC ) ) * (firstVertex + vertexCount) <= ibOffset, "UpdateDynamicVertices is outside the buffer" );
+
+    RecordUpload( id, static_cast< int >( sizeof( VertexPTNTC ) ) * vertexCount, 0 );
+}
+
+void ae3d::VertexBuffer::Generate( const Face* /*faces*/, int faceCount, const VertexPTC* /*vertices*/, int vertexCount, Storage /*storage*/ )
+{
+    vertexFormat = VertexFormat::PTNTC;
+    elementCount = faceCount * 3;
+    uploadedFaceCount = faceCount;
+    RecordUpload( id, static_cast< int >( sizeof( VertexPTNTC ) ) * vertexCount, elementCount );
+}
+
+void ae3d::VertexBuffer::Generate( const Face* /*faces*/, int faceCount, const VertexPTN* /*vertices*/, int vertexCount )
+{
+    vertexFormat = VertexFormat::PTNTC;
+    elementCount = faceCount * 3;
+    uploadedFaceCount = faceCount;
+    RecordUpload( id, static_cast< int >( sizeof( VertexPTNTC ) ) * vertexCount, elementCount );
+}
+
+void ae3d::VertexBuffer::Generate( const Face* /*faces*/, int faceCount, const VertexPTNTC* /*vertices*/, int vertexCount )
+{
+    vertexFormat = VertexFormat::PTNTC;
+    elementCount = faceCount * 3;
+    uploadedFaceCount = faceCount;
+    RecordUpload( id, static_cast< int >( sizeof( VertexPTNTC ) ) * vertexCount, elementCount );
+}
+
+void ae3d::VertexBuffer::Generate( const Face* /*faces*/, int faceCount, const VertexPTNTC_Skinned* /*vertices*/, int vertexCount )
+{
+    vertexFormat = VertexFormat::PTNTC_Skinned;
+    elementCount = faceCount * 3;
+    uploadedFaceCount = faceCount;
+    RecordUpload( id, static_cast< int >( sizeof( VertexPTNTC_Skinned ) ) * vertexCount, elementCount );
+}
+
+void ae3d::VertexBuffer::GenerateWritable( const Face* /*faces*/, int faceCount, int /*vertexCount*/ )
+{
+    vertexFormat = VertexFormat::PTNTC;
+    elementCount = faceCount * 3;
+    uploadedFaceCount = faceCount;
+    // Only indices are uploaded, vertices are written by a compute shader.
+    RecordUpload( id, 0, elementCount );
+}
+
+void ae3d::VertexBuffer::Bind() const
+{
+    GfxDevice::RecordCommand( GfxDevice::Command::BindVertexBuffer, id, 0, 0, 0 );
+}
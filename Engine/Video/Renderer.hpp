@@ -4,6 +4,7 @@
 #include "Shader.hpp"
 #include "VertexBuffer.hpp"
 #include "Texture2D.hpp"
+#include "Matrix.hpp"
 
 namespace ae3d
 {
@@ -16,9 +17,28 @@ namespace ae3d
         ae3d::Vec4 positionAndSize;
         ae3d::Vec4 color;
         ae3d::Vec4 clipPosition;
-        ae3d::Vec4 lifeTimeSecs; // Stored in .x component.
+        ae3d::Vec4 lifeTimeSecs; // .x: age, .y: timeStamp of the last simulation.
     };
 
+    /// Number of particles in the particle buffer. Particle systems allocate their particles from it.
+    const unsigned MaxParticleCount = 1000000;
+
+    /// Simulation parameters of one particle system. Must be kept in sync with particle_simulate.hlsl and particle.metal.
+    struct ParticleEmitter
+    {
+        Matrix44 localToWorld;
+        Vec4 color;
+        int particleOffset; // First particle in the particle buffer.
+        int particleCount; // Live particles.
+        int firstThread; // First simulation thread of the emitter.
+        float emissionRate; // Particles per second.
+        float lifeTime; // In seconds.
+        float padding[ 3 ];
+    };
+
+    /// Number of particle systems that one simulation dispatch can simulate.
+    const unsigned MaxParticleEmitterCount = 4096;
+
     struct BuiltinShaders
     {
         // Loads shader binaries from running directory's 'shaders' subfolder.
@@ -37,6 +57,7 @@ namespace ae3d
         ComputeShader particleSimulationShader;
         ComputeShader particleCullShader;
         ComputeShader particleDrawShader;
+        ComputeShader skinningShader;
     };
 
     /// High-level rendering stuff.
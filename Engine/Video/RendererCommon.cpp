@@ -1,6 +1,7 @@
 // This is an independent project of an individual developer. Dear PVS-Studio, please check it.
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 #include "Renderer.hpp"
+#include <cstring>
 #include <vector>
 #include <math.h>
 #include "Array.hpp"
@@ -30,6 +31,7 @@ namespace ae3d
 namespace MathUtil
 {
     int Max( int x, int y );
+    int Min( int x, int y );
     float Lerp( float start, float end, float amount );
     float Random( float aMin, float aMax );
 }
@@ -143,6 +145,32 @@ void ae3d::Renderer::RenderSkybox( TextureCube* skyTexture, const CameraComponen
     GfxDevice::PopGroupMarker();
 }
 
+static std::vector< ae3d::VertexBuffer::Face > CreateQuadFaces()
+{
+    std::vector< ae3d::VertexBuffer::Face > faces( ae3d::VertexBuffer::MaxQuadCount * 2 );
+
+    for (int i = 0; i < ae3d::VertexBuffer::MaxQuadCount; ++i)
+    {
+        const unsigned short first = static_cast< unsigned short >( i * 4 );
+        faces[ i * 2 + 0 ] = ae3d::VertexBuffer::Face( first, first + 1, first + 2 );
+        faces[ i * 2 + 1 ] = ae3d::VertexBuffer::Face( first + 2, first + 3, first );
+    }
+
+    return faces;
+}
+
+const ae3d::VertexBuffer::Face* ae3d::VertexBuffer::GetQuadFaces()
+{
+    static const std::vector< Face > faces = CreateQuadFaces();
+    return faces.data();
+}
+
+int ae3d::VertexBuffer::GetGrownCapacity( int requiredCount, int capacity, int maxCapacity )
+{
+    const int doubledCapacity = capacity > maxCapacity / 2 ? maxCapacity : capacity * 2;
+    return MathUtil::Min( MathUtil::Max( requiredCount, doubledCapacity ), maxCapacity );
+}
+
 int ae3d::GfxDevice::CreateLineBuffer( const Vec3* lines, int lineCount, const Vec3& color )
 {
     if (lineCount == 0)
@@ -207,8 +235,17 @@ void ae3d::LightTiler::SetPointLightParameters( int bufferIndex, const Vec3& pos
     if (bufferIndex < MaxLights)
     {
         activePointLights = MathUtil::Max( bufferIndex + 1, activePointLights );
-        pointLightCenterAndRadius[ bufferIndex ] = Vec4( position.x, position.y, position.z, radius );
-        pointLightColors[ bufferIndex ] = color;
+
+        const Vec4 centerAndRadius( position.x, position.y, position.z, radius );
+
+        if (std::memcmp( &pointLightCenterAndRadius[ bufferIndex ], &centerAndRadius, sizeof( Vec4 ) ) != 0 ||
+            std::memcmp( &pointLightColors[ bufferIndex ], &color, sizeof( Vec4 ) ) != 0)
+        {
+            pointLightCenterAndRadius[ bufferIndex ] = centerAndRadius;
+            pointLightColors[ bufferIndex ] = color;
+            firstDirtyPointLight = MathUtil::Min( firstDirtyPointLight, bufferIndex );
+            lastDirtyPointLight = MathUtil::Max( lastDirtyPointLight, bufferIndex );
+        }
     }
 }
 
@@ -219,9 +256,21 @@ void ae3d::LightTiler::SetSpotLightParameters( int bufferIndex, Vec3& position,
     if (bufferIndex < MaxLights)
     {
         activeSpotLights = MathUtil::Max( bufferIndex + 1, activeSpotLights );
-        spotLightCenterAndRadius[ bufferIndex ] = Vec4( position.x, position.y, position.z, radius );
-        spotLightParams[ bufferIndex ] = Vec4( direction.x, direction.y, direction.z, (float)cos( coneAngle * 3.14159265f / 180.0f ) );
-		spotLightColors[ bufferIndex ] = Vec4( color.x, color.y, color.z, falloffRadius );
+
+        const Vec4 centerAndRadius( position.x, position.y, position.z, radius );
+        const Vec4 params( direction.x, direction.y, direction.z, cos( coneAngle * 3.14159265f / 180.0f ) );
+        const Vec4 colorAndFalloff( color.x, color.y, color.z, falloffRadius );
+
+        if (std::memcmp( &spotLightCenterAndRadius[ bufferIndex ], &centerAndRadius, sizeof( Vec4 ) ) != 0 ||
+            std::memcmp( &spotLightParams[ bufferIndex ], &params, sizeof( Vec4 ) ) != 0 ||
+            std::memcmp( &spotLightColors[ bufferIndex ], &colorAndFalloff, sizeof( Vec4 ) ) != 0)
+        {
+            spotLightCenterAndRadius[ bufferIndex ] = centerAndRadius;
+            spotLightParams[ bufferIndex ] = params;
+            spotLightColors[ bufferIndex ] = colorAndFalloff;
+            firstDirtySpotLight = MathUtil::Min( firstDirtySpotLight, bufferIndex );
+            lastDirtySpotLight = MathUtil::Max( lastDirtySpotLight, bufferIndex );
+        }
     }
 }
 
@@ -8,7 +8,7 @@
 #include "System.hpp"
 #include "FileSystem.hpp"
 
-#if defined( RENDERER_METAL ) || defined( RENDERER_VULKAN )
+#if defined( RENDERER_METAL ) || defined( RENDERER_VULKAN ) || defined( RENDERER_NULL )
 namespace Texture2DGlobal
 {
     std::map< std::string, ae3d::Texture2D > hashToCachedTexture;
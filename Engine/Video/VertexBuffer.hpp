@@ -2,6 +2,7 @@
 
 #if RENDERER_D3D12
 #include <d3d12.h>
+#include "TextureBase.hpp"
 #endif
 #if RENDERER_METAL
 #import <Metal/Metal.h>
@@ -102,6 +103,9 @@ namespace ae3d
 
         /// \return IB view
         const D3D12_INDEX_BUFFER_VIEW* GetIndexView() const { return &indexBufferView; }
+
+        /// \return Vertices of a buffer generated by GenerateWritable() or null.
+        GpuResource* GetWritableVertices() { return writableVertices.resource ? &writableVertices : nullptr; }
 #endif
 
         /// Binds the buffer. Must be called before GfxDevice::Draw.
@@ -123,7 +127,8 @@ namespace ae3d
         /// \param storage Use CPU if you need to modify the data after calling this method.
         void Generate( const Face* faces, int faceCount, const VertexPTC* vertices, int vertexCount, Storage storage );
 
-        /// Generates a buffer that can be updated using memcpy().
+        /// Generates a buffer that can be updated using memcpy(). The first UpdateDynamic() defines the buffer's size on some backends,
+        /// so it should cover the whole capacity.
         /// \param faceCount Face count.
         /// \param vertexCount Vertex count.
         void GenerateDynamic( int faceCount, int vertexCount );
@@ -135,6 +140,19 @@ namespace ae3d
         /// \param vertexCount Vertex count.
         void UpdateDynamic( const Face* faces, int faceCount, const VertexPTC* vertices, int vertexCount );
 
+        /// Updates the buffer from supplied geometry without conversion.
+        /// \param faces Faces.
+        /// \param faceCount Face count.
+        /// \param vertices Vertices.
+        /// \param vertexCount Vertex count.
+        void UpdateDynamic( const Face* faces, int faceCount, const VertexPTNTC* vertices, int vertexCount );
+
+        /// Updates a range of vertices in a buffer that has been filled using UpdateDynamic. Indices are not touched.
+        /// \param vertices Vertices.
+        /// \param firstVertex Index of the first updated vertex in the buffer.
+        /// \param vertexCount Vertex count.
+        void UpdateDynamicVertices( const VertexPTNTC* vertices, int firstVertex, int vertexCount );
+
         /// Generates the buffer from supplied geometry.
         /// \param faces Faces.
         /// \param faceCount Face count.
@@ -156,6 +174,12 @@ namespace ae3d
         /// \param vertexCount Vertex count.
         void Generate( const Face* faces, int faceCount, const VertexPTNTC_Skinned* vertices, int vertexCount );
 
+        /// Generates a PTNTC buffer whose vertices are written by a compute shader, like the skinning pre-pass. Vertices are undefined until then.
+        /// \param faces Faces.
+        /// \param faceCount Face count.
+        /// \param vertexCount Vertex count.
+        void GenerateWritable( const Face* faces, int faceCount, int vertexCount );
+
         /// Sets a graphics API debug name for the buffer, visible in debugging tools. Must be called after Generate().
         /// \param name Name
         void SetDebugName( const char* name );
@@ -174,6 +198,13 @@ namespace ae3d
         unsigned positionCount = 0;
         unsigned triangleCount = 0;
 #endif
+#if RENDERER_NULL
+        /// \return Handle that the null renderer's command log uses for this buffer.
+        unsigned GetID() const { return id; }
+
+        /// \return Faces whose indices have been written since the buffer was generated. Draws must stay below it.
+        int GetUploadedFaceCount() const { return uploadedFaceCount; }
+#endif
 #if RENDERER_VULKAN
         static const unsigned VERTEX_BUFFER_BIND_ID = 0;
 
@@ -185,6 +216,19 @@ namespace ae3d
         /// Destroys graphics API objects.
         static void DestroyBuffers();
 
+        /// Number of quads of 4 vertices that 16-bit indices can address.
+        static const int MaxQuadCount = 16384;
+
+        /// \return Faces of MaxQuadCount quads, two per quad. Quad i uses vertices 4 * i to 4 * i + 3, so quad buffers can share them.
+        static const Face* GetQuadFaces();
+
+        /// Grows a dynamic buffer's capacity geometrically, so that content that grows a bit at a time doesn't recreate the buffer every time.
+        /// \param requiredCount Count that must fit.
+        /// \param capacity Current capacity.
+        /// \param maxCapacity Upper limit of the capacity.
+        /// \return New capacity.
+        static int GetGrownCapacity( int requiredCount, int capacity, int maxCapacity );
+
         static const int posChannel = 0;
         static const int uvChannel = 1;
         static const int colorChannel = 2;
@@ -199,6 +243,8 @@ namespace ae3d
         void UploadVB( void* faces, void* vertices, unsigned ibSize );
         // Index buffer is stored in the vertex buffer after vertex data.
         ID3D12Resource* vbUpload = nullptr;
+        // Vertices in a default heap, because upload heap buffers can't be written by compute shaders. vbUpload has only the indices.
+        GpuResource writableVertices;
         D3D12_VERTEX_BUFFER_VIEW vertexBufferView = {};
         D3D12_INDEX_BUFFER_VIEW indexBufferView = {};
         long ibOffset = 0;
@@ -207,6 +253,11 @@ namespace ae3d
 #endif
         int elementCount = 0;
         VertexFormat vertexFormat = VertexFormat::PTC;
+#if RENDERER_NULL
+        unsigned id = 0;
+        long ibOffset = 0; // Vertex bytes of a dynamic buffer.
+        int uploadedFaceCount = 0;
+#endif
 #if RENDERER_METAL
         id<MTLBuffer> vertexBuffer;
         id<MTLBuffer> indexBuffer;
@@ -217,18 +268,21 @@ namespace ae3d
 
         VkBuffer vertexBuffer = VK_NULL_HANDLE;
         VkDeviceMemory vertexMem = VK_NULL_HANDLE;
+        VkDeviceSize vertexMemOffset = 0;
         VkPipelineVertexInputStateCreateInfo inputStateCreateInfo = { VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO, nullptr, 0, 0, nullptr, 0, nullptr };
         VkVertexInputBindingDescription bindingDescriptions;
         VkVertexInputAttributeDescription attributeDescriptions[ 7 ];
 
         VkBuffer indexBuffer = VK_NULL_HANDLE;
         VkDeviceMemory indexMem = VK_NULL_HANDLE;
+        VkDeviceSize indexMemOffset = 0;
 
         struct Buffer
         {
             int size = 0;
-            VkDeviceMemory memory;
-            VkBuffer buffer;
+            VkDeviceMemory memory = VK_NULL_HANDLE;
+            VkDeviceSize memoryOffset = 0;
+            VkBuffer buffer = VK_NULL_HANDLE;
             void* mappedData = nullptr;
         };
 
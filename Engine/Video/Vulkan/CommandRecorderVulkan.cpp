@@ -0,0 +1,346 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "CommandRecorderVulkan.hpp"
+#include <condition_variable>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Macros.hpp"
+#include "Statistics.hpp"
+#include "System.hpp"
+#include "VertexBuffer.hpp"
+#include "VulkanUtils.hpp"
+
+namespace GfxDeviceGlobal
+{
+    extern VkDevice device;
+    extern VkPipelineLayout pipelineLayout;
+    extern std::uint32_t queueNodeIndex;
+}
+
+namespace ae3d
+{
+    void WriteDescriptorSet( VkDescriptorSet outDescriptorSet, const VkDescriptorBufferInfo& uboDesc, const VkImageView& view0, VkSampler sampler0, const VkImageView& view1, VkSampler sampler1, const VkImageView& view2, const VkImageView& view3, const VkImageView& view4, const VkImageView& view14 );
+}
+
+namespace CommandRecorderGlobal
+{
+    const unsigned MaxThreads = 8;
+    // Smaller ranges don't win back the cost of waking a thread and executing another secondary buffer.
+    const unsigned MinDrawsPerThread = 64;
+
+    struct Context
+    {
+        VkCommandPool cmdPool = VK_NULL_HANDLE;
+        VkCommandBuffer cmdBuffer = VK_NULL_HANDLE;
+        unsigned firstPacket = 0;
+        unsigned packetCount = 0;
+        int psoBindCalls = 0;
+    };
+
+    Context contexts[ MaxThreads ];
+    unsigned threadCount = 1;
+    std::vector< std::thread > workers;
+    std::vector< CommandRecorder::DrawPacket > packets;
+
+    std::mutex mutex;
+    std::condition_variable workAvailable;
+    std::condition_variable workDone;
+    unsigned generation = 0;
+    unsigned jobCount = 0;
+    unsigned pendingJobs = 0;
+    bool quit = false;
+
+    bool isRecording = false;
+    const char* debugName = "";
+    VkRenderPass renderPass = VK_NULL_HANDLE;
+    VkFramebuffer frameBuffer = VK_NULL_HANDLE;
+    VkViewport viewport = {};
+    VkRect2D scissor = {};
+}
+
+namespace
+{
+    void RecordRange( CommandRecorderGlobal::Context& context )
+    {
+        VkResult err = vkResetCommandPool( GfxDeviceGlobal::device, context.cmdPool, 0 );
+        AE3D_CHECK_VULKAN( err, "vkResetCommandPool" );
+
+        VkCommandBufferInheritanceInfo inheritanceInfo = {};
+        inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        inheritanceInfo.renderPass = CommandRecorderGlobal::renderPass;
+        inheritanceInfo.subpass = 0;
+        inheritanceInfo.framebuffer = CommandRecorderGlobal::frameBuffer;
+
+        VkCommandBufferBeginInfo cmdBufInfo = {};
+        cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        cmdBufInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        cmdBufInfo.pInheritanceInfo = &inheritanceInfo;
+
+        err = vkBeginCommandBuffer( context.cmdBuffer, &cmdBufInfo );
+        AE3D_CHECK_VULKAN( err, "vkBeginCommandBuffer secondary" );
+
+        debug::BeginRegion( context.cmdBuffer, CommandRecorderGlobal::debugName, 0, 1, 0 );
+
+        VkPipeline boundPso = VK_NULL_HANDLE;
+        const CommandRecorder::DrawPacket* previous = nullptr;
+        context.psoBindCalls = 0;
+
+        for (unsigned i = context.firstPacket; i < context.firstPacket + context.packetCount; ++i)
+        {
+            const CommandRecorder::DrawPacket& packet = CommandRecorderGlobal::packets[ i ];
+
+            // Dynamic state is not inherited from the primary buffer, so every secondary buffer sets it before its first draw.
+            if (previous == nullptr || std::memcmp( &previous->viewport, &packet.viewport, sizeof( VkViewport ) ) != 0)
+            {
+                vkCmdSetViewport( context.cmdBuffer, 0, 1, &packet.viewport );
+            }
+
+            if (previous == nullptr || std::memcmp( &previous->scissor, &packet.scissor, sizeof( VkRect2D ) ) != 0)
+            {
+                vkCmdSetScissor( context.cmdBuffer, 0, 1, &packet.scissor );
+            }
+
+            previous = &packet;
+
+            ae3d::WriteDescriptorSet( packet.descriptorSet, packet.uboDesc, packet.views[ 0 ], packet.samplers[ 0 ], packet.views[ 1 ], packet.samplers[ 1 ],
+                                      packet.views[ 2 ], packet.views[ 3 ], packet.views[ 4 ], packet.views[ 5 ] );
+            vkCmdBindDescriptorSets( context.cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, GfxDeviceGlobal::pipelineLayout, 0, 1, &packet.descriptorSet, 0, nullptr );
+
+            if (boundPso != packet.pso)
+            {
+                boundPso = packet.pso;
+                vkCmdBindPipeline( context.cmdBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, packet.pso );
+                ++context.psoBindCalls;
+            }
+
+            VkDeviceSize offsets[ 1 ] = { 0 };
+            vkCmdBindVertexBuffers( context.cmdBuffer, ae3d::VertexBuffer::VERTEX_BUFFER_BIND_ID, 1, &packet.vertexBuffer, offsets );
+
+            if (packet.indexBuffer != VK_NULL_HANDLE)
+            {
+                vkCmdBindIndexBuffer( context.cmdBuffer, packet.indexBuffer, 0, VK_INDEX_TYPE_UINT16 );
+                vkCmdDrawIndexed( context.cmdBuffer, packet.count, 1, packet.first, 0, 0 );
+            }
+            else
+            {
+                vkCmdDraw( context.cmdBuffer, packet.count, 1, packet.first, 0 );
+            }
+        }
+
+        debug::EndRegion( context.cmdBuffer );
+
+        err = vkEndCommandBuffer( context.cmdBuffer );
+        AE3D_CHECK_VULKAN( err, "vkEndCommandBuffer secondary" );
+    }
+
+    void WorkerLoop( unsigned contextIndex )
+    {
+        unsigned seenGeneration = 0;
+
+        while (true)
+        {
+            {
+                std::unique_lock< std::mutex > lock( CommandRecorderGlobal::mutex );
+                CommandRecorderGlobal::workAvailable.wait( lock, [&]() { return CommandRecorderGlobal::quit || CommandRecorderGlobal::generation != seenGeneration; } );
+
+                if (CommandRecorderGlobal::quit)
+                {
+                    return;
+                }
+
+                seenGeneration = CommandRecorderGlobal::generation;
+
+                if (contextIndex >= CommandRecorderGlobal::jobCount)
+                {
+                    continue;
+                }
+            }
+
+            RecordRange( CommandRecorderGlobal::contexts[ contextIndex ] );
+
+            {
+                std::lock_guard< std::mutex > lock( CommandRecorderGlobal::mutex );
+                --CommandRecorderGlobal::pendingJobs;
+            }
+
+            CommandRecorderGlobal::workDone.notify_one();
+        }
+    }
+}
+
+void CommandRecorder::Init( unsigned threadCount )
+{
+    CommandRecorderGlobal::threadCount = threadCount < 1 ? 1 : (threadCount > CommandRecorderGlobal::MaxThreads ? CommandRecorderGlobal::MaxThreads : threadCount);
+
+    if (CommandRecorderGlobal::threadCount == 1)
+    {
+        return;
+    }
+
+    for (unsigned i = 0; i < CommandRecorderGlobal::threadCount; ++i)
+    {
+        VkCommandPoolCreateInfo cmdPoolInfo = {};
+        cmdPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        cmdPoolInfo.queueFamilyIndex = GfxDeviceGlobal::queueNodeIndex;
+        cmdPoolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        VkResult err = vkCreateCommandPool( GfxDeviceGlobal::device, &cmdPoolInfo, nullptr, &CommandRecorderGlobal::contexts[ i ].cmdPool );
+        AE3D_CHECK_VULKAN( err, "vkCreateCommandPool recorder" );
+
+        VkCommandBufferAllocateInfo allocInfo = {};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = CommandRecorderGlobal::contexts[ i ].cmdPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+        allocInfo.commandBufferCount = 1;
+        err = vkAllocateCommandBuffers( GfxDeviceGlobal::device, &allocInfo, &CommandRecorderGlobal::contexts[ i ].cmdBuffer );
+        AE3D_CHECK_VULKAN( err, "vkAllocateCommandBuffers secondary" );
+        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)CommandRecorderGlobal::contexts[ i ].cmdBuffer, VK_OBJECT_TYPE_COMMAND_BUFFER, "secondaryCmdBuffer" );
+    }
+
+    // Context 0 is recorded by the thread that ends the pass.
+    for (unsigned i = 1; i < CommandRecorderGlobal::threadCount; ++i)
+    {
+        CommandRecorderGlobal::workers.push_back( std::thread( WorkerLoop, i ) );
+    }
+
+    CommandRecorderGlobal::packets.reserve( 4096 );
+}
+
+bool CommandRecorder::IsRecording()
+{
+    return CommandRecorderGlobal::isRecording;
+}
+
+void CommandRecorder::BeginPass( const char* debugName )
+{
+    ae3d::System::Assert( !CommandRecorderGlobal::isRecording, "BeginPass called twice without EndPass" );
+
+    if (CommandRecorderGlobal::threadCount == 1)
+    {
+        return;
+    }
+
+    CommandRecorderGlobal::isRecording = true;
+    CommandRecorderGlobal::debugName = debugName;
+    CommandRecorderGlobal::packets.clear();
+}
+
+void CommandRecorder::SetRenderPass( VkRenderPass renderPass, VkFramebuffer frameBuffer, std::uint32_t width, std::uint32_t height )
+{
+    CommandRecorderGlobal::renderPass = renderPass;
+    CommandRecorderGlobal::frameBuffer = frameBuffer;
+
+    CommandRecorderGlobal::viewport = {};
+    CommandRecorderGlobal::viewport.width = (float)width;
+    CommandRecorderGlobal::viewport.height = (float)height;
+    CommandRecorderGlobal::viewport.minDepth = 0.0f;
+    CommandRecorderGlobal::viewport.maxDepth = 1.0f;
+
+    CommandRecorderGlobal::scissor = {};
+    CommandRecorderGlobal::scissor.extent.width = width;
+    CommandRecorderGlobal::scissor.extent.height = height;
+}
+
+void CommandRecorder::SetViewport( const VkViewport& viewport )
+{
+    CommandRecorderGlobal::viewport = viewport;
+}
+
+void CommandRecorder::SetScissor( const VkRect2D& scissor )
+{
+    CommandRecorderGlobal::scissor = scissor;
+}
+
+void CommandRecorder::AddDraw( DrawPacket& packet )
+{
+    packet.viewport = CommandRecorderGlobal::viewport;
+    packet.scissor = CommandRecorderGlobal::scissor;
+    CommandRecorderGlobal::packets.push_back( packet );
+}
+
+void CommandRecorder::EndPass( VkCommandBuffer primaryCmdBuffer )
+{
+    if (!CommandRecorderGlobal::isRecording)
+    {
+        return;
+    }
+
+    CommandRecorderGlobal::isRecording = false;
+
+    const unsigned packetCount = (unsigned)CommandRecorderGlobal::packets.size();
+
+    if (packetCount == 0)
+    {
+        return;
+    }
+
+    unsigned jobCount = (packetCount + CommandRecorderGlobal::MinDrawsPerThread - 1) / CommandRecorderGlobal::MinDrawsPerThread;
+    jobCount = jobCount > CommandRecorderGlobal::threadCount ? CommandRecorderGlobal::threadCount : jobCount;
+
+    // Ranges are contiguous and executed in order, so draw order stays the same as in the capture.
+    unsigned firstPacket = 0;
+
+    for (unsigned i = 0; i < jobCount; ++i)
+    {
+        CommandRecorderGlobal::contexts[ i ].firstPacket = firstPacket;
+        CommandRecorderGlobal::contexts[ i ].packetCount = packetCount / jobCount + (i < packetCount % jobCount ? 1 : 0);
+        firstPacket += CommandRecorderGlobal::contexts[ i ].packetCount;
+    }
+
+    {
+        std::lock_guard< std::mutex > lock( CommandRecorderGlobal::mutex );
+        CommandRecorderGlobal::jobCount = jobCount;
+        CommandRecorderGlobal::pendingJobs = jobCount - 1;
+        ++CommandRecorderGlobal::generation;
+    }
+
+    CommandRecorderGlobal::workAvailable.notify_all();
+
+    RecordRange( CommandRecorderGlobal::contexts[ 0 ] );
+
+    {
+        std::unique_lock< std::mutex > lock( CommandRecorderGlobal::mutex );
+        CommandRecorderGlobal::workDone.wait( lock, []() { return CommandRecorderGlobal::pendingJobs == 0; } );
+    }
+
+    VkCommandBuffer cmdBuffers[ CommandRecorderGlobal::MaxThreads ];
+
+    for (unsigned i = 0; i < jobCount; ++i)
+    {
+        cmdBuffers[ i ] = CommandRecorderGlobal::contexts[ i ].cmdBuffer;
+
+        for (int p = 0; p < CommandRecorderGlobal::contexts[ i ].psoBindCalls; ++p)
+        {
+            Statistics::IncPSOBindCalls();
+        }
+    }
+
+    vkCmdExecuteCommands( primaryCmdBuffer, jobCount, cmdBuffers );
+}
+
+void CommandRecorder::Destroy()
+{
+    {
+        std::lock_guard< std::mutex > lock( CommandRecorderGlobal::mutex );
+        CommandRecorderGlobal::quit = true;
+    }
+
+    CommandRecorderGlobal::workAvailable.notify_all();
+
+    for (auto& worker : CommandRecorderGlobal::workers)
+    {
+        worker.join();
+    }
+
+    CommandRecorderGlobal::workers.clear();
+
+    for (unsigned i = 0; i < CommandRecorderGlobal::MaxThreads; ++i)
+    {
+        if (CommandRecorderGlobal::contexts[ i ].cmdPool != VK_NULL_HANDLE)
+        {
+            vkDestroyCommandPool( GfxDeviceGlobal::device, CommandRecorderGlobal::contexts[ i ].cmdPool, nullptr );
+            CommandRecorderGlobal::contexts[ i ].cmdPool = VK_NULL_HANDLE;
+        }
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef COMMAND_RECORDER_VULKAN
+#define COMMAND_RECORDER_VULKAN
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+/// Records the draws of an offscreen render pass into secondary command buffers on worker threads.
+/// Draws are captured on the main thread (PSO lookup, UBO upload, descriptor set reservation) and each thread
+/// then writes the descriptor sets and records a contiguous range of draws with its own command pool.
+/// The primary command buffer executes the ranges in order, so draw order is preserved.
+namespace CommandRecorder
+{
+    struct DrawPacket
+    {
+        VkPipeline pso = VK_NULL_HANDLE;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        VkDescriptorBufferInfo uboDesc = {};
+        VkImageView views[ 6 ] = {}; // Bindings 0-4 and 14.
+        VkSampler samplers[ 2 ] = {};
+        VkBuffer vertexBuffer = VK_NULL_HANDLE;
+        VkBuffer indexBuffer = VK_NULL_HANDLE; // VK_NULL_HANDLE for non-indexed line draws.
+        std::uint32_t first = 0;
+        std::uint32_t count = 0;
+        VkViewport viewport = {};
+        VkRect2D scissor = {};
+    };
+
+    /// Creates per-thread command pools and starts worker threads.
+    /// \param threadCount Number of recording threads including the main thread. 1 disables parallel recording.
+    void Init( unsigned threadCount );
+
+    /// \return True between BeginPass() and EndPass().
+    bool IsRecording();
+
+    /// Starts capturing draws. Must be called before the render pass is begun.
+    /// \param debugName Debug region name that is recorded into each secondary command buffer.
+    void BeginPass( const char* debugName );
+
+    /// Sets the render pass and framebuffer secondary command buffers inherit, and the initial viewport and scissor.
+    void SetRenderPass( VkRenderPass renderPass, VkFramebuffer frameBuffer, std::uint32_t width, std::uint32_t height );
+
+    void SetViewport( const VkViewport& viewport );
+    void SetScissor( const VkRect2D& scissor );
+
+    /// Adds a draw. Viewport and scissor are filled from the current state.
+    void AddDraw( DrawPacket& packet );
+
+    /// Records captured draws in parallel and executes them in primaryCmdBuffer. Must be called inside the render pass.
+    void EndPass( VkCommandBuffer primaryCmdBuffer );
+
+    /// Stops worker threads and destroys command pools.
+    void Destroy();
+}
+
+#endif
@@ -8,6 +8,7 @@
 #include "Macros.hpp"
 #include "RenderTexture.hpp"
 #include "System.hpp"
+#include "Profiler.hpp"
 #include "Statistics.hpp"
 #include "Texture2D.hpp"
 #include "VulkanUtils.hpp"
@@ -26,6 +27,7 @@ namespace GfxDeviceGlobal
     extern VkPipelineCache pipelineCache;
     extern PerObjectUboStruct perObjectUboStruct;
     extern VkImageView boundViews[ ae3d::ComputeShader::SLOT_COUNT ];
+    extern VkBuffer boundBuffers[ 2 ];
 }
 
 namespace ComputeShaderGlobal
@@ -187,6 +189,18 @@ void ae3d::ComputeShader::SetTexture2D( Texture2D* texture, unsigned slot )
     }
 }
 
+void ae3d::ComputeShader::SetBuffer( unsigned slot, VkBuffer buffer )
+{
+    if (slot < 2)
+    {
+        GfxDeviceGlobal::boundBuffers[ slot ] = buffer;
+    }
+    else
+    {
+        System::Print( "ComputeShader:SetBuffer: Too high slot!\n" );
+    }
+}
+
 void ae3d::ComputeShader::Begin()
 {
     VkCommandBufferBeginInfo cmdBufInfo = {};
@@ -216,9 +230,9 @@ void ae3d::ComputeShader::End()
     AE3D_CHECK_VULKAN( err, "vkQueueSubmit compute" );
     Statistics::IncQueueSubmitCalls();
 
-    System::BeginTimer();
+    Profiler::BeginZone( "Queue wait" );
     err = vkQueueWaitIdle( GfxDeviceGlobal::computeQueue );
-    Statistics::IncQueueWaitTime( System::EndTimer() );
+    Statistics::IncQueueWaitTime( Profiler::EndZone() );
     AE3D_CHECK_VULKAN( err, "vkQueueWaitIdle" );
 }
 
@@ -235,5 +249,9 @@ void ae3d::ComputeShader::Dispatch( unsigned groupCountX, unsigned groupCountY,
     vkCmdDispatch( GfxDeviceGlobal::computeCmdBuffer, groupCountX, groupCountY, groupCountZ );
     Statistics::IncPSOBindCalls();
 
+    // The descriptor set has been written, so the buffers can be destroyed without leaving dangling handles for later draws.
+    GfxDeviceGlobal::boundBuffers[ 0 ] = VK_NULL_HANDLE;
+    GfxDeviceGlobal::boundBuffers[ 1 ] = VK_NULL_HANDLE;
+
     debug::EndRegion( GfxDeviceGlobal::computeCmdBuffer );
 }
@@ -1,16 +1,22 @@
 // This is an independent project of an individual developer. Dear PVS-Studio, please check it.
 // PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
 #include "GfxDevice.hpp"
+#include <algorithm>
 #include <cstdint>
 #include <map>
 #include <vector>
 #include <cstring>
+#include <limits>
 #include <string>
+#include <thread>
 #include <vulkan/vulkan.h>
 #include "Array.hpp"
+#include "CommandRecorderVulkan.hpp"
 #include "FileSystem.hpp"
+#include "GpuProfilerVulkan.hpp"
 #include "LightTiler.hpp"
 #include "Macros.hpp"
+#include "Profiler.hpp"
 #include "RenderTexture.hpp"
 #include "Renderer.hpp"
 #include "System.hpp"
@@ -19,6 +25,7 @@
 #include "Texture2D.hpp"
 #include "TextureCube.hpp"
 #include "VertexBuffer.hpp"
+#include "VulkanAllocator.hpp"
 #include "VulkanUtils.hpp"
 #include "VR.hpp"
 #if VK_USE_PLATFORM_XCB_KHR
@@ -42,7 +49,7 @@ PFN_vkGetShaderInfoAMD getShaderInfoAMD;
 
 constexpr unsigned UI_VERTICE_COUNT = 512 * 1024;
 constexpr unsigned UI_FACE_COUNT = 128 * 1024;
-constexpr std::uint32_t descriptorSlotCount = 17;
+constexpr std::uint32_t descriptorSlotCount = 20;
 
 namespace Texture2DGlobal
 {
@@ -50,16 +57,18 @@ namespace Texture2DGlobal
 }
 
 extern VkBuffer particleBuffer;
-extern VkDeviceMemory particleMemory;
 
 extern VkBuffer particleTileBuffer;
-extern VkDeviceMemory particleTileMemory;
 extern VkBufferView particleTileBufferView;
+extern VkBuffer particleEmitterBuffer;
+
+void CreateBuffer( VkBuffer& buffer, int bufferSize, VkDeviceMemory& memory, VkDeviceSize& memoryOffset, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryFlags, const char* debugName );
 
 struct Ubo
 {
     VkBuffer ubo = VK_NULL_HANDLE;
     VkDeviceMemory uboMemory = VK_NULL_HANDLE;
+    VkDeviceSize uboMemoryOffset = 0;
     VkDescriptorBufferInfo uboDesc = {};
     std::uint8_t* uboData = nullptr;
 };
@@ -131,8 +140,7 @@ namespace GfxDeviceGlobal
     VkSemaphore presentCompleteSemaphore = VK_NULL_HANDLE;
     VkSemaphore renderCompleteSemaphore = VK_NULL_HANDLE;
     VkCommandPool cmdPool = VK_NULL_HANDLE;
-    VkQueryPool queryPool = VK_NULL_HANDLE;
-    float timings[ 3 ];
+    const char* parallelPassName = "";
     VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
     VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
     std::map< std::uint64_t, VkPipeline > psoCache;
@@ -145,11 +153,22 @@ namespace GfxDeviceGlobal
     VkFramebuffer frameBuffer0 = VK_NULL_HANDLE;
     VkImageView boundViews[ ae3d::ComputeShader::SLOT_COUNT ];
     VkSampler boundSamplers[ 2 ];
+    // Storage buffers of the next compute dispatch. Unbound slots use the bone buffer.
+    VkBuffer boundBuffers[ 2 ] = { VK_NULL_HANDLE, VK_NULL_HANDLE };
     VkSampler linearRepeat;
     Array< VkBuffer > pendingFreeVBs;
     Array< VkDeviceMemory > pendingFreeMemory;
+    Array< VkDeviceSize > pendingFreeMemoryOffsets;
     Array< Ubo > ubos;
     unsigned currentUbo = 0;
+    // Joint matrices of this frame's skinned draws. Host-visible, because it's rewritten every frame.
+    VkBuffer boneBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory boneMemory = VK_NULL_HANDLE;
+    VkDeviceSize boneMemoryOffset = 0;
+    ae3d::Matrix44* boneMatrices = nullptr;
+    unsigned boneMatrixCapacity = 0;
+    unsigned boneMatrixCount = 0;
+    unsigned boneBufferFrame = 0;
     VkSampleCountFlagBits msaaSampleBits = VK_SAMPLE_COUNT_1_BIT;
     ae3d::LightTiler lightTiler;
     PerObjectUboStruct perObjectUboStruct;
@@ -187,10 +206,32 @@ namespace ae3d
 				str += "pso changes: " + std::to_string( ::Statistics::GetPSOBindCalls() ) + "\n";
                 str += "queue submit calls: " + std::to_string( ::Statistics::GetQueueSubmitCalls() ) + "\n";
                 str += "mem alloc calls: " + std::to_string( ::Statistics::GetAllocCalls() ) + " (frame), " + std::to_string( ::Statistics::GetTotalAllocCalls() ) + " (total)\n";
+                VulkanAllocator::Stats allocatorStats;
+                VulkanAllocator::GetStats( allocatorStats );
+                str += "mem blocks: " + std::to_string( allocatorStats.blockCount ) + ", allocs: " + std::to_string( allocatorStats.allocationCount ) + ", " + std::to_string( allocatorStats.usedBytes / (1024 * 1024) ) + "/" + std::to_string( allocatorStats.reservedBytes / (1024 * 1024) ) + " MiB\n";
                 str += "triangles: " + std::to_string( ::Statistics::GetTriangleCount() ) + "\n";
+                str += "audio voices: " + std::to_string( ::Statistics::GetAudioVoiceCount() ) + ", virtual: " + std::to_string( ::Statistics::GetVirtualAudioVoiceCount() ) + "\n";
 
 				std::strncpy( outStr, str.c_str(), 512 );
             }
+
+            void GetPassTimings( char* outStr, int outStrLength )
+            {
+                if (outStrLength <= 0)
+                {
+                    return;
+                }
+
+                std::string str;
+
+                for (const GpuProfiler::Scope& scope : GpuProfiler::GetResolvedScopes())
+                {
+                    str += std::string( scope.depth * 2, ' ' ) + scope.name + ": CPU " + std::to_string( scope.cpuMS ) + " ms, GPU " + std::to_string( scope.gpuMS ) + " ms\n";
+                }
+
+                std::strncpy( outStr, str.c_str(), outStrLength );
+                outStr[ outStrLength - 1 ] = '\0';
+            }
         }
     }
 }
@@ -1357,7 +1398,10 @@ namespace ae3d
             { VK_DESCRIPTOR_TYPE_UNIFORM_TEXEL_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT },
             { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, AE3D_DESCRIPTOR_SETS_COUNT },
             { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT },
-            { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT }
+            { VK_DESCRIPTOR_TYPE_STORAGE_TEXEL_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT },
+            { VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, AE3D_DESCRIPTOR_SETS_COUNT }
         };
 
         VkDescriptorPoolCreateInfo descriptorPoolInfo = {};
@@ -1385,10 +1429,16 @@ namespace ae3d
         }
     }
 
-    VkDescriptorSet AllocateDescriptorSet( const VkDescriptorBufferInfo& uboDesc, const VkImageView& view0, VkSampler sampler0, const VkImageView& view1, VkSampler sampler1, const VkImageView& view2, const VkImageView& view3, const VkImageView& view4, const VkImageView& view14 )
+    VkDescriptorSet GetNextDescriptorSet()
     {
         VkDescriptorSet outDescriptorSet = GfxDeviceGlobal::descriptorSets[ GfxDeviceGlobal::descriptorSetIndex ];
         GfxDeviceGlobal::descriptorSetIndex = (GfxDeviceGlobal::descriptorSetIndex + 1) % GfxDeviceGlobal::descriptorSets.count;
+        return outDescriptorSet;
+    }
+
+    /// Writes all bindings of a descriptor set. Can be called from recording threads as long as each thread writes different sets.
+    void WriteDescriptorSet( VkDescriptorSet outDescriptorSet, const VkDescriptorBufferInfo& uboDesc, const VkImageView& view0, VkSampler sampler0, const VkImageView& view1, VkSampler sampler1, const VkImageView& view2, const VkImageView& view3, const VkImageView& view4, const VkImageView& view14 )
+    {
 
         VkDescriptorImageInfo sampler0Desc = {};
         sampler0Desc.sampler = sampler0;
@@ -1562,8 +1612,49 @@ namespace ae3d
         sets[ 16 ].pTexelBufferView = &particleTileBufferView;
         sets[ 16 ].dstBinding = 16;
 
+        VkDescriptorBufferInfo boneBufferDesc = {};
+        boneBufferDesc.buffer = GfxDeviceGlobal::boneBuffer;
+        boneBufferDesc.range = VK_WHOLE_SIZE;
+
+        // Binding 17 : Bone buffer.
+        sets[ 17 ].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        sets[ 17 ].dstSet = outDescriptorSet;
+        sets[ 17 ].descriptorCount = 1;
+        sets[ 17 ].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        sets[ 17 ].pBufferInfo = &boneBufferDesc;
+        sets[ 17 ].dstBinding = 17;
+
+        VkDescriptorBufferInfo computeBufferDescs[ 2 ] = {};
+
+        for (int i = 0; i < 2; ++i)
+        {
+            computeBufferDescs[ i ].buffer = GfxDeviceGlobal::boundBuffers[ i ] != VK_NULL_HANDLE ? GfxDeviceGlobal::boundBuffers[ i ] : GfxDeviceGlobal::boneBuffer;
+            computeBufferDescs[ i ].range = VK_WHOLE_SIZE;
+        }
+
+        // Binding 18 : Compute input buffer.
+        sets[ 18 ].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        sets[ 18 ].dstSet = outDescriptorSet;
+        sets[ 18 ].descriptorCount = 1;
+        sets[ 18 ].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        sets[ 18 ].pBufferInfo = &computeBufferDescs[ 0 ];
+        sets[ 18 ].dstBinding = 18;
+
+        // Binding 19 : Compute output buffer.
+        sets[ 19 ].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        sets[ 19 ].dstSet = outDescriptorSet;
+        sets[ 19 ].descriptorCount = 1;
+        sets[ 19 ].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        sets[ 19 ].pBufferInfo = &computeBufferDescs[ 1 ];
+        sets[ 19 ].dstBinding = 19;
+
         vkUpdateDescriptorSets( GfxDeviceGlobal::device, descriptorSlotCount, sets, 0, nullptr );
+    }
 
+    VkDescriptorSet AllocateDescriptorSet( const VkDescriptorBufferInfo& uboDesc, const VkImageView& view0, VkSampler sampler0, const VkImageView& view1, VkSampler sampler1, const VkImageView& view2, const VkImageView& view3, const VkImageView& view4, const VkImageView& view14 )
+    {
+        VkDescriptorSet outDescriptorSet = GetNextDescriptorSet();
+        WriteDescriptorSet( outDescriptorSet, uboDesc, view0, sampler0, view1, sampler1, view2, view3, view4, view14 );
         return outDescriptorSet;
     }
 
@@ -1673,6 +1764,24 @@ namespace ae3d
         layoutBindings[ 16 ].descriptorCount = 1;
         layoutBindings[ 16 ].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
 
+        // Binding 17 : Bone buffer
+        layoutBindings[ 17 ].binding = 17;
+        layoutBindings[ 17 ].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        layoutBindings[ 17 ].descriptorCount = 1;
+        layoutBindings[ 17 ].stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_COMPUTE_BIT;
+
+        // Binding 18 : Compute input buffer
+        layoutBindings[ 18 ].binding = 18;
+        layoutBindings[ 18 ].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        layoutBindings[ 18 ].descriptorCount = 1;
+        layoutBindings[ 18 ].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
+        // Binding 19 : Compute output buffer
+        layoutBindings[ 19 ].binding = 19;
+        layoutBindings[ 19 ].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        layoutBindings[ 19 ].descriptorCount = 1;
+        layoutBindings[ 19 ].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+
         VkDescriptorSetLayoutCreateInfo descriptorLayout = {};
         descriptorLayout.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
         descriptorLayout.bindingCount = descriptorSlotCount;
@@ -1760,18 +1869,15 @@ namespace ae3d
         GfxDevice::SetClearColor( 0, 0, 0 );
         GfxDevice::CreateUniformBuffers();
 
-        VkQueryPoolCreateInfo queryPoolInfo = {};
-        queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
-        queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
-        queryPoolInfo.queryCount = 2;
-
-        err = vkCreateQueryPool( GfxDeviceGlobal::device, &queryPoolInfo, nullptr, &GfxDeviceGlobal::queryPool );
-        AE3D_CHECK_VULKAN( err, "vkCreateQueryPool" );
+        GpuProfiler::Init( GfxDeviceGlobal::device, GfxDeviceGlobal::cmdPool, GfxDeviceGlobal::properties.limits.timestampPeriod );
 
         GfxDeviceGlobal::uiVertexBuffer.GenerateDynamic( UI_FACE_COUNT, UI_VERTICE_COUNT );
         
         GfxDeviceGlobal::lightTiler.Init();
 
+        const unsigned hardwareThreads = std::thread::hardware_concurrency();
+        CommandRecorder::Init( hardwareThreads > 4 ? 4 : hardwareThreads );
+
         VkCommandBufferAllocateInfo cmdBufInfo = {};
         cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
         cmdBufInfo.commandPool = GfxDeviceGlobal::cmdPool;
@@ -1816,6 +1922,17 @@ void ae3d::GfxDevice::DrawUI( int scX, int scY, int scWidth, int scHeight, int e
     Draw( GfxDeviceGlobal::uiVertexBuffer, offset, offset + elemCount, renderer.builtinShaders.uiShader, BlendMode::AlphaBlend, DepthFunc::NoneWriteOff, CullMode::Off, FillMode::Solid, GfxDevice::PrimitiveTopology::Triangles );
 }
 
+void ae3d::GfxDevice::BeginParallelDraws( const char* debugName )
+{
+    GfxDeviceGlobal::parallelPassName = debugName;
+    CommandRecorder::BeginPass( debugName );
+}
+
+void ae3d::GfxDevice::EndParallelDraws()
+{
+    CommandRecorder::EndPass( GfxDeviceGlobal::offscreenCmdBuffer );
+}
+
 void ae3d::GfxDevice::ResetPSOCache()
 {
     GfxDeviceGlobal::psoCache.clear();
@@ -1862,11 +1979,24 @@ void ae3d::GfxDevice::SetPolygonOffset( bool, float, float )
 
 void ae3d::GfxDevice::PushGroupMarker( const char* name )
 {
+    // A render pass whose contents are secondary buffers can't contain other commands. Recorded draws use the pass's name instead.
+    if (CommandRecorder::IsRecording())
+    {
+        return;
+    }
+
     debug::BeginRegion( GfxDeviceGlobal::currentCmdBuffer, name, 0, 1, 0 );
+    GpuProfiler::BeginScope( GfxDeviceGlobal::currentCmdBuffer, name );
 }
 
 void ae3d::GfxDevice::PopGroupMarker()
 {
+    if (CommandRecorder::IsRecording())
+    {
+        return;
+    }
+
+    GpuProfiler::EndScope( GfxDeviceGlobal::currentCmdBuffer, -1 );
     debug::EndRegion( GfxDeviceGlobal::currentCmdBuffer );
 }
 
@@ -2007,7 +2137,10 @@ void ae3d::GfxDevice::GetGpuMemoryUsage( unsigned& outUsedMBytes, unsigned& outB
     }
     else
     {
-        outUsedMBytes = 0;
+        // Without the budget extension, reports memory reserved by the allocator's blocks.
+        VulkanAllocator::Stats stats;
+        VulkanAllocator::GetStats( stats );
+        outUsedMBytes = (unsigned)(stats.reservedBytes / (1024 * 1024));
         outBudgetMBytes = 0;
     }
 }
@@ -2026,6 +2159,11 @@ void ae3d::GfxDevice::DrawLines( int handle, Shader& shader )
     Draw( GfxDeviceGlobal::lineBuffers[ handle ], 0, GfxDeviceGlobal::lineBuffers[ handle ].GetFaceCount() / 3, shader, BlendMode::Off, DepthFunc::LessOrEqualWriteOn, CullMode::Off, FillMode::Solid, GfxDevice::PrimitiveTopology::Lines );
 }
 
+void ae3d::GfxDevice::DrawLines( VertexBuffer& vertexBuffer, int startVertex, int endVertex, Shader& shader, DepthFunc depthFunc )
+{
+    Draw( vertexBuffer, startVertex / 3, endVertex / 3, shader, BlendMode::Off, depthFunc, CullMode::Off, FillMode::Solid, GfxDevice::PrimitiveTopology::Lines );
+}
+
 void ae3d::GfxDevice::SetViewport( int aViewport[ 4 ] )
 {
     VkViewport viewport = {};
@@ -2036,6 +2174,12 @@ void ae3d::GfxDevice::SetViewport( int aViewport[ 4 ] )
     viewport.minDepth = 0.0f;
     viewport.maxDepth = 1.0f;
 
+    if (CommandRecorder::IsRecording())
+    {
+        CommandRecorder::SetViewport( viewport );
+        return;
+    }
+
     vkCmdSetViewport( GfxDeviceGlobal::currentCmdBuffer, 0, 1, &viewport );    
 }
 
@@ -2046,6 +2190,13 @@ void ae3d::GfxDevice::SetScissor( int aScissor[ 4 ] )
     scissor.extent.height = (std::uint32_t)aScissor[ 3 ];
     scissor.offset.x = (std::uint32_t)aScissor[ 0 ];
     scissor.offset.y = (std::uint32_t)aScissor[ 1 ];
+
+    if (CommandRecorder::IsRecording())
+    {
+        CommandRecorder::SetScissor( scissor );
+        return;
+    }
+
     vkCmdSetScissor( GfxDeviceGlobal::currentCmdBuffer, 0, 1, &scissor );
 }
 
@@ -2103,9 +2254,47 @@ void ae3d::GfxDevice::Draw( VertexBuffer& vertexBuffer, int startIndex, int endI
     GfxDeviceGlobal::perObjectUboStruct.maxNumLightsPerTile = GfxDeviceGlobal::lightTiler.GetMaxNumLightsPerTile();
     GfxDeviceGlobal::perObjectUboStruct.tilesXY.x = (float)GfxDeviceGlobal::lightTiler.GetNumTilesX();
     GfxDeviceGlobal::perObjectUboStruct.tilesXY.y = (float)GfxDeviceGlobal::lightTiler.GetNumTilesY();
+    GfxDeviceGlobal::perObjectUboStruct.clusterSliceScale = GfxDeviceGlobal::lightTiler.GetClusterSliceScale();
+    GfxDeviceGlobal::perObjectUboStruct.clusterSliceBias = GfxDeviceGlobal::lightTiler.GetClusterSliceBias();
+    GfxDeviceGlobal::perObjectUboStruct.clusterSliceCount = 0;
+    GfxDeviceGlobal::perObjectUboStruct.clusterCountX = GfxDeviceGlobal::lightTiler.GetNumClustersX();
+    GfxDeviceGlobal::perObjectUboStruct.clusterCountY = GfxDeviceGlobal::lightTiler.GetNumClustersY();
+    GfxDeviceGlobal::perObjectUboStruct.clusterListBase = GfxDeviceGlobal::lightTiler.GetClusterListBase();
+
+    if (GfxDeviceGlobal::lightTiler.IsClusteredCulling())
+    {
+        GfxDeviceGlobal::perObjectUboStruct.clusterSliceCount = ae3d::LightTiler::ClusterSlices;
+    }
 
     UploadPerObjectUbo();
 
+    if (CommandRecorder::IsRecording())
+    {
+        CommandRecorder::DrawPacket packet;
+        packet.pso = GfxDeviceGlobal::psoCache[ psoHash ];
+        packet.descriptorSet = GetNextDescriptorSet();
+        packet.uboDesc = GfxDeviceGlobal::ubos[ GfxDeviceGlobal::currentUbo ].uboDesc;
+        packet.views[ 0 ] = GfxDeviceGlobal::boundViews[ 0 ];
+        packet.views[ 1 ] = GfxDeviceGlobal::boundViews[ 1 ];
+        packet.views[ 2 ] = GfxDeviceGlobal::boundViews[ 2 ];
+        packet.views[ 3 ] = GfxDeviceGlobal::boundViews[ 3 ];
+        packet.views[ 4 ] = GfxDeviceGlobal::boundViews[ 4 ];
+        packet.views[ 5 ] = GfxDeviceGlobal::boundViews[ 14 ];
+        packet.samplers[ 0 ] = GfxDeviceGlobal::boundSamplers[ 0 ];
+        packet.samplers[ 1 ] = GfxDeviceGlobal::boundSamplers[ 1 ];
+        packet.vertexBuffer = *vertexBuffer.GetVertexBuffer();
+        packet.indexBuffer = topology == PrimitiveTopology::Triangles ? *vertexBuffer.GetIndexBuffer() : VK_NULL_HANDLE;
+        packet.first = startIndex * 3;
+        packet.count = (endIndex - startIndex) * 3;
+        CommandRecorder::AddDraw( packet );
+
+        Statistics::IncTriangleCount( endIndex - startIndex );
+        Statistics::IncDrawCalls();
+
+        GfxDeviceGlobal::boundViews[ 4 ] = TextureCube::GetDefaultTexture()->GetView();
+        return;
+    }
+
     VkDescriptorSet descriptorSet = AllocateDescriptorSet( GfxDeviceGlobal::ubos[ GfxDeviceGlobal::currentUbo ].uboDesc, GfxDeviceGlobal::boundViews[ 0 ], GfxDeviceGlobal::boundSamplers[ 0 ], GfxDeviceGlobal::boundViews[ 1 ],
                                                            GfxDeviceGlobal::boundSamplers[ 1 ], GfxDeviceGlobal::boundViews[ 2 ], GfxDeviceGlobal::boundViews[ 3 ], GfxDeviceGlobal::boundViews[ 4 ], GfxDeviceGlobal::boundViews[ 14 ] );
 
@@ -2145,6 +2334,49 @@ void ae3d::GfxDevice::GetNewUniformBuffer()
     GfxDeviceGlobal::currentUbo = (GfxDeviceGlobal::currentUbo + 1) % GfxDeviceGlobal::ubos.count;
 }
 
+static void CreateBoneBuffer( unsigned capacity )
+{
+    VkBuffer oldBuffer = GfxDeviceGlobal::boneBuffer;
+    VkDeviceMemory oldMemory = GfxDeviceGlobal::boneMemory;
+    VkDeviceSize oldMemoryOffset = GfxDeviceGlobal::boneMemoryOffset;
+    ae3d::Matrix44* oldMatrices = GfxDeviceGlobal::boneMatrices;
+
+    CreateBuffer( GfxDeviceGlobal::boneBuffer, capacity * sizeof( ae3d::Matrix44 ), GfxDeviceGlobal::boneMemory, GfxDeviceGlobal::boneMemoryOffset,
+                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "bone buffer" );
+    GfxDeviceGlobal::boneMatrices = (ae3d::Matrix44*)VulkanAllocator::GetMappedData( GfxDeviceGlobal::boneMemory, GfxDeviceGlobal::boneMemoryOffset );
+    GfxDeviceGlobal::boneMatrixCapacity = capacity;
+
+    if (oldBuffer != VK_NULL_HANDLE)
+    {
+        // Descriptor sets written after this point use the new buffer, so it needs the matrices of earlier draws too.
+        std::copy( oldMatrices, oldMatrices + GfxDeviceGlobal::boneMatrixCount, GfxDeviceGlobal::boneMatrices );
+        GfxDeviceGlobal::pendingFreeVBs.Add( oldBuffer );
+        GfxDeviceGlobal::pendingFreeMemory.Add( oldMemory );
+        GfxDeviceGlobal::pendingFreeMemoryOffsets.Add( oldMemoryOffset );
+    }
+}
+
+unsigned ae3d::GfxDevice::UploadBoneMatrices( const Matrix44* matrices, unsigned count )
+{
+    const unsigned offset = GfxDeviceGlobal::boneMatrixCount;
+
+    if (offset + count > GfxDeviceGlobal::boneMatrixCapacity)
+    {
+        CreateBoneBuffer( static_cast< unsigned >( VertexBuffer::GetGrownCapacity( static_cast< int >( offset + count ), static_cast< int >( GfxDeviceGlobal::boneMatrixCapacity ),
+                                                                                   std::numeric_limits< int >::max() / static_cast< int >( sizeof( Matrix44 ) ) ) ) );
+    }
+
+    std::copy( matrices, matrices + count, GfxDeviceGlobal::boneMatrices + offset );
+    GfxDeviceGlobal::boneMatrixCount += count;
+
+    return offset;
+}
+
+unsigned ae3d::GfxDevice::GetBoneBufferFrame()
+{
+    return GfxDeviceGlobal::boneBufferFrame;
+}
+
 void ae3d::GfxDevice::CreateUniformBuffers()
 {
     GfxDeviceGlobal::ubos.Allocate( 1800 );
@@ -2153,7 +2385,7 @@ void ae3d::GfxDevice::CreateUniformBuffers()
     {
         auto& ubo = GfxDeviceGlobal::ubos[ uboIndex ];
 
-        const VkDeviceSize uboSize = 256 * 3 + 80 * 64 + 128 * 16;
+        const VkDeviceSize uboSize = 256 * 3 + 128 * 16;
         static_assert( uboSize >= sizeof( PerObjectUboStruct ), "UBO size must be larger than UBO struct" );
 
         VkBufferCreateInfo bufferInfo = {};
@@ -2165,28 +2397,17 @@ void ae3d::GfxDevice::CreateUniformBuffers()
         AE3D_CHECK_VULKAN( err, "vkCreateBuffer UBO" );
         debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)ubo.ubo, VK_OBJECT_TYPE_BUFFER, "ubo" );
 
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, ubo.ubo, &memReqs );
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &ubo.uboMemory );
-        AE3D_CHECK_VULKAN( err, "vkAllocateMemory UBO" );
-        Statistics::IncTotalAllocCalls();
-        Statistics::IncAllocCalls();
-
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, ubo.ubo, ubo.uboMemory, 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory UBO" );
+        ubo.uboMemoryOffset = VulkanAllocator::AllocateBufferMemory( ubo.ubo, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, ubo.uboMemory );
 
         ubo.uboDesc.buffer = ubo.ubo;
         ubo.uboDesc.offset = 0;
         ubo.uboDesc.range = uboSize;
 
-        err = vkMapMemory( GfxDeviceGlobal::device, ubo.uboMemory, 0, uboSize, 0, (void **)&ubo.uboData );
-        AE3D_CHECK_VULKAN( err, "vkMapMemory UBO" );
+        ubo.uboData = (std::uint8_t*)VulkanAllocator::GetMappedData( ubo.uboMemory, ubo.uboMemoryOffset );
     }
+
+    // Descriptor sets need a bone buffer even when nothing is skinned.
+    CreateBoneBuffer( 1024 );
 }
 
 std::uint8_t* ae3d::GfxDevice::GetCurrentUbo()
@@ -2213,6 +2434,23 @@ void ae3d::GfxDevice::BeginFrame()
     
     SubmitPostPresentBarrier();
 
+    GpuProfiler::BeginFrame( GfxDeviceGlobal::graphicsQueue );
+
+    // Offscreen passes are tagged with their profiler index.
+    float passTimesGpuMS[ 3 ] = {};
+
+    for (const GpuProfiler::Scope& scope : GpuProfiler::GetResolvedScopes())
+    {
+        if (scope.tag >= 0 && scope.tag < 3)
+        {
+            passTimesGpuMS[ scope.tag ] += scope.gpuMS;
+        }
+    }
+
+    Statistics::SetDepthNormalsGpuTime( passTimesGpuMS[ 0 ] );
+    Statistics::SetShadowMapGpuTime( passTimesGpuMS[ 1 ] );
+    Statistics::SetPrimaryPassGpuTime( passTimesGpuMS[ 2 ] );
+
     GfxDeviceGlobal::boundViews[ 0 ] = Texture2D::GetDefaultTexture()->GetView();
     GfxDeviceGlobal::boundViews[ 1 ] = Texture2D::GetDefaultTexture()->GetView();
     GfxDeviceGlobal::boundViews[ 2 ] = Texture2D::GetDefaultTexture()->GetView();
@@ -2283,9 +2521,9 @@ void ae3d::GfxDevice::Present()
 
     // FIXME: This slows down rendering
     
-    System::BeginTimer();
+    Profiler::BeginZone( "Queue wait" );
     err = vkQueueWaitIdle( GfxDeviceGlobal::graphicsQueue );
-    Statistics::IncQueueWaitTime( System::EndTimer() );
+    Statistics::IncQueueWaitTime( Profiler::EndZone() );
     AE3D_CHECK_VULKAN( err, "vkQueueWaitIdle" );
 
     for (unsigned i = 0; i < GfxDeviceGlobal::pendingFreeVBs.count; ++i)
@@ -2297,10 +2535,14 @@ void ae3d::GfxDevice::Present()
 
     for (unsigned i = 0; i < GfxDeviceGlobal::pendingFreeMemory.count; ++i)
     {
-        vkFreeMemory( GfxDeviceGlobal::device, GfxDeviceGlobal::pendingFreeMemory[ i ], nullptr );
+        VulkanAllocator::Free( GfxDeviceGlobal::pendingFreeMemory[ i ], GfxDeviceGlobal::pendingFreeMemoryOffsets[ i ] );
     }
     
     GfxDeviceGlobal::pendingFreeMemory.Allocate( 0 );
+    GfxDeviceGlobal::pendingFreeMemoryOffsets.Allocate( 0 );
+
+    GfxDeviceGlobal::boneMatrixCount = 0;
+    ++GfxDeviceGlobal::boneBufferFrame;
     Statistics::EndPresentTimeProfiling();
 }
 
@@ -2325,12 +2567,12 @@ void ae3d::GfxDevice::ReleaseGPUObjects()
     vkDestroyImageView( GfxDeviceGlobal::device, GfxDeviceGlobal::depthStencil.view, nullptr );
     vkFreeMemory( GfxDeviceGlobal::device, GfxDeviceGlobal::depthStencil.mem, nullptr );
     vkDestroyBuffer( GfxDeviceGlobal::device, particleBuffer, nullptr );
-    vkFreeMemory( GfxDeviceGlobal::device, particleMemory, nullptr );
+    vkDestroyBuffer( GfxDeviceGlobal::device, GfxDeviceGlobal::boneBuffer, nullptr );
 
     vkDestroyDescriptorSetLayout( GfxDeviceGlobal::device, GfxDeviceGlobal::descriptorSetLayout, nullptr );
     vkDestroyDescriptorPool( GfxDeviceGlobal::device, GfxDeviceGlobal::descriptorPool, nullptr );
     vkDestroyRenderPass( GfxDeviceGlobal::device, GfxDeviceGlobal::renderPass, nullptr );
-    vkDestroyQueryPool( GfxDeviceGlobal::device, GfxDeviceGlobal::queryPool, nullptr );
+    GpuProfiler::Destroy();
 
     if (GfxDeviceGlobal::msaaTarget.colorImage != VK_NULL_HANDLE)
     {
@@ -2344,10 +2586,10 @@ void ae3d::GfxDevice::ReleaseGPUObjects()
 
     vkDestroyBufferView( GfxDeviceGlobal::device, particleTileBufferView, nullptr );
     vkDestroyBuffer( GfxDeviceGlobal::device, particleTileBuffer, nullptr );
+    vkDestroyBuffer( GfxDeviceGlobal::device, particleEmitterBuffer, nullptr );
 
     for (unsigned i = 0; i < GfxDeviceGlobal::ubos.count; ++i)
     {
-        vkFreeMemory( GfxDeviceGlobal::device, GfxDeviceGlobal::ubos[ i ].uboMemory, nullptr );
         vkDestroyBuffer( GfxDeviceGlobal::device, GfxDeviceGlobal::ubos[ i ].ubo, nullptr );
     }
 
@@ -2358,6 +2600,8 @@ void ae3d::GfxDevice::ReleaseGPUObjects()
     RenderTexture::DestroyTextures();
     VertexBuffer::DestroyBuffers();
     GfxDeviceGlobal::lightTiler.DestroyBuffers();
+    VulkanAllocator::DestroyBlocks();
+    CommandRecorder::Destroy();
 
     for (auto pso : GfxDeviceGlobal::psoCache)
     {
@@ -2396,9 +2640,9 @@ void BeginOffscreen()
     ae3d::System::Assert( GfxDeviceGlobal::renderTexture0 != nullptr, "Render texture must be set when beginning offscreen rendering" );
     
     // FIXME: Use fence instead of queue wait.
-    ae3d::System::BeginTimer();
+    Profiler::BeginZone( "Queue wait" );
     vkQueueWaitIdle( GfxDeviceGlobal::graphicsQueue );
-    Statistics::IncQueueWaitTime( ae3d::System::EndTimer() );
+    Statistics::IncQueueWaitTime( Profiler::EndZone() );
 
     VkCommandBufferBeginInfo cmdBufInfo = {};
     cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -2406,10 +2650,8 @@ void BeginOffscreen()
     VkResult err = vkBeginCommandBuffer( GfxDeviceGlobal::offscreenCmdBuffer, &cmdBufInfo );
     AE3D_CHECK_VULKAN( err, "vkBeginCommandBuffer" );
 
-#ifndef DISABLE_TIMESTAMPS
-    vkCmdResetQueryPool( GfxDeviceGlobal::offscreenCmdBuffer, GfxDeviceGlobal::queryPool, 0, 2 );
-    vkCmdWriteTimestamp( GfxDeviceGlobal::offscreenCmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, GfxDeviceGlobal::queryPool, 0 );
-#endif
+    // Markers are skipped inside a pass recorded into secondary buffers, so the whole pass is profiled under its name.
+    GpuProfiler::BeginScope( GfxDeviceGlobal::offscreenCmdBuffer, CommandRecorder::IsRecording() ? GfxDeviceGlobal::parallelPassName : "Offscreen" );
     
     VkClearValue clearValues[ 2 ];
     clearValues[ 0 ].color = GfxDeviceGlobal::clearColor;
@@ -2426,15 +2668,24 @@ void BeginOffscreen()
     renderPassBeginInfo.pClearValues = clearValues;
     renderPassBeginInfo.framebuffer = GfxDeviceGlobal::frameBuffer0;
 
-    vkCmdBeginRenderPass( GfxDeviceGlobal::offscreenCmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE );
+    if (CommandRecorder::IsRecording())
+    {
+        CommandRecorder::SetRenderPass( renderPassBeginInfo.renderPass, renderPassBeginInfo.framebuffer, renderPassBeginInfo.renderArea.extent.width, renderPassBeginInfo.renderArea.extent.height );
+        vkCmdBeginRenderPass( GfxDeviceGlobal::offscreenCmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS );
+    }
+    else
+    {
+        vkCmdBeginRenderPass( GfxDeviceGlobal::offscreenCmdBuffer, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE );
+    }
 }
 
 void EndOffscreen( int profilerIndex, ae3d::RenderTexture* target )
 {
-#ifndef DISABLE_TIMESTAMPS    
-    vkCmdWriteTimestamp( GfxDeviceGlobal::offscreenCmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, GfxDeviceGlobal::queryPool, 1 );
-#endif
+    ae3d::System::Assert( !CommandRecorder::IsRecording(), "EndParallelDraws must be called before EndOffscreen" );
+
     vkCmdEndRenderPass( GfxDeviceGlobal::offscreenCmdBuffer );
+    // Written outside the render pass because a pass recorded into secondary buffers can't contain it.
+    GpuProfiler::EndScope( GfxDeviceGlobal::offscreenCmdBuffer, profilerIndex );
     
     VkResult err = vkEndCommandBuffer( GfxDeviceGlobal::offscreenCmdBuffer );
     AE3D_CHECK_VULKAN( err, "vkEndCommandBuffer" );
@@ -2455,26 +2706,6 @@ void EndOffscreen( int profilerIndex, ae3d::RenderTexture* target )
     AE3D_CHECK_VULKAN( err, "vkQueueSubmit" );
     Statistics::IncQueueSubmitCalls();
 
-#ifndef DISABLE_TIMESTAMPS
-    std::uint64_t timestamps[ 2 ] = {};
-    err = vkGetQueryPoolResults( GfxDeviceGlobal::device, GfxDeviceGlobal::queryPool, 0, 2, sizeof( std::uint64_t ) * 2, timestamps, sizeof( std::uint64_t ), VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WAIT_BIT );
-    //AE3D_CHECK_VULKAN( err, "vkGetQueryPoolResults" );
-    GfxDeviceGlobal::timings[0] = (timestamps[1] - timestamps[0]) * GfxDeviceGlobal::properties.limits.timestampPeriod * 1e-6f;
-#endif
-    
-    if (profilerIndex == 0)
-    {
-        Statistics::SetDepthNormalsGpuTime( GfxDeviceGlobal::timings[ 0 ] );
-    }
-    else if (profilerIndex == 1)
-    {
-        Statistics::SetShadowMapGpuTime( GfxDeviceGlobal::timings[ 0 ] );
-    }
-    else if (profilerIndex == 2)
-    {
-        Statistics::SetPrimaryPassGpuTime( GfxDeviceGlobal::timings[ 0 ] );
-    }
-
     if (target)
     {
         target->color.layout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
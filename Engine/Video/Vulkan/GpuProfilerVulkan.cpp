@@ -0,0 +1,201 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "GpuProfilerVulkan.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include "Macros.hpp"
+#include "Statistics.hpp"
+#include "System.hpp"
+#include "VulkanUtils.hpp"
+
+namespace GpuProfilerGlobal
+{
+    struct Record
+    {
+        GpuProfiler::Scope scope;
+        std::chrono::steady_clock::time_point cpuBegin;
+        bool hasGpuBegin = false;
+        bool hasGpuEnd = false;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkCommandPool cmdPool = VK_NULL_HANDLE;
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    VkCommandBuffer resetCmdBuffers[ GpuProfiler::FrameCount ];
+    float timestampPeriod = 1;
+    unsigned frameSlot = GpuProfiler::FrameCount - 1;
+    std::vector< Record > records[ GpuProfiler::FrameCount ];
+    std::vector< int > openScopes;
+    std::vector< GpuProfiler::Scope > resolvedScopes;
+    std::vector< std::uint64_t > queryResults;
+}
+
+namespace
+{
+    std::uint32_t GetFirstQuery( unsigned slot )
+    {
+        return slot * GpuProfiler::MaxScopesPerFrame * 2;
+    }
+}
+
+void GpuProfiler::Init( VkDevice device, VkCommandPool cmdPool, float timestampPeriod )
+{
+    GpuProfilerGlobal::device = device;
+    GpuProfilerGlobal::cmdPool = cmdPool;
+    GpuProfilerGlobal::timestampPeriod = timestampPeriod;
+
+    VkQueryPoolCreateInfo queryPoolInfo = {};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = FrameCount * MaxScopesPerFrame * 2;
+
+    VkResult err = vkCreateQueryPool( device, &queryPoolInfo, nullptr, &GpuProfilerGlobal::queryPool );
+    AE3D_CHECK_VULKAN( err, "vkCreateQueryPool" );
+
+    VkCommandBufferAllocateInfo cmdBufInfo = {};
+    cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    cmdBufInfo.commandPool = cmdPool;
+    cmdBufInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    cmdBufInfo.commandBufferCount = FrameCount;
+
+    err = vkAllocateCommandBuffers( device, &cmdBufInfo, GpuProfilerGlobal::resetCmdBuffers );
+    AE3D_CHECK_VULKAN( err, "vkAllocateCommandBuffers" );
+
+    // Resets are recorded once, outside render passes, and submitted before the frame's first scope.
+    for (unsigned slot = 0; slot < FrameCount; ++slot)
+    {
+        VkCommandBufferBeginInfo beginInfo = {};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+        err = vkBeginCommandBuffer( GpuProfilerGlobal::resetCmdBuffers[ slot ], &beginInfo );
+        AE3D_CHECK_VULKAN( err, "vkBeginCommandBuffer" );
+        vkCmdResetQueryPool( GpuProfilerGlobal::resetCmdBuffers[ slot ], GpuProfilerGlobal::queryPool, GetFirstQuery( slot ), MaxScopesPerFrame * 2 );
+        err = vkEndCommandBuffer( GpuProfilerGlobal::resetCmdBuffers[ slot ] );
+        AE3D_CHECK_VULKAN( err, "vkEndCommandBuffer" );
+    }
+
+    for (unsigned slot = 0; slot < FrameCount; ++slot)
+    {
+        GpuProfilerGlobal::records[ slot ].reserve( MaxScopesPerFrame );
+    }
+
+    GpuProfilerGlobal::queryResults.resize( MaxScopesPerFrame * 2 * 2 );
+}
+
+void GpuProfiler::BeginFrame( VkQueue queue )
+{
+    ae3d::System::Assert( GpuProfilerGlobal::openScopes.empty(), "Profiler scope was not ended in the previous frame" );
+    GpuProfilerGlobal::openScopes.clear();
+
+    GpuProfilerGlobal::frameSlot = (GpuProfilerGlobal::frameSlot + 1) % FrameCount;
+    std::vector< GpuProfilerGlobal::Record >& records = GpuProfilerGlobal::records[ GpuProfilerGlobal::frameSlot ];
+
+    if (!records.empty())
+    {
+        // Each query's value is followed by its availability, so queries that were never written don't need a wait.
+        const std::uint32_t queryCount = (std::uint32_t)records.size() * 2;
+        vkGetQueryPoolResults( GpuProfilerGlobal::device, GpuProfilerGlobal::queryPool, GetFirstQuery( GpuProfilerGlobal::frameSlot ), queryCount,
+                               queryCount * 2 * sizeof( std::uint64_t ), GpuProfilerGlobal::queryResults.data(), 2 * sizeof( std::uint64_t ),
+                               VK_QUERY_RESULT_64_BIT | VK_QUERY_RESULT_WITH_AVAILABILITY_BIT );
+
+        GpuProfilerGlobal::resolvedScopes.clear();
+
+        for (std::size_t i = 0; i < records.size(); ++i)
+        {
+            const std::uint64_t* begin = &GpuProfilerGlobal::queryResults[ i * 4 ];
+            const std::uint64_t* end = &GpuProfilerGlobal::queryResults[ i * 4 + 2 ];
+            Scope scope = records[ i ].scope;
+
+            if (records[ i ].hasGpuBegin && records[ i ].hasGpuEnd && begin[ 1 ] != 0 && end[ 1 ] != 0 && end[ 0 ] >= begin[ 0 ])
+            {
+                scope.gpuMS = (end[ 0 ] - begin[ 0 ]) * GpuProfilerGlobal::timestampPeriod * 1e-6f;
+            }
+
+            GpuProfilerGlobal::resolvedScopes.push_back( scope );
+        }
+    }
+
+    records.clear();
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &GpuProfilerGlobal::resetCmdBuffers[ GpuProfilerGlobal::frameSlot ];
+
+    VkResult err = vkQueueSubmit( queue, 1, &submitInfo, VK_NULL_HANDLE );
+    AE3D_CHECK_VULKAN( err, "vkQueueSubmit" );
+    Statistics::IncQueueSubmitCalls();
+}
+
+void GpuProfiler::BeginScope( VkCommandBuffer cmdBuffer, const char* name )
+{
+    std::vector< GpuProfilerGlobal::Record >& records = GpuProfilerGlobal::records[ GpuProfilerGlobal::frameSlot ];
+
+    if (records.size() >= MaxScopesPerFrame)
+    {
+        GpuProfilerGlobal::openScopes.push_back( -1 );
+        return;
+    }
+
+    const int index = (int)records.size();
+    records.push_back( GpuProfilerGlobal::Record() );
+    GpuProfilerGlobal::Record& record = records.back();
+    std::strncpy( record.scope.name, name, sizeof( record.scope.name ) - 1 );
+    record.scope.depth = (int)GpuProfilerGlobal::openScopes.size();
+    GpuProfilerGlobal::openScopes.push_back( index );
+
+#ifndef DISABLE_TIMESTAMPS
+    if (cmdBuffer != VK_NULL_HANDLE)
+    {
+        vkCmdWriteTimestamp( cmdBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, GpuProfilerGlobal::queryPool, GetFirstQuery( GpuProfilerGlobal::frameSlot ) + index * 2 );
+        record.hasGpuBegin = true;
+    }
+#endif
+
+    record.cpuBegin = std::chrono::steady_clock::now();
+}
+
+void GpuProfiler::EndScope( VkCommandBuffer cmdBuffer, int tag )
+{
+    const auto cpuEnd = std::chrono::steady_clock::now();
+
+    ae3d::System::Assert( !GpuProfilerGlobal::openScopes.empty(), "EndScope called without BeginScope" );
+
+    if (GpuProfilerGlobal::openScopes.empty())
+    {
+        return;
+    }
+
+    const int index = GpuProfilerGlobal::openScopes.back();
+    GpuProfilerGlobal::openScopes.pop_back();
+
+    if (index == -1)
+    {
+        return;
+    }
+
+    GpuProfilerGlobal::Record& record = GpuProfilerGlobal::records[ GpuProfilerGlobal::frameSlot ][ index ];
+    record.scope.cpuMS = static_cast< float >( std::chrono::duration< double, std::milli >( cpuEnd - record.cpuBegin ).count() );
+    record.scope.tag = tag;
+
+#ifndef DISABLE_TIMESTAMPS
+    if (cmdBuffer != VK_NULL_HANDLE)
+    {
+        vkCmdWriteTimestamp( cmdBuffer, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, GpuProfilerGlobal::queryPool, GetFirstQuery( GpuProfilerGlobal::frameSlot ) + index * 2 + 1 );
+        record.hasGpuEnd = true;
+    }
+#endif
+}
+
+const std::vector< GpuProfiler::Scope >& GpuProfiler::GetResolvedScopes()
+{
+    return GpuProfilerGlobal::resolvedScopes;
+}
+
+void GpuProfiler::Destroy()
+{
+    vkFreeCommandBuffers( GpuProfilerGlobal::device, GpuProfilerGlobal::cmdPool, FrameCount, GpuProfilerGlobal::resetCmdBuffers );
+    vkDestroyQueryPool( GpuProfilerGlobal::device, GpuProfilerGlobal::queryPool, nullptr );
+    GpuProfilerGlobal::queryPool = VK_NULL_HANDLE;
+}
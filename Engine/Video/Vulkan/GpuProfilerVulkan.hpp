@@ -0,0 +1,47 @@
+#ifndef GPU_PROFILER_VULKAN
+#define GPU_PROFILER_VULKAN
+
+#include <vulkan/vulkan.h>
+#include <vector>
+
+/// Measures CPU and GPU time of nested scopes. Scopes write timestamp queries into the frame's slot in a query pool
+/// and are resolved when the slot is reused FrameCount frames later, so reading the results never waits for the GPU.
+namespace GpuProfiler
+{
+    const unsigned FrameCount = 3;
+    const unsigned MaxScopesPerFrame = 256;
+
+    struct Scope
+    {
+        char name[ 32 ] = {};
+        int depth = 0;
+        int tag = -1;
+        float cpuMS = 0;
+        float gpuMS = 0;
+    };
+
+    /// Creates the query pool and command buffers that reset each frame's queries.
+    /// \param device Device.
+    /// \param cmdPool Command pool for reset command buffers.
+    /// \param timestampPeriod Nanoseconds per timestamp tick.
+    void Init( VkDevice device, VkCommandPool cmdPool, float timestampPeriod );
+
+    /// Resolves the frame that last used this frame's slot and resets the slot's queries.
+    /// \param queue Queue that executes this frame's scopes.
+    void BeginFrame( VkQueue queue );
+
+    /// \param cmdBuffer Command buffer that receives the begin timestamp. VK_NULL_HANDLE measures only CPU time.
+    /// \param name Scope name. Copied.
+    void BeginScope( VkCommandBuffer cmdBuffer, const char* name );
+
+    /// \param cmdBuffer Command buffer that receives the end timestamp. VK_NULL_HANDLE measures only CPU time.
+    /// \param tag Tag that is passed to the resolved scope, -1 for none.
+    void EndScope( VkCommandBuffer cmdBuffer, int tag );
+
+    /// \return Scopes of the latest resolved frame in the order they began. A scope's children follow it with depth + 1.
+    const std::vector< Scope >& GetResolvedScopes();
+
+    void Destroy();
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include "LightTiler.hpp"
 #include <cstring>
+#include <math.h>
 #include "ComputeShader.hpp"
 #include "GfxDevice.hpp"
 #include "Macros.hpp"
@@ -10,6 +11,7 @@
 #include "Renderer.hpp"
 #include "Statistics.hpp"
 #include "System.hpp"
+#include "VulkanAllocator.hpp"
 #include "VulkanUtils.hpp"
 
 extern ae3d::Renderer renderer;
@@ -17,6 +19,7 @@ extern ae3d::Renderer renderer;
 namespace MathUtil
 {
     int Max( int x, int y );
+    int Min( int x, int y );
 }
 
 namespace GfxDeviceGlobal
@@ -32,6 +35,18 @@ namespace GfxDeviceGlobal
 
 void UploadPerObjectUbo();
 
+static const unsigned LightIndexBufferSentinel = 0x7fffffff;
+
+static int ClampToCluster( float cluster, int clusterCount )
+{
+    if (!(cluster > 0))
+    {
+        return 0;
+    }
+
+    return cluster < clusterCount ? (int)cluster : clusterCount - 1;
+}
+
 void ae3d::LightTiler::DestroyBuffers()
 {
     vkDestroyBuffer( GfxDeviceGlobal::device, perTileLightIndexBuffer, nullptr );
@@ -46,12 +61,15 @@ void ae3d::LightTiler::DestroyBuffers()
     vkDestroyBufferView( GfxDeviceGlobal::device, spotLightColorView, nullptr );
     vkDestroyBufferView( GfxDeviceGlobal::device, spotLightBufferView, nullptr );
     vkDestroyBufferView( GfxDeviceGlobal::device, spotLightParamsView, nullptr );
-    vkFreeMemory( GfxDeviceGlobal::device, perTileLightIndexBufferMemory, nullptr );
-    vkFreeMemory( GfxDeviceGlobal::device, pointLightCenterAndRadiusMemory, nullptr );
-    vkFreeMemory( GfxDeviceGlobal::device, pointLightColorMemory, nullptr );
-    vkFreeMemory( GfxDeviceGlobal::device, spotLightColorMemory, nullptr );
-    vkFreeMemory( GfxDeviceGlobal::device, spotLightCenterAndRadiusMemory, nullptr );
-    vkFreeMemory( GfxDeviceGlobal::device, spotLightParamsMemory, nullptr );
+    vkDestroyBuffer( GfxDeviceGlobal::device, clusterLightIndexBuffer, nullptr );
+    vkDestroyBufferView( GfxDeviceGlobal::device, clusterLightIndexBufferView, nullptr );
+    VulkanAllocator::Free( perTileLightIndexBufferMemory, perTileLightIndexBufferMemoryOffset );
+    VulkanAllocator::Free( pointLightCenterAndRadiusMemory, pointLightCenterAndRadiusMemoryOffset );
+    VulkanAllocator::Free( pointLightColorMemory, pointLightColorMemoryOffset );
+    VulkanAllocator::Free( spotLightColorMemory, spotLightColorMemoryOffset );
+    VulkanAllocator::Free( spotLightCenterAndRadiusMemory, spotLightCenterAndRadiusMemoryOffset );
+    VulkanAllocator::Free( spotLightParamsMemory, spotLightParamsMemoryOffset );
+    VulkanAllocator::Free( clusterLightIndexBufferMemory, clusterLightIndexBufferMemoryOffset );
 }
 
 void ae3d::LightTiler::Init()
@@ -69,20 +87,7 @@ void ae3d::LightTiler::Init()
         AE3D_CHECK_VULKAN( err, "vkCreateBuffer" );
         debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)perTileLightIndexBuffer, VK_OBJECT_TYPE_BUFFER, "perTileLightIndexBuffer" );
 
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, perTileLightIndexBuffer, &memReqs );
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &perTileLightIndexBufferMemory );
-        AE3D_CHECK_VULKAN( err, "vkAllocateMemory perTileLightIndexBuffer" );
-
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)perTileLightIndexBufferMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "perTileLightIndexBufferMemory" );
-
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, perTileLightIndexBuffer, perTileLightIndexBufferMemory, 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory perTileLightIndexBuffer" );
+        perTileLightIndexBufferMemoryOffset = VulkanAllocator::AllocateBufferMemory( perTileLightIndexBuffer, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, perTileLightIndexBufferMemory );
 
         VkBufferViewCreateInfo bufferViewInfo = {};
         bufferViewInfo.sType = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
@@ -96,6 +101,32 @@ void ae3d::LightTiler::Init()
         debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)perTileLightIndexBufferView, VK_OBJECT_TYPE_BUFFER_VIEW, "perTileLightIndexBufferView" );
     }
 
+    // Cluster light index buffer
+    {
+        VkBufferCreateInfo bufferInfo = {};
+        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        // One region per frame in flight. Each clustered camera appends its lists to the frame's region.
+        bufferInfo.size = ClusterFrameCount * ClusterIndicesPerFrame * sizeof( unsigned );
+        bufferInfo.usage = VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT;
+        VkResult err = vkCreateBuffer( GfxDeviceGlobal::device, &bufferInfo, nullptr, &clusterLightIndexBuffer );
+        AE3D_CHECK_VULKAN( err, "vkCreateBuffer" );
+        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)clusterLightIndexBuffer, VK_OBJECT_TYPE_BUFFER, "clusterLightIndexBuffer" );
+
+        clusterLightIndexBufferMemoryOffset = VulkanAllocator::AllocateBufferMemory( clusterLightIndexBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, clusterLightIndexBufferMemory );
+        mappedClusterLightIndexMemory = VulkanAllocator::GetMappedData( clusterLightIndexBufferMemory, clusterLightIndexBufferMemoryOffset );
+
+        VkBufferViewCreateInfo bufferViewInfo = {};
+        bufferViewInfo.sType = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
+        bufferViewInfo.flags = 0;
+        bufferViewInfo.buffer = clusterLightIndexBuffer;
+        bufferViewInfo.range = VK_WHOLE_SIZE;
+        bufferViewInfo.format = VK_FORMAT_R32_UINT;
+
+        err = vkCreateBufferView( GfxDeviceGlobal::device, &bufferViewInfo, nullptr, &clusterLightIndexBufferView );
+        AE3D_CHECK_VULKAN( err, "cluster light index buffer view" );
+        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)clusterLightIndexBufferView, VK_OBJECT_TYPE_BUFFER_VIEW, "clusterLightIndexBufferView" );
+    }
+
     // Point light center/radius buffer
     {
         VkBufferCreateInfo bufferInfo = {};
@@ -106,23 +137,8 @@ void ae3d::LightTiler::Init()
         AE3D_CHECK_VULKAN( err, "vkCreateBuffer" );
         debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)pointLightCenterAndRadiusBuffer, VK_OBJECT_TYPE_BUFFER, "pointLightCenterAndRadiusBuffer" );
 
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, pointLightCenterAndRadiusBuffer, &memReqs );
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &pointLightCenterAndRadiusMemory );
-        AE3D_CHECK_VULKAN( err, "vkAllocateMemory pointLightCenterAndRadiusMemory" );
-
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)pointLightCenterAndRadiusMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "pointLightCenterAndRadiusMemory" );
-
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, pointLightCenterAndRadiusBuffer, pointLightCenterAndRadiusMemory, 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory pointLightCenterAndRadiusBuffer" );
-
-        err = vkMapMemory( GfxDeviceGlobal::device, pointLightCenterAndRadiusMemory, 0, bufferInfo.size, 0, &mappedPointLightCenterAndRadiusMemory );
-        AE3D_CHECK_VULKAN( err, "vkMapMemory point lights" );
+        pointLightCenterAndRadiusMemoryOffset = VulkanAllocator::AllocateBufferMemory( pointLightCenterAndRadiusBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, pointLightCenterAndRadiusMemory );
+        mappedPointLightCenterAndRadiusMemory = VulkanAllocator::GetMappedData( pointLightCenterAndRadiusMemory, pointLightCenterAndRadiusMemoryOffset );
 
         VkBufferViewCreateInfo bufferViewInfo = {};
         bufferViewInfo.sType = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
@@ -146,22 +162,8 @@ void ae3d::LightTiler::Init()
         AE3D_CHECK_VULKAN( err, "vkCreateBuffer" );
         debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)pointLightColorBuffer, VK_OBJECT_TYPE_BUFFER, "pointLightColorBuffer" );
 
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, pointLightColorBuffer, &memReqs );
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &pointLightColorMemory );
-        AE3D_CHECK_VULKAN( err, "vkAllocateMemory pointLightColorMemory" );
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)pointLightColorMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "pointLightColorMemory" );
-
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, pointLightColorBuffer, pointLightColorMemory, 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory pointLightColorBuffer" );
-
-        err = vkMapMemory( GfxDeviceGlobal::device, pointLightColorMemory, 0, bufferInfo.size, 0, &mappedPointLightColorMemory );
-        AE3D_CHECK_VULKAN( err, "vkMapMemory point lights" );
+        pointLightColorMemoryOffset = VulkanAllocator::AllocateBufferMemory( pointLightColorBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, pointLightColorMemory );
+        mappedPointLightColorMemory = VulkanAllocator::GetMappedData( pointLightColorMemory, pointLightColorMemoryOffset );
 
         VkBufferViewCreateInfo bufferViewInfo = {};
         bufferViewInfo.sType = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
@@ -185,23 +187,8 @@ void ae3d::LightTiler::Init()
         AE3D_CHECK_VULKAN( err, "vkCreateBuffer" );
         debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightCenterAndRadiusBuffer, VK_OBJECT_TYPE_BUFFER, "spotLightCenterAndRadiusBuffer" );
 
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, spotLightCenterAndRadiusBuffer, &memReqs );
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &spotLightCenterAndRadiusMemory );
-        AE3D_CHECK_VULKAN( err, "vkAllocateMemory spotLightCenterAndRadiusMemory" );
-
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightCenterAndRadiusMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "spotLightCenterAndRadiusMemory" );
-
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, spotLightCenterAndRadiusBuffer, spotLightCenterAndRadiusMemory, 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory spotLightCenterAndRadiusBuffer" );
-
-        err = vkMapMemory( GfxDeviceGlobal::device, spotLightCenterAndRadiusMemory, 0, bufferInfo.size, 0, &mappedSpotLightCenterAndRadiusMemory );
-        AE3D_CHECK_VULKAN( err, "vkMapMemory spot lights" );
+        spotLightCenterAndRadiusMemoryOffset = VulkanAllocator::AllocateBufferMemory( spotLightCenterAndRadiusBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, spotLightCenterAndRadiusMemory );
+        mappedSpotLightCenterAndRadiusMemory = VulkanAllocator::GetMappedData( spotLightCenterAndRadiusMemory, spotLightCenterAndRadiusMemoryOffset );
 
         VkBufferViewCreateInfo bufferViewInfo = {};
         bufferViewInfo.sType = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
@@ -225,23 +212,8 @@ void ae3d::LightTiler::Init()
         AE3D_CHECK_VULKAN( err, "vkCreateBuffer" );
         debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightParamsBuffer, VK_OBJECT_TYPE_BUFFER, "spotLightParamsBuffer" );
 
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, spotLightParamsBuffer, &memReqs );
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &spotLightParamsMemory );
-        AE3D_CHECK_VULKAN( err, "vkAllocateMemory spotLightParamsMemory" );
-
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightParamsMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "spotLightParamsMemory" );
-
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, spotLightParamsBuffer, spotLightParamsMemory, 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory spotLightParamsBuffer" );
-
-        err = vkMapMemory( GfxDeviceGlobal::device, spotLightParamsMemory, 0, bufferInfo.size, 0, &mappedSpotLightParamsMemory );
-        AE3D_CHECK_VULKAN( err, "vkMapMemory spot lights" );
+        spotLightParamsMemoryOffset = VulkanAllocator::AllocateBufferMemory( spotLightParamsBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, spotLightParamsMemory );
+        mappedSpotLightParamsMemory = VulkanAllocator::GetMappedData( spotLightParamsMemory, spotLightParamsMemoryOffset );
 
         VkBufferViewCreateInfo bufferViewInfo = {};
         bufferViewInfo.sType = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
@@ -265,23 +237,8 @@ void ae3d::LightTiler::Init()
         AE3D_CHECK_VULKAN( err, "vkCreateBuffer" );
         debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightColorBuffer, VK_OBJECT_TYPE_BUFFER, "spotLightColorBuffer" );
 
-        VkMemoryRequirements memReqs;
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, spotLightColorBuffer, &memReqs );
-
-        VkMemoryAllocateInfo allocInfo = {};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memReqs.size;
-        allocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT );
-        err = vkAllocateMemory( GfxDeviceGlobal::device, &allocInfo, nullptr, &spotLightColorMemory );
-        AE3D_CHECK_VULKAN( err, "vkAllocateMemory spotLightColorMemory" );
-
-        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)spotLightColorMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "spotLightColorMemory" );
-
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, spotLightColorBuffer, spotLightColorMemory, 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory spotLightColorBuffer" );
-
-        err = vkMapMemory( GfxDeviceGlobal::device, spotLightColorMemory, 0, bufferInfo.size, 0, &mappedSpotLightColorMemory );
-        AE3D_CHECK_VULKAN( err, "vkMapMemory spot lights" );
+        spotLightColorMemoryOffset = VulkanAllocator::AllocateBufferMemory( spotLightColorBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, spotLightColorMemory );
+        mappedSpotLightColorMemory = VulkanAllocator::GetMappedData( spotLightColorMemory, spotLightColorMemoryOffset );
 
         VkBufferViewCreateInfo bufferViewInfo = {};
         bufferViewInfo.sType = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
@@ -298,11 +255,51 @@ void ae3d::LightTiler::Init()
 
 void ae3d::LightTiler::UpdateLightBuffers()
 {
-    std::memcpy( mappedPointLightCenterAndRadiusMemory, &pointLightCenterAndRadius[ 0 ], MaxLights * 4 * sizeof( float ) );
-    std::memcpy( mappedPointLightColorMemory, &pointLightColors[ 0 ], MaxLights * 4 * sizeof( float ) );
-    std::memcpy( mappedSpotLightCenterAndRadiusMemory, &spotLightCenterAndRadius[ 0 ], MaxLights * 4 * sizeof( float ) );
-    std::memcpy( mappedSpotLightParamsMemory, &spotLightParams[ 0 ], MaxLights * 4 * sizeof( float ) );
-    std::memcpy( mappedSpotLightColorMemory, &spotLightColors[ 0 ], MaxLights * 4 * sizeof( float ) );
+    Statistics::BeginLightUpdateProfiling();
+
+    const int lastPointLight = MathUtil::Min( lastDirtyPointLight, activePointLights - 1 );
+
+    if (firstDirtyPointLight <= lastPointLight)
+    {
+        const std::size_t offset = firstDirtyPointLight * sizeof( Vec4 );
+        const std::size_t size = (lastPointLight - firstDirtyPointLight + 1) * sizeof( Vec4 );
+        std::memcpy( (std::uint8_t*)mappedPointLightCenterAndRadiusMemory + offset, &pointLightCenterAndRadius[ firstDirtyPointLight ], size );
+        std::memcpy( (std::uint8_t*)mappedPointLightColorMemory + offset, &pointLightColors[ firstDirtyPointLight ], size );
+    }
+
+    // Dirty lights past the active count stay dirty so they are uploaded when they become active.
+    if (lastDirtyPointLight > lastPointLight)
+    {
+        firstDirtyPointLight = MathUtil::Max( firstDirtyPointLight, lastPointLight + 1 );
+    }
+    else
+    {
+        firstDirtyPointLight = MaxLights;
+        lastDirtyPointLight = -1;
+    }
+
+    const int lastSpotLight = MathUtil::Min( lastDirtySpotLight, activeSpotLights - 1 );
+
+    if (firstDirtySpotLight <= lastSpotLight)
+    {
+        const std::size_t offset = firstDirtySpotLight * sizeof( Vec4 );
+        const std::size_t size = (lastSpotLight - firstDirtySpotLight + 1) * sizeof( Vec4 );
+        std::memcpy( (std::uint8_t*)mappedSpotLightCenterAndRadiusMemory + offset, &spotLightCenterAndRadius[ firstDirtySpotLight ], size );
+        std::memcpy( (std::uint8_t*)mappedSpotLightParamsMemory + offset, &spotLightParams[ firstDirtySpotLight ], size );
+        std::memcpy( (std::uint8_t*)mappedSpotLightColorMemory + offset, &spotLightColors[ firstDirtySpotLight ], size );
+    }
+
+    if (lastDirtySpotLight > lastSpotLight)
+    {
+        firstDirtySpotLight = MathUtil::Max( firstDirtySpotLight, lastSpotLight + 1 );
+    }
+    else
+    {
+        firstDirtySpotLight = MaxLights;
+        lastDirtySpotLight = -1;
+    }
+
+    Statistics::EndLightUpdateProfiling();
 }
 
 unsigned ae3d::LightTiler::GetNumTilesX() const
@@ -315,8 +312,225 @@ unsigned ae3d::LightTiler::GetNumTilesY() const
     return (unsigned)((GfxDevice::backBufferHeight + TileRes - 1) / (float)TileRes);
 }
 
+bool ae3d::LightTiler::GetClusterRange( const Vec4& centerAndRadius, const Matrix44& projection, const Matrix44& localToView, float nearPlane, float farPlane,
+                                        const ClusterSet& clusterSet, ClusterRange& outRange ) const
+{
+    Vec3 center;
+    Matrix44::TransformPoint( Vec3( centerAndRadius.x, centerAndRadius.y, centerAndRadius.z ), localToView, &center );
+    const float radius = centerAndRadius.w;
+
+    // View space looks down -z.
+    const float minDepth = -center.z - radius;
+    const float maxDepth = -center.z + radius;
+
+    if (maxDepth < nearPlane || minDepth > farPlane)
+    {
+        return false;
+    }
+
+    outRange.minZ = 0;
+    outRange.maxZ = ClusterSlices - 1;
+
+    if (minDepth > nearPlane)
+    {
+        outRange.minZ = ClampToCluster( logf( minDepth ) * clusterSet.sliceScale + clusterSet.sliceBias, ClusterSlices );
+    }
+
+    if (maxDepth < farPlane)
+    {
+        outRange.maxZ = ClampToCluster( logf( maxDepth ) * clusterSet.sliceScale + clusterSet.sliceBias, ClusterSlices );
+    }
+
+    const int numClustersX = (int)clusterSet.numClustersX;
+    const int numClustersY = (int)clusterSet.numClustersY;
+    outRange.minX = 0;
+    outRange.maxX = numClustersX - 1;
+    outRange.minY = 0;
+    outRange.maxY = numClustersY - 1;
+
+    const bool isPerspective = projection.m[ 11 ] != 0;
+
+    // Lights that cross the near plane cover the whole screen in a perspective projection.
+    if (isPerspective && minDepth <= nearPlane)
+    {
+        return true;
+    }
+
+    // Conservative NDC bounds of the sphere's view space AABB. In perspective, the smallest |x / depth| is at the far side
+    // of the sphere and the largest at the near side.
+    float ndc[ 4 ];
+    const float bounds[ 4 ] = { center.x - radius, center.x + radius, center.y - radius, center.y + radius };
+
+    for (int i = 0; i < 4; ++i)
+    {
+        const int axis = i / 2;
+        const float scale = projection.m[ axis * 5 ];
+
+        if (isPerspective)
+        {
+            const bool towardsCenter = (i & 1) == 0 ? bounds[ i ] >= 0 : bounds[ i ] <= 0;
+            float depth = minDepth;
+
+            if (towardsCenter)
+            {
+                depth = maxDepth;
+            }
+
+            ndc[ i ] = scale * bounds[ i ] / depth - projection.m[ 8 + axis ];
+        }
+        else
+        {
+            ndc[ i ] = scale * bounds[ i ] + projection.m[ 12 + axis ];
+        }
+    }
+
+    // Projection can flip y.
+    const float minNdcX = ndc[ 0 ] < ndc[ 1 ] ? ndc[ 0 ] : ndc[ 1 ];
+    const float maxNdcX = ndc[ 0 ] < ndc[ 1 ] ? ndc[ 1 ] : ndc[ 0 ];
+    const float minNdcY = ndc[ 2 ] < ndc[ 3 ] ? ndc[ 2 ] : ndc[ 3 ];
+    const float maxNdcY = ndc[ 2 ] < ndc[ 3 ] ? ndc[ 3 ] : ndc[ 2 ];
+
+    if (maxNdcX < -1 || minNdcX > 1 || maxNdcY < -1 || minNdcY > 1)
+    {
+        return false;
+    }
+
+    const float clusterWidth = (float)(ClusterTileRes * 2) / clusterSet.targetWidth;
+    const float clusterHeight = (float)(ClusterTileRes * 2) / clusterSet.targetHeight;
+    outRange.minX = ClampToCluster( (minNdcX + 1) / clusterWidth, numClustersX );
+    outRange.maxX = ClampToCluster( (maxNdcX + 1) / clusterWidth, numClustersX );
+    outRange.minY = ClampToCluster( (minNdcY + 1) / clusterHeight, numClustersY );
+    outRange.maxY = ClampToCluster( (maxNdcY + 1) / clusterHeight, numClustersY );
+
+    return true;
+}
+
+void ae3d::LightTiler::BeginClusterFrame()
+{
+    clusterFrame = (clusterFrame + 1) % ClusterFrameCount;
+    clusterWriteCursor = 0;
+    clusterSets.clear();
+    currentClusterSet = -1;
+}
+
+int ae3d::LightTiler::AssignLightsToClusters( const Matrix44& projection, const Matrix44& localToView, float nearPlane, float farPlane, int targetWidth, int targetHeight )
+{
+    ClusterSet clusterSet;
+    clusterSet.targetWidth = targetWidth > 0 ? targetWidth : 1;
+    clusterSet.targetHeight = targetHeight > 0 ? targetHeight : 1;
+    clusterSet.numClustersX = (unsigned)(clusterSet.targetWidth + ClusterTileRes - 1) / ClusterTileRes;
+    clusterSet.numClustersY = (unsigned)(clusterSet.targetHeight + ClusterTileRes - 1) / ClusterTileRes;
+
+    // Orthographic cameras can have a zero near plane.
+    const float clusterNear = nearPlane > 0.01f ? nearPlane : 0.01f;
+    clusterSet.sliceScale = ClusterSlices / logf( farPlane / clusterNear );
+    clusterSet.sliceBias = -clusterSet.sliceScale * logf( clusterNear );
+
+    const unsigned numClustersX = clusterSet.numClustersX;
+    const unsigned numClustersXY = numClustersX * clusterSet.numClustersY;
+    const unsigned numClusters = numClustersXY * ClusterSlices;
+    const int lightCount = activePointLights + activeSpotLights;
+
+    // Offsets and two sentinels per cluster must fit. If only the light indices don't fit, lights are dropped.
+    if (clusterWriteCursor + numClusters * 3 > ClusterIndicesPerFrame)
+    {
+        System::Print( "Clustered light culling: too many clustered cameras this frame, falling back to tiled culling for a %dx%d camera.\n", targetWidth, targetHeight );
+        return -1;
+    }
+
+    clusterSet.listBase = clusterFrame * ClusterIndicesPerFrame + clusterWriteCursor;
+
+    // Counts lights per cluster, [cluster * 2] for point lights and [cluster * 2 + 1] for spot lights.
+    clusterLightCounts.assign( numClusters * 2, 0 );
+    lightClusterRanges.resize( lightCount );
+
+    for (int i = 0; i < lightCount; ++i)
+    {
+        const bool isSpot = i >= activePointLights;
+        ClusterRange& range = lightClusterRanges[ i ];
+
+        if (!GetClusterRange( isSpot ? spotLightCenterAndRadius[ i - activePointLights ] : pointLightCenterAndRadius[ i ], projection, localToView, clusterNear, farPlane, clusterSet, range ))
+        {
+            range.minZ = 1;
+            range.maxZ = 0;
+            continue;
+        }
+
+        for (int z = range.minZ; z <= range.maxZ; ++z)
+        {
+            for (int y = range.minY; y <= range.maxY; ++y)
+            {
+                for (int x = range.minX; x <= range.maxX; ++x)
+                {
+                    const unsigned cluster = x + y * numClustersX + z * numClustersXY;
+                    ++clusterLightCounts[ cluster * 2 + (isSpot ? 1 : 0) ];
+                }
+            }
+        }
+    }
+
+    // Prefix sum into compact lists. Clusters that don't fit into the index budget drop lights.
+    // Offsets are local to clusterLightIndices here and made absolute when they are stored.
+    const unsigned budgetEnd = ClusterIndicesPerFrame - clusterWriteCursor;
+    clusterLightIndices.resize( budgetEnd );
+    clusterWriteOffsets.resize( numClusters * 2 );
+    unsigned offset = numClusters;
+    unsigned budget = budgetEnd - numClusters * 3;
+
+    for (unsigned cluster = 0; cluster < numClusters; ++cluster)
+    {
+        unsigned& pointCount = clusterLightCounts[ cluster * 2 ];
+        unsigned& spotCount = clusterLightCounts[ cluster * 2 + 1 ];
+        pointCount = (unsigned)MathUtil::Min( (int)pointCount, (int)budget );
+        budget -= pointCount;
+        spotCount = (unsigned)MathUtil::Min( (int)spotCount, (int)budget );
+        budget -= spotCount;
+
+        clusterLightIndices[ cluster ] = clusterSet.listBase + offset;
+        clusterWriteOffsets[ cluster * 2 ] = offset;
+        clusterWriteOffsets[ cluster * 2 + 1 ] = offset + pointCount + 1;
+        clusterLightIndices[ offset + pointCount ] = LightIndexBufferSentinel;
+        clusterLightIndices[ offset + pointCount + 1 + spotCount ] = LightIndexBufferSentinel;
+        offset += pointCount + spotCount + 2;
+    }
+
+    for (int i = 0; i < lightCount; ++i)
+    {
+        const bool isSpot = i >= activePointLights;
+        const unsigned lightIndex = isSpot ? (unsigned)(i - activePointLights) : (unsigned)i;
+        const ClusterRange& range = lightClusterRanges[ i ];
+
+        for (int z = range.minZ; z <= range.maxZ; ++z)
+        {
+            for (int y = range.minY; y <= range.maxY; ++y)
+            {
+                for (int x = range.minX; x <= range.maxX; ++x)
+                {
+                    const unsigned cluster = x + y * numClustersX + z * numClustersXY;
+                    const unsigned list = cluster * 2 + (isSpot ? 1 : 0);
+
+                    // Counts are now the remaining space in each list.
+                    if (clusterLightCounts[ list ] > 0)
+                    {
+                        clusterLightIndices[ clusterWriteOffsets[ list ]++ ] = lightIndex;
+                        --clusterLightCounts[ list ];
+                    }
+                }
+            }
+        }
+    }
+
+    std::memcpy( static_cast< unsigned* >( mappedClusterLightIndexMemory ) + clusterSet.listBase, clusterLightIndices.data(), offset * sizeof( unsigned ) );
+    clusterWriteCursor += offset;
+    clusterSets.push_back( clusterSet );
+
+    return (int)clusterSets.size() - 1;
+}
+
 void ae3d::LightTiler::CullLights( ComputeShader& shader, const Matrix44& projection, const Matrix44& localToView, RenderTexture& depthNormalTarget )
 {
+    currentClusterSet = -1;
+
     Matrix44::Invert( projection, GfxDeviceGlobal::perObjectUboStruct.clipToView );
 
     GfxDeviceGlobal::perObjectUboStruct.localToView = localToView;
@@ -6,7 +6,9 @@
 #include "GfxDevice.hpp"
 #include "Macros.hpp"
 #include "System.hpp"
+#include "Profiler.hpp"
 #include "Statistics.hpp"
+#include "VulkanAllocator.hpp"
 #include "VulkanUtils.hpp"
 
 namespace ae3d
@@ -32,12 +34,11 @@ namespace RenderTextureGlobal
     std::vector< VkSampler > samplersToReleaseAtExit;
     std::vector< VkImage > imagesToReleaseAtExit;
     std::vector< VkImageView > imageViewsToReleaseAtExit;
-    std::vector< VkDeviceMemory > memoryToReleaseAtExit;
     std::vector< VkFramebuffer > fbsToReleaseAtExit;
     std::vector< VkRenderPass > renderPassesToReleaseAtExit;
 }
 
-void CreateBuffer( VkBuffer& buffer, int bufferSize, VkDeviceMemory& memory, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryFlags, const char* debugName );
+void CreateBuffer( VkBuffer& buffer, int bufferSize, VkDeviceMemory& memory, VkDeviceSize& memoryOffset, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryFlags, const char* debugName );
 
 void ae3d::RenderTexture::DestroyTextures()
 {
@@ -56,11 +57,6 @@ void ae3d::RenderTexture::DestroyTextures()
         vkDestroyImageView( GfxDeviceGlobal::device, RenderTextureGlobal::imageViewsToReleaseAtExit[ imageViewIndex ], nullptr );
     }
 
-    for (std::size_t memoryIndex = 0; memoryIndex < RenderTextureGlobal::memoryToReleaseAtExit.size(); ++memoryIndex)
-    {
-        vkFreeMemory( GfxDeviceGlobal::device, RenderTextureGlobal::memoryToReleaseAtExit[ memoryIndex ], nullptr );
-    }
-
     for (std::size_t fbIndex = 0; fbIndex < RenderTextureGlobal::fbsToReleaseAtExit.size(); ++fbIndex)
     {
         vkDestroyFramebuffer( GfxDeviceGlobal::device, RenderTextureGlobal::fbsToReleaseAtExit[ fbIndex ], nullptr );
@@ -171,18 +167,12 @@ void* ae3d::RenderTexture::Map()
 
     vkDeviceWaitIdle( GfxDeviceGlobal::device );
 
-    void* pixels = nullptr;
-    //err = vkMapMemory( GfxDeviceGlobal::device, color.mem, 0, VK_WHOLE_SIZE, 0, &pixels );
-    err = vkMapMemory( GfxDeviceGlobal::device, pixelBufferMemory, 0, VK_WHOLE_SIZE, 0, &pixels );
-    AE3D_CHECK_VULKAN( err, "vkMapMemory" );
-
-    return pixels;
+    return VulkanAllocator::GetMappedData( pixelBufferMemory, pixelBufferMemoryOffset );
 }
 
 void ae3d::RenderTexture::Unmap()
 {
-    //vkUnmapMemory( GfxDeviceGlobal::device, color.mem );
-    vkUnmapMemory( GfxDeviceGlobal::device, pixelBufferMemory );
+    // Pixel buffer is allocated from a persistently mapped block, so there's nothing to unmap.
 }
 
 void ae3d::RenderTexture::ResolveTo( RenderTexture* target )
@@ -225,9 +215,9 @@ void ae3d::RenderTexture::ResolveTo( RenderTexture* target )
     AE3D_CHECK_VULKAN( err, "vkQueueSubmit" );
     Statistics::IncQueueSubmitCalls();
 
-    System::BeginTimer();
+    Profiler::BeginZone( "Queue wait" );
     err = vkQueueWaitIdle( GfxDeviceGlobal::graphicsQueue );
-    Statistics::IncQueueWaitTime( System::EndTimer() );
+    Statistics::IncQueueWaitTime( Profiler::EndZone() );
     AE3D_CHECK_VULKAN( err, "vkQueueWaitIdle" );
 
     GfxDevice::BeginRenderPassAndCommandBuffer();
@@ -319,24 +309,8 @@ void ae3d::RenderTexture::Create2D( int aWidth, int aHeight, DataType aDataType,
     RenderTextureGlobal::imagesToReleaseAtExit.push_back( color.image );
     debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)color.image, VK_OBJECT_TYPE_IMAGE, debugName );
 
-    VkMemoryRequirements memReqs;
-    vkGetImageMemoryRequirements( GfxDeviceGlobal::device, color.image, &memReqs );
-
-    VkMemoryAllocateInfo memAlloc = {};
-    memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memAlloc.allocationSize = memReqs.size;
-
     // The check makes it possible to call this method twice. The second call is made in MakeCpuReadable(). It's a hack, but saves some code.
-    memAlloc.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, isCpuAccess ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-    err = vkAllocateMemory( GfxDeviceGlobal::device, &memAlloc, nullptr, &color.mem );
-    AE3D_CHECK_VULKAN( err, "render texture 2d color image memory" );
-    debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)color.mem, VK_OBJECT_TYPE_DEVICE_MEMORY, debugName );
-    RenderTextureGlobal::memoryToReleaseAtExit.push_back( color.mem );
-    Statistics::IncAllocCalls();
-    Statistics::IncTotalAllocCalls();
-
-    err = vkBindImageMemory( GfxDeviceGlobal::device, color.image, color.mem, 0 );
-    AE3D_CHECK_VULKAN( err, "render texture 2d color image bind memory" );
+    VulkanAllocator::AllocateImageMemory( color.image, isCpuAccess ? VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT : VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, color.mem );
 
     AllocateSetupCommandBuffer();
 
@@ -380,17 +354,7 @@ void ae3d::RenderTexture::Create2D( int aWidth, int aHeight, DataType aDataType,
     RenderTextureGlobal::imagesToReleaseAtExit.push_back( depth.image );
     debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)depth.image, VK_OBJECT_TYPE_IMAGE, "render texture 2d depth" );
 
-    vkGetImageMemoryRequirements( GfxDeviceGlobal::device, depth.image, &memReqs );
-    memAlloc.allocationSize = memReqs.size;
-    memAlloc.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-    err = vkAllocateMemory( GfxDeviceGlobal::device, &memAlloc, nullptr, &depth.mem );
-    AE3D_CHECK_VULKAN( err, "render texture 2d depth memory" );
-    RenderTextureGlobal::memoryToReleaseAtExit.push_back( depth.mem );
-    Statistics::IncAllocCalls();
-    Statistics::IncTotalAllocCalls();
-
-    err = vkBindImageMemory( GfxDeviceGlobal::device, depth.image, depth.mem, 0 );
-    AE3D_CHECK_VULKAN( err, "render texture 2d depth bind" );
+    VulkanAllocator::AllocateImageMemory( depth.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depth.mem );
 
     SetImageLayout( GfxDeviceGlobal::setupCmdBuffer,
         depth.image,
@@ -443,7 +407,7 @@ void ae3d::RenderTexture::Create2D( int aWidth, int aHeight, DataType aDataType,
 
     if (isCpuAccess)
     {
-        CreateBuffer( pixelBuffer, width * height * 4 * sizeof( float ), pixelBufferMemory, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "render texture pixel buffer");
+        CreateBuffer( pixelBuffer, width * height * 4 * sizeof( float ), pixelBufferMemory, pixelBufferMemoryOffset, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "render texture pixel buffer");
     }
 }
 
@@ -510,19 +474,7 @@ void ae3d::RenderTexture::CreateCube( int aDimension, DataType aDataType, Textur
     RenderTextureGlobal::imagesToReleaseAtExit.push_back( color.image );
     debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)color.image, VK_OBJECT_TYPE_IMAGE, debugName );
 
-    VkMemoryRequirements memReqs;
-    vkGetImageMemoryRequirements( GfxDeviceGlobal::device, color.image, &memReqs );
-
-    VkMemoryAllocateInfo memAllocInfo = {};
-    memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memAllocInfo.allocationSize = memReqs.size;
-    memAllocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-    err = vkAllocateMemory( GfxDeviceGlobal::device, &memAllocInfo, nullptr, &color.mem );
-    AE3D_CHECK_VULKAN( err, "vkAllocateMemory in RenderTextureCube" );
-    RenderTextureGlobal::memoryToReleaseAtExit.push_back( color.mem );
-
-    err = vkBindImageMemory( GfxDeviceGlobal::device, color.image, color.mem, 0 );
-    AE3D_CHECK_VULKAN( err, "vkBindImageMemory in RenderTextureCube" );
+    VulkanAllocator::AllocateImageMemory( color.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, color.mem );
 
     AllocateSetupCommandBuffer();
 
@@ -582,21 +534,7 @@ void ae3d::RenderTexture::CreateCube( int aDimension, DataType aDataType, Textur
     RenderTextureGlobal::imagesToReleaseAtExit.push_back( depth.image );
     debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)depth.image, VK_OBJECT_TYPE_IMAGE, "render texture cube depth" );
 
-    vkGetImageMemoryRequirements( GfxDeviceGlobal::device, depth.image, &memReqs );
-
-    VkMemoryAllocateInfo memAlloc = {};
-    memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memAlloc.allocationSize = memReqs.size;
-    
-    memAlloc.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-    err = vkAllocateMemory( GfxDeviceGlobal::device, &memAlloc, nullptr, &depth.mem );
-    AE3D_CHECK_VULKAN( err, "render texture cube depth memory" );
-    RenderTextureGlobal::memoryToReleaseAtExit.push_back( depth.mem );
-    Statistics::IncAllocCalls();
-    Statistics::IncTotalAllocCalls();
-
-    err = vkBindImageMemory( GfxDeviceGlobal::device, depth.image, depth.mem, 0 );
-    AE3D_CHECK_VULKAN( err, "render texture cube depth bind" );
+    VulkanAllocator::AllocateImageMemory( depth.image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depth.mem );
 
     SetImageLayout( GfxDeviceGlobal::setupCmdBuffer,
         depth.image,
@@ -4,6 +4,7 @@
 #include "System.hpp"
 #include "Vec3.hpp"
 #include <vulkan/vulkan.h>
+#include "VulkanAllocator.hpp"
 #include "VulkanUtils.hpp"
 
 namespace GfxDeviceGlobal
@@ -15,12 +16,20 @@ ae3d::Renderer renderer;
 
 VkBuffer particleBuffer;
 VkDeviceMemory particleMemory;
+VkDeviceSize particleMemoryOffset;
 
 VkBuffer particleTileBuffer;
 VkBufferView particleTileBufferView;
 VkDeviceMemory particleTileMemory;
+VkDeviceSize particleTileMemoryOffset;
 
-void CreateBuffer( VkBuffer& buffer, int bufferSize, VkDeviceMemory& memory, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryFlags, const char* debugName );
+// Parameters of the emitters in the particle simulation dispatch. Host-visible, because it's rewritten every frame.
+VkBuffer particleEmitterBuffer;
+VkDeviceMemory particleEmitterMemory;
+VkDeviceSize particleEmitterMemoryOffset;
+ae3d::ParticleEmitter* particleEmitters;
+
+void CreateBuffer( VkBuffer& buffer, int bufferSize, VkDeviceMemory& memory, VkDeviceSize& memoryOffset, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryFlags, const char* debugName );
 
 void ae3d::BuiltinShaders::Load()
 {
@@ -37,11 +46,12 @@ void ae3d::BuiltinShaders::Load()
     particleSimulationShader.LoadSPIRV( FileSystem::FileContents( "shaders/particle_simulate.spv" ) );
     particleCullShader.LoadSPIRV( FileSystem::FileContents( "shaders/particle_cull.spv" ) );
     particleDrawShader.LoadSPIRV( FileSystem::FileContents( "shaders/particle_draw.spv" ) );
+    skinningShader.LoadSPIRV( FileSystem::FileContents( "shaders/skin_vertices.spv" ) );
 
-    CreateBuffer( particleBuffer, 1000000 * sizeof( Particle ), particleMemory, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "particle buffer" );
+    CreateBuffer( particleBuffer, MaxParticleCount * sizeof( Particle ), particleMemory, particleMemoryOffset, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "particle buffer" );
     const unsigned particleTileCount = renderer.GetNumParticleTilesX() * renderer.GetNumParticleTilesY();
     const unsigned maxParticlesPerTile = 1000;
-    CreateBuffer( particleTileBuffer, maxParticlesPerTile * particleTileCount * sizeof( unsigned ), particleTileMemory, VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "particle tile buffer" );
+    CreateBuffer( particleTileBuffer, maxParticlesPerTile * particleTileCount * sizeof( unsigned ), particleTileMemory, particleTileMemoryOffset, VK_BUFFER_USAGE_STORAGE_TEXEL_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "particle tile buffer" );
 
     VkBufferViewCreateInfo bufferViewInfo = {};
     bufferViewInfo.sType = VK_STRUCTURE_TYPE_BUFFER_VIEW_CREATE_INFO;
@@ -54,4 +64,7 @@ void ae3d::BuiltinShaders::Load()
     AE3D_CHECK_VULKAN( err, "particle tile buffer view" );
     debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)particleTileBufferView, VK_OBJECT_TYPE_BUFFER_VIEW, "particleTileBufferView" );
 
+    CreateBuffer( particleEmitterBuffer, MaxParticleEmitterCount * sizeof( ParticleEmitter ), particleEmitterMemory, particleEmitterMemoryOffset,
+                  VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "particle emitter buffer" );
+    particleEmitters = (ParticleEmitter*)VulkanAllocator::GetMappedData( particleEmitterMemory, particleEmitterMemoryOffset );
 }
@@ -13,7 +13,9 @@
 #include "FileSystem.hpp"
 #include "Macros.hpp"
 #include "System.hpp"
+#include "Profiler.hpp"
 #include "Statistics.hpp"
+#include "VulkanAllocator.hpp"
 #include "VulkanUtils.hpp"
 
 bool HasStbExtension( const std::string& path ); // Defined in TextureCommon.cpp
@@ -42,7 +44,6 @@ namespace Texture2DGlobal
     std::vector< VkSampler > samplersToReleaseAtExit;
     std::vector< VkImage > imagesToReleaseAtExit;
     std::vector< VkImageView > imageViewsToReleaseAtExit;
-    std::vector< VkDeviceMemory > memoryToReleaseAtExit;
 }
 
 void ae3d::Texture2D::DestroyTextures()
@@ -61,18 +62,12 @@ void ae3d::Texture2D::DestroyTextures()
     {
         vkDestroyImageView( GfxDeviceGlobal::device, Texture2DGlobal::imageViewsToReleaseAtExit[ imageViewIndex ], nullptr );
     }
-
-    for (std::size_t memoryIndex = 0; memoryIndex < Texture2DGlobal::memoryToReleaseAtExit.size(); ++memoryIndex)
-    {
-        vkFreeMemory( GfxDeviceGlobal::device, Texture2DGlobal::memoryToReleaseAtExit[ memoryIndex ], nullptr );
-    }
 }
 
 void ae3d::Texture2D::LoadFromData( const void* imageData, int aWidth, int aHeight, const char* debugName, DataType format )
 {
     width = aWidth;
     height = aHeight;
-    wrap = TextureWrap::Repeat;
     filter = TextureFilter::Linear;
     opaque = true;
 
@@ -103,6 +98,79 @@ void ae3d::Texture2D::LoadFromData( const void* imageData, int aWidth, int aHeig
     debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)image, VK_OBJECT_TYPE_IMAGE, debugName );
 }
 
+void ae3d::Texture2D::UpdateRegion( const void* rgbaPixels, int x, int y, int regionWidth, int regionHeight )
+{
+    System::Assert( image != VK_NULL_HANDLE, "UpdateRegion needs a texture created by LoadFromData" );
+    System::Assert( x >= 0 && y >= 0 && x + regionWidth <= width && y + regionHeight <= height, "UpdateRegion: region is outside the texture" );
+
+    const VkDeviceSize regionSize = static_cast< VkDeviceSize >( regionWidth ) * regionHeight * 4;
+
+    VkBufferCreateInfo bufferCreateInfo = {};
+    bufferCreateInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferCreateInfo.size = regionSize;
+    bufferCreateInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+    bufferCreateInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;
+    VkResult err = vkCreateBuffer( GfxDeviceGlobal::device, &bufferCreateInfo, nullptr, &stagingBuffer );
+    AE3D_CHECK_VULKAN( err, "vkCreateBuffer staging" );
+    debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)stagingBuffer, VK_OBJECT_TYPE_BUFFER, "staging2D region" );
+
+    VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
+    const VkDeviceSize stagingMemoryOffset = VulkanAllocator::AllocateBufferMemory( stagingBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, stagingMemory );
+    std::memcpy( VulkanAllocator::GetMappedData( stagingMemory, stagingMemoryOffset ), rgbaPixels, regionSize );
+
+    VkMappedMemoryRange flushRange = {};
+    flushRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    flushRange.memory = stagingMemory;
+    flushRange.offset = stagingMemoryOffset;
+    flushRange.size = VulkanAllocator::GetAllocationSize( stagingMemory, stagingMemoryOffset );
+    vkFlushMappedMemoryRanges( GfxDeviceGlobal::device, 1, &flushRange );
+
+    VkCommandBufferBeginInfo cmdBufInfo = {};
+    cmdBufInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+
+    err = vkBeginCommandBuffer( GfxDeviceGlobal::texCmdBuffer, &cmdBufInfo );
+    AE3D_CHECK_VULKAN( err, "vkBeginCommandBuffer in Texture2D" );
+
+    // The rest of the image keeps its contents, so the old layout is not undefined.
+    SetImageLayout( GfxDeviceGlobal::texCmdBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT, layout, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, 0, 1 );
+
+    VkBufferImageCopy bufferCopyRegion = {};
+    bufferCopyRegion.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+    bufferCopyRegion.imageSubresource.mipLevel = 0;
+    bufferCopyRegion.imageSubresource.baseArrayLayer = 0;
+    bufferCopyRegion.imageSubresource.layerCount = 1;
+    bufferCopyRegion.imageOffset = { x, y, 0 };
+    bufferCopyRegion.imageExtent.width = static_cast< std::uint32_t >( regionWidth );
+    bufferCopyRegion.imageExtent.height = static_cast< std::uint32_t >( regionHeight );
+    bufferCopyRegion.imageExtent.depth = 1;
+    bufferCopyRegion.bufferOffset = 0;
+
+    vkCmdCopyBufferToImage( GfxDeviceGlobal::texCmdBuffer, stagingBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &bufferCopyRegion );
+
+    SetImageLayout( GfxDeviceGlobal::texCmdBuffer, image, VK_IMAGE_ASPECT_COLOR_BIT, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, layout, 1, 0, 1 );
+
+    vkEndCommandBuffer( GfxDeviceGlobal::texCmdBuffer );
+
+    VkSubmitInfo submitInfo = {};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &GfxDeviceGlobal::texCmdBuffer;
+
+    err = vkQueueSubmit( GfxDeviceGlobal::graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE );
+    AE3D_CHECK_VULKAN( err, "vkQueueSubmit in Texture2D" );
+    Statistics::IncQueueSubmitCalls();
+
+    Profiler::BeginZone( "Queue wait" );
+    err = vkQueueWaitIdle( GfxDeviceGlobal::graphicsQueue );
+    Statistics::IncQueueWaitTime( Profiler::EndZone() );
+    AE3D_CHECK_VULKAN( err, "vkQueueWaitIdle" );
+
+    vkDestroyBuffer( GfxDeviceGlobal::device, stagingBuffer, nullptr );
+    VulkanAllocator::Free( stagingMemory, stagingMemoryOffset );
+}
+
 void ae3d::Texture2D::Load( const FileSystem::FileContentsData& fileContents, TextureWrap aWrap, TextureFilter aFilter, Mipmaps aMipmaps, ColorSpace aColorSpace, Anisotropy aAnisotropy )
 {
     filter = aFilter;
@@ -166,26 +234,11 @@ void ae3d::Texture2D::CreateVulkanObjects( const DDSLoader::Output& mipChain, Vk
     AE3D_CHECK_VULKAN( err, "vkCreateImage" );
     Texture2DGlobal::imagesToReleaseAtExit.push_back( image );
 
-    VkMemoryRequirements memReqs = {};
-    vkGetImageMemoryRequirements( GfxDeviceGlobal::device, image, &memReqs );
-
-    VkMemoryAllocateInfo memAllocInfo = {};
-    memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memAllocInfo.allocationSize = memReqs.size;
-    memAllocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-
-    err = vkAllocateMemory( GfxDeviceGlobal::device, &memAllocInfo, nullptr, &deviceMemory );
-    AE3D_CHECK_VULKAN( err, "vkAllocateMemory" );
-    Statistics::IncAllocCalls();
-    Statistics::IncTotalAllocCalls();
-    Texture2DGlobal::memoryToReleaseAtExit.push_back( deviceMemory );
-	debug::SetObjectName( GfxDeviceGlobal::device, ( std::uint64_t )deviceMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "tex2d dds memory" );
-
-    err = vkBindImageMemory( GfxDeviceGlobal::device, image, deviceMemory, 0 );
-    AE3D_CHECK_VULKAN( err, "vkBindImageMemory" );
+    VulkanAllocator::AllocateImageMemory( image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, deviceMemory );
 
     Array< VkBuffer > stagingBuffers( mipLevelCount );
     Array< VkDeviceMemory > stagingMemory( mipLevelCount );
+    Array< VkDeviceSize > stagingMemoryOffsets( mipLevelCount );
     
     for (int mipIndex = 0; mipIndex < mipLevelCount; ++mipIndex)
     {
@@ -210,21 +263,9 @@ void ae3d::Texture2D::CreateVulkanObjects( const DDSLoader::Output& mipChain, Vk
         AE3D_CHECK_VULKAN( err, "vkCreateBuffer staging" );
         debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)stagingBuffers[ mipIndex ], VK_OBJECT_TYPE_BUFFER, "stagingBuffer2D" );
 
-        vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, stagingBuffers[ mipIndex ], &memReqs );
-
-        memAllocInfo.allocationSize = (memReqs.size + GfxDeviceGlobal::properties.limits.nonCoherentAtomSize - 1) & ~(GfxDeviceGlobal::properties.limits.nonCoherentAtomSize - 1);;
-        memAllocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT );
-
-		err = vkAllocateMemory( GfxDeviceGlobal::device, &memAllocInfo, nullptr, &stagingMemory[ mipIndex ] );
-		AE3D_CHECK_VULKAN( err, "vkAllocateMemory" );
-		debug::SetObjectName( GfxDeviceGlobal::device, ( std::uint64_t )deviceMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "tex2d memory" );
-
-        err = vkBindBufferMemory( GfxDeviceGlobal::device, stagingBuffers[ mipIndex ], stagingMemory[ mipIndex ], 0 );
-        AE3D_CHECK_VULKAN( err, "vkBindBufferMemory staging" );
+        stagingMemoryOffsets[ mipIndex ] = VulkanAllocator::AllocateBufferMemory( stagingBuffers[ mipIndex ], VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, stagingMemory[ mipIndex ] );
 
-        void* stagingData;
-        err = vkMapMemory( GfxDeviceGlobal::device, stagingMemory[ mipIndex ], 0, memAllocInfo.allocationSize, 0, &stagingData );
-        AE3D_CHECK_VULKAN( err, "vkMapMemory in Texture2D" );
+        void* stagingData = VulkanAllocator::GetMappedData( stagingMemory[ mipIndex ], stagingMemoryOffsets[ mipIndex ] );
         VkDeviceSize amountToCopy = imageSize;
         if (mipChain.dataOffsets[ mipIndex ] + imageSize >= (unsigned)mipChain.imageData.count)
         {
@@ -236,11 +277,9 @@ void ae3d::Texture2D::CreateVulkanObjects( const DDSLoader::Output& mipChain, Vk
         VkMappedMemoryRange flushRange = {};
         flushRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
         flushRange.memory = stagingMemory[ mipIndex ];
-        flushRange.offset = 0;
-        flushRange.size = VK_WHOLE_SIZE;
+        flushRange.offset = stagingMemoryOffsets[ mipIndex ];
+        flushRange.size = VulkanAllocator::GetAllocationSize( stagingMemory[ mipIndex ], stagingMemoryOffsets[ mipIndex ] );
         vkFlushMappedMemoryRanges( GfxDeviceGlobal::device, 1, &flushRange );
-
-        vkUnmapMemory( GfxDeviceGlobal::device, stagingMemory[ mipIndex ] );
     }
 
     VkImageViewCreateInfo viewInfo = {};
@@ -369,7 +408,7 @@ void ae3d::Texture2D::CreateVulkanObjects( const DDSLoader::Output& mipChain, Vk
     for (int mipLevel = 0; mipLevel < mipLevelCount; ++mipLevel)
     {
         vkDestroyBuffer( GfxDeviceGlobal::device, stagingBuffers[ mipLevel ], nullptr );
-        vkFreeMemory( GfxDeviceGlobal::device, stagingMemory[ mipLevel ], nullptr );
+        VulkanAllocator::Free( stagingMemory[ mipLevel ], stagingMemoryOffsets[ mipLevel ] );
     }
     
     VkSamplerCreateInfo samplerInfo = {};
@@ -456,9 +495,9 @@ void ae3d::Texture2D::SetLayout( TextureLayout aLayout )
     Statistics::IncQueueSubmitCalls();
 
     // FIXME: This is slow
-    System::BeginTimer();
+    Profiler::BeginZone( "Queue wait" );
 	err = vkQueueWaitIdle( GfxDeviceGlobal::graphicsQueue );
-    Statistics::IncQueueWaitTime( System::EndTimer() );
+    Statistics::IncQueueWaitTime( Profiler::EndZone() );
 
 	AE3D_CHECK_VULKAN( err, "vkQueueWaitIdle" );
 }
@@ -494,23 +533,7 @@ void ae3d::Texture2D::CreateVulkanObjects( void* data, int bytesPerPixel, VkForm
     AE3D_CHECK_VULKAN( err, "vkCreateImage" );
     Texture2DGlobal::imagesToReleaseAtExit.push_back( image );
 
-    VkMemoryRequirements memReqs = {};
-    vkGetImageMemoryRequirements( GfxDeviceGlobal::device, image, &memReqs );
-
-    VkMemoryAllocateInfo memAllocInfo = {};
-    memAllocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    memAllocInfo.allocationSize = memReqs.size;
-    memAllocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT );
-
-    err = vkAllocateMemory( GfxDeviceGlobal::device, &memAllocInfo, nullptr, &deviceMemory );
-    AE3D_CHECK_VULKAN( err, "vkAllocateMemory" );
-    Statistics::IncAllocCalls();
-    Statistics::IncTotalAllocCalls();
-    Texture2DGlobal::memoryToReleaseAtExit.push_back( deviceMemory );
-	debug::SetObjectName( GfxDeviceGlobal::device, ( std::uint64_t )deviceMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "tex2d memory" );
-
-    err = vkBindImageMemory( GfxDeviceGlobal::device, image, deviceMemory, 0 );
-    AE3D_CHECK_VULKAN( err, "vkBindImageMemory" );
+    VulkanAllocator::AllocateImageMemory( image, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, deviceMemory );
 
     VkBuffer stagingBuffer = VK_NULL_HANDLE;
 
@@ -525,22 +548,10 @@ void ae3d::Texture2D::CreateVulkanObjects( void* data, int bytesPerPixel, VkForm
     AE3D_CHECK_VULKAN( err, "vkCreateBuffer staging" );
     debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)stagingBuffer, VK_OBJECT_TYPE_BUFFER, "staging2D" );
 
-    vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, stagingBuffer, &memReqs );
-
-    memAllocInfo.allocationSize = (memReqs.size + GfxDeviceGlobal::properties.limits.nonCoherentAtomSize - 1) & ~(GfxDeviceGlobal::properties.limits.nonCoherentAtomSize - 1);
-    memAllocInfo.memoryTypeIndex = GetMemoryType( memReqs.memoryTypeBits, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT );
     VkDeviceMemory stagingMemory = VK_NULL_HANDLE;
-    err = vkAllocateMemory( GfxDeviceGlobal::device, &memAllocInfo, nullptr, &stagingMemory );
-    AE3D_CHECK_VULKAN( err, "vkAllocateMemory" );
-
-    debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)stagingMemory, VK_OBJECT_TYPE_DEVICE_MEMORY, "texture2d staging memory" );
+    const VkDeviceSize stagingMemoryOffset = VulkanAllocator::AllocateBufferMemory( stagingBuffer, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, stagingMemory );
 
-    err = vkBindBufferMemory( GfxDeviceGlobal::device, stagingBuffer, stagingMemory, 0 );
-    AE3D_CHECK_VULKAN( err, "vkBindBufferMemory staging" );
-
-    void* stagingData;
-    err = vkMapMemory( GfxDeviceGlobal::device, stagingMemory, 0, memAllocInfo.allocationSize, 0, &stagingData );
-    AE3D_CHECK_VULKAN( err, "vkMapMemory in Texture2D" );
+    void* stagingData = VulkanAllocator::GetMappedData( stagingMemory, stagingMemoryOffset );
     
     if (data)
     {
@@ -550,12 +561,10 @@ void ae3d::Texture2D::CreateVulkanObjects( void* data, int bytesPerPixel, VkForm
     VkMappedMemoryRange flushRange = {};
     flushRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
     flushRange.memory = stagingMemory;
-    flushRange.offset = 0;
-    flushRange.size = VK_WHOLE_SIZE;
+    flushRange.offset = stagingMemoryOffset;
+    flushRange.size = VulkanAllocator::GetAllocationSize( stagingMemory, stagingMemoryOffset );
     vkFlushMappedMemoryRanges( GfxDeviceGlobal::device, 1, &flushRange );
 
-    vkUnmapMemory( GfxDeviceGlobal::device, stagingMemory );
-
     VkImageViewCreateInfo viewInfo = {};
     viewInfo.sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO;
     viewInfo.viewType = VK_IMAGE_VIEW_TYPE_2D;
@@ -728,7 +737,7 @@ void ae3d::Texture2D::CreateVulkanObjects( void* data, int bytesPerPixel, VkForm
 
     vkDeviceWaitIdle( GfxDeviceGlobal::device );
     vkDestroyBuffer( GfxDeviceGlobal::device, stagingBuffer, nullptr );
-    vkFreeMemory( GfxDeviceGlobal::device, stagingMemory, nullptr );
+    VulkanAllocator::Free( stagingMemory, stagingMemoryOffset );
 
     VkSamplerCreateInfo samplerInfo = {};
     samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
@@ -908,9 +917,9 @@ void ae3d::Texture2D::SetLayouts( Texture2D* textures[], TextureLayout layouts[]
     Statistics::IncQueueSubmitCalls();
 
     // FIXME: This is slow
-    System::BeginTimer();
+    Profiler::BeginZone( "Queue wait" );
 	err = vkQueueWaitIdle( GfxDeviceGlobal::graphicsQueue );
-    Statistics::IncQueueWaitTime( System::EndTimer() );
+    Statistics::IncQueueWaitTime( Profiler::EndZone() );
 
 	AE3D_CHECK_VULKAN( err, "vkQueueWaitIdle" );
 }
@@ -6,8 +6,10 @@
 #include <cstdint>
 #include "Array.hpp"
 #include "Macros.hpp"
+#include "Profiler.hpp"
 #include "Statistics.hpp"
 #include "System.hpp"
+#include "VulkanAllocator.hpp"
 #include "VulkanUtils.hpp"
 
 namespace GfxDeviceGlobal
@@ -15,6 +17,7 @@ namespace GfxDeviceGlobal
     extern VkDevice device;
     extern Array< VkBuffer > pendingFreeVBs;
     extern Array< VkDeviceMemory > pendingFreeMemory;
+    extern Array< VkDeviceSize > pendingFreeMemoryOffsets;
     extern VkCommandPool cmdPool;
     extern VkQueue graphicsQueue;
 }
@@ -22,7 +25,6 @@ namespace GfxDeviceGlobal
 namespace VertexBufferGlobal
 {
     std::vector< VkBuffer > buffersToReleaseAtExit;
-    std::vector< VkDeviceMemory > memoryToReleaseAtExit;
 }
 
 ae3d::VertexBuffer::Buffer ae3d::VertexBuffer::globalStagingBuffer;
@@ -34,10 +36,7 @@ void ae3d::VertexBuffer::DestroyBuffers()
         vkDestroyBuffer( GfxDeviceGlobal::device, VertexBufferGlobal::buffersToReleaseAtExit[ bufferIndex ], nullptr );
     }
 
-    for (std::size_t memoryIndex = 0; memoryIndex < VertexBufferGlobal::memoryToReleaseAtExit.size(); ++memoryIndex)
-    {
-        vkFreeMemory( GfxDeviceGlobal::device, VertexBufferGlobal::memoryToReleaseAtExit[ memoryIndex ], nullptr );
-    }
+    // Memory is owned by VulkanAllocator blocks which are freed in VulkanAllocator::DestroyBlocks().
 }
 
 void ae3d::VertexBuffer::SetDebugName( const char* name )
@@ -81,16 +80,16 @@ void CopyBuffer( VkBuffer source, VkBuffer& destination, int bufferSize )
     AE3D_CHECK_VULKAN( err, "submit staging VB copy" );
     Statistics::IncQueueSubmitCalls();
 
-    ae3d::System::BeginTimer();
+    Profiler::BeginZone( "Queue wait" );
     err = vkQueueWaitIdle( GfxDeviceGlobal::graphicsQueue );
-    Statistics::IncQueueWaitTime( ae3d::System::EndTimer() );
+    Statistics::IncQueueWaitTime( Profiler::EndZone() );
 
     AE3D_CHECK_VULKAN( err, "wait after staging VB copy" );
 
     vkFreeCommandBuffers( GfxDeviceGlobal::device, cmdBufInfo.commandPool, 1, &copyCommandBuffer );
 }
 
-void CreateBuffer( VkBuffer& buffer, int bufferSize, VkDeviceMemory& memory, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryFlags, const char* debugName )
+void CreateBuffer( VkBuffer& buffer, int bufferSize, VkDeviceMemory& memory, VkDeviceSize& memoryOffset, VkBufferUsageFlags usageFlags, VkMemoryPropertyFlags memoryFlags, const char* debugName )
 {
     VkBufferCreateInfo bufferInfo = {};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -100,43 +99,11 @@ void CreateBuffer( VkBuffer& buffer, int bufferSize, VkDeviceMemory& memory, VkB
     AE3D_CHECK_VULKAN( err, "vkCreateBuffer" );
     debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)buffer, VK_OBJECT_TYPE_BUFFER, debugName );
 
-    VkMemoryRequirements memReqs;
-    VkMemoryAllocateInfo memAlloc = {};
-    memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-
-    vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, buffer, &memReqs );
-    memAlloc.allocationSize = memReqs.size;
-    memAlloc.memoryTypeIndex = ae3d::GetMemoryType( memReqs.memoryTypeBits, memoryFlags );
-    err = vkAllocateMemory( GfxDeviceGlobal::device, &memAlloc, nullptr, &memory );
-    AE3D_CHECK_VULKAN( err, "vkAllocateMemory" );
-
-    debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)memory, VK_OBJECT_TYPE_DEVICE_MEMORY, debugName );
-
-    Statistics::IncAllocCalls();
-    Statistics::IncTotalAllocCalls();
-
-    err = vkBindBufferMemory( GfxDeviceGlobal::device, buffer, memory, 0 );
-    AE3D_CHECK_VULKAN( err, "vkBindBufferMemory" );
+    memoryOffset = VulkanAllocator::AllocateBufferMemory( buffer, memoryFlags, memory );
 }
 
-void MarkForFreeing( VkBuffer vertexBuffer, VkDeviceMemory vertexMem, VkBuffer indexBuffer, VkDeviceMemory indexMem )
+void MarkForFreeing( VkBuffer vertexBuffer, VkDeviceMemory vertexMem, VkDeviceSize vertexMemOffset, VkBuffer indexBuffer, VkDeviceMemory indexMem, VkDeviceSize indexMemOffset )
 {
-    for (std::size_t memoryIndex = 0; memoryIndex < VertexBufferGlobal::memoryToReleaseAtExit.size(); ++memoryIndex)
-    {
-        if (VertexBufferGlobal::memoryToReleaseAtExit[ memoryIndex ] == vertexMem)
-        {
-            VertexBufferGlobal::memoryToReleaseAtExit.erase( std::begin( VertexBufferGlobal::memoryToReleaseAtExit ) + memoryIndex );
-        }
-    }
-
-    for (std::size_t memoryIndex = 0; memoryIndex < VertexBufferGlobal::memoryToReleaseAtExit.size(); ++memoryIndex)
-    {
-        if (VertexBufferGlobal::memoryToReleaseAtExit[ memoryIndex ] == indexMem)
-        {
-            VertexBufferGlobal::memoryToReleaseAtExit.erase( std::begin( VertexBufferGlobal::memoryToReleaseAtExit ) + memoryIndex );
-        }
-    }
-
     for (std::size_t bufferIndex = 0; bufferIndex < VertexBufferGlobal::buffersToReleaseAtExit.size(); ++bufferIndex)
     {
         if (VertexBufferGlobal::buffersToReleaseAtExit[ bufferIndex ] == vertexBuffer)
@@ -154,7 +121,9 @@ void MarkForFreeing( VkBuffer vertexBuffer, VkDeviceMemory vertexMem, VkBuffer i
     }
 
     GfxDeviceGlobal::pendingFreeMemory.Add( vertexMem );
+    GfxDeviceGlobal::pendingFreeMemoryOffsets.Add( vertexMemOffset );
     GfxDeviceGlobal::pendingFreeMemory.Add( indexMem );
+    GfxDeviceGlobal::pendingFreeMemoryOffsets.Add( indexMemOffset );
     GfxDeviceGlobal::pendingFreeVBs.Add( vertexBuffer );
     GfxDeviceGlobal::pendingFreeVBs.Add( indexBuffer );
 }
@@ -167,7 +136,7 @@ void ae3d::VertexBuffer::GenerateVertexBuffer( const void* vertexData, int verte
 
     if (vertexBuffer != VK_NULL_HANDLE)
     {
-        MarkForFreeing( vertexBuffer, vertexMem, indexBuffer, indexMem );
+        MarkForFreeing( vertexBuffer, vertexMem, vertexMemOffset, indexBuffer, indexMem, indexMemOffset );
     }
 
     // Vertex buffer
@@ -175,37 +144,33 @@ void ae3d::VertexBuffer::GenerateVertexBuffer( const void* vertexData, int verte
 
     if (shouldCreateStagingBuffer)
     {
+        // CopyBuffer() waits until the queue is idle, so the old staging buffer is not in use anymore.
+        if (globalStagingBuffer.buffer != VK_NULL_HANDLE)
+        {
+            vkDestroyBuffer( GfxDeviceGlobal::device, globalStagingBuffer.buffer, nullptr );
+            VulkanAllocator::Free( globalStagingBuffer.memory, globalStagingBuffer.memoryOffset );
+        }
+
         globalStagingBuffer.size = vertexBufferSize > indexBufferSize ? vertexBufferSize : indexBufferSize;
-        CreateBuffer( globalStagingBuffer.buffer, globalStagingBuffer.size, globalStagingBuffer.memory, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "global staging buffer" );
-        //VertexBufferGlobal::buffersToReleaseAtExit.push_back( stagingBuffers.vertices.buffer );
-        //VertexBufferGlobal::memoryToReleaseAtExit.push_back( stagingBuffers.vertices.memory );
+        CreateBuffer( globalStagingBuffer.buffer, globalStagingBuffer.size, globalStagingBuffer.memory, globalStagingBuffer.memoryOffset, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "global staging buffer" );
+        globalStagingBuffer.mappedData = VulkanAllocator::GetMappedData( globalStagingBuffer.memory, globalStagingBuffer.memoryOffset );
     }
     
-    void* bufferData = nullptr;
-    VkResult err = vkMapMemory( GfxDeviceGlobal::device, globalStagingBuffer.memory, 0, vertexBufferSize, 0, &bufferData );
-    AE3D_CHECK_VULKAN( err, "map vertex memory" );
-
-    std::memcpy( bufferData, vertexData, vertexBufferSize );
-    vkUnmapMemory( GfxDeviceGlobal::device, globalStagingBuffer.memory );
+    std::memcpy( globalStagingBuffer.mappedData, vertexData, vertexBufferSize );
 
+    // Storage usage lets the skinning pre-pass read skinned vertices and write its results.
     {
-        CreateBuffer( vertexBuffer, vertexBufferSize, vertexMem, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "vertex buffer" );
+        CreateBuffer( vertexBuffer, vertexBufferSize, vertexMem, vertexMemOffset, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "vertex buffer" );
         VertexBufferGlobal::buffersToReleaseAtExit.push_back( vertexBuffer );
-        VertexBufferGlobal::memoryToReleaseAtExit.push_back( vertexMem );
     }
     
     CopyBuffer( globalStagingBuffer.buffer, vertexBuffer, vertexBufferSize );
     
-    err = vkMapMemory( GfxDeviceGlobal::device, globalStagingBuffer.memory, 0, indexBufferSize, 0, &bufferData );
-    AE3D_CHECK_VULKAN( err, "map staging index memory" );
-
-    std::memcpy( bufferData, indexData, indexBufferSize );
-    vkUnmapMemory( GfxDeviceGlobal::device, globalStagingBuffer.memory );
+    std::memcpy( globalStagingBuffer.mappedData, indexData, indexBufferSize );
 
     {
-        CreateBuffer( indexBuffer, indexBufferSize, indexMem, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "index buffer" );
+        CreateBuffer( indexBuffer, indexBufferSize, indexMem, indexMemOffset, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, "index buffer" );
         VertexBufferGlobal::buffersToReleaseAtExit.push_back( indexBuffer );
-        VertexBufferGlobal::memoryToReleaseAtExit.push_back( indexMem );
     }
     
     CopyBuffer( globalStagingBuffer.buffer, indexBuffer, indexBufferSize );
@@ -363,17 +328,23 @@ void ae3d::VertexBuffer::GenerateDynamic( int faceCount, int vertexCount )
     vertexFormat = VertexFormat::PTNTC;
     elementCount = faceCount * 3;
 
-    CreateBuffer( stagingBuffers.vertices.buffer, vertexCount * sizeof( VertexPTNTC ), stagingBuffers.vertices.memory, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "dynamic vertex buffer" );
-    stagingBuffers.vertices.size = vertexCount * sizeof( VertexPTNTC );
+    // Growing a dynamic buffer replaces it. The old buffers may still be used by the frame in flight, so they are freed after present.
+    if (stagingBuffers.vertices.buffer != VK_NULL_HANDLE)
+    {
+        MarkForFreeing( stagingBuffers.vertices.buffer, stagingBuffers.vertices.memory, stagingBuffers.vertices.memoryOffset,
+                        stagingBuffers.indices.buffer, stagingBuffers.indices.memory, stagingBuffers.indices.memoryOffset );
+    }
 
-    VkResult err = vkMapMemory( GfxDeviceGlobal::device, stagingBuffers.vertices.memory, 0, stagingBuffers.vertices.size, 0, &stagingBuffers.vertices.mappedData );
-    AE3D_CHECK_VULKAN( err, "vkMapMemory GenerateDynamic" );
+    CreateBuffer( stagingBuffers.vertices.buffer, vertexCount * sizeof( VertexPTNTC ), stagingBuffers.vertices.memory, stagingBuffers.vertices.memoryOffset, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "dynamic vertex buffer" );
+    stagingBuffers.vertices.size = vertexCount * sizeof( VertexPTNTC );
+    stagingBuffers.vertices.mappedData = VulkanAllocator::GetMappedData( stagingBuffers.vertices.memory, stagingBuffers.vertices.memoryOffset );
 
-    CreateBuffer( stagingBuffers.indices.buffer, elementCount * 2, stagingBuffers.indices.memory, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "dynamic index buffer" );
+    CreateBuffer( stagingBuffers.indices.buffer, elementCount * 2, stagingBuffers.indices.memory, stagingBuffers.indices.memoryOffset, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, "dynamic index buffer" );
     stagingBuffers.indices.size = elementCount * 2;
+    stagingBuffers.indices.mappedData = VulkanAllocator::GetMappedData( stagingBuffers.indices.memory, stagingBuffers.indices.memoryOffset );
 
-    err = vkMapMemory( GfxDeviceGlobal::device, stagingBuffers.indices.memory, 0, stagingBuffers.indices.size, 0, &stagingBuffers.indices.mappedData );
-    AE3D_CHECK_VULKAN( err, "vkMapMemory GenerateDynamic" );
+    VertexBufferGlobal::buffersToReleaseAtExit.push_back( stagingBuffers.vertices.buffer );
+    VertexBufferGlobal::buffersToReleaseAtExit.push_back( stagingBuffers.indices.buffer );
 
     vertexBuffer = stagingBuffers.vertices.buffer;
     indexBuffer = stagingBuffers.indices.buffer;
@@ -405,6 +376,24 @@ void ae3d::VertexBuffer::UpdateDynamic( const Face* faces, int faceCount, const
     std::memcpy( stagingBuffers.vertices.mappedData, verticesPTNTC.elements, vertexCount * sizeof( VertexPTNTC ) );
 }
 
+void ae3d::VertexBuffer::UpdateDynamic( const Face* faces, int faceCount, const VertexPTNTC* vertices, int vertexCount )
+{
+    System::Assert( stagingBuffers.indices.mappedData != nullptr, "Index buffer not initialized!" );
+    System::Assert( stagingBuffers.indices.size >= faceCount * 3 * 2, "Index buffer too small!" );
+    System::Assert( (std::size_t)stagingBuffers.vertices.size >= vertexCount * sizeof( VertexPTNTC ), "Vertex buffer too small!" );
+
+    std::memcpy( stagingBuffers.indices.mappedData, faces, faceCount * 3 * 2 );
+    std::memcpy( stagingBuffers.vertices.mappedData, vertices, vertexCount * sizeof( VertexPTNTC ) );
+}
+
+void ae3d::VertexBuffer::UpdateDynamicVertices( const VertexPTNTC* vertices, int firstVertex, int vertexCount )
+{
+    System::Assert( stagingBuffers.vertices.mappedData != nullptr, "Vertex buffer not initialized!" );
+    System::Assert( (std::size_t)stagingBuffers.vertices.size >= (firstVertex + vertexCount) * sizeof( VertexPTNTC ), "Vertex buffer too small!" );
+
+    std::memcpy( static_cast< char* >( stagingBuffers.vertices.mappedData ) + firstVertex * sizeof( VertexPTNTC ), vertices, vertexCount * sizeof( VertexPTNTC ) );
+}
+
 void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const VertexPTC* vertices, int vertexCount, Storage /*storage*/ )
 {
     vertexFormat = VertexFormat::PTNTC;
@@ -460,3 +449,25 @@ void ae3d::VertexBuffer::Generate( const Face* faces, int faceCount, const Verte
     elementCount = faceCount * 3;
     GenerateVertexBuffer( static_cast< const void*>( vertices ), vertexCount * sizeof( VertexPTNTC_Skinned ), sizeof( VertexPTNTC_Skinned ), static_cast< const void*>( faces ), elementCount * 2 );
 }
+
+void ae3d::VertexBuffer::GenerateWritable( const Face* faces, int faceCount, int vertexCount )
+{
+    vertexFormat = VertexFormat::PTNTC;
+    elementCount = faceCount * 3;
+
+    // Contents are overwritten by the compute shader, but they are initialized so that the buffer is never drawn with garbage.
+    Array< VertexPTNTC > verticesPTNTC2;
+    verticesPTNTC2.Allocate( vertexCount );
+
+    for (unsigned vertexInd = 0; vertexInd < verticesPTNTC2.count; ++vertexInd)
+    {
+        verticesPTNTC2[ vertexInd ].position = Vec3( 0, 0, 0 );
+        verticesPTNTC2[ vertexInd ].u = 0;
+        verticesPTNTC2[ vertexInd ].v = 0;
+        verticesPTNTC2[ vertexInd ].normal = Vec3( 0, 0, 1 );
+        verticesPTNTC2[ vertexInd ].tangent = Vec4( 1, 0, 0, 0 );
+        verticesPTNTC2[ vertexInd ].color = Vec4( 1, 1, 1, 1 );
+    }
+
+    GenerateVertexBuffer( static_cast< const void*>( verticesPTNTC2.elements ), vertexCount * sizeof( VertexPTNTC ), sizeof( VertexPTNTC ), static_cast< const void*>( faces ), elementCount * 2 );
+}
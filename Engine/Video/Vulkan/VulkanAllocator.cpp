@@ -0,0 +1,318 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "VulkanAllocator.hpp"
+#include <map>
+#include <vector>
+#include "Macros.hpp"
+#include "Statistics.hpp"
+#include "System.hpp"
+#include "VulkanUtils.hpp"
+
+namespace GfxDeviceGlobal
+{
+    extern VkDevice device;
+    extern VkPhysicalDeviceProperties properties;
+    extern VkPhysicalDeviceMemoryProperties deviceMemoryProperties;
+}
+
+namespace VulkanAllocatorGlobal
+{
+    enum class SizeClass { Small, Large, Dedicated };
+
+    // Requests up to this size go to small blocks so that UBOs and small buffers don't fragment texture blocks.
+    const VkDeviceSize SmallAllocationLimit = 512 * 1024;
+    const VkDeviceSize SmallBlockSize = 8 * 1024 * 1024;
+    const VkDeviceSize LargeAllocationLimit = 32 * 1024 * 1024;
+    const VkDeviceSize LargeBlockSize = 64 * 1024 * 1024;
+
+    struct Range
+    {
+        VkDeviceSize offset;
+        VkDeviceSize size;
+    };
+
+    struct Block
+    {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VkDeviceSize size = 0;
+        VkDeviceSize usedBytes = 0;
+        std::uint32_t memoryTypeIndex = 0;
+        bool isImage = false;
+        SizeClass sizeClass = SizeClass::Small;
+        std::uint8_t* mappedData = nullptr;
+        std::vector< Range > freeRanges; // Sorted by offset, adjacent ranges are always merged.
+        std::map< VkDeviceSize, VkDeviceSize > allocations; // offset -> size
+    };
+
+    std::vector< Block > blocks;
+}
+
+namespace
+{
+    VkDeviceSize AlignUp( VkDeviceSize value, VkDeviceSize alignment )
+    {
+        return (value + alignment - 1) & ~(alignment - 1);
+    }
+
+    int FindBlock( VkDeviceMemory memory )
+    {
+        for (std::size_t blockIndex = 0; blockIndex < VulkanAllocatorGlobal::blocks.size(); ++blockIndex)
+        {
+            if (VulkanAllocatorGlobal::blocks[ blockIndex ].memory == memory)
+            {
+                return (int)blockIndex;
+            }
+        }
+
+        return -1;
+    }
+
+    int CreateBlock( VkDeviceSize size, std::uint32_t memoryTypeIndex, bool isImage, VulkanAllocatorGlobal::SizeClass sizeClass )
+    {
+        VulkanAllocatorGlobal::Block block;
+        block.size = size;
+        block.memoryTypeIndex = memoryTypeIndex;
+        block.isImage = isImage;
+        block.sizeClass = sizeClass;
+        block.freeRanges.push_back( { 0, size } );
+
+        VkMemoryAllocateInfo memAlloc = {};
+        memAlloc.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+        memAlloc.allocationSize = size;
+        memAlloc.memoryTypeIndex = memoryTypeIndex;
+        VkResult err = vkAllocateMemory( GfxDeviceGlobal::device, &memAlloc, nullptr, &block.memory );
+        AE3D_CHECK_VULKAN( err, "vkAllocateMemory allocator block" );
+        debug::SetObjectName( GfxDeviceGlobal::device, (std::uint64_t)block.memory, VK_OBJECT_TYPE_DEVICE_MEMORY, isImage ? "allocator image block" : "allocator buffer block" );
+
+        Statistics::IncAllocCalls();
+        Statistics::IncTotalAllocCalls();
+
+        // Blocks are shared by every request that resolves to this memory type, so mapping is decided by the type, not by the request.
+        // On UMA devices a device-local request can create a block that a later host-visible request reuses.
+        if (GfxDeviceGlobal::deviceMemoryProperties.memoryTypes[ memoryTypeIndex ].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+        {
+            void* mapped = nullptr;
+            err = vkMapMemory( GfxDeviceGlobal::device, block.memory, 0, VK_WHOLE_SIZE, 0, &mapped );
+            AE3D_CHECK_VULKAN( err, "vkMapMemory allocator block" );
+            block.mappedData = (std::uint8_t*)mapped;
+        }
+
+        VulkanAllocatorGlobal::blocks.push_back( block );
+        return (int)VulkanAllocatorGlobal::blocks.size() - 1;
+    }
+
+    bool AllocateFromBlock( VulkanAllocatorGlobal::Block& block, VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& outOffset )
+    {
+        for (std::size_t rangeIndex = 0; rangeIndex < block.freeRanges.size(); ++rangeIndex)
+        {
+            const VulkanAllocatorGlobal::Range range = block.freeRanges[ rangeIndex ];
+            const VkDeviceSize alignedOffset = AlignUp( range.offset, alignment );
+            const VkDeviceSize padding = alignedOffset - range.offset;
+
+            if (padding + size > range.size)
+            {
+                continue;
+            }
+
+            const VkDeviceSize remaining = range.size - padding - size;
+            block.freeRanges.erase( std::begin( block.freeRanges ) + rangeIndex );
+
+            // Tail first so that the ranges stay sorted after inserting the padding.
+            if (remaining > 0)
+            {
+                block.freeRanges.insert( std::begin( block.freeRanges ) + rangeIndex, { alignedOffset + size, remaining } );
+            }
+
+            if (padding > 0)
+            {
+                block.freeRanges.insert( std::begin( block.freeRanges ) + rangeIndex, { range.offset, padding } );
+            }
+
+            block.allocations[ alignedOffset ] = size;
+            block.usedBytes += size;
+            outOffset = alignedOffset;
+            return true;
+        }
+
+        return false;
+    }
+
+    VkDeviceSize Allocate( const VkMemoryRequirements& memReqs, VkMemoryPropertyFlags properties, bool isImage, VkDeviceMemory& outMemory )
+    {
+        const std::uint32_t memoryTypeIndex = ae3d::GetMemoryType( memReqs.memoryTypeBits, properties );
+
+        VkDeviceSize alignment = memReqs.alignment;
+
+        // Mapped ranges of non-coherent memory are flushed in nonCoherentAtomSize units, so neighbours must not share an atom.
+        if ((GfxDeviceGlobal::deviceMemoryProperties.memoryTypes[ memoryTypeIndex ].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && GfxDeviceGlobal::properties.limits.nonCoherentAtomSize > alignment)
+        {
+            alignment = GfxDeviceGlobal::properties.limits.nonCoherentAtomSize;
+        }
+
+        const VkDeviceSize size = AlignUp( memReqs.size, alignment );
+
+        VulkanAllocatorGlobal::SizeClass sizeClass = VulkanAllocatorGlobal::SizeClass::Dedicated;
+        VkDeviceSize blockSize = size;
+
+        if (size <= VulkanAllocatorGlobal::SmallAllocationLimit)
+        {
+            sizeClass = VulkanAllocatorGlobal::SizeClass::Small;
+            blockSize = VulkanAllocatorGlobal::SmallBlockSize;
+        }
+        else if (size <= VulkanAllocatorGlobal::LargeAllocationLimit)
+        {
+            sizeClass = VulkanAllocatorGlobal::SizeClass::Large;
+            blockSize = VulkanAllocatorGlobal::LargeBlockSize;
+        }
+
+        VkDeviceSize offset = 0;
+
+        if (sizeClass != VulkanAllocatorGlobal::SizeClass::Dedicated)
+        {
+            for (auto& block : VulkanAllocatorGlobal::blocks)
+            {
+                if (block.memoryTypeIndex == memoryTypeIndex && block.isImage == isImage && block.sizeClass == sizeClass &&
+                    block.size - block.usedBytes >= size && AllocateFromBlock( block, size, alignment, offset ))
+                {
+                    outMemory = block.memory;
+                    return offset;
+                }
+            }
+        }
+
+        const int blockIndex = CreateBlock( blockSize, memoryTypeIndex, isImage, sizeClass );
+        const bool allocated = AllocateFromBlock( VulkanAllocatorGlobal::blocks[ blockIndex ], size, alignment, offset );
+        ae3d::System::Assert( allocated, "new allocator block is too small" );
+
+        outMemory = VulkanAllocatorGlobal::blocks[ blockIndex ].memory;
+        return offset;
+    }
+}
+
+VkDeviceSize VulkanAllocator::AllocateBufferMemory( VkBuffer buffer, VkMemoryPropertyFlags properties, VkDeviceMemory& outMemory )
+{
+    VkMemoryRequirements memReqs;
+    vkGetBufferMemoryRequirements( GfxDeviceGlobal::device, buffer, &memReqs );
+
+    const VkDeviceSize offset = Allocate( memReqs, properties, false, outMemory );
+
+    VkResult err = vkBindBufferMemory( GfxDeviceGlobal::device, buffer, outMemory, offset );
+    AE3D_CHECK_VULKAN( err, "vkBindBufferMemory" );
+
+    return offset;
+}
+
+VkDeviceSize VulkanAllocator::AllocateImageMemory( VkImage image, VkMemoryPropertyFlags properties, VkDeviceMemory& outMemory )
+{
+    VkMemoryRequirements memReqs;
+    vkGetImageMemoryRequirements( GfxDeviceGlobal::device, image, &memReqs );
+
+    const VkDeviceSize offset = Allocate( memReqs, properties, true, outMemory );
+
+    VkResult err = vkBindImageMemory( GfxDeviceGlobal::device, image, outMemory, offset );
+    AE3D_CHECK_VULKAN( err, "vkBindImageMemory" );
+
+    return offset;
+}
+
+void* VulkanAllocator::GetMappedData( VkDeviceMemory memory, VkDeviceSize offset )
+{
+    const int blockIndex = FindBlock( memory );
+    ae3d::System::Assert( blockIndex != -1, "GetMappedData: memory is not owned by the allocator" );
+    ae3d::System::Assert( VulkanAllocatorGlobal::blocks[ blockIndex ].mappedData != nullptr, "GetMappedData: memory is not host-visible" );
+
+    return VulkanAllocatorGlobal::blocks[ blockIndex ].mappedData + offset;
+}
+
+VkDeviceSize VulkanAllocator::GetAllocationSize( VkDeviceMemory memory, VkDeviceSize offset )
+{
+    const int blockIndex = FindBlock( memory );
+    ae3d::System::Assert( blockIndex != -1, "GetAllocationSize: memory is not owned by the allocator" );
+
+    const auto& allocations = VulkanAllocatorGlobal::blocks[ blockIndex ].allocations;
+    const auto allocation = allocations.find( offset );
+    ae3d::System::Assert( allocation != std::end( allocations ), "GetAllocationSize: no allocation at offset" );
+
+    return allocation != std::end( allocations ) ? allocation->second : 0;
+}
+
+void VulkanAllocator::Free( VkDeviceMemory memory, VkDeviceSize offset )
+{
+    if (memory == VK_NULL_HANDLE)
+    {
+        return;
+    }
+
+    const int blockIndex = FindBlock( memory );
+    ae3d::System::Assert( blockIndex != -1, "Free: memory is not owned by the allocator" );
+
+    if (blockIndex == -1)
+    {
+        return;
+    }
+
+    VulkanAllocatorGlobal::Block& block = VulkanAllocatorGlobal::blocks[ blockIndex ];
+    const auto allocation = block.allocations.find( offset );
+    ae3d::System::Assert( allocation != std::end( block.allocations ), "Free: no allocation at offset, double free?" );
+
+    if (allocation == std::end( block.allocations ))
+    {
+        return;
+    }
+
+    const VkDeviceSize size = allocation->second;
+    block.allocations.erase( allocation );
+    block.usedBytes -= size;
+
+    if (block.sizeClass == VulkanAllocatorGlobal::SizeClass::Dedicated && block.allocations.empty())
+    {
+        vkFreeMemory( GfxDeviceGlobal::device, block.memory, nullptr );
+        VulkanAllocatorGlobal::blocks.erase( std::begin( VulkanAllocatorGlobal::blocks ) + blockIndex );
+        return;
+    }
+
+    std::size_t insertIndex = 0;
+
+    while (insertIndex < block.freeRanges.size() && block.freeRanges[ insertIndex ].offset < offset)
+    {
+        ++insertIndex;
+    }
+
+    block.freeRanges.insert( std::begin( block.freeRanges ) + insertIndex, { offset, size } );
+
+    // Merges with the next and previous range so that the free list doesn't fragment over time.
+    if (insertIndex + 1 < block.freeRanges.size() && offset + size == block.freeRanges[ insertIndex + 1 ].offset)
+    {
+        block.freeRanges[ insertIndex ].size += block.freeRanges[ insertIndex + 1 ].size;
+        block.freeRanges.erase( std::begin( block.freeRanges ) + insertIndex + 1 );
+    }
+
+    if (insertIndex > 0 && block.freeRanges[ insertIndex - 1 ].offset + block.freeRanges[ insertIndex - 1 ].size == offset)
+    {
+        block.freeRanges[ insertIndex - 1 ].size += block.freeRanges[ insertIndex ].size;
+        block.freeRanges.erase( std::begin( block.freeRanges ) + insertIndex );
+    }
+}
+
+void VulkanAllocator::GetStats( Stats& outStats )
+{
+    outStats = Stats();
+    outStats.blockCount = (unsigned)VulkanAllocatorGlobal::blocks.size();
+
+    for (const auto& block : VulkanAllocatorGlobal::blocks)
+    {
+        outStats.allocationCount += (unsigned)block.allocations.size();
+        outStats.usedBytes += block.usedBytes;
+        outStats.reservedBytes += block.size;
+    }
+}
+
+void VulkanAllocator::DestroyBlocks()
+{
+    for (const auto& block : VulkanAllocatorGlobal::blocks)
+    {
+        vkFreeMemory( GfxDeviceGlobal::device, block.memory, nullptr );
+    }
+
+    VulkanAllocatorGlobal::blocks.clear();
+}
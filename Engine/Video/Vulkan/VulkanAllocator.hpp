@@ -0,0 +1,50 @@
+#ifndef VULKAN_ALLOCATOR
+#define VULKAN_ALLOCATOR
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+
+/// Sub-allocates buffers and images from large VkDeviceMemory blocks instead of calling vkAllocateMemory per resource.
+/// Blocks are grouped by memory type, resource kind (linear buffers and optimal images never share a block, so
+/// bufferImageGranularity is respected) and size class. Requests bigger than the largest size class get a dedicated block.
+/// Blocks of host-visible memory types are mapped once when created and stay mapped, use GetMappedData() instead of vkMapMemory.
+namespace VulkanAllocator
+{
+    struct Stats
+    {
+        unsigned blockCount = 0;
+        unsigned allocationCount = 0;
+        VkDeviceSize usedBytes = 0;
+        VkDeviceSize reservedBytes = 0;
+    };
+
+    /// Allocates memory for a buffer and binds it.
+    /// \param buffer Buffer.
+    /// \param properties Memory properties.
+    /// \param outMemory Receives the block's memory.
+    /// \return Offset inside outMemory.
+    VkDeviceSize AllocateBufferMemory( VkBuffer buffer, VkMemoryPropertyFlags properties, VkDeviceMemory& outMemory );
+
+    /// Allocates memory for an image and binds it.
+    /// \param image Image.
+    /// \param properties Memory properties.
+    /// \param outMemory Receives the block's memory.
+    /// \return Offset inside outMemory.
+    VkDeviceSize AllocateImageMemory( VkImage image, VkMemoryPropertyFlags properties, VkDeviceMemory& outMemory );
+
+    /// \return Pointer to host-visible memory at offset. Memory stays mapped until the allocator is destroyed.
+    void* GetMappedData( VkDeviceMemory memory, VkDeviceSize offset );
+
+    /// \return Allocation size that was rounded up to alignment. Use it as the flush range size for non-coherent memory.
+    VkDeviceSize GetAllocationSize( VkDeviceMemory memory, VkDeviceSize offset );
+
+    /// Returns an allocation to its block's free list. Must not be called before the GPU has finished using the memory.
+    void Free( VkDeviceMemory memory, VkDeviceSize offset );
+
+    void GetStats( Stats& outStats );
+
+    /// Frees all blocks. Called at exit after all resources have been destroyed.
+    void DestroyBlocks();
+}
+
+#endif
@@ -0,0 +1,87 @@
+// This is an independent project of an individual developer. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++, C#, and Java: http://www.viva64.com
+#include "Window.hpp"
+#include "GfxDevice.hpp"
+
+// Headless window for the null renderer. There are no events and swapping buffers ends the recorded frame.
+
+namespace ae3d
+{
+    void CreateRenderer( int samples, bool apiValidation );
+}
+
+namespace WindowGlobal
+{
+    bool isOpen = false;
+    int windowWidth = 640;
+    int windowHeight = 480;
+}
+
+void PlatformInitGamePad()
+{
+}
+
+bool ae3d::Window::IsWayland()
+{
+    return false;
+}
+
+bool ae3d::Window::IsOpen()
+{
+    return WindowGlobal::isOpen;
+}
+
+void ae3d::Window::Create( int width, int height, WindowCreateFlags flags )
+{
+    WindowGlobal::windowWidth = width > 0 ? width : 640;
+    WindowGlobal::windowHeight = height > 0 ? height : 480;
+
+    GfxDevice::Init( WindowGlobal::windowWidth, WindowGlobal::windowHeight );
+
+    int samples = 1;
+
+    if (flags & ae3d::WindowCreateFlags::MSAA4)
+    {
+        samples = 4;
+    }
+    else if (flags & ae3d::WindowCreateFlags::MSAA8)
+    {
+        samples = 8;
+    }
+    else if (flags & ae3d::WindowCreateFlags::MSAA16)
+    {
+        samples = 16;
+    }
+
+    ae3d::CreateRenderer( samples, (flags & ae3d::WindowCreateFlags::ApiValidation) != 0 );
+    WindowGlobal::isOpen = true;
+}
+
+void ae3d::Window::SetTitle( const char* /*title*/ )
+{
+}
+
+void ae3d::Window::GetSize( int& outWidth, int& outHeight )
+{
+    outWidth = WindowGlobal::windowWidth;
+    outHeight = WindowGlobal::windowHeight;
+}
+
+void ae3d::Window::PumpEvents()
+{
+}
+
+bool ae3d::Window::IsKeyDown( KeyCode /*keyCode*/ )
+{
+    return false;
+}
+
+void ae3d::Window::SwapBuffers()
+{
+    GfxDevice::Present();
+}
+
+bool ae3d::Window::PollEvent( WindowEvent& /*outEvent*/ )
+{
+    return false;
+}
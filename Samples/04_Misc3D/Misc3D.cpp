@@ -917,6 +917,7 @@ int main()
     GameObject particleGo;
     particleGo.AddComponent< ParticleSystemComponent >();
     particleGo.GetComponent< ParticleSystemComponent >()->SetMaxParticles( 10000 );
+    particleGo.GetComponent< ParticleSystemComponent >()->SetEmissionRate( 2000 );
     particleGo.GetComponent< ParticleSystemComponent >()->SetColor( 1, 0, 0 );
     particleGo.AddComponent< TransformComponent >();
     particleGo.GetComponent< TransformComponent >()->SetLocalPosition( { 20, 40, 0 } );
@@ -1163,7 +1164,8 @@ int main()
 
         static int animationFrame = 0;
         ++animationFrame;
-        animatedGo.GetComponent< MeshRendererComponent >()->SetAnimationFrame( animationFrame );
+        // The animation is sampled at 24 fps and the sample runs at 60 fps, in-between frames are interpolated.
+        animatedGo.GetComponent< MeshRendererComponent >()->SetAnimationFrame( animationFrame * (24.0f / 60.0f) );
 
         if (animationFrame % 60 == 0)
         {
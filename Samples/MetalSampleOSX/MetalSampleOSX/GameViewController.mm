@@ -720,6 +720,7 @@ using namespace ae3d;
     particleGo.SetName( "ParticleSystem" );
     particleGo.AddComponent< ParticleSystemComponent >();
     particleGo.GetComponent< ParticleSystemComponent>()->SetMaxParticles( 2000 );
+    particleGo.GetComponent< ParticleSystemComponent>()->SetEmissionRate( 400 );
     //particleGo.GetComponent< ParticleSystemComponent>()->SetColor( 1.0f, 0.0f, 0.0f );
     particleGo.AddComponent< TransformComponent >();
     particleGo.GetComponent< TransformComponent >()->SetLocalPosition( ae3d::Vec3( 20, 0, 0 ) );
@@ -1106,7 +1107,8 @@ using namespace ae3d;
 
     static int animationFrame = 0;
     ++animationFrame;
-    animatedGo.GetComponent< MeshRendererComponent >()->SetAnimationFrame( animationFrame );
+    // The animation is sampled at 24 fps and the sample runs at 60 fps, in-between frames are interpolated.
+    animatedGo.GetComponent< MeshRendererComponent >()->SetAnimationFrame( animationFrame * (24.0f / 60.0f) );
 
     // Testing vertex buffer growing
     if (angle == 5)
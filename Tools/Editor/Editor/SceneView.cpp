@@ -255,59 +255,6 @@ float IntersectRayTriangles( const Vec3& origin, const Vec3& target, const Vec3*
     return -1;
 }
 
-static void GetMinMax( const Vec3* aPoints, int count, Vec3& outMin, Vec3& outMax )
-{
-    outMin = aPoints[ 0 ];
-    outMax = aPoints[ 0 ];
-
-    for (int i = 1, s = count; i < s; ++i)
-    {
-        const Vec3& point = aPoints[ i ];
-
-        if (point.x < outMin.x)
-        {
-            outMin.x = point.x;
-        }
-
-        if (point.y < outMin.y)
-        {
-            outMin.y = point.y;
-        }
-
-        if (point.z < outMin.z)
-        {
-            outMin.z = point.z;
-        }
-
-        if (point.x > outMax.x)
-        {
-            outMax.x = point.x;
-        }
-
-        if (point.y > outMax.y)
-        {
-            outMax.y = point.y;
-        }
-
-        if (point.z > outMax.z)
-        {
-            outMax.z = point.z;
-        }
-    }
-}
-
-static void GetCorners( const Vec3& min, const Vec3& max, Vec3 outCorners[ 8 ] )
-{
-    outCorners[ 0 ] = Vec3( min.x, min.y, min.z );
-    outCorners[ 1 ] = Vec3( max.x, min.y, min.z );
-    outCorners[ 2 ] = Vec3( min.x, max.y, min.z );
-    outCorners[ 3 ] = Vec3( min.x, min.y, max.z );
-    outCorners[ 4 ] = Vec3( max.x, max.y, min.z );
-    outCorners[ 5 ] = Vec3( min.x, max.y, max.z );
-    outCorners[ 6 ] = Vec3( max.x, max.y, max.z );
-    outCorners[ 7 ] = Vec3( max.x, min.y, max.z );
-}
-
 void GetColliders( GameObject& camera, CollisionFilter filter, int screenX, int screenY, int width, int height, float maxDistance, Array< GameObject* >& gameObjects, CollisionTest collisionTest, Array< CollisionInfo >& outColliders )
 {
     Vec3 rayOrigin, rayTarget;
@@ -329,18 +276,7 @@ void GetColliders( GameObject& camera, CollisionFilter filter, int screenX, int
         }
 
         auto meshLocalToWorld = go->GetComponent< TransformComponent >() ? go->GetComponent< TransformComponent >()->GetLocalMatrix() : Matrix44::identity;
-        Vec3 oMin, oMax;
-        Vec3 oAABB[ 8 ];
-        GetCorners( meshRenderer->GetMesh()->GetAABBMin(), meshRenderer->GetMesh()->GetAABBMax(), oAABB );
-
-        for (int v = 0; v < 8; ++v)
-        {
-            Matrix44::TransformPoint( oAABB[ v ], meshLocalToWorld, &oAABB[ v ] );
-        }
-
-        GetMinMax( oAABB, 8, oMin, oMax );
-
-        const float meshDistance = IntersectRayAABB( rayOrigin, rayTarget, oMin, oMax );
+        const float meshDistance = IntersectRayAABB( rayOrigin, rayTarget, meshRenderer->GetWorldAABBMin(), meshRenderer->GetWorldAABBMax() );
 
         if (0 < meshDistance && meshDistance < maxDistance)
         {
@@ -353,24 +289,12 @@ void GetColliders( GameObject& camera, CollisionFilter filter, int screenX, int
             for (unsigned subMeshIndex = 0; subMeshIndex < meshRenderer->GetMesh()->GetSubMeshCount(); ++subMeshIndex)
             {
                 Vec3 subMeshMin, subMeshMax;
-                Vec3 mAABB[ 8 ];
-
-                GetCorners( meshRenderer->GetMesh()->GetSubMeshAABBMin( subMeshIndex ), meshRenderer->GetMesh()->GetSubMeshAABBMax( subMeshIndex ), mAABB );
-
-                for (int v = 0; v < 8; ++v)
-                {
-                    Matrix44::TransformPoint( mAABB[ v ], meshLocalToWorld, &mAABB[ v ] );
-                }
-
-                GetMinMax( mAABB, 8, subMeshMin, subMeshMax );
+                meshRenderer->GetSubMeshWorldAABB( subMeshIndex, subMeshMin, subMeshMax );
 
                 Array< Vec3 > triangles;
                 meshRenderer->GetMesh()->GetSubMeshFlattenedTriangles( subMeshIndex, triangles );
                 
-                for (unsigned v = 0; v < triangles.count; ++v)
-                {
-                    Matrix44::TransformPoint( triangles[ v ], meshLocalToWorld, &triangles[ v ] );
-                }
+                Matrix44::TransformPoints( triangles.elements, (int)triangles.count, meshLocalToWorld, triangles.elements );
 
                 const float subMeshDistance = collisionTest == CollisionTest::AABB ? IntersectRayAABB( rayOrigin, rayTarget, subMeshMin, subMeshMax )
                                                                                    : IntersectRayTriangles( rayOrigin, rayTarget, triangles.elements, triangles.count );
@@ -651,6 +651,40 @@ void LoadFBX( const std::string& path )
     ProcessJointsAndAnimationsRecursively( rootNode );
 }
 
+// Compresses sampled joint transforms into keys. The error tolerance is relative to the model's size.
+void CompressAnimations()
+{
+    const float maxValue = 99999999.0f;
+    Vec3 aabbMin(  maxValue,  maxValue,  maxValue );
+    Vec3 aabbMax( -maxValue, -maxValue, -maxValue );
+
+    for (auto& mesh : gMeshes)
+    {
+        mesh.SolveAABB();
+        aabbMin = Vec3::Min2( aabbMin, mesh.aabbMin );
+        aabbMax = Vec3::Max2( aabbMax, mesh.aabbMax );
+    }
+
+    const float maxTranslationError = (aabbMax - aabbMin).Length() * JointAnimation::RelativeMaxTranslationError;
+    std::size_t matrixBytes = 0;
+    std::size_t keyBytes = 0;
+
+    for (auto& mesh : gMeshes)
+    {
+        for (auto& joint : mesh.joints)
+        {
+            joint.animation.Build( joint.animTransforms.data(), static_cast< int >( joint.animTransforms.size() ), maxTranslationError );
+            matrixBytes += joint.animTransforms.size() * sizeof( Matrix44 );
+            keyBytes += joint.animation.GetKeySizeInBytes();
+        }
+    }
+
+    if (matrixBytes > 0)
+    {
+        std::cout << "Compressed animation from " << matrixBytes << " to " << keyBytes << " bytes." << std::endl;
+    }
+}
+
 int main( int paramCount, char** params )
 {
     if (paramCount != 2)
@@ -682,6 +716,7 @@ int main( int paramCount, char** params )
     outFile = outFile.substr( 0, outFile.length() - 3 );
     outFile.append( "ae3d" );
 
+    CompressAnimations();
     WriteAe3d( outFile, VertexFormat::PTNTC );
     return 0;
 }
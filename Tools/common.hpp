@@ -15,6 +15,7 @@
 #include <vector>
 #include "Matrix.hpp"
 #include "Vec3.hpp"
+#include "../Engine/Core/JointAnimation.hpp"
 
 // Cache optimization code adapted from http://gameangst.com/wp-content/uploads/2009/03/forsythtriangleorderoptimizer.cpp
 
@@ -125,7 +126,9 @@ struct Joint
     ae3d::Matrix44 globalBindposeInverse;
     int parentIndex = -1;
     std::string name;
+    /// Sampled transforms, one per frame. Compressed into animation before writing.
     std::vector< ae3d::Matrix44 > animTransforms;
+    ae3d::JointAnimation animation;
 };
 
 struct BoneIndices
@@ -989,7 +992,7 @@ bool Mesh::AlmostEquals( const TexCoord& t1, const TexCoord& t2 ) const
  (2)        # of faces
  (*)        faces
  (2)        # of joints if magic number is >= a8
- (*)        joints
+ (*)        joints. Since b0 joint animations are stored as keys (see JointAnimation) instead of a matrix per frame.
  (1)    terminator byte: 100
  */
 
@@ -1048,7 +1051,7 @@ void WriteAe3d( const std::string& aOutFile, VertexFormat vertexFormat )
     }
 
     // The file starts with identification bytes.
-    const char* gAe3dVersion = "a9";
+    const char* gAe3dVersion = "b0";
     ofs.write( gAe3dVersion, 2 );
 
     ofs.write( reinterpret_cast< char* >( &aabbMin.x ), 3 * 4 );
@@ -1130,9 +1133,25 @@ void WriteAe3d( const std::string& aOutFile, VertexFormat vertexFormat )
                 const int jointNameLength = (int)gMeshes[ m ].joints[ j ].name.length();
                 ofs.write( (char*)&jointNameLength, sizeof( int ) );
                 ofs.write( reinterpret_cast<char*>((char*)gMeshes[m].joints[ j ].name.data()), jointNameLength );
-                const int animLength = (int)gMeshes[ m ].joints[ j ].animTransforms.size();
-                ofs.write( (char*)&animLength, sizeof( int ) );
-                ofs.write( (char*)&gMeshes[ m ].joints[ j ].animTransforms[ 0 ].m[ 0 ], gMeshes[ m ].joints[ j ].animTransforms.size() * sizeof( ae3d::Matrix44 ) );
+
+                const ae3d::JointAnimation& animation = gMeshes[ m ].joints[ j ].animation;
+                ofs.write( (char*)&animation.frameCount, sizeof( int ) );
+                ofs.write( (char*)&animation.translationMin, sizeof( ae3d::Vec3 ) );
+                ofs.write( (char*)&animation.translationRange, sizeof( ae3d::Vec3 ) );
+                ofs.write( (char*)&animation.scaleMin, sizeof( ae3d::Vec3 ) );
+                ofs.write( (char*)&animation.scaleRange, sizeof( ae3d::Vec3 ) );
+
+                unsigned short keyCount = (unsigned short)animation.rotationKeys.size();
+                ofs.write( (char*)&keyCount, 2 );
+                ofs.write( (char*)animation.rotationKeys.data(), keyCount * sizeof( ae3d::JointAnimation::RotationKey ) );
+
+                keyCount = (unsigned short)animation.translationKeys.size();
+                ofs.write( (char*)&keyCount, 2 );
+                ofs.write( (char*)animation.translationKeys.data(), keyCount * sizeof( ae3d::JointAnimation::Vec3Key ) );
+
+                keyCount = (unsigned short)animation.scaleKeys.size();
+                ofs.write( (char*)&keyCount, 2 );
+                ofs.write( (char*)animation.scaleKeys.data(), keyCount * sizeof( ae3d::JointAnimation::Vec3Key ) );
             }
         }
     }